@@ -128,6 +128,7 @@ testScripts = [
     'invalidtxrequest.py', # NOTE: needs dash_hash to pass
     'abandonconflict.py',
     'p2p-versionbits-warning.py',
+    'unixrpc.py',
 ]
 if ENABLE_ZMQ:
     testScripts.append('zmq_test.py')
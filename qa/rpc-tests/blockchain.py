@@ -60,6 +60,22 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(len(res[u'bestblock']), 64)
         assert_equal(len(res[u'hash_serialized_2']), 64)
 
+        # The commitment kept up to date agrees with the walk of the set
+        inc = node.gettxoutsetinfo(False)
+        assert_equal(inc['txouts'], res['txouts'])
+        assert_equal(inc['total_amount'], res['total_amount'])
+        assert_equal(inc['bestblock'], res['bestblock'])
+        assert_equal(inc['muhash'], res['muhash'])
+        assert 'transactions' not in inc
+
+        print("Test that dumptxoutset() writes the set it commits to")
+        dump = node.dumptxoutset('utxo.dat')
+        assert_equal(dump['coins_written'], inc['txouts'])
+        assert_equal(dump['base_hash'], inc['bestblock'])
+        assert_equal(dump['base_height'], 200)
+        assert_equal(dump['muhash'], inc['muhash'])
+        assert_raises(JSONRPCException, node.dumptxoutset, 'utxo.dat')
+
         print("Test that gettxoutsetinfo() works for blockchain with just the genesis block")
         b1hash = node.getblockhash(1)
         node.invalidateblock(b1hash)
@@ -71,6 +87,8 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res2['txouts'], 0)
         assert_equal(res2['bestblock'], node.getblockhash(0))
         assert_equal(len(res2['hash_serialized_2']), 64)
+        # The empty set
+        assert_equal(node.gettxoutsetinfo(False)['muhash'], 'dd5ad2a105c2d29495f577245c357409002329b9f4d6182c0af3dc2f462555c8')
 
         print("Test that gettxoutsetinfo() returns the same result after invalidate/reconsider block")
         node.reconsiderblock(b1hash)
@@ -82,6 +100,7 @@ class BlockchainTest(BitcoinTestFramework):
         assert_equal(res['txouts'], res3['txouts'])
         assert_equal(res['bestblock'], res3['bestblock'])
         assert_equal(res['hash_serialized_2'], res3['hash_serialized_2'])
+        assert_equal(node.gettxoutsetinfo(False)['muhash'], inc['muhash'])
 
     def _test_getblockheader(self):
         node = self.nodes[0]
@@ -32,9 +32,9 @@ def deser_uint256(f):
     return r
 
 #allows simple http get calls
-def http_get_call(host, port, path, response_object = 0):
+def http_get_call(host, port, path, response_object = 0, headers = {}):
     conn = httplib.HTTPConnection(host, port)
-    conn.request('GET', path)
+    conn.request('GET', path, headers=headers)
 
     if response_object:
         return conn.getresponse()
@@ -229,6 +229,21 @@ class RESTTest (BitcoinTestFramework):
         response_header_str = response_header.read()
         assert_equal(response_str[0:80], response_header_str)
 
+        # the binary block is sent from the block file, with byte ranges and the block hash as ETag
+        assert_equal(response.getheader('etag'), '"'+bb_hash+'"')
+        assert_equal(response.getheader('accept-ranges'), 'bytes')
+        response_range = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True, {'Range': 'bytes=0-79'})
+        assert_equal(response_range.status, 206)
+        assert_equal(response_range.getheader('content-range'), 'bytes 0-79/%d' % len(response_str))
+        assert_equal(response_range.read(), response_header_str)
+        response_range = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True, {'Range': 'bytes=-10'})
+        assert_equal(response_range.status, 206)
+        assert_equal(response_range.read(), response_str[-10:])
+        response_range = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True, {'Range': 'bytes=%d-' % len(response_str)})
+        assert_equal(response_range.status, 416)
+        response_cached = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+"bin", True, {'If-None-Match': '"'+bb_hash+'"'})
+        assert_equal(response_cached.status, 304)
+
         # check block hex format
         response_hex = http_get_call(url.hostname, url.port, '/rest/block/'+bb_hash+self.FORMAT_SEPARATOR+"hex", True)
         assert_equal(response_hex.status, 200)
@@ -337,5 +352,34 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         assert_equal(json_obj['bestblockhash'], bb_hash)
 
+        # /rest/blockhashbyheight/
+        height = self.nodes[0].getblockcount()
+        json_string = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/%d.json' % height)
+        assert_equal(json.loads(json_string)['blockhash'], bb_hash)
+        response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/%d.json' % (height + 1), True)
+        assert_equal(response.status, 404)
+
+        # /rest/blockrange/ returns the blocks concatenated and stops at the tip
+        blocks_bin = b''
+        for h in [height - 1, height]:
+            blocks_bin += http_get_call(url.hostname, url.port, '/rest/block/'+self.nodes[0].getblockhash(h)+self.FORMAT_SEPARATOR+"bin", True).read()
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/%d/%d.bin' % (height - 1, height + 10), True)
+        assert_equal(response.status, 200)
+        assert_equal(response.read(), blocks_bin)
+        response = http_get_call(url.hostname, url.port, '/rest/blockrange/%d/%d.bin' % (height + 1, height + 2), True)
+        assert_equal(response.status, 404)
+
+        # /rest/txs has a record per txid, null for unknown ones
+        txid = self.nodes[0].sendtoaddress(self.nodes[2].getnewaddress(), 1)
+        json_string = http_post_call(url.hostname, url.port, '/rest/txs.json', json.dumps([txid, '00'*32]))
+        json_obj = json.loads(json_string.decode('utf-8'))
+        assert_equal(len(json_obj), 2)
+        assert_equal(json_obj[0]['txid'], txid)
+        assert_equal(json_obj[1], None)
+        request_bin = b'\x02' + binascii.unhexlify(txid)[::-1] + b'\x00'*32
+        response_bin = http_post_call(url.hostname, url.port, '/rest/txs.bin', request_bin)
+        tx_bin = http_get_call(url.hostname, url.port, '/rest/tx/'+txid+self.FORMAT_SEPARATOR+"bin", True).read()
+        assert_equal(response_bin, b'\x01' + tx_bin + b'\x00')
+
 if __name__ == '__main__':
     RESTTest ().main ()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python2
+# Copyright (c) 2018 The Dash Core developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+from test_framework.mininode import ser_string, deser_string, ser_uint256
+from io import BytesIO
+import socket
+import stat
+import struct
+import time
+
+'''
+UnixRPCTest -- test the binary RPC transport of -rpcunixsocket (doc/unix-rpc.md)
+'''
+
+UNIX_RPC_BINARY = 0
+UNIX_RPC_JSON = 1
+UNIX_RPC_OK = 0
+UNIX_RPC_ERROR = 1
+MAX_UNIX_RPC_REQUEST_SIZE = 4 * 1024 * 1024
+
+def recv_all(sock, size):
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+# Send a request frame and return the id and status of the reply, and a stream of the rest
+def call(sock, req_id, fmt, method, params):
+    payload = struct.pack("<IB", req_id, fmt) + ser_string(method) + params
+    sock.sendall(struct.pack("<I", len(payload)) + payload)
+    header = recv_all(sock, 4)
+    assert(header is not None)
+    reply = BytesIO(recv_all(sock, struct.unpack("<I", header)[0]))
+    reply_id, status = struct.unpack("<IB", reply.read(5))
+    return reply_id, status, reply
+
+class UnixRPCTest(BitcoinTestFramework):
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self):
+        self.nodes = start_nodes(1, self.options.tmpdir, [["-rpcunixsocket"]])
+        self.is_network_split = False
+
+    def connect(self):
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.connect(self.socket_path)
+        return sock
+
+    def run_test(self):
+        node = self.nodes[0]
+        self.socket_path = os.path.join(self.options.tmpdir, "node0", "regtest", "rpc.sock")
+
+        print("Checking the socket is only accessible to its owner...")
+        mode = os.stat(self.socket_path).st_mode
+        assert(stat.S_ISSOCK(mode))
+        assert_equal(mode & (stat.S_IRWXG | stat.S_IRWXO), 0)
+
+        print("Calling methods with the JSON format...")
+        sock = self.connect()
+        reply_id, status, reply = call(sock, 1, UNIX_RPC_JSON, "getblockcount", ser_string("[]"))
+        assert_equal((reply_id, status), (1, UNIX_RPC_OK))
+        assert_equal(int(deser_string(reply)), node.getblockcount())
+        reply_id, status, reply = call(sock, 2, UNIX_RPC_JSON, "nosuchmethod", ser_string("[]"))
+        assert_equal((reply_id, status), (2, UNIX_RPC_ERROR))
+        assert_equal(struct.unpack("<i", reply.read(4))[0], -32601)
+        assert_equal(deser_string(reply), "Method not found")
+
+        print("Calling methods with the binary format...")
+        genesis_hash = node.getblockhash(0)
+        reply_id, status, reply = call(sock, 3, UNIX_RPC_BINARY, "getblock", ser_uint256(int(genesis_hash, 16)))
+        assert_equal((reply_id, status), (3, UNIX_RPC_OK))
+        assert_equal(bytes_to_hex_str(reply.read()), node.getblock(genesis_hash, False))
+        reply_id, status, reply = call(sock, 4, UNIX_RPC_BINARY, "decodescript", b"")
+        assert_equal((reply_id, status), (4, UNIX_RPC_ERROR))
+
+        print("Checking oversized requests close the connection...")
+        sock.sendall(struct.pack("<I", MAX_UNIX_RPC_REQUEST_SIZE + 1))
+        assert_equal(sock.recv(1), b"")
+        sock.close()
+
+        print("Stopping the node with an idle connection open...")
+        sock = self.connect()
+        start = time.time()
+        stop_node(node, 0)
+        assert(time.time() - start < 30)
+        assert(not os.path.exists(self.socket_path))
+        sock.close()
+
+        print("Restarting the node on the same socket...")
+        self.nodes[0] = start_node(0, self.options.tmpdir, ["-rpcunixsocket"])
+        sock = self.connect()
+        reply_id, status, reply = call(sock, 5, UNIX_RPC_JSON, "getbestblockhash", ser_string("[]"))
+        assert_equal((reply_id, status), (5, UNIX_RPC_OK))
+        assert_equal(deser_string(reply), '"%s"' % genesis_hash)
+        sock.close()
+
+if __name__ == '__main__':
+    UnixRPCTest().main()
@@ -11,6 +11,7 @@ from test_framework.test_framework import BitcoinTestFramework
 from test_framework.util import *
 import zmq
 import binascii
+import struct
 
 try:
     import http.client as httplib
@@ -53,6 +54,7 @@ class ZMQTest (BitcoinTestFramework):
         topic = msg[0]
         body = msg[1]
         blkhash = bytes_to_hex_str(body)
+        blkseq = struct.unpack('<I', msg[2])[0]
 
         assert_equal(genhashes[0], blkhash) #blockhash from generate must be equal to the hash received over zmq
 
@@ -67,6 +69,8 @@ class ZMQTest (BitcoinTestFramework):
             body = msg[1]
             if topic == b"hashblock":
                 zmqHashes.append(bytes_to_hex_str(body))
+                seq = struct.unpack('<I', msg[2])[0]
+                assert_equal(seq, blkseq + len(zmqHashes)) #sequence numbers count the messages of each topic
 
         for x in range(0,n):
             assert_equal(genhashes[x], zmqHashes[x]) #blockhash from generate must be equal to the hash received over zmq
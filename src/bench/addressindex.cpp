@@ -0,0 +1,239 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "base58.h"
+#include "chainparams.h"
+#include "random.h"
+#include "scheduler.h"
+#include "rpc/server.h"
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread.hpp>
+
+#include <univalue.h>
+
+static const int BENCH_ADDRESSES = 20000;
+static const int BENCH_ENTRIES_PER_ADDRESS = 4;
+static const int BENCH_PROBES = 1000;
+static const int BENCH_HOT_BLOCKS = 5000;
+static const int BENCH_HOT_ENTRIES_PER_BLOCK = 4;
+//! Addresses of a wallet queried at once, e.g. derived from an xpub
+static const int BENCH_WALLET_ADDRESSES = 5000;
+static const int BENCH_PAGE_SIZE = 1000;
+//! getaddressbalance calls of a JSON-RPC batch, as sent by a wallet service
+static const int BENCH_BATCH_SIZE = 200;
+
+static uint160 RandomAddressHash()
+{
+    uint256 hash = GetRandHash();
+    return uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20));
+}
+
+/** A block index database with a populated address index, shared by the benchmarks below */
+class AddressIndexSetup
+{
+public:
+    boost::filesystem::path pathTemp;
+    std::vector<std::string> vUsed;
+    std::vector<std::string> vUnused;
+    //! An address with many entries, like one of a pool or an exchange
+    uint160 hashHot;
+    std::vector<std::pair<uint160, int> > vWallet;
+    UniValue walletParams;
+    UniValue balanceBatch;
+    //! Stands in for the HTTP workers the entries of a batch are handed to
+    CScheduler scheduler;
+    boost::thread_group threadGroup;
+
+    AddressIndexSetup()
+    {
+        SelectParams(CBaseChainParams::MAIN);
+        pathTemp = GetTempPath() / strprintf("bench_dash_addressindex_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        boost::filesystem::create_directories(pathTemp / "blocks");
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+        fAddressIndex = true;
+        pblocktree = new CBlockTreeDB(8 << 20, false, true);
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+        for (int i = 0; i < BENCH_ADDRESSES; i++) {
+            uint160 hash = RandomAddressHash();
+            for (int j = 0; j < BENCH_ENTRIES_PER_ADDRESS; j++)
+                vIndex.push_back(std::make_pair(CAddressIndexKey(1, hash, i, j, GetRandHash(), 0, false), 1000));
+            if (i % (BENCH_ADDRESSES / BENCH_PROBES) == 0)
+                vUsed.push_back(CBitcoinAddress(CKeyID(hash)).ToString());
+            if (i % (BENCH_ADDRESSES / BENCH_WALLET_ADDRESSES) == 0)
+                vWallet.push_back(std::make_pair(hash, 1));
+        }
+        pblocktree->WriteAddressIndex(vIndex);
+
+        hashHot = RandomAddressHash();
+        for (int i = 0; i < BENCH_HOT_BLOCKS; i++) {
+            vIndex.clear();
+            for (int j = 0; j < BENCH_HOT_ENTRIES_PER_BLOCK; j++)
+                vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashHot, i, j, GetRandHash(), 0, false), 1000));
+            pblocktree->WriteAddressIndex(vIndex);
+        }
+        for (int i = 0; i < BENCH_PROBES; i++)
+            vUnused.push_back(CBitcoinAddress(CKeyID(RandomAddressHash())).ToString());
+
+        UniValue addresses(UniValue::VARR);
+        for (size_t i = 0; i < vWallet.size(); i++)
+            addresses.push_back(CBitcoinAddress(CKeyID(vWallet[i].first)).ToString());
+        UniValue request(UniValue::VOBJ);
+        request.push_back(Pair("addresses", addresses));
+        request.push_back(Pair("limit", BENCH_PAGE_SIZE));
+        walletParams = UniValue(UniValue::VARR);
+        walletParams.push_back(request);
+
+        balanceBatch = UniValue(UniValue::VARR);
+        for (int i = 0; i < BENCH_BATCH_SIZE; i++) {
+            UniValue params(UniValue::VARR);
+            params.push_back(vUsed[i % vUsed.size()]);
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("method", "getaddressbalance"));
+            entry.push_back(Pair("params", params));
+            entry.push_back(Pair("id", i));
+            balanceBatch.push_back(entry);
+        }
+        for (int i = 0; i < DEFAULT_RPC_BATCH_PARALLEL - 1; i++)
+            threadGroup.create_thread(boost::bind(&CScheduler::serviceQueue, &scheduler));
+
+        nAddressSeekThreads = DEFAULT_ADDRESS_SEEK_THREADS;
+        for (int i = 0; i < nAddressSeekThreads; i++)
+            threadGroup.create_thread(&ThreadAddressSeek);
+    }
+
+    ~AddressIndexSetup()
+    {
+        scheduler.stop();
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        nAddressSeekThreads = 0;
+        delete pblocktree;
+        pblocktree = NULL;
+        fAddressIndex = false;
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        boost::filesystem::remove_all(pathTemp);
+    }
+};
+
+static AddressIndexSetup& GetSetup()
+{
+    static AddressIndexSetup setup;
+    return setup;
+}
+
+static void GetAddressBalance(benchmark::State& state, const std::vector<std::string>& vAddresses)
+{
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        UniValue params(UniValue::VARR);
+        params.push_back(vAddresses[i++ % vAddresses.size()]);
+        getaddressbalance(params, false);
+    }
+}
+
+// Balance of addresses that never received anything, a common wallet and explorer query
+static void GetAddressBalanceUnused(benchmark::State& state)
+{
+    GetAddressBalance(state, GetSetup().vUnused);
+}
+
+static void GetAddressBalanceUsed(benchmark::State& state)
+{
+    GetAddressBalance(state, GetSetup().vUsed);
+}
+
+static void GetAddressBalanceHot(benchmark::State& state)
+{
+    GetAddressBalance(state, std::vector<std::string>(1, CBitcoinAddress(CKeyID(GetSetup().hashHot)).ToString()));
+}
+
+// What getaddressbalance did before address summaries: sum up every entry
+static void SumAddressIndexHot(benchmark::State& state)
+{
+    uint160 hashHot = GetSetup().hashHot;
+    while (state.KeepRunning()) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        pblocktree->ReadAddressIndex(hashHot, 1, addressIndex);
+        CAmount balance = 0;
+        for (size_t i = 0; i < addressIndex.size(); i++)
+            balance += addressIndex[i].second;
+        assert(balance == (CAmount)BENCH_HOT_BLOCKS * BENCH_HOT_ENTRIES_PER_BLOCK * 1000);
+    }
+}
+
+// The first page of the history of a whole wallet
+static void MergeAddressIndex(benchmark::State& state, bool fParallel)
+{
+    const std::vector<std::pair<uint160, int> >& vWallet = GetSetup().vWallet;
+    while (state.KeepRunning()) {
+        CAddressIndexMerger merger(*pblocktree, vWallet, true);
+        int nEntries = 0;
+        for (merger.Seek(fParallel); merger.Valid() && nEntries < BENCH_PAGE_SIZE; merger.Next())
+            nEntries++;
+        assert(nEntries == BENCH_PAGE_SIZE);
+    }
+}
+
+static void MergeAddressIndex5000Serial(benchmark::State& state)
+{
+    MergeAddressIndex(state, false);
+}
+
+static void MergeAddressIndex5000Parallel(benchmark::State& state)
+{
+    MergeAddressIndex(state, true);
+}
+
+static void GetAddressDeltas5000(benchmark::State& state)
+{
+    const UniValue& params = GetSetup().walletParams;
+    while (state.KeepRunning())
+        getaddressdeltas(params, false);
+}
+
+static bool ScheduleTask(const boost::function<void()>& func)
+{
+    GetSetup().scheduler.scheduleFromNow(func, 0);
+    return true;
+}
+
+static void ExecBalanceBatch(benchmark::State& state, int nParallel)
+{
+    const UniValue& batch = GetSetup().balanceBatch;
+    while (state.KeepRunning()) {
+        std::string strReply = JSONRPCExecBatch(batch, boost::bind(&ScheduleTask, _1), nParallel);
+        assert(!strReply.empty());
+    }
+}
+
+static void RPCBatchGetAddressBalanceSerial(benchmark::State& state)
+{
+    ExecBalanceBatch(state, 1);
+}
+
+static void RPCBatchGetAddressBalanceParallel(benchmark::State& state)
+{
+    ExecBalanceBatch(state, DEFAULT_RPC_BATCH_PARALLEL);
+}
+
+BENCHMARK(GetAddressBalanceUnused);
+BENCHMARK(GetAddressBalanceUsed);
+BENCHMARK(GetAddressBalanceHot);
+BENCHMARK(SumAddressIndexHot);
+BENCHMARK(MergeAddressIndex5000Serial);
+BENCHMARK(MergeAddressIndex5000Parallel);
+BENCHMARK(GetAddressDeltas5000);
+BENCHMARK(RPCBatchGetAddressBalanceSerial);
+BENCHMARK(RPCBatchGetAddressBalanceParallel);
@@ -0,0 +1,110 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "masternodeman.h"
+#include "netbase.h"
+#include "random.h"
+#include "script/standard.h"
+#include "timedata.h"
+#include "utiltime.h"
+#include "validation.h"
+
+//! Masternodes of the list, about the size of the mainnet list
+static const int BENCH_MASTERNODES = 5000;
+
+/** A list of enabled masternodes with their collaterals in the UTXO set, pinging every few minutes */
+class MasternodeListSetup
+{
+public:
+    CCoinsView viewDummy;
+    CCoinsViewCache* pcoinsTipOld;
+    std::vector<COutPoint> vOutpoints;
+    int64_t nTime;
+
+    MasternodeListSetup()
+    {
+        SelectParams(CBaseChainParams::MAIN);
+        pcoinsTipOld = pcoinsTip;
+        pcoinsTip = new CCoinsViewCache(&viewDummy);
+
+        nTime = GetTime();
+        SetMockTime(nTime);
+        for (int i = 0; i < BENCH_MASTERNODES; i++) {
+            COutPoint outpoint(GetRandHash(), 0);
+            uint256 hash = GetRandHash();
+            std::vector<unsigned char> vchPubKey(1, 0x02);
+            vchPubKey.insert(vchPubKey.end(), hash.begin(), hash.end());
+            CPubKey pubKey(vchPubKey);
+            pcoinsTip->AddCoin(outpoint, Coin(CTxOut(1000 * COIN, GetScriptForDestination(pubKey.GetID())), 1, false), false);
+
+            CMasternode mn(LookupNumeric("1.2.3.4", 9999), outpoint, pubKey, pubKey, PROTOCOL_VERSION);
+            mn.sigTime = nTime - 24 * 60 * 60;
+            mn.nTimeLastWatchdogVote = mn.sigTime;
+            mn.lastPing.vin = CTxIn(outpoint);
+            mn.lastPing.blockHash = GetRandHash();
+            mn.lastPing.sigTime = nTime - MASTERNODE_MIN_MNP_SECONDS + i * MASTERNODE_MIN_MNP_SECONDS / BENCH_MASTERNODES;
+            mnodeman.Add(mn);
+            vOutpoints.push_back(outpoint);
+        }
+        // The first scheduled check looks at the whole list once
+        mnodeman.CheckScheduled();
+    }
+
+    ~MasternodeListSetup()
+    {
+        mnodeman.Clear();
+        mnodeman.mapSeenMasternodePing.clear();
+        delete pcoinsTip;
+        pcoinsTip = pcoinsTipOld;
+        SetMockTime(0);
+    }
+
+    /** Advance the time by a second, with the pings which arrive in it */
+    void Tick()
+    {
+        SetMockTime(++nTime);
+        // Each masternode pings every MASTERNODE_MIN_MNP_SECONDS, in the order of vOutpoints
+        for (int64_t i = nTime * BENCH_MASTERNODES / MASTERNODE_MIN_MNP_SECONDS; i < (nTime + 1) * BENCH_MASTERNODES / MASTERNODE_MIN_MNP_SECONDS; i++) {
+            const COutPoint& outpoint = vOutpoints[i % BENCH_MASTERNODES];
+            CMasternodePing mnp;
+            mnp.vin = CTxIn(outpoint);
+            mnp.blockHash = GetRandHash();
+            mnp.sigTime = nTime;
+            mnodeman.SetMasternodeLastPing(outpoint, mnp);
+        }
+    }
+};
+
+static MasternodeListSetup& GetMasternodeListSetup()
+{
+    static MasternodeListSetup setup;
+    return setup;
+}
+
+// A second of the masternode thread as it was: a sweep over the whole list, with the pings of that second
+static void MasternodeCheckSweep(benchmark::State& state)
+{
+    MasternodeListSetup& setup = GetMasternodeListSetup();
+    while (state.KeepRunning()) {
+        setup.Tick();
+        mnodeman.Check();
+    }
+}
+
+// A second of it now: only the masternodes which pinged or have a deadline in that second
+static void MasternodeCheckScheduled(benchmark::State& state)
+{
+    MasternodeListSetup& setup = GetMasternodeListSetup();
+    while (state.KeepRunning()) {
+        setup.Tick();
+        mnodeman.CheckScheduled();
+    }
+}
+
+BENCHMARK(MasternodeCheckSweep);
+BENCHMARK(MasternodeCheckScheduled);
@@ -0,0 +1,303 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "arith_uint256.h"
+#include "blockcache.h"
+#include "blockfilemap.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/merkle.h"
+#include "pow.h"
+#include "primitives/block.h"
+#include "pubkey.h"
+#include "random.h"
+#include "rpc/protocol.h"
+#include "rpc/server.h"
+#include "script/standard.h"
+#include "streams.h"
+#include "unixrpc.h"
+#include "util.h"
+#include "utiltime.h"
+#include "validation.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+#include <univalue.h>
+
+extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSONStream(const CBlock& block, const UniValue& result, bool txDetails, CJSONStreamWriter& writer);
+
+//! Transactions of a full block, with two inputs and two outputs each
+static const int BENCH_BLOCK_TXS = 2500;
+//! Blocks written after the full block, to be read in turn like historical blocks
+static const int BENCH_HISTORICAL_BLOCKS = 10000;
+static const int BENCH_HISTORICAL_BLOCK_TXS = 10;
+
+static const CBlock& GetFullBlock()
+{
+    static CBlock block;
+    if (!block.vtx.empty())
+        return block;
+
+    SelectParams(CBaseChainParams::MAIN);
+    for (int i = 0; i < BENCH_BLOCK_TXS; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        tx.vout.resize(2);
+        for (int j = 0; j < 2; j++) {
+            tx.vin[j].prevout = COutPoint(GetRandHash(), j);
+            // Signature and public key of a P2PKH spend
+            std::vector<unsigned char> vchSig(72, 0x30), vchPubKey(33, 0x02);
+            tx.vin[j].scriptSig << vchSig << vchPubKey;
+            uint256 hash = GetRandHash();
+            tx.vout[j].nValue = 1000 + i;
+            tx.vout[j].scriptPubKey = GetScriptForDestination(CKeyID(uint160(std::vector<unsigned char>(hash.begin(), hash.begin() + 20))));
+        }
+        block.vtx.push_back(tx);
+    }
+    return block;
+}
+
+static void CountBytes(const std::string& strChunk, size_t& nBytes)
+{
+    nBytes += strChunk.size();
+}
+
+// What getblock <hash> 2 did before streaming: the whole result as tree and string
+static void GetBlockVerboseJSON(benchmark::State& state)
+{
+    const CBlock& block = GetFullBlock();
+    CBlockIndex index(block);
+    while (state.KeepRunning()) {
+        std::string strReply = blockToJSON(block, &index, true).write();
+        assert(!strReply.empty());
+    }
+}
+
+// Streamed, one decoded transaction and one chunk in memory at a time
+static void GetBlockVerboseJSONStream(benchmark::State& state)
+{
+    const CBlock& block = GetFullBlock();
+    CBlockIndex index(block);
+    size_t nExpected = blockToJSON(block, &index, true).write().size();
+    while (state.KeepRunning()) {
+        size_t nBytes = 0;
+        CJSONStreamWriter writer(boost::bind(&CountBytes, _1, boost::ref(nBytes)));
+        blockToJSONStream(block, blockToJSON(block, &index), true, writer);
+        writer.Flush();
+        assert(nBytes == nExpected);
+    }
+}
+
+/** The full block written to a block file, as served by /rest/block/<hash>.bin, followed by smaller blocks */
+class BlockFileSetup
+{
+public:
+    boost::filesystem::path pathTemp;
+    CBlock block;
+    uint256 hash;
+    CBlockIndex index;
+    std::vector<uint256> vHistoricalHashes;
+    std::vector<CBlockIndex> vHistoricalIndex;
+
+    BlockFileSetup()
+    {
+        pathTemp = GetTempPath() / strprintf("bench_dash_blockfile_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+
+        block = GetFullBlock();
+        const CChainParams& params = Params(CBaseChainParams::REGTEST);
+        block.nBits = UintToArith256(params.GetConsensus().powLimit).GetCompact();
+        while (!CheckProofOfWork(block.GetHash(), block.nBits, params.GetConsensus()))
+            block.nNonce++;
+
+        CDiskBlockPos pos(0, 0);
+        assert(WriteBlockToDisk(block, pos, params.MessageStart()));
+        index = CBlockIndex(block);
+        hash = block.GetHash();
+        index.phashBlock = &hash;
+        index.nFile = pos.nFile;
+        index.nDataPos = pos.nPos;
+        index.nStatus |= BLOCK_HAVE_DATA;
+        mapBlockIndex[hash] = &index;
+
+        const CBlock& blockFull = GetFullBlock();
+        vHistoricalHashes.resize(BENCH_HISTORICAL_BLOCKS);
+        vHistoricalIndex.resize(BENCH_HISTORICAL_BLOCKS);
+        pos.nPos += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        for (int i = 0; i < BENCH_HISTORICAL_BLOCKS; i++) {
+            CBlock blockHistorical;
+            blockHistorical.nBits = block.nBits;
+            blockHistorical.nTime = i;
+            blockHistorical.vtx.assign(blockFull.vtx.begin() + i % (BENCH_BLOCK_TXS - BENCH_HISTORICAL_BLOCK_TXS),
+                blockFull.vtx.begin() + i % (BENCH_BLOCK_TXS - BENCH_HISTORICAL_BLOCK_TXS) + BENCH_HISTORICAL_BLOCK_TXS);
+            blockHistorical.hashMerkleRoot = BlockMerkleRoot(blockHistorical);
+            while (!CheckProofOfWork(blockHistorical.GetHash(), blockHistorical.nBits, params.GetConsensus()))
+                blockHistorical.nNonce++;
+            assert(WriteBlockToDisk(blockHistorical, pos, params.MessageStart()));
+
+            CBlockIndex& indexHistorical = vHistoricalIndex[i];
+            indexHistorical = CBlockIndex(blockHistorical);
+            vHistoricalHashes[i] = blockHistorical.GetHash();
+            indexHistorical.phashBlock = &vHistoricalHashes[i];
+            indexHistorical.nFile = pos.nFile;
+            indexHistorical.nDataPos = pos.nPos;
+            indexHistorical.nStatus |= BLOCK_HAVE_DATA;
+            mapBlockIndex[vHistoricalHashes[i]] = &indexHistorical;
+            pos.nPos += ::GetSerializeSize(blockHistorical, SER_DISK, CLIENT_VERSION);
+        }
+    }
+
+    ~BlockFileSetup()
+    {
+        for (int i = 0; i < BENCH_HISTORICAL_BLOCKS; i++)
+            mapBlockIndex.erase(vHistoricalHashes[i]);
+        mapBlockIndex.erase(hash);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        boost::filesystem::remove_all(pathTemp);
+    }
+};
+
+static BlockFileSetup& GetBlockFileSetup()
+{
+    static BlockFileSetup setup;
+    return setup;
+}
+
+// What /rest/block/<hash>.bin did before: deserialize the block and serialize it again
+static void ReadBlockFromDiskSerialize(benchmark::State& state)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    while (state.KeepRunning()) {
+        CBlock block;
+        assert(ReadBlockFromDisk(block, &setup.index, Params(CBaseChainParams::REGTEST).GetConsensus()));
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+        assert(ssBlock.size() > 0);
+    }
+}
+
+// Read the stored bytes only, the reply is sent from the file by libevent
+static void ReadRawBlock(benchmark::State& state)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    while (state.KeepRunning()) {
+        unsigned int nSize;
+        FILE* file = OpenRawBlock(&setup.index, nSize);
+        assert(file);
+        std::vector<unsigned char> vData(nSize);
+        assert(fread(begin_ptr(vData), 1, nSize, file) == nSize);
+        fclose(file);
+    }
+}
+
+// A getblock call for the raw block over JSON-RPC, without the HTTP layer
+static void GetBlockRawJSONRPC(benchmark::State& state)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    std::string strRequest = strprintf("{\"method\": \"getblock\", \"params\": [\"%s\", 0], \"id\": 1}", setup.hash.GetHex());
+    // The block only has the proof of work of regtest
+    SelectParams(CBaseChainParams::REGTEST);
+    while (state.KeepRunning()) {
+        UniValue valRequest;
+        assert(valRequest.read(strRequest));
+        JSONRequest jreq;
+        jreq.parse(valRequest);
+        UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
+        std::string strReply = JSONRPCReply(result, NullUniValue, jreq.id);
+        assert(strReply.size() > 2 * ::GetSerializeSize(setup.block, SER_NETWORK, PROTOCOL_VERSION));
+    }
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+// The same call over the binary RPC socket, without the socket
+static void GetBlockRawUnixRPC(benchmark::State& state)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    CDataStream ssRequest(SER_NETWORK, PROTOCOL_VERSION);
+    ssRequest << (uint32_t)1 << (uint8_t)UNIX_RPC_BINARY << std::string("getblock") << setup.hash;
+    while (state.KeepRunning()) {
+        CDataStream request(ssRequest);
+        CDataStream reply(SER_NETWORK, PROTOCOL_VERSION);
+        ExecUnixRPCRequest(request, reply);
+        assert(reply.size() == 5 + ::GetSerializeSize(setup.block, SER_NETWORK, PROTOCOL_VERSION));
+    }
+}
+
+// getblock <hash> 0 over the historical blocks in turn, with the block files read as configured
+static void GetBlockHistorical(benchmark::State& state, int nBlockFileMaps)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    std::vector<std::string> vRequests;
+    for (int i = 0; i < BENCH_HISTORICAL_BLOCKS; i++)
+        vRequests.push_back(strprintf("[\"%s\", 0]", setup.vHistoricalHashes[i].GetHex()));
+    SelectParams(CBaseChainParams::REGTEST);
+    blockFileMaps.SetMaxFiles(nBlockFileMaps);
+    int i = 0;
+    while (state.KeepRunning()) {
+        UniValue params;
+        assert(params.read(vRequests[i++ % BENCH_HISTORICAL_BLOCKS]));
+        UniValue result = tableRPC.execute("getblock", params);
+        assert(result.get_str().size() > 160);
+    }
+    blockFileMaps.SetMaxFiles(0);
+    SelectParams(CBaseChainParams::MAIN);
+}
+
+// Each block read through a newly opened FILE
+static void GetBlockHistoricalFile(benchmark::State& state)
+{
+    GetBlockHistorical(state, 0);
+}
+
+// Each block deserialized straight from the mapped block file
+static void GetBlockHistoricalMapped(benchmark::State& state)
+{
+    GetBlockHistorical(state, DEFAULT_BLOCK_FILE_MAPS);
+}
+
+// The reply to a getdata for the tip block, up to the copy queued for the peer
+static void GetDataBlock(benchmark::State& state, size_t nRecentBlockCache)
+{
+    BlockFileSetup& setup = GetBlockFileSetup();
+    recentBlocks.SetMaxUsage(nRecentBlockCache);
+    recentBlocks.Add(setup.block);
+    while (state.KeepRunning()) {
+        std::shared_ptr<const CServedBlock> pblock = recentBlocks.GetOrRead(&setup.index, Params(CBaseChainParams::REGTEST).GetConsensus());
+        assert(pblock);
+        CSerializeData vSend(pblock->GetMessage().begin(), pblock->GetMessage().end());
+        assert(vSend.size() > CMessageHeader::HEADER_SIZE);
+    }
+    recentBlocks.SetMaxUsage(0);
+}
+
+// Read, serialized and checksummed for every request
+static void GetDataBlockFromDisk(benchmark::State& state)
+{
+    GetDataBlock(state, 0);
+}
+
+// The message assembled once for the connected block, then copied
+static void GetDataBlockRecent(benchmark::State& state)
+{
+    GetDataBlock(state, (size_t)DEFAULT_RECENT_BLOCK_CACHE << 20);
+}
+
+BENCHMARK(GetBlockVerboseJSON);
+BENCHMARK(GetBlockVerboseJSONStream);
+BENCHMARK(ReadBlockFromDiskSerialize);
+BENCHMARK(ReadRawBlock);
+BENCHMARK(GetBlockRawJSONRPC);
+BENCHMARK(GetBlockRawUnixRPC);
+BENCHMARK(GetBlockHistoricalFile);
+BENCHMARK(GetBlockHistoricalMapped);
+BENCHMARK(GetDataBlockFromDisk);
+BENCHMARK(GetDataBlockRecent);
@@ -0,0 +1,143 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "chainparams.h"
+#include "core_memusage.h"
+#include "crypto/common.h"
+#include "hash.h"
+#include "streams.h"
+#include "util.h"
+#include "validation.h"
+#include "version.h"
+
+#include <string.h>
+
+CRecentBlockCache recentBlocks;
+
+const CSerializeData& CServedBlock::GetMessage() const
+{
+    LOCK(cs);
+    if (vMessage.empty()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << CMessageHeader(Params().MessageStart(), NetMsgType::BLOCK, 0) << block;
+        // the size and checksum as CConnman::EndMessage sets them
+        WriteLE32((uint8_t*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], ss.size() - CMessageHeader::HEADER_SIZE);
+        uint256 hashData = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+        memcpy(&ss[CMessageHeader::CHECKSUM_OFFSET], hashData.begin(), CMessageHeader::CHECKSUM_SIZE);
+        vMessage.assign(ss.begin(), ss.end());
+    }
+    return vMessage;
+}
+
+const CSerializeData& CServedBlock::GetPayload() const
+{
+    LOCK(cs);
+    if (vPayload.empty()) {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << block;
+        vPayload.assign(ss.begin(), ss.end());
+    }
+    return vPayload;
+}
+
+const char* CServedBlock::GetSerialized() const
+{
+    if (fCached)
+        return &GetMessage()[CMessageHeader::HEADER_SIZE];
+    return &GetPayload()[0];
+}
+
+size_t CServedBlock::GetSerializedSize() const
+{
+    if (fCached)
+        return GetMessage().size() - CMessageHeader::HEADER_SIZE;
+    return GetPayload().size();
+}
+
+void CRecentBlockCache::Evict(size_t nMaxUsageIn)
+{
+    AssertLockHeld(cs);
+    while (nUsage > nMaxUsageIn && !listLRU.empty()) {
+        std::map<uint256, CEntry>::iterator it = mapBlocks.find(listLRU.back());
+        // blocks still being served stay alive until they are sent
+        nUsage -= it->second.nUsage;
+        listLRU.pop_back();
+        mapBlocks.erase(it);
+    }
+}
+
+void CRecentBlockCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    LOCK(cs);
+    nMaxUsage = nMaxUsageIn;
+    Evict(nMaxUsage);
+}
+
+void CRecentBlockCache::Add(const CBlock& block)
+{
+    // the message is counted before it is assembled, on the first request
+    size_t nBlockUsage = sizeof(CServedBlock) + RecursiveDynamicUsage(block) +
+        CMessageHeader::HEADER_SIZE + ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    uint256 hash = block.GetHash();
+    {
+        LOCK(cs);
+        if (nBlockUsage > nMaxUsage || mapBlocks.count(hash))
+            return;
+    }
+    CBlock blockCopy(block);
+    std::shared_ptr<const CServedBlock> pblock = std::make_shared<const CServedBlock>(std::move(blockCopy), hash, true);
+
+    LOCK(cs);
+    if (nBlockUsage > nMaxUsage || mapBlocks.count(hash))
+        return;
+    Evict(nMaxUsage - nBlockUsage);
+    listLRU.push_front(hash);
+    CEntry& entry = mapBlocks[hash];
+    entry.pblock = pblock;
+    entry.nUsage = nBlockUsage;
+    entry.itLRU = listLRU.begin();
+    nUsage += nBlockUsage;
+    LogPrint("net", "CRecentBlockCache::%s -- block %s, %u bytes, %u blocks cached\n", __func__, hash.ToString(), nBlockUsage, mapBlocks.size());
+}
+
+std::shared_ptr<const CServedBlock> CRecentBlockCache::GetOrRead(const CBlockIndex* pindex, const Consensus::Params& consensusParams)
+{
+    {
+        LOCK(cs);
+        std::map<uint256, CEntry>::iterator it = mapBlocks.find(pindex->GetBlockHash());
+        if (it != mapBlocks.end()) {
+            nHits++;
+            listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+            return it->second.pblock;
+        }
+        nMisses++;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex, consensusParams))
+        return std::shared_ptr<const CServedBlock>();
+    return std::make_shared<const CServedBlock>(std::move(block), pindex->GetBlockHash(), false);
+}
+
+CRecentBlockCacheStats CRecentBlockCache::GetStats() const
+{
+    LOCK(cs);
+    CRecentBlockCacheStats stats;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nBlocks = mapBlocks.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+    return stats;
+}
+
+void CRecentBlockCache::Clear()
+{
+    LOCK(cs);
+    mapBlocks.clear();
+    listLRU.clear();
+    nUsage = 0;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "primitives/block.h"
+#include "protocol.h"
+#include "support/allocators/zeroafterfree.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+class CBlockIndex;
+class CRecentBlockCache;
+
+namespace Consensus { struct Params; }
+
+extern CRecentBlockCache recentBlocks;
+
+//! -recentblockcache default, in megabytes
+static const int DEFAULT_RECENT_BLOCK_CACHE = 16;
+static const int MAX_RECENT_BLOCK_CACHE = 1024;
+
+/**
+ * A block as it is served to peers, RPC and ZMQ clients. The network
+ * message is only serialized and checksummed once, the first time it is
+ * asked for, and then copied for every peer.
+ */
+class CServedBlock
+{
+private:
+    mutable CCriticalSection cs;
+    mutable CSerializeData vMessage;
+    //! The serialized block alone, for a block read for one request
+    mutable CSerializeData vPayload;
+    //! Whether the block is cached, so its payload is shared with the network message
+    const bool fCached;
+
+    CServedBlock(const CServedBlock&);
+    CServedBlock& operator=(const CServedBlock&);
+
+    const CSerializeData& GetPayload() const;
+
+public:
+    const CBlock block;
+    const uint256 hash;
+
+    CServedBlock(CBlock&& blockIn, const uint256& hashIn, bool fCachedIn) : fCached(fCachedIn), block(std::move(blockIn)), hash(hashIn) {}
+
+    /** The block as a complete "block" network message */
+    const CSerializeData& GetMessage() const;
+
+    /**
+     * The serialized block, the payload of the network message. Blocks
+     * which aren't cached are serialized without building the message,
+     * which isn't worth its checksum for a single RPC or ZMQ client.
+     */
+    const char* GetSerialized() const;
+    size_t GetSerializedSize() const;
+};
+
+struct CRecentBlockCacheStats
+{
+    uint64_t nHits;
+    uint64_t nMisses;
+    size_t nBlocks;
+    size_t nUsage;
+    size_t nMaxUsage;
+};
+
+/**
+ * Byte-budgeted cache of the blocks connected last, keyed by hash. Right
+ * after a block is connected most peers ask for it within seconds, and so
+ * may RPC and ZMQ clients; they are all served from the one copy here
+ * instead of each reading and deserializing it from disk again. The least
+ * recently served blocks are dropped beyond the budget.
+ */
+class CRecentBlockCache
+{
+private:
+    struct CEntry
+    {
+        std::shared_ptr<const CServedBlock> pblock;
+        size_t nUsage;
+        std::list<uint256>::iterator itLRU;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<uint256, CEntry> mapBlocks;
+    //! Most recently served first
+    std::list<uint256> listLRU;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+    void Evict(size_t nMaxUsageIn);
+
+public:
+    CRecentBlockCache() : nUsage(0), nMaxUsage(0), nHits(0), nMisses(0) {}
+
+    /** Limit the memory used by the cached blocks, 0 disables the cache */
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    /** Add a block which was just connected, blocks over the budget aren't cached */
+    void Add(const CBlock& block);
+
+    /**
+     * The block of pindex from the cache, or read from disk if it isn't
+     * cached. Blocks read from disk aren't added. Returns NULL if the block
+     * can't be read.
+     */
+    std::shared_ptr<const CServedBlock> GetOrRead(const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+
+    CRecentBlockCacheStats GetStats() const;
+    void Clear();
+};
+
+#endif // BLOCKCACHE_H
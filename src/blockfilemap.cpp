@@ -0,0 +1,142 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "compat/endian.h"
+#include "serialize.h"
+#include "util.h"
+#include "validation.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockFileMapPool blockFileMaps;
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    munmap((void*)pData, nSize);
+#endif
+}
+
+void CBlockFileMapPool::SetMaxFiles(size_t nMaxFilesIn)
+{
+    LOCK(cs);
+    nMaxFiles = nMaxFilesIn;
+    while (mapFiles.size() > nMaxFiles)
+        Unmap(mapFiles.find(listLRU.back()));
+}
+
+size_t CBlockFileMapPool::GetMappedFiles() const
+{
+    LOCK(cs);
+    return mapFiles.size();
+}
+
+void CBlockFileMapPool::Unmap(std::map<FileKey, CEntry>::iterator it)
+{
+    // readers still holding a view keep the mapping until they are done
+    listLRU.erase(it->second.itLRU);
+    mapFiles.erase(it);
+}
+
+CBlockFileMapPool::CEntry* CBlockFileMapPool::GetMapped(const FileKey& key, size_t nEnd)
+{
+    AssertLockHeld(cs);
+    std::map<FileKey, CEntry>::iterator it = mapFiles.find(key);
+    if (it != mapFiles.end()) {
+        listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+        if (it->second.pfile->size() >= nEnd)
+            return &it->second;
+        // the file grew since it was mapped
+        Unmap(it);
+    }
+
+#ifdef WIN32
+    return NULL;
+#else
+    boost::filesystem::path path = GetBlockPosFilename(CDiskBlockPos(key.second, 0), key.first == BLOCK_FILE ? "blk" : "rev");
+    int fd = open(path.string().c_str(), O_RDONLY);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    void* pData = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= nEnd && st.st_size > 0)
+        pData = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid without the descriptor
+    close(fd);
+    if (pData == MAP_FAILED)
+        return NULL;
+
+    while (mapFiles.size() >= nMaxFiles && !listLRU.empty())
+        Unmap(mapFiles.find(listLRU.back()));
+    CEntry& entry = mapFiles[key];
+    entry.pfile = std::make_shared<const CMappedBlockFile>((const char*)pData, (size_t)st.st_size);
+    entry.nLastEnd = 0;
+    entry.nAdvisedEnd = 0;
+    listLRU.push_front(key);
+    entry.itLRU = listLRU.begin();
+    LogPrint("db", "CBlockFileMapPool::%s -- mapped %s, %u bytes\n", __func__, path.filename().string(), (size_t)st.st_size);
+    return &entry;
+#endif
+}
+
+bool CBlockFileMapPool::MapRecord(FileType type, const CDiskBlockPos& pos, size_t nTrailer, CBlockFileView& view)
+{
+    if (pos.IsNull() || pos.nPos < sizeof(uint32_t))
+        return false;
+
+    LOCK(cs);
+    if (nMaxFiles == 0)
+        return false;
+    FileKey key(type, pos.nFile);
+
+    CEntry* pentry = GetMapped(key, pos.nPos);
+    if (!pentry)
+        return false;
+    uint32_t nSize;
+    memcpy(&nSize, pentry->pfile->data() + pos.nPos - sizeof(nSize), sizeof(nSize));
+    nSize = le32toh(nSize);
+    if (nSize > MAX_SIZE)
+        return false;
+    size_t nEnd = (size_t)pos.nPos + nSize + nTrailer;
+    pentry = GetMapped(key, nEnd);
+    if (!pentry)
+        return false;
+
+#ifndef WIN32
+    // request the pages after a sequential read before they are read
+    if (pos.nPos >= pentry->nLastEnd && pos.nPos - pentry->nLastEnd <= BLOCK_FILE_SEQUENTIAL_GAP &&
+        pentry->nAdvisedEnd < std::min(nEnd + BLOCK_FILE_READAHEAD, pentry->pfile->size())) {
+        static const size_t nPageSize = sysconf(_SC_PAGESIZE);
+        size_t nFrom = std::max(nEnd, pentry->nAdvisedEnd) / nPageSize * nPageSize;
+        size_t nTo = std::min(nEnd + BLOCK_FILE_READAHEAD, pentry->pfile->size());
+        madvise((void*)(pentry->pfile->data() + nFrom), nTo - nFrom, MADV_WILLNEED);
+        pentry->nAdvisedEnd = nTo;
+    }
+#endif
+    pentry->nLastEnd = nEnd;
+
+    view.pfile = pentry->pfile;
+    view.pch = pentry->pfile->data() + pos.nPos;
+    view.nSize = nSize + nTrailer;
+    return true;
+}
+
+void CBlockFileMapPool::Invalidate(int nFile)
+{
+    LOCK(cs);
+    for (int type = BLOCK_FILE; type <= UNDO_FILE; type++) {
+        std::map<FileKey, CEntry>::iterator it = mapFiles.find(FileKey(type, nFile));
+        if (it != mapFiles.end())
+            Unmap(it);
+    }
+}
@@ -0,0 +1,114 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKFILEMAP_H
+#define BLOCKFILEMAP_H
+
+#include "chain.h"
+#include "sync.h"
+
+#include <list>
+#include <map>
+#include <memory>
+
+class CBlockFileMapPool;
+
+extern CBlockFileMapPool blockFileMaps;
+
+//! -blockfilemaps default, number of block and undo files kept mapped
+#ifdef WIN32
+static const int DEFAULT_BLOCK_FILE_MAPS = 0;
+#else
+static const int DEFAULT_BLOCK_FILE_MAPS = sizeof(void*) > 4 ? 64 : 0;
+#endif
+static const int MAX_BLOCK_FILE_MAPS = 1024;
+//! Reads starting at most this far after the end of the previous read of a file count as sequential
+static const size_t BLOCK_FILE_SEQUENTIAL_GAP = 1024 * 1024;
+//! Bytes after a sequential read whose pages are requested ahead
+static const size_t BLOCK_FILE_READAHEAD = 4 * 1024 * 1024;
+
+/** A read-only memory mapping of a whole block or undo file, unmapped when destroyed */
+class CMappedBlockFile
+{
+private:
+    const char* pData;
+    size_t nSize;
+
+    CMappedBlockFile(const CMappedBlockFile&);
+    CMappedBlockFile& operator=(const CMappedBlockFile&);
+
+public:
+    CMappedBlockFile(const char* pDataIn, size_t nSizeIn) : pData(pDataIn), nSize(nSizeIn) {}
+    ~CMappedBlockFile();
+
+    const char* data() const { return pData; }
+    size_t size() const { return nSize; }
+};
+
+/** A block or undo record in a mapped file, valid as long as the view is kept */
+struct CBlockFileView
+{
+    std::shared_ptr<const CMappedBlockFile> pfile;
+    const char* pch;
+    size_t nSize;
+};
+
+/**
+ * Pool of read-only memory mappings of the blk?????.dat and rev?????.dat
+ * files. Once a file is mapped, reading a block or undo record from it takes
+ * no system calls and deserializes straight from the page cache, instead of
+ * opening, seeking and reading through a FILE each time.
+ *
+ * The least recently used files are unmapped beyond the configured number,
+ * and a file is mapped again once it has grown past its mapping. Reads
+ * following on from the previous read of the same file, like scans over the
+ * chain, have the pages after them requested ahead with madvise; other pages
+ * are read on demand.
+ */
+class CBlockFileMapPool
+{
+public:
+    enum FileType { BLOCK_FILE, UNDO_FILE };
+
+private:
+    typedef std::pair<int, int> FileKey;
+
+    struct CEntry
+    {
+        std::shared_ptr<const CMappedBlockFile> pfile;
+        //! End of the last record read, and of the pages requested ahead
+        size_t nLastEnd;
+        size_t nAdvisedEnd;
+        std::list<FileKey>::iterator itLRU;
+    };
+
+    mutable CCriticalSection cs;
+    std::map<FileKey, CEntry> mapFiles;
+    //! Most recently used first
+    std::list<FileKey> listLRU;
+    size_t nMaxFiles;
+
+    CEntry* GetMapped(const FileKey& key, size_t nEnd);
+    void Unmap(std::map<FileKey, CEntry>::iterator it);
+
+public:
+    CBlockFileMapPool() : nMaxFiles(0) {}
+
+    /** Keep up to nMaxFiles files mapped, 0 disables the pool */
+    void SetMaxFiles(size_t nMaxFilesIn);
+    size_t GetMappedFiles() const;
+
+    /**
+     * Map the record at pos, whose size is stored in the 4 bytes before it
+     * (see WriteBlockToDisk), followed by nTrailer more bytes. Returns false
+     * if the pool is disabled or the record can't be mapped, the caller then
+     * reads it from the file.
+     */
+    bool MapRecord(FileType type, const CDiskBlockPos& pos, size_t nTrailer, CBlockFileView& view);
+
+    /** Drop the mappings of the block and undo files nFile, after they were truncated or deleted */
+    void Invalidate(int nFile);
+};
+
+#endif // BLOCKFILEMAP_H
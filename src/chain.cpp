@@ -11,6 +11,7 @@ using namespace std;
  * CChain implementation
  */
 void CChain::SetTip(CBlockIndex *pindex) {
+    pindexTipPublished.store(pindex, std::memory_order_release);
     if (pindex == NULL) {
         vChain.clear();
         return;
@@ -12,6 +12,7 @@
 #include "tinyformat.h"
 #include "uint256.h"
 
+#include <atomic>
 #include <vector>
 
 class CBlockFileInfo
@@ -409,8 +410,12 @@ public:
 class CChain {
 private:
     std::vector<CBlockIndex*> vChain;
+    //! Copy of the tip for readers that don't hold cs_main, see AtomicTip()
+    std::atomic<CBlockIndex*> pindexTipPublished;
 
 public:
+    CChain() : pindexTipPublished(NULL) {}
+
     /** Returns the index entry for the genesis block of this chain, or NULL if none. */
     CBlockIndex *Genesis() const {
         return vChain.size() > 0 ? vChain[0] : NULL;
@@ -421,6 +426,15 @@ public:
         return vChain.size() > 0 ? vChain[vChain.size() - 1] : NULL;
     }
 
+    /**
+     * Returns the index entry for the tip of this chain like Tip(), but without
+     * requiring cs_main. The entry may be replaced as tip right after it was
+     * returned; block index entries themselves stay valid while running.
+     */
+    CBlockIndex *AtomicTip() const {
+        return pindexTipPublished.load(std::memory_order_acquire);
+    }
+
     /** Returns the index entry at a particular height in this chain, or NULL if no such height exists. */
     CBlockIndex *operator[](int nHeight) const {
         if (nHeight < 0 || nHeight >= (int)vChain.size())
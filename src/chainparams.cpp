@@ -203,6 +203,14 @@ public:
         //                 //   (the tx=... number in the SetBestChain debug.log lines)
         //     5000        // * estimated number of transactions per day after checkpoint
         // };
+
+        // Snapshots are added at release like the checkpoints, from gettxoutsetinfo at the height:
+        // mapAssumeUTXO[height] = (CAssumeUTXOData) {
+        //     uint256S("0x"), // * block hash
+        //     uint256S("0x"), // * muhash
+        //     0,              // * txouts
+        //     0               // * chain tx of the block (the tx=... number in the SetBestChain debug.log lines)
+        // };
     }
 };
 static CMainParams mainParams;
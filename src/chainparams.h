@@ -32,6 +32,18 @@ struct CCheckpointData {
     double fTransactionsPerDay;
 };
 
+/** A UTXO set snapshot which loadtxoutset accepts, as reported by gettxoutsetinfo at its block */
+struct CAssumeUTXOData {
+    uint256 hashBlock;
+    //! The muhash of the set
+    uint256 hashCommitment;
+    uint64_t nTransactionOutputs;
+    //! Transactions in the chain up to and including the block
+    unsigned int nChainTx;
+};
+
+typedef std::map<int, CAssumeUTXOData> MapAssumeUTXO;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Dash system. There are three: the main network on which people trade goods
@@ -78,6 +90,7 @@ public:
     int ExtCoinType() const { return nExtCoinType; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    const MapAssumeUTXO& AssumeUTXO() const { return mapAssumeUTXO; }
     int PoolMaxTransactions() const { return nPoolMaxTransactions; }
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
     std::string SporkPubKey() const { return strSporkPubKey; }
@@ -104,6 +117,7 @@ protected:
     bool fMineBlocksOnDemand;
     bool fTestnetToBeDeprecatedFieldRPC;
     CCheckpointData checkpointData;
+    MapAssumeUTXO mapAssumeUTXO;
     int nPoolMaxTransactions;
     int nFulfilledRequestExpireTime;
     std::string strSporkPubKey;
@@ -7,12 +7,13 @@
 #include "consensus/consensus.h"
 #include "memusage.h"
 #include "random.h"
+#include "streams.h"
 
 #include <assert.h>
 
 bool CCoinsView::GetCoin(const COutPoint &outpoint, Coin &coin) const { return false; }
 uint256 CCoinsView::GetBestBlock() const { return uint256(); }
-bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return false; }
+bool CCoinsView::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) { return false; }
 CCoinsViewCursor *CCoinsView::Cursor() const { return 0; }
 
 bool CCoinsView::HaveCoin(const COutPoint &outpoint) const
@@ -26,10 +27,51 @@ bool CCoinsViewBacked::GetCoin(const COutPoint &outpoint, Coin &coin) const { re
 bool CCoinsViewBacked::HaveCoin(const COutPoint &outpoint) const { return base->HaveCoin(outpoint); }
 uint256 CCoinsViewBacked::GetBestBlock() const { return base->GetBestBlock(); }
 void CCoinsViewBacked::SetBackend(CCoinsView &viewIn) { base = &viewIn; }
-bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) { return base->BatchWrite(mapCoins, hashBlock); }
+bool CCoinsViewBacked::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) { return base->BatchWrite(mapCoins, hashBlock, commitmentDelta); }
 CCoinsViewCursor *CCoinsViewBacked::Cursor() const { return base->Cursor(); }
 size_t CCoinsViewBacked::EstimateSize() const { return base->EstimateSize(); }
 
+/** The serialized coin as a MuHash element */
+static void SerializeCommitted(CDataStream& ss, const COutPoint& outpoint, const Coin& coin)
+{
+    ss << outpoint;
+    ss << (uint32_t)(coin.nHeight * 2 + coin.fCoinBase);
+    ss << coin.out;
+}
+
+void CCoinsCommitment::Add(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, 0);
+    SerializeCommitted(ss, outpoint, coin);
+    muhash.Insert((const unsigned char*)&ss[0], ss.size());
+    nTransactionOutputs++;
+    nTotalAmount += coin.out.nValue;
+}
+
+void CCoinsCommitment::Remove(const COutPoint& outpoint, const Coin& coin)
+{
+    CDataStream ss(SER_DISK, 0);
+    SerializeCommitted(ss, outpoint, coin);
+    muhash.Remove((const unsigned char*)&ss[0], ss.size());
+    nTransactionOutputs--;
+    nTotalAmount -= coin.out.nValue;
+}
+
+CCoinsCommitment& CCoinsCommitment::operator+=(const CCoinsCommitment& delta)
+{
+    muhash *= delta.muhash;
+    nTransactionOutputs += delta.nTransactionOutputs;
+    nTotalAmount += delta.nTotalAmount;
+    return *this;
+}
+
+uint256 CCoinsCommitment::GetHash() const
+{
+    uint256 hash;
+    muhash.Finalize(hash.begin());
+    return hash;
+}
+
 SaltedOutpointHasher::SaltedOutpointHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
 
 CCoinsViewCache::CCoinsViewCache(CCoinsView *baseIn) : CCoinsViewBacked(baseIn), cachedCoinsUsage(0) {}
@@ -55,6 +97,16 @@ CCoinsMap::iterator CCoinsViewCache::FetchCoin(const COutPoint &outpoint) const
     return ret;
 }
 
+bool CCoinsViewCache::CacheCoin(const COutPoint& outpoint, Coin&& coin) {
+    if (coin.IsSpent())
+        return false;
+    std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.emplace(std::piecewise_construct, std::forward_as_tuple(outpoint), std::forward_as_tuple(std::move(coin)));
+    if (!ret.second)
+        return false;
+    cachedCoinsUsage += ret.first->second.coin.DynamicMemoryUsage();
+    return true;
+}
+
 bool CCoinsViewCache::GetCoin(const COutPoint &outpoint, Coin &coin) const {
     CCoinsMap::const_iterator it = FetchCoin(outpoint);
     if (it != cacheCoins.end()) {
@@ -80,6 +132,15 @@ void CCoinsViewCache::AddCoin(const COutPoint &outpoint, Coin&& coin, bool possi
         }
         fresh = !(it->second.flags & CCoinsCacheEntry::DIRTY);
     }
+    if (!it->second.coin.IsSpent()) {
+        commitmentDelta.Remove(outpoint, it->second.coin);
+    } else if (inserted && possible_overwrite) {
+        // Not cached, but it may still be unspent in the base
+        Coin coinOld;
+        if (base->GetCoin(outpoint, coinOld) && !coinOld.IsSpent())
+            commitmentDelta.Remove(outpoint, coinOld);
+    }
+    commitmentDelta.Add(outpoint, coin);
     it->second.coin = std::move(coin);
     it->second.flags |= CCoinsCacheEntry::DIRTY | (fresh ? CCoinsCacheEntry::FRESH : 0);
     cachedCoinsUsage += it->second.coin.DynamicMemoryUsage();
@@ -99,6 +160,8 @@ bool CCoinsViewCache::SpendCoin(const COutPoint &outpoint, Coin* moveout) {
     CCoinsMap::iterator it = FetchCoin(outpoint);
     if (it == cacheCoins.end()) return false;
     cachedCoinsUsage -= it->second.coin.DynamicMemoryUsage();
+    if (!it->second.coin.IsSpent())
+        commitmentDelta.Remove(outpoint, it->second.coin);
     if (moveout) {
         *moveout = std::move(it->second.coin);
     }
@@ -142,7 +205,7 @@ void CCoinsViewCache::SetBestBlock(const uint256 &hashBlockIn) {
     hashBlock = hashBlockIn;
 }
 
-bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn) {
+bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn, const CCoinsCommitment &commitmentDeltaIn) {
     for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) { // Ignore non-dirty entries (optimization).
             CCoinsMap::iterator itUs = cacheCoins.find(it->first);
@@ -195,13 +258,19 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlockIn
         mapCoins.erase(itOld);
     }
     hashBlock = hashBlockIn;
+    commitmentDelta += commitmentDeltaIn;
     return true;
 }
 
 bool CCoinsViewCache::Flush() {
-    bool fOk = base->BatchWrite(cacheCoins, hashBlock);
-    cacheCoins.clear();
+    size_t nBuckets = cacheCoins.bucket_count();
+    bool fOk = base->BatchWrite(cacheCoins, hashBlock, commitmentDelta);
+    // Start over with a fresh map, so the node pool of the old one is released,
+    // but keep as many buckets as before to not rehash while the cache refills.
+    cacheCoins = CCoinsMap();
+    cacheCoins.rehash(nBuckets);
     cachedCoinsUsage = 0;
+    commitmentDelta = CCoinsCommitment();
     return fOk;
 }
 
@@ -8,9 +8,11 @@
 
 #include "compressor.h"
 #include "core_memusage.h"
+#include "crypto/muhash.h"
 #include "hash.h"
 #include "memusage.h"
 #include "serialize.h"
+#include "support/allocators/pool.h"
 #include "uint256.h"
 
 #include <assert.h>
@@ -84,8 +86,8 @@ public:
 class SaltedOutpointHasher
 {
 private:
-    /** Salt */
-    const uint64_t k0, k1;
+    /** Salt (not const, so a CCoinsMap can be swapped and move assigned) */
+    uint64_t k0, k1;
 
 public:
     SaltedOutpointHasher();
@@ -119,7 +121,50 @@ struct CCoinsCacheEntry
     explicit CCoinsCacheEntry(Coin&& coin_) : coin(std::move(coin_)), flags(0) {}
 };
 
-typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher> CCoinsMap;
+/**
+ * Nodes of a CCoinsMap are served from a pool owned by that map, which avoids a
+ * malloc/free pair per cached coin and keeps the nodes densely packed. Leave
+ * room for the next pointer and the cached hash libstdc++ adds to each node.
+ */
+static const size_t COINS_MAP_MAX_NODE_SIZE = sizeof(std::pair<const COutPoint, CCoinsCacheEntry>) + 4 * sizeof(void*);
+typedef pool_allocator<std::pair<const COutPoint, CCoinsCacheEntry>, COINS_MAP_MAX_NODE_SIZE> CCoinsMapAllocator;
+typedef std::unordered_map<COutPoint, CCoinsCacheEntry, SaltedOutpointHasher, std::equal_to<COutPoint>, CCoinsMapAllocator> CCoinsMap;
+
+/**
+ * Commitment to a set of coins which is updated as coins are added and spent,
+ * instead of walking the whole set: the MuHash of every coin with its
+ * outpoint, and the number and total value of the coins. A cache keeps the
+ * change it makes to the commitment of its base, and passes it on with its
+ * coins when it is flushed.
+ */
+class CCoinsCommitment
+{
+private:
+    CMuHash3072 muhash;
+
+public:
+    int64_t nTransactionOutputs;
+    CAmount nTotalAmount;
+
+    CCoinsCommitment() : nTransactionOutputs(0), nTotalAmount(0) {}
+
+    void Add(const COutPoint& outpoint, const Coin& coin);
+    void Remove(const COutPoint& outpoint, const Coin& coin);
+    //! Apply the changes of another commitment
+    CCoinsCommitment& operator+=(const CCoinsCommitment& delta);
+
+    //! Hash of the coins, the same whatever order they were added in
+    uint256 GetHash() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(muhash);
+        READWRITE(nTransactionOutputs);
+        READWRITE(nTotalAmount);
+    }
+};
 
 /** Cursor for iterating over CoinsView state */
 class CCoinsViewCursor
@@ -159,8 +204,9 @@ public:
     virtual uint256 GetBestBlock() const;
 
     //! Do a bulk modification (multiple Coin changes + BestBlock change).
-    //! The passed mapCoins can be modified.
-    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
+    //! The passed mapCoins can be modified. commitmentDelta is the change
+    //! these modifications make to the commitment of the view.
+    virtual bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta);
 
     //! Get a cursor to iterate over the whole state
     virtual CCoinsViewCursor *Cursor() const;
@@ -185,7 +231,7 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBackend(CCoinsView &viewIn);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) override;
     CCoinsViewCursor *Cursor() const override;
     size_t EstimateSize() const override;
 };
@@ -205,6 +251,9 @@ protected:
     /* Cached dynamic memory usage for the inner Coin objects. */
     mutable size_t cachedCoinsUsage;
 
+    /* Change this cache makes to the commitment of its base. */
+    CCoinsCommitment commitmentDelta;
+
 public:
     CCoinsViewCache(CCoinsView *baseIn);
 
@@ -213,7 +262,7 @@ public:
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
     void SetBestBlock(const uint256 &hashBlock);
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) override;
     CCoinsViewCursor* Cursor() const override {
         throw std::logic_error("CCoinsViewCache cursor iteration not supported.");
     }
@@ -243,6 +292,13 @@ public:
      */
     void AddCoin(const COutPoint& outpoint, Coin&& coin, bool potential_overwrite);
 
+    /**
+     * Insert an unmodified coin that was read from the backing view ahead of
+     * time. Does nothing and returns false if the outpoint is already cached.
+     * The caller must make sure the coin still matches the backing view.
+     */
+    bool CacheCoin(const COutPoint& outpoint, Coin&& coin);
+
     /**
      * Spend a coin. Pass moveto in order to get the deleted data.
      * If no unspent output exists for the passed outpoint, this call
@@ -266,6 +322,9 @@ public:
     //! Calculate the size of the cache (in number of transaction outputs)
     unsigned int GetCacheSize() const;
 
+    //! The change made to the commitment of the base view since the last flush
+    const CCoinsCommitment& GetCommitmentDelta() const { return commitmentDelta; }
+
     //! Calculate the size of the cache (in bytes)
     size_t DynamicMemoryUsage() const;
 
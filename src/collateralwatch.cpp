@@ -0,0 +1,99 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "collateralwatch.h"
+
+#include "chain.h"
+#include "primitives/block.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+
+CCollateralWatch collateralWatch;
+
+void CCollateralWatch::Watch(const COutPoint& outpoint, CCollateralWatcher* pwatcher)
+{
+    LOCK(cs);
+    std::pair<watch_map_t::iterator, watch_map_t::iterator> range = mapWatched.equal_range(outpoint);
+    for (watch_map_t::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == pwatcher)
+            return;
+    }
+    mapWatched.insert(std::make_pair(outpoint, pwatcher));
+}
+
+void CCollateralWatch::Unwatch(const COutPoint& outpoint, CCollateralWatcher* pwatcher)
+{
+    LOCK(cs);
+    std::pair<watch_map_t::iterator, watch_map_t::iterator> range = mapWatched.equal_range(outpoint);
+    for (watch_map_t::iterator it = range.first; it != range.second; ++it) {
+        if (it->second == pwatcher) {
+            mapWatched.erase(it);
+            return;
+        }
+    }
+}
+
+void CCollateralWatch::UnwatchAll(CCollateralWatcher* pwatcher)
+{
+    LOCK(cs);
+    for (watch_map_t::iterator it = mapWatched.begin(); it != mapWatched.end(); ) {
+        if (it->second == pwatcher)
+            it = mapWatched.erase(it);
+        else
+            ++it;
+    }
+}
+
+bool CCollateralWatch::IsWatched(const COutPoint& outpoint) const
+{
+    LOCK(cs);
+    return mapWatched.count(outpoint) > 0;
+}
+
+size_t CCollateralWatch::size() const
+{
+    LOCK(cs);
+    return mapWatched.size();
+}
+
+void CCollateralWatch::NotifyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnected)
+{
+    // Look the inputs up first and notify without holding cs, so watchers may take their own locks
+    std::vector<std::pair<CCollateralWatcher*, std::pair<COutPoint, const CTransaction*> > > vNotify;
+    {
+        LOCK(cs);
+        if (mapWatched.empty())
+            return;
+        BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+            if (tx.IsCoinBase())
+                continue;
+            BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+                std::pair<watch_map_t::const_iterator, watch_map_t::const_iterator> range = mapWatched.equal_range(txin.prevout);
+                for (watch_map_t::const_iterator it = range.first; it != range.second; ++it)
+                    vNotify.push_back(std::make_pair(it->second, std::make_pair(txin.prevout, &tx)));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < vNotify.size(); i++) {
+        const COutPoint& outpoint = vNotify[i].second.first;
+        LogPrint("masternode", "CCollateralWatch::NotifyBlock -- %s %s in block %s\n", outpoint.ToStringShort(),
+                 fConnected ? "spent" : "unspent", pindex->GetBlockHash().ToString());
+        if (fConnected)
+            vNotify[i].first->CollateralSpent(outpoint, *vNotify[i].second.second, pindex);
+        else
+            vNotify[i].first->CollateralUnspent(outpoint, pindex);
+    }
+}
+
+void CCollateralWatch::BlockConnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    NotifyBlock(block, pindex, true);
+}
+
+void CCollateralWatch::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex)
+{
+    NotifyBlock(block, pindex, false);
+}
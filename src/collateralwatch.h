@@ -0,0 +1,66 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef COLLATERALWATCH_H
+#define COLLATERALWATCH_H
+
+#include "coins.h"
+#include "sync.h"
+
+#include <unordered_map>
+
+class CBlock;
+class CBlockIndex;
+class CCollateralWatch;
+class CTransaction;
+
+extern CCollateralWatch collateralWatch;
+
+/** Owner of watched outpoints, told when they are spent or unspent by the active chain */
+class CCollateralWatcher
+{
+public:
+    virtual ~CCollateralWatcher() {}
+    /** A watched outpoint was spent by tx, in the block pindex connected to the tip */
+    virtual void CollateralSpent(const COutPoint& outpoint, const CTransaction& tx, const CBlockIndex* pindex) = 0;
+    /** The block pindex spending a watched outpoint was disconnected from the tip */
+    virtual void CollateralUnspent(const COutPoint& outpoint, const CBlockIndex* pindex) = 0;
+};
+
+/**
+ * Registry of the outpoints the Dash managers keep track of, like masternode
+ * collaterals. The inputs of the blocks connected to and disconnected from
+ * the tip are looked up in it, one hash lookup per input, and the owners of
+ * the outpoints found are notified, so they don't have to poll the UTXO set.
+ *
+ * Watchers are notified with cs_main held, but not the registry's lock, so
+ * they may Watch() or Unwatch() outpoints from the notification.
+ */
+class CCollateralWatch
+{
+private:
+    typedef std::unordered_multimap<COutPoint, CCollateralWatcher*, SaltedOutpointHasher> watch_map_t;
+
+    mutable CCriticalSection cs;
+    watch_map_t mapWatched;
+
+    void NotifyBlock(const CBlock& block, const CBlockIndex* pindex, bool fConnected);
+
+public:
+    /** Notify pwatcher when outpoint is spent or unspent, watching an outpoint twice is a no-op */
+    void Watch(const COutPoint& outpoint, CCollateralWatcher* pwatcher);
+    void Unwatch(const COutPoint& outpoint, CCollateralWatcher* pwatcher);
+    /** Stop watching all the outpoints of pwatcher */
+    void UnwatchAll(CCollateralWatcher* pwatcher);
+
+    bool IsWatched(const COutPoint& outpoint) const;
+    size_t size() const;
+
+    /** Called by ConnectTip, after the block is applied to the chain state */
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex);
+    /** Called by DisconnectTip, after the block is undone from the chain state */
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex);
+};
+
+#endif // COLLATERALWATCH_H
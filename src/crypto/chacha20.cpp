@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Based on the public domain implementation 'merged' by D. J. Bernstein
+// See https://cr.yp.to/chacha.html.
+
+#include "crypto/chacha20.h"
+
+#include "crypto/common.h"
+
+#include <string.h>
+
+namespace
+{
+uint32_t inline Rotl32(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
+
+void inline QuarterRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d)
+{
+    a += b; d = Rotl32(d ^ a, 16);
+    c += d; b = Rotl32(b ^ c, 12);
+    a += b; d = Rotl32(d ^ a, 8);
+    c += d; b = Rotl32(b ^ c, 7);
+}
+
+/** Write one 64 byte keystream block for the state in input */
+void Block(const uint32_t input[16], unsigned char output[CChaCha20::BLOCK_SIZE])
+{
+    uint32_t x[16];
+    memcpy(x, input, sizeof(x));
+    for (int i = 0; i < 10; i++) {
+        QuarterRound(x[0], x[4], x[8], x[12]);
+        QuarterRound(x[1], x[5], x[9], x[13]);
+        QuarterRound(x[2], x[6], x[10], x[14]);
+        QuarterRound(x[3], x[7], x[11], x[15]);
+        QuarterRound(x[0], x[5], x[10], x[15]);
+        QuarterRound(x[1], x[6], x[11], x[12]);
+        QuarterRound(x[2], x[7], x[8], x[13]);
+        QuarterRound(x[3], x[4], x[9], x[14]);
+    }
+    for (int i = 0; i < 16; i++)
+        WriteLE32(output + 4 * i, x[i] + input[i]);
+}
+}
+
+CChaCha20::CChaCha20(const unsigned char key[KEY_SIZE])
+{
+    // "expand 32-byte k"
+    input[0] = 0x61707865;
+    input[1] = 0x3320646e;
+    input[2] = 0x79622d32;
+    input[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++)
+        input[4 + i] = ReadLE32(key + 4 * i);
+    SetIV(0);
+    Seek(0);
+}
+
+CChaCha20& CChaCha20::SetIV(uint64_t iv)
+{
+    input[14] = iv;
+    input[15] = iv >> 32;
+    return *this;
+}
+
+CChaCha20& CChaCha20::Seek(uint64_t pos)
+{
+    input[12] = pos;
+    input[13] = pos >> 32;
+    return *this;
+}
+
+void CChaCha20::Output(unsigned char* output, size_t bytes)
+{
+    while (bytes > 0) {
+        unsigned char block[BLOCK_SIZE];
+        unsigned char* dest = bytes >= BLOCK_SIZE ? output : block;
+        Block(input, dest);
+        if (++input[12] == 0)
+            ++input[13];
+        size_t n = bytes >= BLOCK_SIZE ? BLOCK_SIZE : bytes;
+        if (dest == block)
+            memcpy(output, block, n);
+        output += n;
+        bytes -= n;
+    }
+}
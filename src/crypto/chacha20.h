@@ -0,0 +1,28 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_CHACHA20_H
+#define BITCOIN_CRYPTO_CHACHA20_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** The ChaCha20 stream cipher keystream, with a 64-bit nonce and block counter. */
+class CChaCha20
+{
+private:
+    uint32_t input[16];
+
+public:
+    static const size_t KEY_SIZE = 32;
+    static const size_t BLOCK_SIZE = 64;
+
+    CChaCha20(const unsigned char key[KEY_SIZE]);
+    CChaCha20& SetIV(uint64_t iv);
+    //! Continue the keystream at block pos
+    CChaCha20& Seek(uint64_t pos);
+    void Output(unsigned char* output, size_t bytes);
+};
+
+#endif // BITCOIN_CRYPTO_CHACHA20_H
@@ -0,0 +1,183 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/muhash.h"
+
+#include "crypto/chacha20.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
+
+#include <limits>
+
+namespace
+{
+typedef Num3072::limb_t limb_t;
+typedef Num3072::double_limb_t double_limb_t;
+
+/** 2^3072 - modulus */
+const limb_t MAX_PRIME_DIFF = 1103717;
+
+limb_t inline ReadLimb(const unsigned char* ptr)
+{
+    return sizeof(limb_t) == 8 ? ReadLE64(ptr) : ReadLE32(ptr);
+}
+
+void inline WriteLimb(unsigned char* ptr, limb_t x)
+{
+    if (sizeof(limb_t) == 8)
+        WriteLE64(ptr, x);
+    else
+        WriteLE32(ptr, x);
+}
+}
+
+Num3072::Num3072(const unsigned char data[BYTE_SIZE])
+{
+    for (int i = 0; i < LIMBS; ++i)
+        limbs[i] = ReadLimb(data + i * sizeof(limb_t));
+}
+
+void Num3072::SetToOne()
+{
+    limbs[0] = 1;
+    for (int i = 1; i < LIMBS; ++i)
+        limbs[i] = 0;
+}
+
+bool Num3072::IsOverflow() const
+{
+    // The modulus is all ones but for the lowest limb
+    if (limbs[0] <= std::numeric_limits<limb_t>::max() - MAX_PRIME_DIFF)
+        return false;
+    for (int i = 1; i < LIMBS; ++i) {
+        if (limbs[i] != std::numeric_limits<limb_t>::max())
+            return false;
+    }
+    return true;
+}
+
+void Num3072::FullReduce()
+{
+    // Subtracting the modulus is adding MAX_PRIME_DIFF and dropping 2^3072
+    double_limb_t c = MAX_PRIME_DIFF;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += limbs[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+}
+
+void Num3072::Multiply(const Num3072& a)
+{
+    // Schoolbook product; a limb product plus two limbs fits a double limb
+    limb_t tmp[2 * LIMBS];
+    for (int i = 0; i < 2 * LIMBS; ++i)
+        tmp[i] = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        limb_t carry = 0;
+        for (int j = 0; j < LIMBS; ++j) {
+            double_limb_t t = (double_limb_t)limbs[i] * a.limbs[j] + tmp[i + j] + carry;
+            tmp[i + j] = (limb_t)t;
+            carry = t >> LIMB_SIZE;
+        }
+        tmp[i + LIMBS] = carry;
+    }
+
+    // As 2^3072 is MAX_PRIME_DIFF modulo the prime, fold the upper half
+    // onto the lower one, and then the carry that leaves, until none does.
+    double_limb_t c = 0;
+    for (int i = 0; i < LIMBS; ++i) {
+        c += (double_limb_t)tmp[LIMBS + i] * MAX_PRIME_DIFF + tmp[i];
+        limbs[i] = (limb_t)c;
+        c >>= LIMB_SIZE;
+    }
+    while (c) {
+        c *= MAX_PRIME_DIFF;
+        for (int i = 0; i < LIMBS && c; ++i) {
+            c += limbs[i];
+            limbs[i] = (limb_t)c;
+            c >>= LIMB_SIZE;
+        }
+    }
+    if (IsOverflow())
+        FullReduce();
+}
+
+Num3072 Num3072::GetInverse() const
+{
+    // Fermat's little theorem: a^(p - 2) is the inverse of a
+    Num3072 result;
+    for (int i = LIMBS - 1; i >= 0; --i) {
+        limb_t exponent = i == 0 ? (limb_t)(0 - MAX_PRIME_DIFF - 2) : std::numeric_limits<limb_t>::max();
+        for (int bit = LIMB_SIZE - 1; bit >= 0; --bit) {
+            Num3072 square(result);
+            result.Multiply(square);
+            if ((exponent >> bit) & 1)
+                result.Multiply(*this);
+        }
+    }
+    return result;
+}
+
+void Num3072::Divide(const Num3072& a)
+{
+    Multiply(a.GetInverse());
+}
+
+void Num3072::ToBytes(unsigned char out[BYTE_SIZE]) const
+{
+    Num3072 reduced(*this);
+    if (reduced.IsOverflow())
+        reduced.FullReduce();
+    for (int i = 0; i < LIMBS; ++i)
+        WriteLimb(out + i * sizeof(limb_t), reduced.limbs[i]);
+}
+
+Num3072 CMuHash3072::ToNum3072(const unsigned char* data, size_t len)
+{
+    unsigned char key[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(data, len).Finalize(key);
+    unsigned char expanded[Num3072::BYTE_SIZE];
+    CChaCha20(key).Output(expanded, sizeof(expanded));
+    return Num3072(expanded);
+}
+
+CMuHash3072::CMuHash3072(const unsigned char* data, size_t len) : numerator(ToNum3072(data, len))
+{
+}
+
+CMuHash3072& CMuHash3072::Insert(const unsigned char* data, size_t len)
+{
+    numerator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+CMuHash3072& CMuHash3072::Remove(const unsigned char* data, size_t len)
+{
+    denominator.Multiply(ToNum3072(data, len));
+    return *this;
+}
+
+CMuHash3072& CMuHash3072::operator*=(const CMuHash3072& mul)
+{
+    numerator.Multiply(mul.numerator);
+    denominator.Multiply(mul.denominator);
+    return *this;
+}
+
+CMuHash3072& CMuHash3072::operator/=(const CMuHash3072& div)
+{
+    numerator.Multiply(div.denominator);
+    denominator.Multiply(div.numerator);
+    return *this;
+}
+
+void CMuHash3072::Finalize(unsigned char hash[OUTPUT_SIZE]) const
+{
+    Num3072 result(numerator);
+    result.Divide(denominator);
+    unsigned char data[Num3072::BYTE_SIZE];
+    result.ToBytes(data);
+    CSHA256().Write(data, sizeof(data)).Finalize(hash);
+}
@@ -0,0 +1,106 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_MUHASH_H
+#define BITCOIN_CRYPTO_MUHASH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** A number modulo the 3072-bit safe prime 2^3072 - 1103717 */
+class Num3072
+{
+public:
+    static const size_t BYTE_SIZE = 384;
+
+#ifdef __SIZEOF_INT128__
+    typedef unsigned __int128 double_limb_t;
+    typedef uint64_t limb_t;
+    static const int LIMBS = 48;
+    static const int LIMB_SIZE = 64;
+#else
+    typedef uint64_t double_limb_t;
+    typedef uint32_t limb_t;
+    static const int LIMBS = 96;
+    static const int LIMB_SIZE = 32;
+#endif
+    static_assert(LIMB_SIZE * LIMBS == 3072, "Num3072 isn't 3072 bits");
+    static_assert(sizeof(double_limb_t) == sizeof(limb_t) * 2, "double_limb_t must be twice the size of limb_t");
+
+    limb_t limbs[LIMBS];
+
+    Num3072() { SetToOne(); }
+    //! From a little endian number, which may exceed the modulus
+    explicit Num3072(const unsigned char data[BYTE_SIZE]);
+
+    void SetToOne();
+    void Multiply(const Num3072& a);
+    //! Multiply by the inverse of a
+    void Divide(const Num3072& a);
+    //! The little endian number, fully reduced
+    void ToBytes(unsigned char out[BYTE_SIZE]) const;
+
+private:
+    bool IsOverflow() const;
+    void FullReduce();
+    Num3072 GetInverse() const;
+};
+
+/**
+ * A hash of a set of byte strings (MuHash3072), which elements can be added
+ * to and removed from in any order, at a constant cost each.
+ *
+ * Each element is hashed with SHA256, expanded to 3072 bits with ChaCha20
+ * and taken as a number modulo a 3072-bit prime; the set is the product of
+ * its elements. Removing multiplies a separate denominator, so updates need
+ * no inversion, and sets combine by multiplying both. Only Finalize divides
+ * them, to hash the result to 32 bytes.
+ */
+class CMuHash3072
+{
+private:
+    Num3072 numerator;
+    Num3072 denominator;
+
+    static Num3072 ToNum3072(const unsigned char* data, size_t len);
+
+public:
+    static const size_t OUTPUT_SIZE = 32;
+
+    //! The empty set
+    CMuHash3072() {}
+    //! The set containing only data
+    CMuHash3072(const unsigned char* data, size_t len);
+
+    CMuHash3072& Insert(const unsigned char* data, size_t len);
+    CMuHash3072& Remove(const unsigned char* data, size_t len);
+    //! Add the elements of mul
+    CMuHash3072& operator*=(const CMuHash3072& mul);
+    //! Remove the elements of div
+    CMuHash3072& operator/=(const CMuHash3072& div);
+
+    void Finalize(unsigned char hash[OUTPUT_SIZE]) const;
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        numerator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+        denominator.ToBytes(data);
+        s.write((const char*)data, sizeof(data));
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        unsigned char data[Num3072::BYTE_SIZE];
+        s.read((char*)data, sizeof(data));
+        numerator = Num3072(data);
+        s.read((char*)data, sizeof(data));
+        denominator = Num3072(data);
+    }
+};
+
+#endif // BITCOIN_CRYPTO_MUHASH_H
@@ -7,6 +7,7 @@
 #include "util.h"
 #include "random.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 #include <leveldb/cache.h>
@@ -73,14 +74,15 @@ public:
     }
 };
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBWrapperOptions& dbOptions)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
-    options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+    options.block_cache = leveldb::NewLRUCache(nCacheSize * dbOptions.nBlockCachePercent / 100);
+    options.write_buffer_size = nCacheSize * dbOptions.nWriteBufferPercent / 100; // up to two write buffers may be held in memory simultaneously
+    options.filter_policy = dbOptions.nBloomBitsPerKey > 0 ? leveldb::NewBloomFilterPolicy(dbOptions.nBloomBitsPerKey) : NULL;
+    options.compression = dbOptions.fCompression ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+    options.max_open_files = dbOptions.nMaxOpenFiles;
+    options.block_size = dbOptions.nBlockSize;
     options.info_log = new CBitcoinLevelDBLogger();
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
@@ -90,14 +92,15 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBWrapperOptions& dbOptionsIn) :
+    strPath(path.string()), dbOptions(dbOptionsIn)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, dbOptions);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -143,6 +146,11 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
 
 CDBWrapper::~CDBWrapper()
 {
+    if (threadCompaction.joinable()) {
+        // LevelDB can't interrupt a manual compaction
+        LogPrintf("Waiting for the compaction of %s to finish\n", strPath);
+        threadCompaction.join();
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
@@ -182,6 +190,56 @@ std::vector<unsigned char> CDBWrapper::CreateObfuscateKey() const
 
 }
 
+bool CDBWrapper::StartCompaction(const std::string& strRange, const std::string& strBegin, const std::string& strEnd)
+{
+    boost::unique_lock<boost::mutex> lock(csCompaction);
+    if (compactionStatus.fRunning)
+        return false;
+    // The previous compaction thread is done, reap it
+    if (threadCompaction.joinable())
+        threadCompaction.join();
+    compactionStatus.fRunning = true;
+    compactionStatus.strRange = strRange;
+    compactionStatus.nStartTime = GetTime();
+    threadCompaction = boost::thread(boost::bind(&CDBWrapper::ThreadCompaction, this, strBegin, strEnd));
+    return true;
+}
+
+void CDBWrapper::ThreadCompaction(const std::string& strBegin, const std::string& strEnd)
+{
+    RenameThread("dash-dbcompact");
+    std::string strRange;
+    {
+        boost::unique_lock<boost::mutex> lock(csCompaction);
+        strRange = compactionStatus.strRange;
+    }
+    LogPrintf("Starting compaction of %s in %s\n", strRange, strPath);
+    int64_t nStart = GetTimeMillis();
+    leveldb::Slice slBegin(strBegin), slEnd(strEnd);
+    pdb->CompactRange(strBegin.empty() ? NULL : &slBegin, strEnd.empty() ? NULL : &slEnd);
+    int64_t nDuration = GetTimeMillis() - nStart;
+    LogPrintf("Finished compaction of %s in %s (%.2fs)\n", strRange, strPath, 0.001 * nDuration);
+
+    boost::unique_lock<boost::mutex> lock(csCompaction);
+    compactionStatus.fRunning = false;
+    compactionStatus.nDuration = nDuration / 1000;
+    compactionStatus.nCompactions++;
+}
+
+CDBCompactionStatus CDBWrapper::GetCompactionStatus() const
+{
+    boost::unique_lock<boost::mutex> lock(csCompaction);
+    return compactionStatus;
+}
+
+std::string CDBWrapper::GetProperty(const std::string& strProperty) const
+{
+    std::string strValue;
+    if (!pdb->GetProperty(strProperty, &strValue))
+        return "";
+    return strValue;
+}
+
 bool CDBWrapper::IsEmpty()
 {
     boost::scoped_ptr<CDBIterator> it(NewIterator());
@@ -192,7 +250,9 @@ bool CDBWrapper::IsEmpty()
 CDBIterator::~CDBIterator() { delete piter; }
 bool CDBIterator::Valid() { return piter->Valid(); }
 void CDBIterator::SeekToFirst() { piter->SeekToFirst(); }
+void CDBIterator::SeekToLast() { piter->SeekToLast(); }
 void CDBIterator::Next() { piter->Next(); }
+void CDBIterator::Prev() { piter->Prev(); }
 
 namespace dbwrapper_private {
 
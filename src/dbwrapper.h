@@ -13,12 +13,57 @@
 #include "version.h"
 
 #include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
 
 static const size_t DBWRAPPER_PREALLOC_KEY_SIZE = 64;
 static const size_t DBWRAPPER_PREALLOC_VALUE_SIZE = 1024;
+//! Table files kept open by a database using the default options
+static const int DBWRAPPER_DEFAULT_MAX_OPEN_FILES = 64;
+//! Number of levels of the LevelDB LSM tree
+static const int DBWRAPPER_NUM_LEVELS = 7;
+
+/** Tuning of a database, passed to CDBWrapper */
+struct CDBWrapperOptions
+{
+    //! Table files LevelDB may keep open; every one of them is a file descriptor
+    int nMaxOpenFiles;
+    //! Bits per key of the bloom filter used to skip tables on point lookups, 0 for none
+    int nBloomBitsPerKey;
+    //! Snappy compress table blocks (only effective if LevelDB was built with Snappy)
+    bool fCompression;
+    //! Approximate size of uncompressed data per table block
+    size_t nBlockSize;
+    //! Share of the cache size used for the block cache and for the write buffer, in percent
+    int nBlockCachePercent;
+    int nWriteBufferPercent;
+
+    CDBWrapperOptions() :
+        nMaxOpenFiles(DBWRAPPER_DEFAULT_MAX_OPEN_FILES),
+        nBloomBitsPerKey(10),
+        fCompression(false),
+        nBlockSize(4096),
+        nBlockCachePercent(50),
+        nWriteBufferPercent(25) {}
+};
+
+/** State of the manual compaction of a CDBWrapper */
+struct CDBCompactionStatus
+{
+    bool fRunning;
+    //! Name of the key range being compacted, or that was compacted last
+    std::string strRange;
+    //! Start of the running or last compaction (unix time)
+    int64_t nStartTime;
+    //! Seconds the last finished compaction took, -1 if none finished yet
+    int64_t nDuration;
+    uint64_t nCompactions;
+
+    CDBCompactionStatus() : fRunning(false), nStartTime(0), nDuration(-1), nCompactions(0) {}
+};
 
 class dbwrapper_error : public std::runtime_error
 {
@@ -131,6 +176,7 @@ public:
     bool Valid();
 
     void SeekToFirst();
+    void SeekToLast();
 
     template<typename K> void Seek(const K& key) {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
@@ -141,6 +187,7 @@ public:
     }
 
     void Next();
+    void Prev();
 
     template<typename K> bool GetKey(K& key) {
         leveldb::Slice slKey = piter->key();
@@ -209,7 +256,19 @@ private:
     //! the length of the obfuscate key in number of bytes
     static const unsigned int OBFUSCATE_KEY_NUM_BYTES;
 
+    //! location of the database, for log messages
+    std::string strPath;
+
+    //! tuning the database was opened with
+    CDBWrapperOptions dbOptions;
+
+    //! manual compaction running in the background, see StartCompaction
+    mutable boost::mutex csCompaction;
+    boost::thread threadCompaction;
+    CDBCompactionStatus compactionStatus;
+
     std::vector<unsigned char> CreateObfuscateKey() const;
+    void ThreadCompaction(const std::string& strBegin, const std::string& strEnd);
 
 public:
     /**
@@ -219,8 +278,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] dbOptionsIn Tuning of the database for its access pattern.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBWrapperOptions& dbOptionsIn = CDBWrapperOptions());
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -340,6 +400,24 @@ public:
         pdb->CompactRange(&slKey1, &slKey2);
     }
 
+    /**
+     * Compact a range of keys in a background thread, or the whole database
+     * if both keys are empty. Returns false if a compaction is still running.
+     *
+     * @param[in] strRange  Name of the range, reported by GetCompactionStatus
+     * @param[in] strBegin  Serialized first key of the range, empty for the start of the database
+     * @param[in] strEnd    Serialized key past the range, empty for the end of the database
+     */
+    bool StartCompaction(const std::string& strRange, const std::string& strBegin = "", const std::string& strEnd = "");
+    CDBCompactionStatus GetCompactionStatus() const;
+
+    /**
+     * Value of a LevelDB property such as "leveldb.stats" or
+     * "leveldb.num-files-at-level0", empty if the property is unknown.
+     */
+    std::string GetProperty(const std::string& strProperty) const;
+
+    const CDBWrapperOptions& GetDBOptions() const { return dbOptions; }
 };
 
 #endif // BITCOIN_DBWRAPPER_H
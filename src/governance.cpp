@@ -13,6 +13,7 @@
 #include "messagesigner.h"
 #include "netfulfilledman.h"
 #include "util.h"
+#include "validationinterface.h"
 
 CGovernanceManager governance;
 
@@ -375,6 +376,7 @@ void CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CConnman
 
     LogPrintf("AddGovernanceObject -- %s new, received form %s\n", strHash, pfrom? pfrom->addrName : "NULL");
     govobj.Relay(connman);
+    GetMainSignals().NotifyGovernanceObject(govobj);
 
     // Update the rate buffer
     MasternodeRateUpdate(govobj);
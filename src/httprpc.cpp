@@ -15,6 +15,7 @@
 #include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp> //BOOST_FOREACH
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
@@ -61,6 +62,10 @@ private:
 static std::string strRPCUserColonPass;
 /* Stored RPC timer interface (for unregistration) */
 static HTTPRPCTimerInterface* httpRPCTimerInterface = 0;
+/* Work queue serving each RPCMethodClass */
+static int nClassQueues[RPC_CLASS_COUNT];
+/* Entries of a batch executed at once */
+static int nBatchParallel = DEFAULT_RPC_BATCH_PARALLEL;
 
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
@@ -79,6 +84,52 @@ static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const Uni
     req->WriteReply(nStatus, strReply);
 }
 
+/** Sink of a CJSONStreamWriter, starts a chunked reply on the first chunk */
+static void JSONStreamChunk(HTTPRequest* req, const std::string& strChunk, bool& fStarted)
+{
+    if (!fStarted) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->StartChunkedReply(HTTP_OK);
+        fStarted = true;
+    }
+    if (!req->WriteReplyChunk(strChunk))
+        throw std::runtime_error("client stopped receiving the reply");
+}
+
+/**
+ * Execute a singleton request of a method that can stream its result. Results
+ * larger than a chunk are sent with chunked transfer encoding while they are
+ * produced, smaller ones as a normal reply.
+ */
+static void JSONRPCExecStream(HTTPRequest* req, const JSONRequest& jreq)
+{
+    bool fStarted = false;
+    CJSONStreamWriter writer(boost::bind(&JSONStreamChunk, req, _1, boost::ref(fStarted)));
+    try {
+        writer.BeginObject();
+        writer.Key("result");
+        tableRPC.executeStream(jreq.strMethod, jreq.params, writer);
+        writer.KeyValue("error", NullUniValue);
+        writer.KeyValue("id", jreq.id);
+        writer.EndObject();
+    } catch (...) {
+        // Before anything was sent the error can still be replied as usual
+        if (!fStarted)
+            throw;
+        LogPrintf("%s: %s failed while its result was sent, closing reply\n", __func__, jreq.strMethod);
+        req->EndChunkedReply();
+        return;
+    }
+    if (!fStarted) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.GetBuffer() + "\n");
+        return;
+    }
+    if (!req->WriteReplyChunk(writer.GetBuffer() + "\n"))
+        LogPrintf("%s: client stopped receiving the result of %s\n", __func__, jreq.strMethod);
+    req->EndChunkedReply();
+}
+
 //This function checks username and password against -rpcauth
 //entries from config file.
 static bool multiUserAuthorized(std::string strUserPass)
@@ -180,6 +231,11 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (tableRPC.canStream(jreq.strMethod)) {
+                JSONRPCExecStream(req, jreq);
+                return true;
+            }
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -187,7 +243,7 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 
         // array of requests
         } else if (valRequest.isArray())
-            strReply = JSONRPCExecBatch(valRequest.get_array());
+            strReply = JSONRPCExecBatch(valRequest.get_array(), boost::bind(&EnqueueHTTPWork, HTTP_DEFAULT_QUEUE, _1), nBatchParallel);
         else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
@@ -203,6 +259,38 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
     return true;
 }
 
+/**
+ * Dispatch single requests by the class of their method, batches go to the default queue.
+ * The body of a request is only looked at once it is authorized, others are rejected by
+ * HTTPReq_JSONRPC from the default queue.
+ */
+static int JSONRPCSelectQueue(HTTPRequest* req)
+{
+    if (req->GetRequestMethod() != HTTPRequest::POST)
+        return HTTP_DEFAULT_QUEUE;
+    std::pair<bool, std::string> authHeader = req->GetHeader("authorization");
+    if (!authHeader.first || !RPCAuthorized(authHeader.second))
+        return HTTP_DEFAULT_QUEUE;
+    std::string strBody;
+    if (!req->PeekBody(strBody, MAX_RPC_SELECT_BODY_SIZE))
+        return HTTP_DEFAULT_QUEUE;
+    UniValue valRequest;
+    if (!valRequest.read(strBody) || !valRequest.isObject())
+        return HTTP_DEFAULT_QUEUE;
+    const UniValue& method = find_value(valRequest, "method");
+    if (!method.isStr())
+        return HTTP_DEFAULT_QUEUE;
+    return nClassQueues[tableRPC.methodClass(method.get_str())];
+}
+
+static void CreateRPCClassQueue(RPCMethodClass methodClass, const std::string& name, int nThreads, int nDepth)
+{
+    if (nThreads > 0)
+        nClassQueues[methodClass] = CreateHTTPWorkQueue(name, nThreads, nDepth);
+    else
+        nClassQueues[methodClass] = HTTP_DEFAULT_QUEUE;
+}
+
 static bool InitRPCAuthentication()
 {
     if (mapArgs["-rpcpassword"] == "")
@@ -227,7 +315,13 @@ bool StartHTTPRPC()
     if (!InitRPCAuthentication())
         return false;
 
-    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC);
+    int nDepth = GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE);
+    nClassQueues[RPC_CLASS_CHAIN] = HTTP_DEFAULT_QUEUE;
+    nBatchParallel = std::max((int)GetArg("-rpcbatchparallel", DEFAULT_RPC_BATCH_PARALLEL), 1);
+    CreateRPCClassQueue(RPC_CLASS_FAST, "fast", GetArg("-rpcfastthreads", DEFAULT_RPC_FAST_THREADS), nDepth);
+    CreateRPCClassQueue(RPC_CLASS_WALLET, "wallet", GetArg("-rpcwalletthreads", DEFAULT_RPC_WALLET_THREADS), nDepth);
+    CreateRPCClassQueue(RPC_CLASS_HEAVY, "heavy", GetArg("-rpcheavythreads", DEFAULT_RPC_HEAVY_THREADS), nDepth);
+    RegisterHTTPHandler("/", true, HTTPReq_JSONRPC, JSONRPCSelectQueue);
 
     assert(EventBase());
     httpRPCTimerInterface = new HTTPRPCTimerInterface(EventBase());
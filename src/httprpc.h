@@ -10,6 +10,15 @@
 
 class HTTPRequest;
 
+//! Workers of the RPC method classes besides the -rpcthreads ones, 0 to serve the class by those
+static const int DEFAULT_RPC_FAST_THREADS = 1;
+static const int DEFAULT_RPC_WALLET_THREADS = 1;
+static const int DEFAULT_RPC_HEAVY_THREADS = 2;
+//! Largest JSON-RPC request parsed on the event loop thread to find its method class
+static const size_t MAX_RPC_SELECT_BODY_SIZE = 4096;
+//! Bytes a batch REST request returns at most, the remaining records are left to a next request
+static const unsigned int DEFAULT_REST_MAX_BYTES = 32 * 1024 * 1024;
+
 /** Start HTTP RPC subsystem.
  * Precondition; HTTP and RPC has been started.
  */
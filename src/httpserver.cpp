@@ -19,6 +19,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <signal.h>
+#ifdef WIN32
+#include <io.h> // for dup() and close()
+#endif
 
 #include <event2/event.h>
 #include <event2/http.h>
@@ -61,6 +64,22 @@ private:
     HTTPRequestHandler func;
 };
 
+/** Work item that isn't a request, see EnqueueHTTPWork */
+class HTTPTaskItem : public HTTPClosure
+{
+public:
+    HTTPTaskItem(const boost::function<void()>& func): func(func)
+    {
+    }
+    void operator()()
+    {
+        func();
+    }
+
+private:
+    boost::function<void()> func;
+};
+
 /** Simple work queue for distributing work over multiple threads.
  * Work items are simply callable objects.
  */
@@ -168,13 +187,26 @@ public:
 struct HTTPPathHandler
 {
     HTTPPathHandler() {}
-    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler):
-        prefix(prefix), exactMatch(exactMatch), handler(handler)
+    HTTPPathHandler(std::string prefix, bool exactMatch, HTTPRequestHandler handler, HTTPQueueSelector selector):
+        prefix(prefix), exactMatch(exactMatch), handler(handler), selector(selector)
     {
     }
     std::string prefix;
     bool exactMatch;
     HTTPRequestHandler handler;
+    HTTPQueueSelector selector;
+};
+
+/** A work queue with the worker threads serving it */
+struct HTTPWorkers
+{
+    HTTPWorkers(const std::string& name, int nThreads, WorkQueue<HTTPClosure>* queue):
+        name(name), nThreads(nThreads), queue(queue)
+    {
+    }
+    std::string name;
+    int nThreads;
+    WorkQueue<HTTPClosure>* queue;
 };
 
 /** HTTP module state */
@@ -185,8 +217,8 @@ static struct event_base* eventBase = 0;
 struct evhttp* eventHTTP = 0;
 //! List of subnets to allow RPC connections from
 static std::vector<CSubNet> rpc_allow_subnets;
-//! Work queue for handling longer requests off the event loop thread
-static WorkQueue<HTTPClosure>* workQueue = 0;
+//! Work queues for handling longer requests off the event loop thread, HTTP_DEFAULT_QUEUE first
+static std::vector<HTTPWorkers> vWorkers;
 //! Handlers for (sub)paths
 std::vector<HTTPPathHandler> pathHandlers;
 //! Bound listening sockets
@@ -294,9 +326,12 @@ static void http_request_cb(struct evhttp_request* req, void* arg)
 
     // Dispatch to worker thread
     if (i != iend) {
+        int nQueue = i->selector ? i->selector(hreq.get()) : HTTP_DEFAULT_QUEUE;
+        if (nQueue < 0 || nQueue >= (int)vWorkers.size())
+            nQueue = HTTP_DEFAULT_QUEUE;
         std::unique_ptr<HTTPWorkItem> item(new HTTPWorkItem(hreq.release(), path, i->handler));
-        assert(workQueue);
-        if (workQueue->Enqueue(item.get()))
+        assert(!vWorkers.empty());
+        if (vWorkers[nQueue].queue->Enqueue(item.get()))
             item.release(); /* if true, queue took ownership */
         else
             item->req->WriteReply(HTTP_INTERNAL, "Work queue depth exceeded");
@@ -362,9 +397,9 @@ static bool HTTPBindAddresses(struct evhttp* http)
 }
 
 /** Simple wrapper to set thread name and run work queue */
-static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue)
+static void HTTPWorkQueueRun(WorkQueue<HTTPClosure>* queue, const std::string& name)
 {
-    RenameThread("dash-httpworker");
+    RenameThread(name.empty() ? "dash-httpworker" : ("dash-http-" + name).c_str());
     queue->Run();
 }
 
@@ -442,7 +477,8 @@ bool InitHTTPServer()
     int workQueueDepth = std::max((long)GetArg("-rpcworkqueue", DEFAULT_HTTP_WORKQUEUE), 1L);
     LogPrintf("HTTP: creating work queue of depth %d\n", workQueueDepth);
 
-    workQueue = new WorkQueue<HTTPClosure>(workQueueDepth);
+    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
+    vWorkers.push_back(HTTPWorkers("", rpcThreads, new WorkQueue<HTTPClosure>(workQueueDepth)));
     eventBase = base;
     eventHTTP = http;
     return true;
@@ -450,15 +486,35 @@ bool InitHTTPServer()
 
 boost::thread threadHTTP;
 
+int CreateHTTPWorkQueue(const std::string &name, int nThreads, int nDepth)
+{
+    assert(!vWorkers.empty());
+    LogPrintf("HTTP: creating %s work queue of depth %d\n", name, nDepth);
+    vWorkers.push_back(HTTPWorkers(name, std::max(nThreads, 1), new WorkQueue<HTTPClosure>(std::max(nDepth, 1))));
+    return vWorkers.size() - 1;
+}
+
+bool EnqueueHTTPWork(int nQueue, const boost::function<void()>& func)
+{
+    if (nQueue < 0 || nQueue >= (int)vWorkers.size())
+        return false;
+    std::unique_ptr<HTTPTaskItem> item(new HTTPTaskItem(func));
+    if (!vWorkers[nQueue].queue->Enqueue(item.get()))
+        return false;
+    item.release(); /* queue took ownership */
+    return true;
+}
+
 bool StartHTTPServer()
 {
     LogPrint("http", "Starting HTTP server\n");
-    int rpcThreads = std::max((long)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1L);
-    LogPrintf("HTTP: starting %d worker threads\n", rpcThreads);
     threadHTTP = boost::thread(boost::bind(&ThreadHTTP, eventBase, eventHTTP));
 
-    for (int i = 0; i < rpcThreads; i++)
-        boost::thread(boost::bind(&HTTPWorkQueueRun, workQueue));
+    BOOST_FOREACH(const HTTPWorkers& workers, vWorkers) {
+        LogPrintf("HTTP: starting %d %sworker threads\n", workers.nThreads, workers.name.empty() ? "" : workers.name + " ");
+        for (int i = 0; i < workers.nThreads; i++)
+            boost::thread(boost::bind(&HTTPWorkQueueRun, workers.queue, workers.name));
+    }
     return true;
 }
 
@@ -473,22 +529,25 @@ void InterruptHTTPServer()
         // Reject requests on current connections
         evhttp_set_gencb(eventHTTP, http_reject_request_cb, NULL);
     }
-    if (workQueue)
-        workQueue->Interrupt();
+    BOOST_FOREACH(const HTTPWorkers& workers, vWorkers)
+        workers.queue->Interrupt();
 }
 
 void StopHTTPServer()
 {
     LogPrint("http", "Stopping HTTP server\n");
-    if (workQueue) {
+    if (!vWorkers.empty()) {
         LogPrint("http", "Waiting for HTTP worker threads to exit\n");
+        BOOST_FOREACH(const HTTPWorkers& workers, vWorkers) {
 #ifndef WIN32
-        // ToDo: Disabling WaitExit() for Windows platforms is an ugly workaround for the wallet not
-        // closing during a repair-restart. It doesn't hurt, though, because threadHTTP.timed_join
-        // below takes care of this and sends a loopbreak.
-        workQueue->WaitExit();
-#endif        
-        delete workQueue;
+            // ToDo: Disabling WaitExit() for Windows platforms is an ugly workaround for the wallet not
+            // closing during a repair-restart. It doesn't hurt, though, because threadHTTP.timed_join
+            // below takes care of this and sends a loopbreak.
+            workers.queue->WaitExit();
+#endif
+            delete workers.queue;
+        }
+        vWorkers.clear();
     }
     if (eventBase) {
         LogPrint("http", "Waiting for HTTP event thread to exit\n");
@@ -551,13 +610,77 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Flow control of a chunked reply, shared by the worker producing it and the main http thread sending it */
+struct HTTPReplyStream
+{
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    //! Bytes queued by the worker
+    size_t nQueued;
+    //! Bytes handed to libevent by the main thread
+    size_t nHanded;
+    //! Bytes written to the connection
+    size_t nWritten;
+    bool fClosed;
+
+    HTTPReplyStream() : nQueued(0), nHanded(0), nWritten(0), fClosed(false) {}
+};
+
+/** Called by libevent when the output buffer of a connection was drained */
+static void http_reply_chunk_written_cb(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyStream* stream = (HTTPReplyStream*)arg;
+    boost::lock_guard<boost::mutex> lock(stream->cs);
+    stream->nWritten = stream->nHanded;
+    stream->cond.notify_all();
+}
+
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb, HTTPReplyStream* stream)
+{
+    size_t nSize = evbuffer_get_length(evb);
+    if (!evhttp_request_get_connection(req)) {
+        // The client went away, libevent keeps the request until the reply ends
+        boost::lock_guard<boost::mutex> lock(stream->cs);
+        stream->fClosed = true;
+        stream->cond.notify_all();
+    } else {
+#if LIBEVENT_VERSION_NUMBER >= 0x02010000
+        {
+            boost::lock_guard<boost::mutex> lock(stream->cs);
+            stream->nHanded += nSize;
+        }
+        evhttp_send_reply_chunk_with_cb(req, evb, http_reply_chunk_written_cb, stream);
+#else
+        // No way to learn when the chunk was written, so no flow control
+        evhttp_send_reply_chunk(req, evb);
+        {
+            boost::lock_guard<boost::mutex> lock(stream->cs);
+            stream->nHanded += nSize;
+        }
+        http_reply_chunk_written_cb(NULL, stream);
+#endif
+    }
+    evbuffer_free(evb);
+}
+
+static void http_send_reply_end(struct evhttp_request* req, HTTPReplyStream* stream)
+{
+    // This replaces the write callback of the connection, so the stream is not referenced anymore
+    evhttp_send_reply_end(req);
+    delete stream;
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       stream(NULL)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (stream) {
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        EndChunkedReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -596,6 +719,21 @@ std::string HTTPRequest::ReadBody()
     return rv;
 }
 
+bool HTTPRequest::PeekBody(std::string& strBody, size_t nMaxSize)
+{
+    strBody.clear();
+    struct evbuffer* buf = evhttp_request_get_input_buffer(req);
+    if (!buf)
+        return true;
+    size_t size = evbuffer_get_length(buf);
+    if (size > nMaxSize)
+        return false;
+    strBody.resize(size);
+    if (size > 0 && evbuffer_copyout(buf, &strBody[0], size) != (ev_ssize_t)size)
+        return false;
+    return true;
+}
+
 void HTTPRequest::WriteHeader(const std::string& hdr, const std::string& value)
 {
     struct evkeyvalq* headers = evhttp_request_get_output_headers(req);
@@ -622,6 +760,74 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::WriteReplyFile(int nStatus, FILE* file, int64_t nOffset, int64_t nSize)
+{
+    assert(!replySent && req && file);
+    struct evbuffer* evb = evhttp_request_get_output_buffer(req);
+    assert(evb);
+    // libevent closes the descriptor once the body was sent
+    int fd = dup(fileno(file));
+    fclose(file);
+    if (fd < 0 || evbuffer_add_file(evb, fd, nOffset, nSize) != 0) {
+        // libevent only takes the descriptor on success
+        if (fd >= 0)
+            close(fd);
+        LogPrintf("%s: Unable to send %d bytes of a file\n", __func__, nSize);
+        WriteReply(HTTP_INTERNAL, "Unable to read file");
+        return;
+    }
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(evhttp_send_reply, req, nStatus, (const char*)NULL, (struct evbuffer *)NULL));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::StartChunkedReply(int nStatus)
+{
+    assert(!replySent && !stream && req);
+    stream = new HTTPReplyStream();
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(stream && req);
+    {
+        // Wait for the client to catch up with earlier chunks
+        boost::unique_lock<boost::mutex> lock(stream->cs);
+        boost::system_time deadline = boost::get_system_time() +
+            boost::posix_time::seconds(GetArg("-rpcservertimeout", DEFAULT_HTTP_SERVER_TIMEOUT));
+        while (!stream->fClosed && stream->nQueued - stream->nWritten > MAX_HTTP_REPLY_PENDING) {
+            if (!stream->cond.timed_wait(lock, deadline))
+                break;
+        }
+        if (stream->fClosed || stream->nQueued - stream->nWritten > MAX_HTTP_REPLY_PENDING)
+            return false;
+        stream->nQueued += strChunk.size();
+    }
+    struct evbuffer* evb = evbuffer_new();
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_send_reply_chunk, req, evb, stream));
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::EndChunkedReply()
+{
+    assert(stream && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_send_reply_end, req, stream));
+    ev->trigger(0);
+    stream = NULL; // deleted by the main thread
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -662,10 +868,10 @@ HTTPRequest::RequestMethod HTTPRequest::GetRequestMethod()
     }
 }
 
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler)
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPQueueSelector &selector)
 {
     LogPrint("http", "Registering HTTP handler for %s (exactmatch %d)\n", prefix, exactMatch);
-    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler));
+    pathHandlers.push_back(HTTPPathHandler(prefix, exactMatch, handler, selector));
 }
 
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch)
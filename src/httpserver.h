@@ -7,6 +7,7 @@
 
 #include <string>
 #include <stdint.h>
+#include <stdio.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
@@ -14,9 +15,14 @@
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+//! Bytes of a chunked reply that may wait to be sent before the worker producing it is held up
+static const size_t MAX_HTTP_REPLY_PENDING=256 * 1024;
+//! Work queue served by the -rpcthreads workers
+static const int HTTP_DEFAULT_QUEUE=0;
 
 struct evhttp_request;
 struct event_base;
+struct HTTPReplyStream;
 class CService;
 class HTTPRequest;
 
@@ -36,11 +42,22 @@ void StopHTTPServer();
 
 /** Handler for requests to a certain HTTP path */
 typedef boost::function<void(HTTPRequest* req, const std::string &)> HTTPRequestHandler;
+/** Picks the work queue of a request, called on the event loop thread so it must be cheap */
+typedef boost::function<int(HTTPRequest* req)> HTTPQueueSelector;
 /** Register handler for prefix.
  * If multiple handlers match a prefix, the first-registered one will
- * be invoked.
+ * be invoked. Requests go to HTTP_DEFAULT_QUEUE unless a selector is given.
  */
-void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler);
+void RegisterHTTPHandler(const std::string &prefix, bool exactMatch, const HTTPRequestHandler &handler, const HTTPQueueSelector &selector = HTTPQueueSelector());
+/** Create a work queue with nThreads workers of its own and room for nDepth requests.
+ * Call this between InitHTTPServer and StartHTTPServer.
+ * @returns the id a HTTPQueueSelector returns to dispatch to the queue.
+ */
+int CreateHTTPWorkQueue(const std::string &name, int nThreads, int nDepth);
+/** Run func on a worker of a work queue.
+ * @returns false if the queue is full or the server is not running.
+ */
+bool EnqueueHTTPWork(int nQueue, const boost::function<void()>& func);
 /** Unregister handler for prefix */
 void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
 
@@ -57,6 +74,8 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! Flow control of a chunked reply, handed to the main http thread by EndChunkedReply
+    HTTPReplyStream* stream;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -96,6 +115,12 @@ public:
      */
     std::string ReadBody();
 
+    /**
+     * Copy the request body into strBody without consuming it.
+     * @returns false if the body is larger than nMaxSize.
+     */
+    bool PeekBody(std::string& strBody, size_t nMaxSize);
+
     /**
      * Write output header.
      *
@@ -112,6 +137,39 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Write HTTP reply with nSize bytes of file from nOffset on as body. libevent
+     * sends them straight from the file (with sendfile or mmap where available),
+     * without copying them into memory first. Takes ownership of file.
+     *
+     * @note Like WriteReply, this can be called only once.
+     */
+    void WriteReplyFile(int nStatus, FILE* file, int64_t nOffset, int64_t nSize);
+
+    /**
+     * Start a chunked HTTP reply, for replies that are produced incrementally.
+     * Send the body with WriteReplyChunk and finish with EndChunkedReply.
+     *
+     * @note call WriteHeader before this, and WriteReply not at all.
+     */
+    void StartChunkedReply(int nStatus);
+
+    /**
+     * Send a part of a chunked reply. Waits while more than MAX_HTTP_REPLY_PENDING
+     * bytes were not sent yet, so a slow client holds up the worker instead of
+     * piling up data.
+     * Returns false if the connection was closed or the client did not receive
+     * anything for -rpcservertimeout seconds.
+     */
+    bool WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply.
+     *
+     * @note Like WriteReply, this gives the request back to the main thread.
+     */
+    void EndChunkedReply();
 };
 
 /** Event handler closure.
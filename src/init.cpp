@@ -13,6 +13,8 @@
 #include "addrman.h"
 #include "amount.h"
 #include "base58.h"
+#include "blockcache.h"
+#include "blockfilemap.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -21,12 +23,14 @@
 #include "httpserver.h"
 #include "httprpc.h"
 #include "key.h"
+#include "maintenance.h"
 #include "validation.h"
 #include "miner.h"
 #include "netbase.h"
 #include "net.h"
 #include "netfulfilledman.h"
 #include "net_processing.h"
+#include "orphanpool.h"
 #include "policy/policy.h"
 #include "rpc/server.h"
 #include "script/standard.h"
@@ -36,6 +40,7 @@
 #include "txmempool.h"
 #include "torcontrol.h"
 #include "ui_interface.h"
+#include "unixrpc.h"
 #include "util.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
@@ -86,6 +91,7 @@
 #include <openssl/crypto.h>
 
 #if ENABLE_ZMQ
+#include "zmq/zmqabstractnotifier.h"
 #include "zmq/zmqnotificationinterface.h"
 #endif
 
@@ -200,6 +206,7 @@ void Interrupt(boost::thread_group& threadGroup)
 {
     InterruptHTTPServer();
     InterruptHTTPRPC();
+    InterruptUnixRPC();
     InterruptRPC();
     InterruptREST();
     InterruptTorControl();
@@ -227,6 +234,7 @@ void PrepareShutdown()
     mempool.AddTransactionsUpdated(1);
     StopHTTPRPC();
     StopREST();
+    StopUnixRPC();
     StopRPC();
     StopHTTPServer();
 #ifdef ENABLE_WALLET
@@ -273,6 +281,10 @@ void PrepareShutdown()
         pcoinscatcher = NULL;
         delete pcoinsdbview;
         pcoinsdbview = NULL;
+        delete pcoinsBackground;
+        pcoinsBackground = NULL;
+        delete pcoinsdbviewBackground;
+        pcoinsdbviewBackground = NULL;
         delete pblocktree;
         pblocktree = NULL;
     }
@@ -329,6 +341,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopDebugLogWriter();
 }
 
 /**
@@ -394,6 +407,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockfilemaps=<n>", strprintf(_("Keep up to <n> block and undo files memory mapped to read blocks from (0 to %d, 0 = disable, default: %d)"), MAX_BLOCK_FILE_MAPS, DEFAULT_BLOCK_FILE_MAPS));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -407,8 +421,14 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    strUsage += HelpMessageOpt("-dbcompressindex", strprintf(_("Compress the block index database, which also holds the transaction, address, spent and timestamp indexes. Takes effect for newly written data and needs LevelDB built with Snappy (default: %u)"), DEFAULT_DB_COMPRESS_INDEX));
+    strUsage += HelpMessageOpt("-dbmaxopenfiles=<n>", strprintf(_("Maximum number of table files each of the chainstate and block index databases keeps open (%d to %d, default: %d)"), DBWRAPPER_DEFAULT_MAX_OPEN_FILES, MAX_DB_MAX_OPEN_FILES, DEFAULT_DB_MAX_OPEN_FILES));
+    strUsage += HelpMessageOpt("-dbbackgroundflush", strprintf(_("Write the coins cache to disk in a background thread instead of stalling block validation; memory use can reach about twice -dbcache while a flush is in progress (default: %u)"), DEFAULT_COINS_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-importthreads=<n>", strprintf(_("Set the number of threads reading and checking blocks of -reindex and -loadblock files (0 to %d, 0 = auto, default: %d)"),
+        MAX_IMPORT_THREADS, DEFAULT_IMPORT_THREADS));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxorphantxpeersize=<n>", strprintf(_("Keep at most <n> kilobytes of unconnectable transactions per peer in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TX_PEER_SIZE));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"),
@@ -416,6 +436,8 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Set the number of threads reading the inputs of a new block from the coin database before it is connected (0 to %d, 0 = disable, default: %d)"),
+        MAX_COINS_PREFETCH_THREADS, DEFAULT_COINS_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
@@ -427,6 +449,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
 
     strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain a full address index, used to query for the balance, txids and unspent outputs for addresses (default: %u)"), DEFAULT_ADDRESSINDEX));
+    strUsage += HelpMessageOpt("-addressseekthreads=<n>", strprintf(_("Set the number of threads reading the address index when a query covers many addresses (0 to %d, 0 = disable, default: %d)"),
+        MAX_ADDRESS_SEEK_THREADS, DEFAULT_ADDRESS_SEEK_THREADS));
     strUsage += HelpMessageOpt("-timestampindex", strprintf(_("Maintain a timestamp index for block hashes, used to query blocks hashes by a range of timestamps (default: %u)"), DEFAULT_TIMESTAMPINDEX));
     strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain a full spent index, used to query the spending txid and input index for an outpoint (default: %u)"), DEFAULT_SPENTINDEX));
 
@@ -472,6 +496,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-whitelistrelay", strprintf(_("Accept relayed transactions received from whitelisted peers even when not relaying transactions (default: %d)"), DEFAULT_WHITELISTRELAY));
     strUsage += HelpMessageOpt("-whitelistforcerelay", strprintf(_("Force relay of transactions from whitelisted peers even they violate local relay policy (default: %d)"), DEFAULT_WHITELISTFORCERELAY));
     strUsage += HelpMessageOpt("-maxuploadtarget=<n>", strprintf(_("Tries to keep outbound traffic under the given target (in MiB per 24h), 0 = no limit (default: %d)"), DEFAULT_MAX_UPLOAD_TARGET));
+    strUsage += HelpMessageOpt("-recentblockcache=<n>", strprintf(_("Keep the last connected blocks in up to <n> MiB of memory to serve them to peers, RPC and ZMQ clients (0 to %d, 0 = disable, default: %d)"), MAX_RECENT_BLOCK_CACHE, DEFAULT_RECENT_BLOCK_CACHE));
 
 #ifdef ENABLE_WALLET
     strUsage += HelpMessageGroup(_("Wallet options:"));
@@ -519,6 +544,11 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashtxremoved=<address>", _("Enable publish hash of transactions removed from the mempool in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubmasternodelist=<address>", _("Enable publish masternodes added to and removed from the masternode list in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubhashgovernanceobject=<address>", _("Enable publish hash governance object in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubrawgovernanceobject=<address>", _("Enable publish raw governance object in <address>"));
+    strUsage += HelpMessageOpt("-zmqpub<topic>hwm=<n>", strprintf(_("Set the outbound message high water mark of the socket of -zmqpub<topic> (default: %d)"), DEFAULT_ZMQ_SNDHWM));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -557,7 +587,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-gen", strprintf(_("Generate coins (default: %u)"), DEFAULT_GENERATE));
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads for coin generation if enabled (-1 = all cores, default: %d)"), DEFAULT_GENERATE_THREADS));
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-debugratelimit=<n>", strprintf(_("Log at most <n> lines per second of each debugging category, 0 for no limit (default: %u)"), DEFAULT_DEBUGRATELIMIT));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), DEFAULT_LOGIPS));
+    strUsage += HelpMessageOpt("-logasync", strprintf(_("Write debug.log from a background thread, dropping lines if it falls behind (default: %u)"), DEFAULT_LOGASYNC));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), DEFAULT_LOGTIMESTAMPS));
     if (showDebug)
     {
@@ -582,6 +614,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-shrinkdebugfile", _("Shrink debug.log file on client startup (default: 1 when no -debug)"));
     AppendParamsHelpMessages(strUsage, showDebug);
     strUsage += HelpMessageOpt("-litemode=<n>", strprintf(_("Disable all Dash specific functionality (Masternodes, PrivateSend, InstantSend, Governance) (0-1, default: %u)"), 0));
+    strUsage += HelpMessageOpt("-maintenancethreads=<n>", strprintf(_("Number of threads running the periodic maintenance of the Dash modules (1-%d, default: %d)"), MAX_MAINTENANCE_THREADS, DEFAULT_MAINTENANCE_THREADS));
 
     strUsage += HelpMessageGroup(_("Masternode options:"));
     strUsage += HelpMessageOpt("-masternode=<n>", strprintf(_("Enable the client to act as a masternode (0-1, default: %u)"), 0));
@@ -622,6 +655,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("RPC server options:"));
     strUsage += HelpMessageOpt("-server", _("Accept command line and JSON-RPC commands"));
     strUsage += HelpMessageOpt("-rest", strprintf(_("Accept public REST requests (default: %u)"), DEFAULT_REST_ENABLE));
+    strUsage += HelpMessageOpt("-restmaxbytes=<n>", strprintf(_("Maximum number of bytes returned by a batch REST request (default: %u)"), DEFAULT_REST_MAX_BYTES));
     strUsage += HelpMessageOpt("-rpcbind=<addr>", _("Bind to given address to listen for JSON-RPC connections. Use [host]:port notation for IPv6. This option can be specified multiple times (default: bind to all interfaces)"));
     strUsage += HelpMessageOpt("-rpccookiefile=<loc>", _("Location of the auth cookie (default: data dir)"));
     strUsage += HelpMessageOpt("-rpcuser=<user>", _("Username for JSON-RPC connections"));
@@ -630,6 +664,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), BaseParams(CBaseChainParams::MAIN).RPCPort(), BaseParams(CBaseChainParams::TESTNET).RPCPort()));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcfastthreads=<n>", strprintf(_("Set the number of threads to service lock-free RPC calls like getblockcount, 0 to use the -rpcthreads ones (default: %d)"), DEFAULT_RPC_FAST_THREADS));
+    strUsage += HelpMessageOpt("-rpcwalletthreads=<n>", strprintf(_("Set the number of threads to service wallet RPC calls, 0 to use the -rpcthreads ones (default: %d)"), DEFAULT_RPC_WALLET_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchparallel=<n>", strprintf(_("Set the number of requests of a JSON-RPC batch executed at once by the -rpcthreads threads (default: %d)"), DEFAULT_RPC_BATCH_PARALLEL));
+    strUsage += HelpMessageOpt("-rpcheavythreads=<n>", strprintf(_("Set the number of threads to service long running RPC calls like gettxoutsetinfo, 0 to use the -rpcthreads ones (default: %d)"), DEFAULT_RPC_HEAVY_THREADS));
+#ifndef WIN32
+    strUsage += HelpMessageOpt("-rpcunixsocket=<path>", strprintf(_("Accept binary RPC calls on the Unix domain socket <path>, relative to the data directory (default: none, %s if no path is given)"), DEFAULT_UNIX_RPC_SOCKET));
+#endif
     if (showDebug) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
@@ -728,18 +769,15 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
 
     // -reindex
     if (fReindex) {
-        int nFile = 0;
-        while (true) {
+        std::vector<CImportFile> vFiles;
+        for (int nFile = 0; true; nFile++) {
             CDiskBlockPos pos(nFile, 0);
-            if (!boost::filesystem::exists(GetBlockPosFilename(pos, "blk")))
+            boost::filesystem::path path = GetBlockPosFilename(pos, "blk");
+            if (!boost::filesystem::exists(path))
                 break; // No block files left to reindex
-            FILE *file = OpenBlockFile(pos, true);
-            if (!file)
-                break; // This error is logged in OpenBlockFile
-            LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)nFile);
-            LoadExternalBlockFile(chainparams, file, &pos);
-            nFile++;
+            vFiles.push_back(CImportFile(NULL, nFile, path.string()));
         }
+        LoadExternalBlockFiles(chainparams, vFiles);
         pblocktree->WriteReindexing(false);
         fReindex = false;
         LogPrintf("Reindexing finished\n");
@@ -753,8 +791,7 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
         FILE *file = fopen(pathBootstrap.string().c_str(), "rb");
         if (file) {
             boost::filesystem::path pathBootstrapOld = GetDataDir() / "bootstrap.dat.old";
-            LogPrintf("Importing bootstrap.dat...\n");
-            LoadExternalBlockFile(chainparams, file);
+            LoadExternalBlockFiles(chainparams, std::vector<CImportFile>(1, CImportFile(file, -1, pathBootstrap.string())));
             RenameOver(pathBootstrap, pathBootstrapOld);
         } else {
             LogPrintf("Warning: Could not open bootstrap file %s\n", pathBootstrap.string());
@@ -762,15 +799,17 @@ void ThreadImport(std::vector<boost::filesystem::path> vImportFiles)
     }
 
     // -loadblock=
+    std::vector<CImportFile> vFiles;
     BOOST_FOREACH(const boost::filesystem::path& path, vImportFiles) {
         FILE *file = fopen(path.string().c_str(), "rb");
         if (file) {
-            LogPrintf("Importing blocks file %s...\n", path.string());
-            LoadExternalBlockFile(chainparams, file);
+            vFiles.push_back(CImportFile(file, -1, path.string()));
         } else {
             LogPrintf("Warning: Could not open blocks file %s\n", path.string());
         }
     }
+    if (!vFiles.empty())
+        LoadExternalBlockFiles(chainparams, vFiles);
 
     // scan for better chains in the block chain database, that are not yet connected in the active best chain
     CValidationState state;
@@ -813,6 +852,8 @@ bool AppInitServers(boost::thread_group& threadGroup)
         return false;
     if (GetBoolArg("-rest", DEFAULT_REST_ENABLE) && !StartREST())
         return false;
+    if (!StartUnixRPC())
+        return false;
     if (!StartHTTPServer())
         return false;
     return true;
@@ -949,6 +990,7 @@ void InitLogging()
     fLogTimeMicros = GetBoolArg("-logtimemicros", DEFAULT_LOGTIMEMICROS);
     fLogThreadNames = GetBoolArg("-logthreadnames", DEFAULT_LOGTHREADNAMES);
     fLogIPs = GetBoolArg("-logips", DEFAULT_LOGIPS);
+    nDebugRateLimit = GetArg("-debugratelimit", DEFAULT_DEBUGRATELIMIT);
 
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("Dash Core version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
@@ -1036,12 +1078,26 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     int nMaxConnections = std::max(nUserMaxConnections, 0);
 
+    // MIN_CORE_FILEDESCRIPTORS covers the default number of open table files of the
+    // chainstate and block index databases, more of them need extra descriptors.
+    nDBMaxOpenFiles = std::max(DBWRAPPER_DEFAULT_MAX_OPEN_FILES, std::min((int)GetArg("-dbmaxopenfiles", DEFAULT_DB_MAX_OPEN_FILES), MAX_DB_MAX_OPEN_FILES));
+#ifdef WIN32
+    int nDBExtraFD = 0;
+#else
+    int nDBExtraFD = 2 * (nDBMaxOpenFiles - DBWRAPPER_DEFAULT_MAX_OPEN_FILES);
+#endif
+
     // Trim requested connection counts, to fit into system limitations
     nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
-    int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
+    int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS + nDBExtraFD);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
     nMaxConnections = std::min(nFD - MIN_CORE_FILEDESCRIPTORS, nMaxConnections);
+    if (nFD - MIN_CORE_FILEDESCRIPTORS - nMaxConnections < nDBExtraFD) {
+        // Connections win over database file handles
+        nDBMaxOpenFiles = DBWRAPPER_DEFAULT_MAX_OPEN_FILES + (nFD - MIN_CORE_FILEDESCRIPTORS - nMaxConnections) / 2;
+    }
+    fDBCompressIndex = GetBoolArg("-dbcompressindex", DEFAULT_DB_COMPRESS_INDEX);
 
     if (nMaxConnections < nUserMaxConnections)
         InitWarning(strprintf(_("Reducing -maxconnections from %d to %d, because of system limitations."), nUserMaxConnections, nMaxConnections));
@@ -1090,6 +1146,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (nMempoolSizeMax < 0 || nMempoolSizeMax < nMempoolSizeMin)
         return InitError(strprintf(_("-maxmempool must be at least %d MB"), std::ceil(nMempoolSizeMin / 1000000.0)));
 
+    // orphan pool limits
+    int64_t nMaxOrphanPeerUsage = GetArg("-maxorphantxpeersize", DEFAULT_MAX_ORPHAN_TX_PEER_SIZE) * 1000;
+    if (nMaxOrphanPeerUsage < 0)
+        return InitError(_("-maxorphantxpeersize must not be negative"));
+    orphanpool.SetMaxPeerUsage(nMaxOrphanPeerUsage);
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0)
@@ -1099,6 +1161,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nCoinsPrefetchThreads = std::max(0, std::min((int)GetArg("-prefetchthreads", DEFAULT_COINS_PREFETCH_THREADS), MAX_COINS_PREFETCH_THREADS));
+    recentBlocks.SetMaxUsage((size_t)std::max(0, std::min((int)GetArg("-recentblockcache", DEFAULT_RECENT_BLOCK_CACHE), MAX_RECENT_BLOCK_CACHE)) << 20);
+    blockFileMaps.SetMaxFiles(std::max(0, std::min((int)GetArg("-blockfilemaps", DEFAULT_BLOCK_FILE_MAPS), MAX_BLOCK_FILE_MAPS)));
+    nImportThreads = GetArg("-importthreads", DEFAULT_IMPORT_THREADS);
+    if (nImportThreads <= 0)
+        nImportThreads = GetNumCores();
+    nImportThreads = std::max(1, std::min(nImportThreads, MAX_IMPORT_THREADS));
+    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX))
+        nAddressSeekThreads = std::max(0, std::min((int)GetArg("-addressseekthreads", DEFAULT_ADDRESS_SEEK_THREADS), MAX_ADDRESS_SEEK_THREADS));
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1262,8 +1334,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         ShrinkDebugFile();
     }
 
-    if (fPrintToDebugLog)
+    if (fPrintToDebugLog) {
         OpenDebugLog();
+        if (GetBoolArg("-logasync", DEFAULT_LOGASYNC))
+            StartDebugLogWriter();
+    }
 
 #ifdef ENABLE_WALLET
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
@@ -1274,6 +1349,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("Using data directory %s\n", strDataDir);
     LogPrintf("Using config file %s\n", GetConfigFile().string());
     LogPrintf("Using at most %i connections (%i file descriptors available)\n", nMaxConnections, nFD);
+    LogPrintf("Using at most %i open files per database\n", nDBMaxOpenFiles);
     std::ostringstream strErrors;
 
     LogPrintf("Using %u threads for script verification\n", nScriptCheckThreads);
@@ -1282,6 +1358,15 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    LogPrintf("Using %u threads for coins prefetch\n", nCoinsPrefetchThreads);
+    for (int i = 0; i < nCoinsPrefetchThreads; i++)
+        threadGroup.create_thread(&ThreadCoinsPrefetch);
+
+    if (nAddressSeekThreads)
+        LogPrintf("Using %u threads for address index seeks\n", nAddressSeekThreads);
+    for (int i = 0; i < nAddressSeekThreads; i++)
+        threadGroup.create_thread(&ThreadAddressSeek);
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1558,10 +1643,18 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 delete pblocktree;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
-                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
+                pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState, GetBoolArg("-dbbackgroundflush", DEFAULT_COINS_BACKGROUND_FLUSH));
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
 
+                if (fReindexChainState && !fReindex) {
+                    // The chain state is rebuilt from the blocks, without any UTXO snapshot
+                    pblocktree->EraseSnapshotBase();
+                    pblocktree->WriteFlag("utxosnapshotload", false);
+                }
+                if (fReindex || fReindexChainState)
+                    boost::filesystem::remove_all(GetDataDir() / BACKGROUND_CHAINSTATE_DIR);
+
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
                     //If we're reindexing in prune mode, wipe away unusable block files and all undo data files
@@ -1872,6 +1965,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    // The blocks below a loaded UTXO snapshot can't be served either, until they are validated
+    if (pindexSnapshotBase && (nLocalServices & NODE_NETWORK)) {
+        LogPrintf("Unsetting NODE_NETWORK after loading a UTXO snapshot\n");
+        nLocalServices = ServiceFlags(nLocalServices & ~NODE_NETWORK);
+    }
+
     // ********************************************************* Step 10: import blocks
 
     if (mapArgs.count("-blocknotify"))
@@ -1884,6 +1983,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             vImportFiles.push_back(strFile);
     }
     threadGroup.create_thread(boost::bind(&ThreadImport, vImportFiles));
+    threadGroup.create_thread(&ThreadSnapshotValidation);
     if (chainActive.Tip() == NULL) {
         LogPrintf("Waiting for genesis block to be imported...\n");
         while (!fRequestShutdown && chainActive.Tip() == NULL)
@@ -2013,15 +2113,17 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     // GetMainSignals().UpdatedBlockTip(chainActive.Tip());
     pdsNotificationInterface->InitializeCurrentBlockTip();
 
-    // ********************************************************* Step 11d: start dash-ps-<smth> threads
+    // ********************************************************* Step 11d: start the maintenance of the Dash modules
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSend, boost::ref(*g_connman)));
+    SchedulePrivateSendMaintenance(*g_connman);
     if (fMasterNode)
-        threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSendServer, boost::ref(*g_connman)));
+        SchedulePrivateSendServerMaintenance(*g_connman);
 #ifdef ENABLE_WALLET
     else
-        threadGroup.create_thread(boost::bind(&ThreadCheckPrivateSendClient, boost::ref(*g_connman)));
+        SchedulePrivateSendClientMaintenance(*g_connman);
 #endif // ENABLE_WALLET
+    int nMaintenanceThreads = std::max(1, std::min((int)GetArg("-maintenancethreads", DEFAULT_MAINTENANCE_THREADS), MAX_MAINTENANCE_THREADS));
+    maintenanceScheduler.Start(threadGroup, nMaintenanceThreads);
 
     // ********************************************************* Step 12: start node
 
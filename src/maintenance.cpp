@@ -0,0 +1,180 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "maintenance.h"
+
+#include "random.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <assert.h>
+
+#include <boost/bind.hpp>
+
+CMaintenanceScheduler maintenanceScheduler;
+
+int64_t CMaintenanceScheduler::GetHistogramBound(int nBucket)
+{
+    if (nBucket >= MAINTENANCE_HISTOGRAM_BUCKETS - 1)
+        return -1;
+    return (int64_t)1 << nBucket;
+}
+
+static int GetHistogramBucket(int64_t nMicros)
+{
+    int nBucket = 0;
+    for (int64_t nMillis = nMicros / 1000; nMillis > 0 && nBucket < MAINTENANCE_HISTOGRAM_BUCKETS - 1; nMillis >>= 1)
+        nBucket++;
+    return nBucket;
+}
+
+void CMaintenanceScheduler::ScheduleEvery(const std::string& strName, Function func, int64_t nInterval, int64_t nJitter, int64_t nDelay)
+{
+    assert(nInterval > 0 && nJitter >= 0);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    int64_t nNow = GetTimeMillis() / 1000;
+
+    CJob& job = mapJobs[strName];
+    job.func = func;
+    job.stats = CMaintenanceJobStats();
+    job.stats.strName = strName;
+    job.stats.nInterval = nInterval;
+    job.stats.nJitter = nJitter;
+    for (int i = 0; i < MAINTENANCE_HISTOGRAM_BUCKETS; i++)
+        job.stats.vHistogram[i] = 0;
+
+    int64_t nFirst = nNow + (nDelay >= 0 ? nDelay : 1 + GetRand(nInterval));
+    job.nTimeScheduled = wheel.Schedule(nFirst, strName);
+    job.stats.nTimeNext = job.nTimeScheduled;
+}
+
+void CMaintenanceScheduler::ScheduleNext(CJob& job, int64_t nTimeLast, int64_t nNow)
+{
+    // runs missed while the job was late or running are skipped
+    int64_t nNext = nTimeLast + job.stats.nInterval;
+    if (nNext <= nNow)
+        nNext += (nNow - nNext) / job.stats.nInterval * job.stats.nInterval + job.stats.nInterval;
+    if (job.stats.nJitter > 0)
+        nNext += GetRand(job.stats.nJitter + 1);
+    job.nTimeScheduled = wheel.Schedule(nNext, job.stats.strName);
+    job.stats.nTimeNext = job.nTimeScheduled;
+}
+
+void CMaintenanceScheduler::Dispatch(int64_t nNow)
+{
+    std::vector<CTimerWheel<std::string>::entry_type> vDue;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        wheel.Advance(nNow, vDue);
+        for (size_t i = 0; i < vDue.size(); i++) {
+            std::map<std::string, CJob>::iterator it = mapJobs.find(vDue[i].second);
+            // replaced by ScheduleEvery() since
+            if (it == mapJobs.end() || it->second.nTimeScheduled != vDue[i].first)
+                continue;
+            it->second.nTimeScheduled = 0;
+            it->second.stats.nTimeNext = 0;
+            queueReady.push_back(std::make_pair(vDue[i].second, vDue[i].first));
+        }
+    }
+    if (!vDue.empty())
+        condReady.notify_all();
+}
+
+void CMaintenanceScheduler::RunJob(const std::string& strName, int64_t nTimeDue)
+{
+    Function func;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::map<std::string, CJob>::iterator it = mapJobs.find(strName);
+        if (it == mapJobs.end())
+            return;
+        func = it->second.func;
+    }
+
+    int64_t nStart = GetTimeMicros();
+    try {
+        func();
+    } catch (const boost::thread_interrupted&) {
+        throw;
+    } catch (const std::exception& e) {
+        PrintExceptionContinue(&e, ("maintenance job " + strName).c_str());
+    } catch (...) {
+        PrintExceptionContinue(NULL, ("maintenance job " + strName).c_str());
+    }
+    int64_t nMicros = GetTimeMicros() - nStart;
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<std::string, CJob>::iterator it = mapJobs.find(strName);
+    if (it == mapJobs.end())
+        return;
+    CMaintenanceJobStats& stats = it->second.stats;
+    stats.nRuns++;
+    stats.nTotalMicros += nMicros;
+    stats.nLastMicros = nMicros;
+    stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+    stats.nMaxLateSeconds = std::max(stats.nMaxLateSeconds, nStart / 1000000 - nTimeDue);
+    stats.vHistogram[GetHistogramBucket(nMicros)]++;
+    if (nMicros >= stats.nInterval * 1000000) {
+        stats.nOverruns++;
+        LogPrintf("CMaintenanceScheduler::RunJob -- %s took %.3fs, longer than its interval of %ds\n", strName, nMicros * 0.000001, stats.nInterval);
+    }
+    LogPrint("bench", "CMaintenanceScheduler::RunJob -- %s: %.2fms\n", strName, nMicros * 0.001);
+    ScheduleNext(it->second, nTimeDue, GetTimeMillis() / 1000);
+}
+
+bool CMaintenanceScheduler::RunQueued()
+{
+    std::pair<std::string, int64_t> job;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (queueReady.empty())
+            return false;
+        job = queueReady.front();
+        queueReady.pop_front();
+    }
+    RunJob(job.first, job.second);
+    return true;
+}
+
+void CMaintenanceScheduler::ThreadDispatch()
+{
+    while (true) {
+        Dispatch(GetTimeMillis() / 1000);
+        // wake up just after the start of the next second
+        MilliSleep(1000 - GetTimeMillis() % 1000);
+    }
+}
+
+void CMaintenanceScheduler::ThreadWork()
+{
+    while (true) {
+        std::pair<std::string, int64_t> job;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queueReady.empty())
+                condReady.wait(lock);
+            job = queueReady.front();
+            queueReady.pop_front();
+        }
+        RunJob(job.first, job.second);
+    }
+}
+
+void CMaintenanceScheduler::Start(boost::thread_group& threadGroup, int nWorkers)
+{
+    Function dispatchLoop = boost::bind(&CMaintenanceScheduler::ThreadDispatch, this);
+    threadGroup.create_thread(boost::bind(&TraceThread<Function>, "maintenance", dispatchLoop));
+    Function workLoop = boost::bind(&CMaintenanceScheduler::ThreadWork, this);
+    for (int i = 0; i < nWorkers; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<Function>, "maintwork", workLoop));
+}
+
+std::vector<CMaintenanceJobStats> CMaintenanceScheduler::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::vector<CMaintenanceJobStats> vStats;
+    for (std::map<std::string, CJob>::const_iterator it = mapJobs.begin(); it != mapJobs.end(); ++it)
+        vStats.push_back(it->second.stats);
+    return vStats;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include "timerwheel.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
+class CMaintenanceScheduler;
+
+extern CMaintenanceScheduler maintenanceScheduler;
+
+//! Worker threads running the maintenance jobs
+static const int DEFAULT_MAINTENANCE_THREADS = 2;
+static const int MAX_MAINTENANCE_THREADS = 16;
+//! Buckets of the runtime histograms: run times below 1, 2, 4, ... ms, the last one for anything longer
+static const int MAINTENANCE_HISTOGRAM_BUCKETS = 16;
+
+/** Statistics of a maintenance job, as of the last time it finished */
+struct CMaintenanceJobStats
+{
+    std::string strName;
+    int64_t nInterval;
+    int64_t nJitter;
+    //! When the job runs next, 0 while it is running
+    int64_t nTimeNext;
+    uint64_t nRuns;
+    //! Runs which took longer than the interval, the job was due again before it finished
+    uint64_t nOverruns;
+    int64_t nTotalMicros;
+    int64_t nLastMicros;
+    int64_t nMaxMicros;
+    //! Largest delay between when the job was due and when a worker started it, in seconds
+    int64_t nMaxLateSeconds;
+    uint64_t vHistogram[MAINTENANCE_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * Runs the periodic maintenance jobs of the Dash modules on a pool of worker
+ * threads. Jobs are named and kept in a timer wheel with a slot per second;
+ * a dispatcher thread advances it every second and queues the jobs due for
+ * the workers.
+ *
+ * A job never runs twice at the same time: it is scheduled again when it
+ * finishes, a whole number of intervals after its previous start time plus
+ * a random jitter, skipping the runs it missed. Jobs start at a random offset
+ * in their interval unless told otherwise, so jobs with the same interval
+ * don't all run in the same second.
+ */
+class CMaintenanceScheduler
+{
+public:
+    typedef boost::function<void(void)> Function;
+
+private:
+    struct CJob
+    {
+        Function func;
+        CMaintenanceJobStats stats;
+        //! Time the job is due at in the wheel, 0 while queued or running
+        int64_t nTimeScheduled;
+    };
+
+    mutable boost::mutex mutex;
+    boost::condition_variable condReady;
+    std::map<std::string, CJob> mapJobs;
+    CTimerWheel<std::string> wheel;
+    //! Jobs due, in the order they became due, and the time they were due at
+    std::deque<std::pair<std::string, int64_t> > queueReady;
+
+    void ScheduleNext(CJob& job, int64_t nTimeLast, int64_t nNow);
+    void RunJob(const std::string& strName, int64_t nTimeDue);
+
+    void ThreadDispatch();
+    void ThreadWork();
+
+public:
+    /**
+     * Run func every nInterval seconds, delayed by up to nJitter seconds
+     * each time. The first run is nDelay seconds from now, or at a random
+     * time within the first interval if nDelay is negative.
+     * A job with the same name is replaced.
+     */
+    void ScheduleEvery(const std::string& strName, Function func, int64_t nInterval, int64_t nJitter = 0, int64_t nDelay = -1);
+
+    /** Queue the jobs due at nNow, called by the dispatcher thread every second */
+    void Dispatch(int64_t nNow);
+    /** Run the first queued job, if any, on the calling thread. Returns false if none was queued. */
+    bool RunQueued();
+
+    /** Start the dispatcher and nWorkers worker threads in threadGroup, they stop when interrupted */
+    void Start(boost::thread_group& threadGroup, int nWorkers);
+
+    std::vector<CMaintenanceJobStats> GetStats() const;
+    /** Upper bound in ms of the runs counted in histogram bucket nBucket, -1 for the last bucket */
+    static int64_t GetHistogramBound(int nBucket);
+};
+
+#endif // MAINTENANCE_H
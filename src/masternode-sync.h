@@ -7,6 +7,8 @@
 #include "chain.h"
 #include "net.h"
 
+#include <atomic>
+
 #include <univalue.h>
 
 class CMasternodeSync;
@@ -35,13 +37,14 @@ extern CMasternodeSync masternodeSync;
 class CMasternodeSync
 {
 private:
+    // Sync state read by "mnsync status" and others without taking any lock
     // Keep track of current asset
-    int nRequestedMasternodeAssets;
+    std::atomic<int> nRequestedMasternodeAssets;
     // Count peers we've requested the asset from
-    int nRequestedMasternodeAttempt;
+    std::atomic<int> nRequestedMasternodeAttempt;
 
     // Time when current masternode asset sync started
-    int64_t nTimeAssetSyncStarted;
+    std::atomic<int64_t> nTimeAssetSyncStarted;
     // ... last bumped
     int64_t nTimeLastBumped;
     // ... or failed
@@ -40,7 +40,8 @@ CMasternode::CMasternode(const CMasternode& other) :
     nPoSeBanScore(other.nPoSeBanScore),
     nPoSeBanHeight(other.nPoSeBanHeight),
     fAllowMixingTx(other.fAllowMixingTx),
-    fUnitTest(other.fUnitTest)
+    fUnitTest(other.fUnitTest),
+    nTimeNextCheck(other.nTimeNextCheck)
 {}
 
 CMasternode::CMasternode(const CMasternodeBroadcast& mnb) :
@@ -136,6 +137,7 @@ void CMasternode::Check(bool fForce)
     LogPrint("masternode", "CMasternode::Check -- Masternode %s is in %s state\n", vin.prevout.ToStringShort(), GetStateString());
 
     //once spent, stop doing the checks
+    //(spends of the collateral are reported by collateralWatch to CMasternodeMan::CollateralSpent())
     if(IsOutpointSpent()) return;
 
     int nHeight = 0;
@@ -143,13 +145,6 @@ void CMasternode::Check(bool fForce)
         TRY_LOCK(cs_main, lockMain);
         if(!lockMain) return;
 
-        CollateralStatus err = CheckCollateral(vin.prevout);
-        if (err == COLLATERAL_UTXO_NOT_FOUND) {
-            nActiveState = MASTERNODE_OUTPOINT_SPENT;
-            LogPrint("masternode", "CMasternode::Check -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
-            return;
-        }
-
         nHeight = chainActive.Height();
     }
 
@@ -243,16 +238,35 @@ void CMasternode::Check(bool fForce)
     }
 }
 
+int64_t CMasternode::GetNextCheckTime(int64_t nTime)
+{
+    LOCK(cs);
+
+    // a spent collateral is final, without pings nothing changes until the next one
+    if(IsOutpointSpent() || lastPing == CMasternodePing()) return 0;
+
+    // the times at which the IsPingedWithin() calls of Check() turn false
+    int64_t nNextTime = 0;
+    const int vPingSeconds[] = {MASTERNODE_MIN_MNP_SECONDS, MASTERNODE_EXPIRATION_SECONDS, MASTERNODE_NEW_START_REQUIRED_SECONDS};
+    for (unsigned int i = 0; i < ARRAYLEN(vPingSeconds); i++) {
+        int64_t nDeadline = lastPing.sigTime + vPingSeconds[i];
+        if(nDeadline > nTime && (nNextTime == 0 || nDeadline < nNextTime)) nNextTime = nDeadline;
+    }
+    int64_t nWatchdogDeadline = nTimeLastWatchdogVote + MASTERNODE_WATCHDOG_MAX_SECONDS + 1;
+    if(nWatchdogDeadline > nTime && (nNextTime == 0 || nWatchdogDeadline < nNextTime)) nNextTime = nWatchdogDeadline;
+
+    return nNextTime;
+}
+
 bool CMasternode::IsInputAssociatedWithPubkey()
 {
     CScript payee;
     payee = GetScriptForDestination(pubKeyCollateralAddress.GetID());
 
-    CTransaction tx;
-    uint256 hash;
-    if(GetTransaction(vin.prevout.hash, tx, Params().GetConsensus(), hash, true)) {
-        BOOST_FOREACH(CTxOut out, tx.vout)
-            if(out.nValue == 1000*COIN && out.scriptPubKey == payee) return true;
+    // look at the collateral itself, the transaction isn't indexed if it's below a loaded UTXO snapshot
+    Coin coin;
+    if(GetUTXOCoin(vin.prevout, coin)) {
+        if(coin.out.nValue == 1000*COIN && coin.out.scriptPubKey == payee) return true;
     }
 
     return false;
@@ -543,6 +557,7 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
         return false;
     }
 
+    int nHeight;
     {
         TRY_LOCK(cs_main, lockMain);
         if(!lockMain) {
@@ -552,7 +567,6 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
             return false;
         }
 
-        int nHeight;
         CollateralStatus err = CheckCollateral(vin.prevout, nHeight);
         if (err == COLLATERAL_UTXO_NOT_FOUND) {
             LogPrint("masternode", "CMasternodeBroadcast::CheckOutpoint -- Failed to find Masternode UTXO, masternode=%s\n", vin.prevout.ToStringShort());
@@ -586,21 +600,15 @@ bool CMasternodeBroadcast::CheckOutpoint(int& nDos)
     }
 
     // verify that sig time is legit in past
-    // should be at least not earlier than block when 1000 DASH tx got nMasternodeMinimumConfirmations
-    uint256 hashBlock = uint256();
-    CTransaction tx2;
-    GetTransaction(vin.prevout.hash, tx2, Params().GetConsensus(), hashBlock, true);
+    // should be at least not earlier than block when 1000 DASH tx got nMasternodeMinimumConfirmations,
+    // found by the height of the collateral, as the tx isn't indexed if it's below a loaded UTXO snapshot
     {
         LOCK(cs_main);
-        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
-        if (mi != mapBlockIndex.end() && (*mi).second) {
-            CBlockIndex* pMNIndex = (*mi).second; // block for 1000 DASH tx -> 1 confirmation
-            CBlockIndex* pConfIndex = chainActive[pMNIndex->nHeight + Params().GetConsensus().nMasternodeMinimumConfirmations - 1]; // block where tx got nMasternodeMinimumConfirmations
-            if(pConfIndex->GetBlockTime() > sigTime) {
-                LogPrintf("CMasternodeBroadcast::CheckOutpoint -- Bad sigTime %d (%d conf block is at %d) for Masternode %s %s\n",
-                          sigTime, Params().GetConsensus().nMasternodeMinimumConfirmations, pConfIndex->GetBlockTime(), vin.prevout.ToStringShort(), addr.ToString());
-                return false;
-            }
+        CBlockIndex* pConfIndex = chainActive[nHeight + Params().GetConsensus().nMasternodeMinimumConfirmations - 1]; // block where tx got nMasternodeMinimumConfirmations
+        if(pConfIndex && pConfIndex->GetBlockTime() > sigTime) {
+            LogPrintf("CMasternodeBroadcast::CheckOutpoint -- Bad sigTime %d (%d conf block is at %d) for Masternode %s %s\n",
+                      sigTime, Params().GetConsensus().nMasternodeMinimumConfirmations, pConfIndex->GetBlockTime(), vin.prevout.ToStringShort(), addr.ToString());
+            return false;
         }
     }
 
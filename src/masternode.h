@@ -162,6 +162,8 @@ public:
     int nPoSeBanHeight{};
     bool fAllowMixingTx{};
     bool fUnitTest = false;
+    // when CMasternodeMan checks this masternode next, not serialized
+    int64_t nTimeNextCheck{};
 
     // KEEP TRACK OF GOVERNANCE ITEMS EACH MASTERNODE HAS VOTE UPON FOR RECALCULATION
     std::map<uint256, int> mapGovernanceObjectsVotedOn;
@@ -206,6 +208,8 @@ public:
     static CollateralStatus CheckCollateral(const COutPoint& outpoint);
     static CollateralStatus CheckCollateral(const COutPoint& outpoint, int& nHeightRet);
     void Check(bool fForce = false);
+    /// Adjusted time after nTime at which Check() may find a new state without any other event, 0 if none
+    int64_t GetNextCheckTime(int64_t nTime);
 
     bool IsBroadcastedWithin(int nSeconds) { return GetAdjustedTime() - sigTime < nSeconds; }
 
@@ -291,6 +295,7 @@ public:
         nPoSeBanHeight = from.nPoSeBanHeight;
         fAllowMixingTx = from.fAllowMixingTx;
         fUnitTest = from.fUnitTest;
+        nTimeNextCheck = from.nTimeNextCheck;
         mapGovernanceObjectsVotedOn = from.mapGovernanceObjectsVotedOn;
         return *this;
     }
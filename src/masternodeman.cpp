@@ -15,6 +15,7 @@
 #endif // ENABLE_WALLET
 #include "script/standard.h"
 #include "util.h"
+#include "validationinterface.h"
 
 /** Masternode manager */
 CMasternodeMan mnodeman;
@@ -63,6 +64,11 @@ CMasternodeMan::CMasternodeMan()
   fMasternodesRemoved(false),
   vecDirtyGovernanceObjectHashes(),
   nLastWatchdogVoteTime(0),
+  wheelCheck(),
+  fCheckAll(true),
+  fCheckedListSynced(false),
+  fCheckedWatchdogActive(false),
+  nCheckedMinPaymentsProto(0),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
   nDsqCount(0)
@@ -77,6 +83,9 @@ bool CMasternodeMan::Add(CMasternode &mn)
     LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
     mapMasternodes[mn.vin.prevout] = mn;
     fMasternodesAdded = true;
+    ScheduleCheck(mapMasternodes[mn.vin.prevout], GetAdjustedTime());
+    collateralWatch.Watch(mn.vin.prevout, this);
+    GetMainSignals().NotifyMasternodeListChanged(mn.vin.prevout, true);
     return true;
 }
 
@@ -143,6 +152,7 @@ bool CMasternodeMan::PoSeBan(const COutPoint &outpoint)
         return false;
     }
     pmn->PoSeBan();
+    ScheduleCheck(*pmn, GetAdjustedTime());
 
     return true;
 }
@@ -158,6 +168,87 @@ void CMasternodeMan::Check()
     }
 }
 
+void CMasternodeMan::ScheduleCheck(CMasternode& mn, int64_t nTime)
+{
+    AssertLockHeld(cs);
+    if(nTime <= 0) return;
+    // already due sooner, that check schedules the next one
+    if(mn.nTimeNextCheck > 0 && mn.nTimeNextCheck <= nTime) return;
+    mn.nTimeNextCheck = wheelCheck.Schedule(nTime, mn.vin.prevout);
+}
+
+void CMasternodeMan::CheckScheduled()
+{
+    // CMasternode::Check() needs cs_main for the chain height, try again on the next call if it's busy
+    TRY_LOCK(cs_main, lockMain);
+    if(!lockMain) return;
+    LOCK(cs);
+
+    int64_t nNow = GetAdjustedTime();
+
+    // a change of what all masternodes depend on is an event for each of them
+    bool fListSynced = masternodeSync.IsMasternodeListSynced();
+    bool fWatchdogActive = masternodeSync.IsSynced() && IsWatchdogActive();
+    int nMinPaymentsProto = mnpayments.GetMinMasternodePaymentsProto();
+    if(fListSynced != fCheckedListSynced || fWatchdogActive != fCheckedWatchdogActive || nMinPaymentsProto != nCheckedMinPaymentsProto) {
+        fCheckedListSynced = fListSynced;
+        fCheckedWatchdogActive = fWatchdogActive;
+        nCheckedMinPaymentsProto = nMinPaymentsProto;
+        fCheckAll = true;
+    }
+
+    std::vector<CTimerWheel<COutPoint>::entry_type> vDue;
+    wheelCheck.Advance(nNow, vDue);
+
+    if(fCheckAll) {
+        LogPrint("masternode", "CMasternodeMan::CheckScheduled -- checking all %d masternodes\n", mapMasternodes.size());
+        fCheckAll = false;
+        for (auto& mnpair : mapMasternodes) {
+            // the list may have been loaded from disk, with collaterals spent while we weren't watching
+            collateralWatch.Watch(mnpair.first, this);
+            if(!mnpair.second.IsOutpointSpent() && CMasternode::CheckCollateral(mnpair.first) == CMasternode::COLLATERAL_UTXO_NOT_FOUND) {
+                LogPrint("masternode", "CMasternodeMan::CheckScheduled -- Failed to find Masternode UTXO, masternode=%s\n", mnpair.first.ToStringShort());
+                mnpair.second.nActiveState = CMasternode::MASTERNODE_OUTPOINT_SPENT;
+            }
+            mnpair.second.nTimeNextCheck = 0;
+            mnpair.second.Check(true);
+            ScheduleCheck(mnpair.second, mnpair.second.GetNextCheckTime(nNow));
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < vDue.size(); i++) {
+        CMasternode* pmn = Find(vDue[i].second);
+        // removed, or rescheduled for an earlier time and checked then
+        if(!pmn || pmn->nTimeNextCheck != vDue[i].first) continue;
+        pmn->nTimeNextCheck = 0;
+        pmn->Check(true);
+        ScheduleCheck(*pmn, pmn->GetNextCheckTime(nNow));
+    }
+}
+
+void CMasternodeMan::CollateralSpent(const COutPoint& outpoint, const CTransaction& tx, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    CMasternode* pmn = Find(outpoint);
+    if(!pmn || pmn->IsOutpointSpent()) return;
+    LogPrint("masternode", "CMasternodeMan::CollateralSpent -- Masternode collateral %s spent by %s\n", outpoint.ToStringShort(), tx.GetHash().ToString());
+    pmn->nActiveState = CMasternode::MASTERNODE_OUTPOINT_SPENT;
+}
+
+void CMasternodeMan::CollateralUnspent(const COutPoint& outpoint, const CBlockIndex* pindex)
+{
+    LOCK(cs);
+    CMasternode* pmn = Find(outpoint);
+    if(!pmn || !pmn->IsOutpointSpent()) return;
+    // the spend was reorged out before CheckAndRemove() removed the masternode, work out its state again
+    LogPrint("masternode", "CMasternodeMan::CollateralUnspent -- Masternode collateral %s unspent\n", outpoint.ToStringShort());
+    // Check() leaves spent masternodes alone, so take it out of that state first
+    pmn->nActiveState = CMasternode::MASTERNODE_PRE_ENABLED;
+    pmn->Check(true);
+    ScheduleCheck(*pmn, GetAdjustedTime());
+}
+
 void CMasternodeMan::CheckAndRemove(CConnman& connman)
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
@@ -169,7 +260,7 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
         // in CheckMnbAndUpdateMasternodeList()
         LOCK2(cs_main, cs);
 
-        Check();
+        CheckScheduled();
 
         // Remove spent masternodes, prepare structures and make requests to reasure the state of inactive ones
         rank_pair_vec_t vecMasternodeRanks;
@@ -189,6 +280,8 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 
                 // and finally remove it from the list
                 it->second.FlagGovernanceItemsAsDirty();
+                GetMainSignals().NotifyMasternodeListChanged(it->first, false);
+                collateralWatch.Unwatch(it->first, this);
                 mapMasternodes.erase(it++);
                 fMasternodesRemoved = true;
             } else {
@@ -344,7 +437,11 @@ void CMasternodeMan::CheckAndRemove(CConnman& connman)
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
+    // subscribers keep their own copy of the list, tell them every masternode is gone
+    for (std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin(); it != mapMasternodes.end(); ++it)
+        GetMainSignals().NotifyMasternodeListChanged(it->first, false);
     mapMasternodes.clear();
+    collateralWatch.UnwatchAll(this);
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -352,6 +449,8 @@ void CMasternodeMan::Clear()
     mapSeenMasternodePing.clear();
     nDsqCount = 0;
     nLastWatchdogVoteTime = 0;
+    wheelCheck.clear();
+    fCheckAll = true;
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -799,7 +898,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
         if(pmn && pmn->IsNewStartRequired()) return;
 
         int nDos = 0;
-        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) return;
+        if(mnp.CheckAndUpdate(pmn, false, nDos, connman)) {
+            // the ping moved the deadlines of this masternode
+            ScheduleCheck(*pmn, pmn->GetNextCheckTime(GetAdjustedTime()));
+            return;
+        }
 
         if(nDos > 0) {
             // if anything significant failed, mark that node
@@ -1033,6 +1136,7 @@ void CMasternodeMan::CheckSameAddr()
     BOOST_FOREACH(CMasternode* pmn, vBan) {
         LogPrintf("CMasternodeMan::CheckSameAddr -- increasing PoSe ban score for masternode %s\n", pmn->vin.prevout.ToStringShort());
         pmn->IncreasePoSeBanScore();
+        ScheduleCheck(*pmn, GetAdjustedTime());
     }
 }
 
@@ -1200,6 +1304,7 @@ void CMasternodeMan::ProcessVerifyReply(CNode* pnode, CMasternodeVerification& m
         // increase ban score for everyone else
         BOOST_FOREACH(CMasternode* pmn, vpMasternodesToBan) {
             pmn->IncreasePoSeBanScore();
+            ScheduleCheck(*pmn, GetAdjustedTime());
             LogPrint("masternode", "CMasternodeMan::ProcessVerifyReply -- increased PoSe ban score for %s addr %s, new score %d\n",
                         prealMasternode->vin.prevout.ToStringShort(), pnode->addr.ToString(), pmn->nPoSeBanScore);
         }
@@ -1303,6 +1408,7 @@ void CMasternodeMan::ProcessVerifyBroadcast(CNode* pnode, const CMasternodeVerif
         for (auto& mnpair : mapMasternodes) {
             if(mnpair.second.addr != mnv.addr || mnpair.first == mnv.vin1.prevout) continue;
             mnpair.second.IncreasePoSeBanScore();
+            ScheduleCheck(mnpair.second, GetAdjustedTime());
             nCount++;
             LogPrint("masternode", "CMasternodeMan::ProcessVerifyBroadcast -- increased PoSe ban score for %s addr %s, new score %d\n",
                         mnpair.first.ToStringShort(), mnpair.second.addr.ToString(), mnpair.second.nPoSeBanScore);
@@ -1342,6 +1448,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb, CConnman& co
     } else {
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
         if(pmn->UpdateFromNewBroadcast(mnb, connman)) {
+            ScheduleCheck(*pmn, GetAdjustedTime());
             masternodeSync.BumpAssetLastTime("CMasternodeMan::UpdateMasternodeList - seen");
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
@@ -1407,6 +1514,7 @@ bool CMasternodeMan::CheckMnbAndUpdateMasternodeList(CNode* pfrom, CMasternodeBr
                 LogPrint("masternode", "CMasternodeMan::CheckMnbAndUpdateMasternodeList -- Update() failed, masternode=%s\n", mnb.vin.prevout.ToStringShort());
                 return false;
             }
+            ScheduleCheck(*pmn, GetAdjustedTime());
             if(hash != mnbOld.GetHash()) {
                 mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
             }
@@ -1531,6 +1639,7 @@ void CMasternodeMan::SetMasternodeLastPing(const COutPoint& outpoint, const CMas
     if(mnp.fSentinelIsCurrent) {
         UpdateWatchdogVoteTime(mnp.vin.prevout, mnp.sigTime);
     }
+    ScheduleCheck(*pmn, GetAdjustedTime());
     mapSeenMasternodePing.insert(std::make_pair(mnp.GetHash(), mnp));
 
     CMasternodeBroadcast mnb(*pmn);
@@ -1545,6 +1654,16 @@ void CMasternodeMan::UpdatedBlockTip(const CBlockIndex *pindex)
     nCachedBlockHeight = pindex->nHeight;
     LogPrint("masternode", "CMasternodeMan::UpdatedBlockTip -- nCachedBlockHeight=%d\n", nCachedBlockHeight);
 
+    {
+        LOCK(cs);
+        // PoSe bans end at a height
+        for (auto& mnpair : mapMasternodes) {
+            if(mnpair.second.IsPoSeBanned() && mnpair.second.nPoSeBanHeight <= nCachedBlockHeight) {
+                ScheduleCheck(mnpair.second, GetAdjustedTime());
+            }
+        }
+    }
+
     CheckSameAddr();
 
     if(fMasterNode) {
@@ -5,8 +5,10 @@
 #ifndef MASTERNODEMAN_H
 #define MASTERNODEMAN_H
 
+#include "collateralwatch.h"
 #include "masternode.h"
 #include "sync.h"
+#include "timerwheel.h"
 
 using namespace std;
 
@@ -15,7 +17,7 @@ class CConnman;
 
 extern CMasternodeMan mnodeman;
 
-class CMasternodeMan
+class CMasternodeMan : public CCollateralWatcher
 {
 public:
     typedef std::pair<arith_uint256, CMasternode*> score_pair_t;
@@ -74,10 +76,22 @@ private:
 
     int64_t nLastWatchdogVoteTime;
 
+    /// Masternodes due for a Check(), see CheckScheduled()
+    CTimerWheel<COutPoint> wheelCheck;
+    /// Set when every masternode has to be checked, on startup or when a condition of all of them changed
+    bool fCheckAll;
+    /// The conditions of CMasternode::Check() shared by all masternodes, as of the last CheckScheduled()
+    bool fCheckedListSynced;
+    bool fCheckedWatchdogActive;
+    int nCheckedMinPaymentsProto;
+
     friend class CMasternodeSync;
     /// Find an entry
     CMasternode* Find(const COutPoint& outpoint);
 
+    /// Make sure the masternode is checked no later than nTime (adjusted time)
+    void ScheduleCheck(CMasternode& mn, int64_t nTime);
+
     bool GetMasternodeScores(const uint256& nBlockHash, score_pair_vec_t& vecMasternodeScoresRet, int nMinProtocol = 0);
 
 public:
@@ -119,6 +133,9 @@ public:
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        if(ser_action.ForRead()) {
+            fCheckAll = true;
+        }
     }
 
     CMasternodeMan();
@@ -136,6 +153,9 @@ public:
 
     /// Check all Masternodes
     void Check();
+    /// Check the Masternodes with events since their last check: new pings and broadcasts,
+    /// PoSe score changes and ping deadlines which passed
+    void CheckScheduled();
 
     /// Check all Masternodes and remove inactive
     void CheckAndRemove(CConnman& connman);
@@ -228,6 +248,9 @@ public:
     void SetMasternodeLastPing(const COutPoint& outpoint, const CMasternodePing& mnp);
 
     void UpdatedBlockTip(const CBlockIndex *pindex);
+    /// Mark the masternode as spent, its collateral is in collateralWatch from Add() on
+    void CollateralSpent(const COutPoint& outpoint, const CTransaction& tx, const CBlockIndex* pindex);
+    void CollateralUnspent(const COutPoint& outpoint, const CBlockIndex* pindex);
 
     /**
      * Called to notify CGovernanceManager that the masternode index has been updated.
@@ -2648,6 +2648,16 @@ ServiceFlags CConnman::GetLocalServices() const
     return nLocalServices;
 }
 
+void CConnman::RemoveLocalServices(ServiceFlags nServices)
+{
+    nLocalServices = ServiceFlags(nLocalServices & ~nServices);
+}
+
+void CConnman::AddLocalServices(ServiceFlags nServices)
+{
+    nLocalServices = ServiceFlags(nLocalServices | nServices);
+}
+
 void CConnman::SetBestHeight(int height)
 {
     nBestHeight.store(height, std::memory_order_release);
@@ -2835,7 +2845,18 @@ void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& s
     if(strm.empty())
         return;
 
-    unsigned int nSize = strm.size() - CMessageHeader::HEADER_SIZE;
+    PushMessage(pnode, &strm[0], strm.size(), sCommand);
+}
+
+void CConnman::PushSerializedMessage(CNode* pnode, const CSerializeData& vMessage, const std::string& sCommand)
+{
+    assert(vMessage.size() >= CMessageHeader::HEADER_SIZE);
+    PushMessage(pnode, &vMessage[0], vMessage.size(), sCommand);
+}
+
+void CConnman::PushMessage(CNode* pnode, const char* pch, size_t nMessageSize, const std::string& sCommand)
+{
+    unsigned int nSize = nMessageSize - CMessageHeader::HEADER_SIZE;
     LogPrint("net", "sending %s (%d bytes) peer=%d\n",  SanitizeString(sCommand.c_str()), nSize, pnode->id);
 
     size_t nBytesSent = 0;
@@ -2845,11 +2866,11 @@ void CConnman::PushMessage(CNode* pnode, CDataStream& strm, const std::string& s
             return;
         }
         bool optimisticSend(pnode->vSendMsg.empty());
-        pnode->vSendMsg.emplace_back(strm.begin(), strm.end());
+        pnode->vSendMsg.emplace_back(pch, pch + nMessageSize);
 
         //log total amount of bytes per command
-        pnode->mapSendBytesPerMsgCmd[sCommand] += strm.size();
-        pnode->nSendSize += strm.size();
+        pnode->mapSendBytesPerMsgCmd[sCommand] += nMessageSize;
+        pnode->nSendSize += nMessageSize;
 
         if (pnode->nSendSize > nSendBufferMaxSize)
             pnode->fPauseSend = true;
@@ -201,6 +201,9 @@ public:
         PushMessageWithVersionAndFlag(pnode, 0, 0, sCommand, std::forward<Args>(args)...);
     }
 
+    /** Send a message which was assembled with its header and checksum before, like a cached block */
+    void PushSerializedMessage(CNode* pnode, const CSerializeData& vMessage, const std::string& sCommand);
+
     template<typename Condition, typename Callable>
     bool ForEachNodeContinueIf(const Condition& cond, Callable&& func)
     {
@@ -357,6 +360,10 @@ public:
     void AddWhitelistedRange(const CSubNet &subnet);
 
     ServiceFlags GetLocalServices() const;
+    //! Stop offering services to new connections
+    void RemoveLocalServices(ServiceFlags nServices);
+    //! Offer services to new connections
+    void AddLocalServices(ServiceFlags nServices);
 
     //!set the max outbound target in bytes
     void SetMaxOutboundTarget(uint64_t limit);
@@ -431,6 +438,7 @@ private:
 
     CDataStream BeginMessage(CNode* node, int nVersion, int flags, const std::string& sCommand);
     void PushMessage(CNode* pnode, CDataStream& strm, const std::string& sCommand);
+    void PushMessage(CNode* pnode, const char* pch, size_t nMessageSize, const std::string& sCommand);
     void EndMessage(CDataStream& strm);
 
     // Network stats
@@ -477,7 +485,7 @@ private:
     std::atomic<NodeId> nLastNodeId;
 
     /** Services this instance offers */
-    ServiceFlags nLocalServices;
+    std::atomic<ServiceFlags> nLocalServices;
 
     /** Services this instance cares about */
     ServiceFlags nRelevantServices;
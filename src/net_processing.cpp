@@ -8,6 +8,7 @@
 #include "alert.h"
 #include "addrman.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
 #include "chainparams.h"
 #include "consensus/validation.h"
 #include "hash.h"
@@ -16,6 +17,7 @@
 #include "merkleblock.h"
 #include "net.h"
 #include "netbase.h"
+#include "orphanpool.h"
 #include "policy/fees.h"
 #include "policy/policy.h"
 #include "primitives/block.h"
@@ -50,14 +52,6 @@ using namespace std;
 
 int64_t nTimeBestReceived = 0; // Used only to inform the wallet of when we last received a block
 
-struct COrphanTx {
-    CTransaction tx;
-    NodeId fromPeer;
-};
-map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(cs_main);
-map<uint256, set<uint256> > mapOrphanTransactionsByPrev GUARDED_BY(cs_main);;
-void EraseOrphansFor(NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main);
-
 // Internal stuff
 namespace {
     /** Number of nodes with fSyncStarted. */
@@ -98,6 +92,7 @@ namespace {
         uint256 hash;
         CBlockIndex* pindex;     //!< Optional.
         bool fValidatedHeaders;  //!< Whether this block has validated headers at the time of request.
+        int64_t nTime;           //!< When the block was requested (in microseconds).
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
@@ -107,6 +102,12 @@ namespace {
 
     /** Number of peers from which we're downloading blocks. */
     int nPeersWithValidatedDownloads = 0;
+
+    /**
+     * Transactions from connected blocks which may be parents of orphans,
+     * resolved as one batch once the new tip is announced. Protected by cs_main.
+     */
+    std::vector<uint256> vOrphanParentsFromBlocks;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -160,6 +161,18 @@ struct CNodeState {
     int64_t nDownloadingSince;
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Requested blocks received from this peer, and when the last one arrived (in microseconds).
+    uint64_t nBlocksReceived;
+    int64_t nLastBlockReceived;
+    //! Moving averages of the time this peer takes to send a block once it can start sending it, of the
+    //! time from a request until the block arrives (both in microseconds), and of the block size.
+    int64_t nAvgBlockInterval;
+    int64_t nAvgBlockResponse;
+    int64_t nAvgBlockSize;
+    //! Blocks requested from this peer which were requested from another peer after it stalled.
+    int nBlocksStalled;
+    //! Number of blocks kept in flight from this peer during parallel download.
+    int nBlockWindow;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
     //! Whether this peer wants invs or headers (when possible) for block announcements.
@@ -179,6 +192,13 @@ struct CNodeState {
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksReceived = 0;
+        nLastBlockReceived = 0;
+        nAvgBlockInterval = 0;
+        nAvgBlockResponse = 0;
+        nAvgBlockSize = 0;
+        nBlocksStalled = 0;
+        nBlockWindow = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
         fPreferredDownload = false;
         fPreferHeaders = false;
     }
@@ -252,7 +272,7 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     BOOST_FOREACH(const QueuedBlock& entry, state->vBlocksInFlight) {
         mapBlocksInFlight.erase(entry.hash);
     }
-    EraseOrphansFor(nodeid);
+    orphanpool.RemoveForPeer(nodeid);
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
@@ -267,25 +287,57 @@ void FinalizeNode(NodeId nodeid, bool& fUpdateConnectionTime) {
     }
 }
 
+/** Fold a sample into a moving average over roughly the last 8 samples. */
+int64_t UpdateAverage(int64_t nAvg, int64_t nSample) {
+    return nAvg == 0 ? nSample : nAvg + (nSample - nAvg) / 8;
+}
+
+// Requires cs_main.
+// Time the arrival of a block requested from this peer. Its sending time only starts once the previous
+// block arrived, when the peer was still busy with that one.
+void UpdateBlockDownloadStats(CNodeState* state, const QueuedBlock& queuedBlock, size_t nSize, int64_t nNow) {
+    state->nAvgBlockInterval = UpdateAverage(state->nAvgBlockInterval, std::max<int64_t>(nNow - std::max(queuedBlock.nTime, state->nLastBlockReceived), 1));
+    state->nAvgBlockResponse = UpdateAverage(state->nAvgBlockResponse, std::max<int64_t>(nNow - queuedBlock.nTime, 1));
+    state->nAvgBlockSize = UpdateAverage(state->nAvgBlockSize, nSize);
+    state->nBlocksReceived++;
+    state->nLastBlockReceived = nNow;
+}
+
+// Requires cs_main.
+// Drop a block from the blocks in flight, without it being received.
+void RemoveBlockInFlight(map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight) {
+    CNodeState *state = State(itInFlight->second.first);
+    state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
+    if (state->nBlocksInFlightValidHeaders == 0 && itInFlight->second.second->fValidatedHeaders) {
+        // Last validated block on the queue was removed.
+        nPeersWithValidatedDownloads--;
+    }
+    state->vBlocksInFlight.erase(itInFlight->second.second);
+    state->nBlocksInFlight--;
+    mapBlocksInFlight.erase(itInFlight);
+}
+
 // Requires cs_main.
 // Returns a bool indicating whether we requested this block.
-bool MarkBlockAsReceived(const uint256& hash) {
+bool MarkBlockAsReceived(const uint256& hash, NodeId nodeFrom = -1, size_t nSize = 0) {
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
-        state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
-        if (state->nBlocksInFlightValidHeaders == 0 && itInFlight->second.second->fValidatedHeaders) {
-            // Last validated block on the queue was received.
-            nPeersWithValidatedDownloads--;
-        }
+        int64_t nNow = GetTimeMicros();
         if (state->vBlocksInFlight.begin() == itInFlight->second.second) {
             // First block on the queue was received, update the start download time for the next one
-            state->nDownloadingSince = std::max(state->nDownloadingSince, GetTimeMicros());
+            state->nDownloadingSince = std::max(state->nDownloadingSince, nNow);
+        }
+        if (itInFlight->second.first == nodeFrom) {
+            UpdateBlockDownloadStats(state, *itInFlight->second.second, nSize, nNow);
+        } else if (nodeFrom != -1) {
+            // A stalling peer which still sent the block after it was requested from another one
+            CNodeState *stateFrom = State(nodeFrom);
+            if (stateFrom)
+                stateFrom->nStallingSince = 0;
         }
-        state->vBlocksInFlight.erase(itInFlight->second.second);
-        state->nBlocksInFlight--;
         state->nStallingSince = 0;
-        mapBlocksInFlight.erase(itInFlight);
+        RemoveBlockInFlight(itInFlight);
         return true;
     }
     return false;
@@ -297,9 +349,11 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     assert(state != NULL);
 
     // Make sure it's not listed somewhere already.
-    MarkBlockAsReceived(hash);
+    map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight != mapBlocksInFlight.end())
+        RemoveBlockInFlight(itInFlight);
 
-    QueuedBlock newentry = {hash, pindex, pindex != NULL};
+    QueuedBlock newentry = {hash, pindex, pindex != NULL, GetTimeMicros()};
     list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
@@ -384,7 +438,8 @@ CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
  *  at most count entries. */
 void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller, const Consensus::Params& consensusParams) {
-    if (count == 0)
+    // Blocks can't be connected while a UTXO snapshot is being loaded
+    if (count == 0 || fUTXOSnapshotLoading)
         return;
 
     vBlocks.reserve(vBlocks.size() + count);
@@ -408,6 +463,10 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
     // If the peer reorganized, our previous pindexLastCommonBlock may not be an ancestor
     // of its current tip anymore. Go back enough to fix that.
     state->pindexLastCommonBlock = LastCommonAncestor(state->pindexLastCommonBlock, state->pindexBestKnownBlock);
+    // The blocks up to a loaded UTXO snapshot's are never connected, so aren't downloaded
+    if (pindexSnapshotBase && state->pindexLastCommonBlock->nHeight < pindexSnapshotBase->nHeight &&
+        state->pindexBestKnownBlock->GetAncestor(pindexSnapshotBase->nHeight) == pindexSnapshotBase)
+        state->pindexLastCommonBlock = pindexSnapshotBase;
     if (state->pindexLastCommonBlock == state->pindexBestKnownBlock)
         return;
 
@@ -465,8 +524,64 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
     }
 }
 
+/** Add not-in-flight blocks below a loaded UTXO snapshot's, which the background validation needs next and
+ *  the peer has, to vBlocks until it has at most count entries. Requires cs_main. */
+void FindSnapshotBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks) {
+    if (vBlocks.size() >= count || pindexSnapshotBase == NULL || fUTXOSnapshotLoading)
+        return;
+
+    CNodeState *state = State(nodeid);
+    assert(state != NULL);
+    if (state->pindexBestKnownBlock == NULL || state->pindexBestKnownBlock->GetAncestor(pindexSnapshotBase->nHeight) != pindexSnapshotBase)
+        return;
+
+    // Like the active chain, only a window beyond the last block connected is fetched
+    int nStart = pindexSnapshotValidated ? pindexSnapshotValidated->nHeight + 1 : 0;
+    int nEnd = std::min<int>(pindexSnapshotBase->nHeight, nStart + BLOCK_DOWNLOAD_WINDOW - 1);
+    std::vector<CBlockIndex*> vToFetch(nEnd - nStart + 1);
+    vToFetch.back() = pindexSnapshotBase->GetAncestor(nEnd);
+    for (size_t i = vToFetch.size() - 1; i > 0; i--)
+        vToFetch[i - 1] = vToFetch[i]->pprev;
+    BOOST_FOREACH(CBlockIndex* pindex, vToFetch) {
+        if (pindex->nStatus & BLOCK_HAVE_DATA || mapBlocksInFlight.count(pindex->GetBlockHash()))
+            continue;
+        vBlocks.push_back(pindex);
+        if (vBlocks.size() == count)
+            return;
+    }
+}
+
+/** Add the blocks in flight from the stalling peer nodeStaller which are overdue and which nodeid has to vBlocks,
+ *  until it has at most count entries. Requires cs_main. */
+void FindStalledBlocks(NodeId nodeid, NodeId nodeStaller, unsigned int count, std::vector<CBlockIndex*>& vBlocks, int64_t nNow) {
+    CNodeState *state = State(nodeid);
+    CNodeState *stateStaller = State(nodeStaller);
+    assert(state != NULL && stateStaller != NULL);
+    if (state->pindexBestKnownBlock == NULL)
+        return;
+
+    int64_t nOverdue = std::max(2 * stateStaller->nAvgBlockResponse, BLOCK_STALLED_REREQUEST_MIN);
+    BOOST_FOREACH(const QueuedBlock& queuedBlock, stateStaller->vBlocksInFlight) {
+        if (vBlocks.size() >= count || queuedBlock.nTime > nNow - nOverdue) {
+            // Blocks are queued in the order they were requested, the later ones aren't overdue either
+            return;
+        }
+        if (queuedBlock.pindex && state->pindexBestKnownBlock->GetAncestor(queuedBlock.pindex->nHeight) == queuedBlock.pindex)
+            vBlocks.push_back(queuedBlock.pindex);
+    }
+}
+
 } // anon namespace
 
+int GetBlockDownloadWindow(uint64_t nBlocksReceived, int64_t nAvgBlockInterval, int64_t nPingUsec) {
+    if (nBlocksReceived < (uint64_t)BLOCK_DOWNLOAD_MIN_SAMPLES)
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    if (nPingUsec == std::numeric_limits<int64_t>::max())
+        nPingUsec = 0;
+    int64_t nWindow = (nPingUsec + BLOCK_DOWNLOAD_BUFFER_TIME) / nAvgBlockInterval + 1;
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(nWindow, MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER));
+}
+
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     LOCK(cs_main);
     CNodeState *state = State(nodeid);
@@ -479,6 +594,11 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlockWindow = state->nBlockWindow;
+    stats.nBlocksReceived = state->nBlocksReceived;
+    stats.dBlockDownloadRate = state->nAvgBlockInterval ? state->nAvgBlockSize * 1e6 / state->nAvgBlockInterval : 0.0;
+    stats.dBlockResponseTime = state->nAvgBlockResponse / 1e6;
+    stats.nBlocksStalled = state->nBlocksStalled;
     return true;
 }
 
@@ -498,91 +618,6 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
 }
 
-//////////////////////////////////////////////////////////////////////////////
-//
-// mapOrphanTransactions
-//
-
-bool AddOrphanTx(const CTransaction& tx, NodeId peer) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    uint256 hash = tx.GetHash();
-    if (mapOrphanTransactions.count(hash))
-        return false;
-
-    // Ignore big transactions, to avoid a
-    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
-    // large transaction with a missing parent then we assume
-    // it will rebroadcast it later, after the parent transaction(s)
-    // have been mined or received.
-    // 10,000 orphans, each of which is at most 5,000 bytes big is
-    // at most 500 megabytes of orphans:
-    unsigned int sz = tx.GetSerializeSize(SER_NETWORK, CTransaction::CURRENT_VERSION);
-    if (sz > 5000)
-    {
-        LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
-        return false;
-    }
-
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
-    BOOST_FOREACH(const CTxIn& txin, tx.vin)
-        mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
-
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u)\n", hash.ToString(),
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
-    return true;
-}
-
-void static EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
-    if (it == mapOrphanTransactions.end())
-        return;
-    BOOST_FOREACH(const CTxIn& txin, it->second.tx.vin)
-    {
-        map<uint256, set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
-        if (itPrev == mapOrphanTransactionsByPrev.end())
-            continue;
-        itPrev->second.erase(hash);
-        if (itPrev->second.empty())
-            mapOrphanTransactionsByPrev.erase(itPrev);
-    }
-    mapOrphanTransactions.erase(it);
-}
-
-void EraseOrphansFor(NodeId peer)
-{
-    int nErased = 0;
-    map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end())
-    {
-        map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer)
-        {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
-            ++nErased;
-        }
-    }
-    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
-}
-
-
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
-{
-    unsigned int nEvicted = 0;
-    while (mapOrphanTransactions.size() > nMaxOrphans)
-    {
-        // Evict a random orphan:
-        uint256 randomhash = GetRandHash();
-        map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end())
-            it = mapOrphanTransactions.begin();
-        EraseOrphanTx(it->first);
-        ++nEvicted;
-    }
-    return nEvicted;
-}
-
 // Requires cs_main.
 void Misbehaving(NodeId pnode, int howmuch)
 {
@@ -603,6 +638,60 @@ void Misbehaving(NodeId pnode, int howmuch)
         LogPrintf("%s: %s (%d -> %d)\n", __func__, state->name, state->nMisbehavior-howmuch, state->nMisbehavior);
 }
 
+// Requires cs_main.
+// Retry all orphans which spend any of vParents, parents before children.
+void static ProcessOrphanTxs(const std::vector<uint256>& vParents, CConnman& connman)
+{
+    std::vector<uint256> vOrphans;
+    orphanpool.GetChildrenSorted(vParents, vOrphans);
+    if (vOrphans.empty())
+        return;
+
+    LogPrint("mempool", "ProcessOrphanTxs -- %u parents, retrying %u orphans\n", vParents.size(), vOrphans.size());
+
+    set<NodeId> setMisbehaving;
+    BOOST_FOREACH(const uint256& orphanHash, vOrphans)
+    {
+        CTransaction orphanTx;
+        NodeId fromPeer;
+        if (!orphanpool.GetTx(orphanHash, orphanTx, fromPeer))
+            continue;
+        if (setMisbehaving.count(fromPeer))
+            continue;
+
+        bool fMissingInputs2 = false;
+        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+        // anyone relaying LegitTxX banned)
+        CValidationState stateDummy;
+
+        if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2))
+        {
+            LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+            connman.RelayTransaction(orphanTx);
+            orphanpool.RemoveTx(orphanHash, ORPHAN_REMOVED_ACCEPTED);
+        }
+        else if (!fMissingInputs2)
+        {
+            int nDos = 0;
+            if (stateDummy.IsInvalid(nDos) && nDos > 0)
+            {
+                // Punish peer that gave us an invalid orphan tx
+                Misbehaving(fromPeer, nDos);
+                setMisbehaving.insert(fromPeer);
+                LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+            }
+            // Has inputs but not accepted to mempool
+            // Probably non-standard or insufficient fee/priority
+            LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+            orphanpool.RemoveTx(orphanHash, ORPHAN_REMOVED_INVALID);
+            assert(recentRejects);
+            recentRejects->insert(orphanHash);
+        }
+        mempool.check(pcoinsTip);
+    }
+}
+
 
 
 
@@ -648,6 +737,25 @@ void PeerLogicValidation::UpdatedBlockTip(const CBlockIndex *pindexNew, const CB
     }
 
     nTimeBestReceived = GetTime();
+
+    // Orphans whose parents just got mined may be acceptable now
+    LOCK(cs_main);
+    std::vector<uint256> vParents;
+    vParents.swap(vOrphanParentsFromBlocks);
+    if (!fInitialDownload)
+        ProcessOrphanTxs(vParents, *connman);
+}
+
+void PeerLogicValidation::SyncTransaction(const CTransaction& tx, const CBlock* pblock) {
+    if (pblock == NULL)
+        return;
+
+    LOCK(cs_main);
+    // Orphans which got mined or which double-spend a mined transaction are useless now
+    int nErased = orphanpool.RemoveForBlockTx(tx);
+    if (nErased > 0)
+        LogPrint("mempool", "Erased %d orphan tx included or conflicted by block\n", nErased);
+    vOrphanParentsFromBlocks.push_back(tx.GetHash());
 }
 
 void PeerLogicValidation::BlockChecked(const CBlock& block, const CValidationState& state) {
@@ -695,7 +803,7 @@ bool static AlreadyHave(const CInv& inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main)
 
             return recentRejects->contains(inv.hash) ||
                    mempool.exists(inv.hash) ||
-                   mapOrphanTransactions.count(inv.hash) ||
+                   orphanpool.HaveTx(inv.hash) ||
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 0)) || // Best effort: only try output 0 and 1
                    pcoinsTip->HaveCoinInCache(COutPoint(inv.hash, 1));
         }
@@ -840,12 +948,13 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Pruned nodes may have deleted the block, so check whether
                 // it's available before trying to send.
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second, consensusParams))
+                    // Send block from the recent blocks, or from disk
+                    std::shared_ptr<const CServedBlock> pblock = recentBlocks.GetOrRead((*mi).second, consensusParams);
+                    if (!pblock)
                         assert(!"cannot load block from disk");
+                    const CBlock& block = pblock->block;
                     if (inv.type == MSG_BLOCK)
-                        connman.PushMessage(pfrom, NetMsgType::BLOCK, block);
+                        connman.PushSerializedMessage(pfrom, pblock->GetMessage(), NetMsgType::BLOCK);
                     else // MSG_FILTERED_BLOCK)
                     {
                         LOCK(pfrom->cs_filter);
@@ -1476,12 +1585,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 LogPrint("net", "  getblocks stopping at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
                 break;
             }
-            // If pruning, don't inv blocks unless we have on disk and are likely to still have
+            // Don't inv blocks we don't have on disk, as the blocks up to a loaded UTXO snapshot's.
+            // If pruning, also don't inv blocks unless we are likely to still have them
             // for some reasonable time window (1 hour) that block relay might require.
             const int nPrunedBlocksLikelyToHave = MIN_BLOCKS_TO_KEEP - 3600 / chainparams.GetConsensus().nPowTargetSpacing;
-            if (fPruneMode && (!(pindex->nStatus & BLOCK_HAVE_DATA) || pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave))
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA) || (fPruneMode && pindex->nHeight <= chainActive.Tip()->nHeight - nPrunedBlocksLikelyToHave))
             {
-                LogPrint("net", " getblocks stopping, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
+                LogPrint("net", " getblocks stopping, missing, pruned or too old block at %d %s\n", pindex->nHeight, pindex->GetBlockHash().ToString());
                 break;
             }
             pfrom->PushInventory(CInv(MSG_BLOCK, pindex->GetBlockHash()));
@@ -1557,7 +1667,6 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         }
 
         vector<uint256> vWorkQueue;
-        vector<uint256> vEraseQueue;
         CTransaction tx;
         CTxLockRequest txLockRequest;
         CDarksendBroadcastTx dstx;
@@ -1649,69 +1758,19 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 tx.GetHash().ToString(),
                 mempool.size(), mempool.DynamicMemoryUsage() / 1000);
 
-            // Recursively process any orphan transactions that depended on this one
-            set<NodeId> setMisbehaving;
-            for (unsigned int i = 0; i < vWorkQueue.size(); i++)
-            {
-                map<uint256, set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
-                if (itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for (set<uint256>::iterator mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end();
-                     ++mi)
-                {
-                    const uint256& orphanHash = *mi;
-                    const CTransaction& orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if (setMisbehaving.count(fromPeer))
-                        continue;
-                    if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2))
-                    {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        connman.RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    else if (!fMissingInputs2)
-                    {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos) && nDos > 0)
-                        {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                        assert(recentRejects);
-                        recentRejects->insert(orphanHash);
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            BOOST_FOREACH(uint256 hash, vEraseQueue)
-                EraseOrphanTx(hash);
+            // Process any orphan transactions that depended on this one
+            ProcessOrphanTxs(vWorkQueue, connman);
         }
         else if (fMissingInputs)
         {
-            AddOrphanTx(tx, pfrom->GetId());
+            orphanpool.AddTx(tx, pfrom->GetId(), GetTime());
 
-            // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
+            // DoS prevention: do not allow the orphan pool to grow unbounded
+            orphanpool.ExpireOrphans(GetTime());
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            unsigned int nEvicted = orphanpool.LimitOrphans(nMaxOrphanTx);
             if (nEvicted > 0)
-                LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
+                LogPrint("mempool", "orphan pool overflow, removed %u tx\n", nEvicted);
         } else {
             assert(recentRejects);
             recentRejects->insert(tx.GetHash());
@@ -1883,6 +1942,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (strCommand == NetMsgType::BLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
     {
+        size_t nBlockSize = vRecv.size();
         CBlock block;
         vRecv >> block;
 
@@ -1901,7 +1961,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             LOCK(cs_main);
             // Also always process if we requested the block explicitly, as we may
             // need it even though it is not a candidate for a new best tip.
-            forceProcessing |= MarkBlockAsReceived(hash);
+            forceProcessing |= MarkBlockAsReceived(hash, pfrom->GetId(), nBlockSize);
             // mapBlockSource is only used for sending reject messages and DoS scores,
             // so the race between here and cs_main in ProcessNewBlock is fine.
             mapBlockSource.emplace(hash, pfrom->GetId());
@@ -2662,22 +2722,40 @@ bool SendMessages(CNode* pto, CConnman& connman, std::atomic<bool>& interruptMsg
         // Message: getdata (blocks)
         //
         vector<CInv> vGetData;
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        state.nBlockWindow = GetBlockDownloadWindow(state.nBlocksReceived, state.nAvgBlockInterval, pto->nMinPingUsecTime);
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlockWindow) {
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            FindNextBlocksToDownload(pto->GetId(), state.nBlockWindow - state.nBlocksInFlight, vToDownload, staller, consensusParams);
+            if (staller != -1) {
+                CNodeState *stateStaller = State(staller);
+                if (state.nBlocksInFlight == 0 && stateStaller->nStallingSince == 0) {
+                    stateStaller->nStallingSince = nNow;
+                    LogPrint("net", "Stall started peer=%d\n", staller);
+                }
+                // The download window can't move until the staller sends its blocks, ask this peer for the overdue ones
+                // as well. The staller is still disconnected unless it sends one of them within BLOCK_STALLING_TIMEOUT.
+                vector<CBlockIndex*> vStalled;
+                FindStalledBlocks(pto->GetId(), staller, state.nBlockWindow - state.nBlocksInFlight - vToDownload.size(), vStalled, nNow);
+                BOOST_FOREACH(CBlockIndex *pindex, vStalled) {
+                    map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(pindex->GetBlockHash());
+                    assert(itInFlight != mapBlocksInFlight.end());
+                    const QueuedBlock &queuedBlock = *itInFlight->second.second;
+                    // The time it's been waiting for is a lower bound of the time the staller takes for the block
+                    stateStaller->nAvgBlockInterval = UpdateAverage(stateStaller->nAvgBlockInterval, nNow - std::max(queuedBlock.nTime, stateStaller->nLastBlockReceived));
+                    stateStaller->nBlocksStalled++;
+                    LogPrint("net", "Block %s (%d) stalled at peer=%d\n", pindex->GetBlockHash().ToString(), pindex->nHeight, staller);
+                }
+                vToDownload.insert(vToDownload.end(), vStalled.begin(), vStalled.end());
+            }
+            // The room left is for the blocks the background validation of a UTXO snapshot needs
+            FindSnapshotBlocksToDownload(pto->GetId(), state.nBlockWindow - state.nBlocksInFlight, vToDownload);
             BOOST_FOREACH(CBlockIndex *pindex, vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
                 LogPrint("net", "Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash().ToString(),
                     pindex->nHeight, pto->id);
             }
-            if (state.nBlocksInFlight == 0 && staller != -1) {
-                if (State(staller)->nStallingSince == 0) {
-                    State(staller)->nStallingSince = nNow;
-                    LogPrint("net", "Stall started peer=%d\n", staller);
-                }
-            }
         }
 
         //
@@ -2718,7 +2796,6 @@ public:
     CNetProcessingCleanup() {}
     ~CNetProcessingCleanup() {
         // orphan transactions
-        mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
+        orphanpool.Clear();
     }
 } instance_of_cnetprocessingcleanup;
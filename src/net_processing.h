@@ -27,6 +27,7 @@ public:
     PeerLogicValidation(CConnman* connmanIn);
 
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
+    virtual void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     virtual void BlockChecked(const CBlock& block, const CValidationState& state);
 };
 
@@ -35,8 +36,18 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlockWindow;
+    uint64_t nBlocksReceived;
+    double dBlockDownloadRate;
+    double dBlockResponseTime;
+    int nBlocksStalled;
 };
 
+/**
+ * Number of blocks to keep in flight from a peer during parallel download: enough to keep it sending for its
+ * round trip (nPingUsec) plus BLOCK_DOWNLOAD_BUFFER_TIME, at the time it takes to send a block.
+ */
+int GetBlockDownloadWindow(uint64_t nBlocksReceived, int64_t nAvgBlockInterval, int64_t nPingUsec);
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
 /** Increase a node's misbehavior score. */
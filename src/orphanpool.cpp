@@ -0,0 +1,349 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "orphanpool.h"
+
+#include "core_memusage.h"
+#include "util.h"
+
+#include <boost/foreach.hpp>
+
+COrphanPool orphanpool;
+
+COrphanPool::COrphanPool() :
+    vExpiryWheel(ORPHAN_TX_EXPIRE_TIME / ORPHAN_TX_EXPIRE_INTERVAL + 1),
+    nWheelCursor(-1),
+    nSequence(0),
+    nTotalUsage(0),
+    nMaxPeerUsage(DEFAULT_MAX_ORPHAN_TX_PEER_SIZE * 1000),
+    nAdded(0),
+    nAccepted(0),
+    nInvalid(0),
+    nRemovedBlock(0),
+    nRemovedPeer(0),
+    nExpired(0),
+    nEvictedQuota(0),
+    nEvictedLimit(0)
+{
+}
+
+void COrphanPool::SetMaxPeerUsage(size_t nMaxPeerUsageIn)
+{
+    LOCK(cs);
+    nMaxPeerUsage = nMaxPeerUsageIn;
+}
+
+bool COrphanPool::AddTx(const CTransaction& tx, NodeId peer, int64_t nNow)
+{
+    LOCK(cs);
+
+    const uint256 hash = tx.GetHash();
+    if (mapOrphans.count(hash))
+        return false;
+
+    // Ignore big transactions, to avoid a
+    // send-big-orphans memory exhaustion attack. If a peer has a legitimate
+    // large transaction with a missing parent then we assume
+    // it will rebroadcast it later, after the parent transaction(s)
+    // have been mined or received.
+    unsigned int sz = tx.GetSerializeSize(SER_NETWORK, CTransaction::CURRENT_VERSION);
+    if (sz > MAX_ORPHAN_TX_SIZE) {
+        LogPrint("mempool", "COrphanPool::AddTx -- ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash.ToString());
+        return false;
+    }
+
+    COrphanTx& orphan = mapOrphans[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTimeExpire = nNow + ORPHAN_TX_EXPIRE_TIME;
+    orphan.nSequence = nSequence++;
+    orphan.nUsage = RecursiveDynamicUsage(tx);
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+        mapOrphansByPrev[txin.prevout].insert(hash);
+
+    CPeerOrphans& peerOrphans = mapPeerOrphans[peer];
+    peerOrphans.nUsage += orphan.nUsage;
+    peerOrphans.setOrphans.insert(std::make_pair(orphan.nSequence, hash));
+
+    vExpiryWheel[(orphan.nTimeExpire / ORPHAN_TX_EXPIRE_INTERVAL) % vExpiryWheel.size()].insert(hash);
+    nTotalUsage += orphan.nUsage;
+    nAdded++;
+
+    // Keep the peer within its quota, the oldest orphans of that peer go first
+    while (mapPeerOrphans.count(peer) && mapPeerOrphans[peer].nUsage > nMaxPeerUsage) {
+        EvictOldestForPeer(peer);
+        nEvictedQuota++;
+    }
+
+    LogPrint("mempool", "COrphanPool::AddTx -- stored orphan tx %s from peer=%d (mapsz %u prevsz %u usage %u)\n", hash.ToString(),
+             peer, mapOrphans.size(), mapOrphansByPrev.size(), nTotalUsage);
+
+    return mapOrphans.count(hash) != 0;
+}
+
+bool COrphanPool::HaveTx(const uint256& hash) const
+{
+    LOCK(cs);
+    return mapOrphans.count(hash) != 0;
+}
+
+bool COrphanPool::GetTx(const uint256& hash, CTransaction& txRet, NodeId& peerRet) const
+{
+    LOCK(cs);
+    std::map<uint256, COrphanTx>::const_iterator it = mapOrphans.find(hash);
+    if (it == mapOrphans.end())
+        return false;
+    txRet = it->second.tx;
+    peerRet = it->second.fromPeer;
+    return true;
+}
+
+void COrphanPool::RemoveTx(const uint256& hash, OrphanRemovalReason reason)
+{
+    LOCK(cs);
+    if (!mapOrphans.count(hash))
+        return;
+
+    EraseTxInternal(hash);
+
+    switch (reason) {
+        case ORPHAN_REMOVED_ACCEPTED:   nAccepted++;        break;
+        case ORPHAN_REMOVED_INVALID:    nInvalid++;         break;
+        case ORPHAN_REMOVED_BLOCK:      nRemovedBlock++;    break;
+        case ORPHAN_REMOVED_PEER:       nRemovedPeer++;     break;
+    }
+}
+
+void COrphanPool::EraseTxInternal(const uint256& hash)
+{
+    AssertLockHeld(cs);
+
+    std::map<uint256, COrphanTx>::iterator it = mapOrphans.find(hash);
+    if (it == mapOrphans.end())
+        return;
+
+    const COrphanTx& orphan = it->second;
+
+    BOOST_FOREACH(const CTxIn& txin, orphan.tx.vin) {
+        std::map<COutPoint, std::set<uint256> >::iterator itPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itPrev == mapOrphansByPrev.end())
+            continue;
+        itPrev->second.erase(hash);
+        if (itPrev->second.empty())
+            mapOrphansByPrev.erase(itPrev);
+    }
+
+    std::map<NodeId, CPeerOrphans>::iterator itPeer = mapPeerOrphans.find(orphan.fromPeer);
+    if (itPeer != mapPeerOrphans.end()) {
+        itPeer->second.nUsage -= orphan.nUsage;
+        itPeer->second.setOrphans.erase(std::make_pair(orphan.nSequence, hash));
+        if (itPeer->second.setOrphans.empty())
+            mapPeerOrphans.erase(itPeer);
+    }
+
+    vExpiryWheel[(orphan.nTimeExpire / ORPHAN_TX_EXPIRE_INTERVAL) % vExpiryWheel.size()].erase(hash);
+    nTotalUsage -= orphan.nUsage;
+
+    mapOrphans.erase(it);
+}
+
+void COrphanPool::EvictOldestForPeer(NodeId peer)
+{
+    AssertLockHeld(cs);
+
+    std::map<NodeId, CPeerOrphans>::iterator itPeer = mapPeerOrphans.find(peer);
+    if (itPeer == mapPeerOrphans.end() || itPeer->second.setOrphans.empty())
+        return;
+
+    uint256 hash = itPeer->second.setOrphans.begin()->second;
+    LogPrint("mempool", "COrphanPool::EvictOldestForPeer -- evicting orphan tx %s from peer=%d\n", hash.ToString(), peer);
+    EraseTxInternal(hash);
+}
+
+int COrphanPool::RemoveForPeer(NodeId peer)
+{
+    LOCK(cs);
+
+    std::map<NodeId, CPeerOrphans>::iterator itPeer = mapPeerOrphans.find(peer);
+    if (itPeer == mapPeerOrphans.end())
+        return 0;
+
+    // copy, EraseTxInternal drops the peer entry together with its last orphan
+    std::set<std::pair<uint64_t, uint256> > setOrphans = itPeer->second.setOrphans;
+    for (std::set<std::pair<uint64_t, uint256> >::const_iterator it = setOrphans.begin(); it != setOrphans.end(); ++it)
+        EraseTxInternal(it->second);
+
+    nRemovedPeer += setOrphans.size();
+    if (!setOrphans.empty())
+        LogPrint("mempool", "COrphanPool::RemoveForPeer -- erased %d orphan tx from peer=%d\n", setOrphans.size(), peer);
+    return setOrphans.size();
+}
+
+int COrphanPool::RemoveForBlockTx(const CTransaction& tx)
+{
+    LOCK(cs);
+
+    std::vector<uint256> vErase;
+    if (mapOrphans.count(tx.GetHash()))
+        vErase.push_back(tx.GetHash());
+
+    BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+        std::map<COutPoint, std::set<uint256> >::const_iterator itPrev = mapOrphansByPrev.find(txin.prevout);
+        if (itPrev == mapOrphansByPrev.end())
+            continue;
+        vErase.insert(vErase.end(), itPrev->second.begin(), itPrev->second.end());
+    }
+
+    int nErased = 0;
+    BOOST_FOREACH(const uint256& hash, vErase) {
+        if (!mapOrphans.count(hash))
+            continue;
+        EraseTxInternal(hash);
+        nErased++;
+    }
+    nRemovedBlock += nErased;
+    return nErased;
+}
+
+unsigned int COrphanPool::ExpireOrphans(int64_t nNow)
+{
+    LOCK(cs);
+
+    const int64_t nSlots = vExpiryWheel.size();
+    const int64_t nSlotNow = nNow / ORPHAN_TX_EXPIRE_INTERVAL;
+
+    // Every slot is visited at most once per call, even if we were not called for a long time
+    int64_t nSlotStart = nSlotNow - nSlots + 1;
+    if (nWheelCursor >= 0 && nWheelCursor > nSlotStart)
+        nSlotStart = nWheelCursor;
+
+    unsigned int nErased = 0;
+    for (int64_t nSlot = nSlotStart; nSlot <= nSlotNow; nSlot++) {
+        std::set<uint256>& setSlot = vExpiryWheel[nSlot % nSlots];
+        // the wheel wraps, so a slot can also hold orphans which are due later
+        std::vector<uint256> vDue;
+        BOOST_FOREACH(const uint256& hash, setSlot) {
+            if (mapOrphans[hash].nTimeExpire <= nNow)
+                vDue.push_back(hash);
+        }
+        BOOST_FOREACH(const uint256& hash, vDue)
+            EraseTxInternal(hash);
+        nErased += vDue.size();
+    }
+    // The current slot was only partially due, revisit it next time
+    nWheelCursor = nSlotNow;
+
+    nExpired += nErased;
+    if (nErased > 0)
+        LogPrint("mempool", "COrphanPool::ExpireOrphans -- erased %d expired orphan tx\n", nErased);
+    return nErased;
+}
+
+unsigned int COrphanPool::LimitOrphans(unsigned int nMaxOrphans)
+{
+    LOCK(cs);
+
+    unsigned int nEvicted = 0;
+    while (mapOrphans.size() > nMaxOrphans) {
+        // Evict the oldest orphan of the peer which uses the most memory
+        std::map<NodeId, CPeerOrphans>::const_iterator itHeaviest = mapPeerOrphans.begin();
+        for (std::map<NodeId, CPeerOrphans>::const_iterator it = mapPeerOrphans.begin(); it != mapPeerOrphans.end(); ++it) {
+            if (it->second.nUsage > itHeaviest->second.nUsage)
+                itHeaviest = it;
+        }
+        assert(itHeaviest != mapPeerOrphans.end());
+        EvictOldestForPeer(itHeaviest->first);
+        ++nEvicted;
+    }
+    nEvictedLimit += nEvicted;
+    return nEvicted;
+}
+
+void COrphanPool::GetChildrenSorted(const std::vector<uint256>& vParents, std::vector<uint256>& vRet) const
+{
+    LOCK(cs);
+
+    vRet.clear();
+
+    // Collect every orphan reachable from vParents through the outpoint index
+    std::set<uint256> setFound;
+    std::vector<uint256> vQueue(vParents);
+    for (size_t i = 0; i < vQueue.size(); i++) {
+        std::map<COutPoint, std::set<uint256> >::const_iterator itPrev = mapOrphansByPrev.lower_bound(COutPoint(vQueue[i], 0));
+        for (; itPrev != mapOrphansByPrev.end() && itPrev->first.hash == vQueue[i]; ++itPrev) {
+            BOOST_FOREACH(const uint256& hash, itPrev->second) {
+                if (setFound.insert(hash).second)
+                    vQueue.push_back(hash);
+            }
+        }
+    }
+
+    // Kahn's algorithm over the orphan-to-orphan edges, ties are broken by arrival order
+    std::map<uint256, int> mapMissingParents;
+    std::set<std::pair<uint64_t, uint256> > setReady;
+    BOOST_FOREACH(const uint256& hash, setFound) {
+        const COrphanTx& orphan = mapOrphans.find(hash)->second;
+        std::set<uint256> setOrphanParents;
+        BOOST_FOREACH(const CTxIn& txin, orphan.tx.vin) {
+            if (setFound.count(txin.prevout.hash))
+                setOrphanParents.insert(txin.prevout.hash);
+        }
+        mapMissingParents[hash] = setOrphanParents.size();
+        if (setOrphanParents.empty())
+            setReady.insert(std::make_pair(orphan.nSequence, hash));
+    }
+
+    vRet.reserve(setFound.size());
+    while (!setReady.empty()) {
+        const uint256 hash = setReady.begin()->second;
+        setReady.erase(setReady.begin());
+        vRet.push_back(hash);
+
+        std::set<uint256> setChildren;
+        std::map<COutPoint, std::set<uint256> >::const_iterator itPrev = mapOrphansByPrev.lower_bound(COutPoint(hash, 0));
+        for (; itPrev != mapOrphansByPrev.end() && itPrev->first.hash == hash; ++itPrev)
+            setChildren.insert(itPrev->second.begin(), itPrev->second.end());
+
+        BOOST_FOREACH(const uint256& hashChild, setChildren) {
+            if (--mapMissingParents[hashChild] == 0)
+                setReady.insert(std::make_pair(mapOrphans.find(hashChild)->second.nSequence, hashChild));
+        }
+    }
+    assert(vRet.size() == setFound.size());
+}
+
+size_t COrphanPool::Size() const
+{
+    LOCK(cs);
+    return mapOrphans.size();
+}
+
+void COrphanPool::GetStats(COrphanPoolStats& stats) const
+{
+    LOCK(cs);
+    stats.nOrphans = mapOrphans.size();
+    stats.nUsage = nTotalUsage;
+    stats.nPeers = mapPeerOrphans.size();
+    stats.nAdded = nAdded;
+    stats.nAccepted = nAccepted;
+    stats.nInvalid = nInvalid;
+    stats.nRemovedBlock = nRemovedBlock;
+    stats.nRemovedPeer = nRemovedPeer;
+    stats.nExpired = nExpired;
+    stats.nEvictedQuota = nEvictedQuota;
+    stats.nEvictedLimit = nEvictedLimit;
+}
+
+void COrphanPool::Clear()
+{
+    LOCK(cs);
+    mapOrphans.clear();
+    mapOrphansByPrev.clear();
+    mapPeerOrphans.clear();
+    BOOST_FOREACH(std::set<uint256>& setSlot, vExpiryWheel)
+        setSlot.clear();
+    nWheelCursor = -1;
+    nTotalUsage = 0;
+}
@@ -0,0 +1,144 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ORPHANPOOL_H
+#define ORPHANPOOL_H
+
+#include "net.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+class COrphanPool;
+extern COrphanPool orphanpool;
+
+/** Expire orphan transactions which did not get their parents after this many seconds */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Granularity of the orphan expiry time wheel, in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 60;
+/** Orphans bigger than this (serialized size) are never stored */
+static const unsigned int MAX_ORPHAN_TX_SIZE = 5000;
+/** Default for -maxorphantxpeersize, per-peer orphan memory quota in kilobytes */
+static const unsigned int DEFAULT_MAX_ORPHAN_TX_PEER_SIZE = 100;
+
+/** Why an orphan left the pool, used for statistics */
+enum OrphanRemovalReason {
+    ORPHAN_REMOVED_ACCEPTED,    //! All parents were found and it made it into the mempool
+    ORPHAN_REMOVED_INVALID,     //! Had all inputs but was rejected
+    ORPHAN_REMOVED_BLOCK,       //! Included in or conflicted with a connected block
+    ORPHAN_REMOVED_PEER,        //! Announcing peer disconnected
+};
+
+struct COrphanPoolStats
+{
+    size_t nOrphans;
+    size_t nUsage;
+    size_t nPeers;
+    uint64_t nAdded;
+    uint64_t nAccepted;
+    uint64_t nInvalid;
+    uint64_t nRemovedBlock;
+    uint64_t nRemovedPeer;
+    uint64_t nExpired;
+    uint64_t nEvictedQuota;
+    uint64_t nEvictedLimit;
+};
+
+/**
+ * Transactions received from peers whose inputs we can't find yet.
+ *
+ * Every peer has a memory quota; once it is exceeded the oldest orphans of that
+ * peer are evicted first, so a single peer can't flush out orphans announced by
+ * everyone else. The global count limit evicts from the heaviest peer. Orphans
+ * expire after ORPHAN_TX_EXPIRE_TIME through a time wheel with
+ * ORPHAN_TX_EXPIRE_INTERVAL sized slots, so expiry only touches entries that
+ * are actually due.
+ *
+ * Parents are indexed by outpoint which allows to find all orphans spending
+ * a batch of newly available transactions at once (GetChildrenSorted) and to
+ * drop orphans conflicting with a connected block (RemoveForBlockTx).
+ */
+class COrphanPool
+{
+private:
+    struct COrphanTx {
+        CTransaction tx;
+        NodeId fromPeer;
+        int64_t nTimeExpire;
+        uint64_t nSequence;
+        size_t nUsage;
+    };
+
+    struct CPeerOrphans {
+        size_t nUsage;
+        // ordered by arrival so that the oldest orphan is evicted first
+        std::set<std::pair<uint64_t, uint256> > setOrphans;
+
+        CPeerOrphans() : nUsage(0) {}
+    };
+
+    mutable CCriticalSection cs;
+
+    std::map<uint256, COrphanTx> mapOrphans;
+    std::map<COutPoint, std::set<uint256> > mapOrphansByPrev;
+    std::map<NodeId, CPeerOrphans> mapPeerOrphans;
+
+    // slot = (nTimeExpire / ORPHAN_TX_EXPIRE_INTERVAL) % vExpiryWheel.size()
+    std::vector<std::set<uint256> > vExpiryWheel;
+    // absolute index of the first slot which was not fully expired yet, -1 if never run
+    int64_t nWheelCursor;
+
+    uint64_t nSequence;
+    size_t nTotalUsage;
+    size_t nMaxPeerUsage;
+
+    uint64_t nAdded;
+    uint64_t nAccepted;
+    uint64_t nInvalid;
+    uint64_t nRemovedBlock;
+    uint64_t nRemovedPeer;
+    uint64_t nExpired;
+    uint64_t nEvictedQuota;
+    uint64_t nEvictedLimit;
+
+    void EraseTxInternal(const uint256& hash);
+    void EvictOldestForPeer(NodeId peer);
+
+public:
+    COrphanPool();
+
+    /** Set the per-peer memory quota in bytes */
+    void SetMaxPeerUsage(size_t nMaxPeerUsageIn);
+
+    /** Store an orphan, returns false if it is a duplicate, too big, or got evicted by its peer's quota */
+    bool AddTx(const CTransaction& tx, NodeId peer, int64_t nNow);
+    bool HaveTx(const uint256& hash) const;
+    bool GetTx(const uint256& hash, CTransaction& txRet, NodeId& peerRet) const;
+    void RemoveTx(const uint256& hash, OrphanRemovalReason reason);
+
+    /** Drop everything announced by a peer, returns the number of orphans removed */
+    int RemoveForPeer(NodeId peer);
+    /** Drop the orphan itself and any orphan spending the same outpoints as a tx from a connected block */
+    int RemoveForBlockTx(const CTransaction& tx);
+    /** Drop orphans whose expiry time has passed, returns the number of orphans expired */
+    unsigned int ExpireOrphans(int64_t nNow);
+    /** Evict orphans of the heaviest peers until at most nMaxOrphans remain */
+    unsigned int LimitOrphans(unsigned int nMaxOrphans);
+
+    /**
+     * Collect all orphans which (directly or through other orphans) spend any of
+     * vParents, ordered so that every orphan comes after the orphans it spends.
+     */
+    void GetChildrenSorted(const std::vector<uint256>& vParents, std::vector<uint256>& vRet) const;
+
+    size_t Size() const;
+    void GetStats(COrphanPoolStats& stats) const;
+    void Clear();
+};
+
+#endif
@@ -7,6 +7,7 @@
 #include "consensus/validation.h"
 #include "core_io.h"
 #include "init.h"
+#include "maintenance.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "script/sign.h"
@@ -1390,32 +1391,22 @@ void CPrivateSendClient::UpdatedBlockTip(const CBlockIndex *pindex)
 }
 
 //TODO: Rename/move to core
-void ThreadCheckPrivateSendClient(CConnman& connman)
+void SchedulePrivateSendClientMaintenance(CConnman& connman)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
     if(fMasterNode) return; // no client-side mixing on masternodes
 
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
-
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-ps-client");
-
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
-
-    while (true)
-    {
-        MilliSleep(1000);
-
-        if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
-            nTick++;
-            privateSendClient.CheckTimeout();
-            if(nDoAutoNextRun == nTick) {
-                privateSendClient.DoAutomaticDenominating(connman);
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
+    // check the timeouts every second and mix every few seconds in one job,
+    // so the session isn't reset while DoAutomaticDenominating is using it
+    std::shared_ptr<unsigned int> pnTick = std::make_shared<unsigned int>(0);
+    std::shared_ptr<unsigned int> pnDoAutoNextRun = std::make_shared<unsigned int>(PRIVATESEND_AUTO_TIMEOUT_MIN);
+    maintenanceScheduler.ScheduleEvery("psclient", [&connman, pnTick, pnDoAutoNextRun]() {
+        if(!masternodeSync.IsBlockchainSynced() || ShutdownRequested()) return;
+        ++*pnTick;
+        privateSendClient.CheckTimeout();
+        if(*pnDoAutoNextRun == *pnTick) {
+            privateSendClient.DoAutomaticDenominating(connman);
+            *pnDoAutoNextRun = *pnTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
         }
-    }
+    }, 1, 0, 1);
 }
@@ -145,6 +145,6 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckPrivateSendClient(CConnman& connman);
+void SchedulePrivateSendClientMaintenance(CConnman& connman);
 
 #endif
@@ -7,6 +7,7 @@
 #include "consensus/validation.h"
 #include "core_io.h"
 #include "init.h"
+#include "maintenance.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "script/interpreter.h"
@@ -870,27 +871,14 @@ void CPrivateSendServer::SetState(PoolState nStateNew)
 }
 
 //TODO: Rename/move to core
-void ThreadCheckPrivateSendServer(CConnman& connman)
+void SchedulePrivateSendServerMaintenance(CConnman& connman)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
 
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
-
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-ps-server");
-
-    unsigned int nTick = 0;
-
-    while (true)
-    {
-        MilliSleep(1000);
-
+    maintenanceScheduler.ScheduleEvery("psserver", [&connman]() {
         if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
-            nTick++;
             privateSendServer.CheckTimeout(connman);
             privateSendServer.CheckForCompleteQueue(connman);
         }
-    }
+    }, 1, 0, 1);
 }
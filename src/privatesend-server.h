@@ -75,6 +75,6 @@ public:
     void CheckForCompleteQueue(CConnman& connman);
 };
 
-void ThreadCheckPrivateSendServer(CConnman& connman);
+void SchedulePrivateSendServerMaintenance(CConnman& connman);
 
 #endif
@@ -8,6 +8,7 @@
 #include "governance.h"
 #include "init.h"
 #include "instantx.h"
+#include "maintenance.h"
 #include "masternode-payments.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
@@ -17,6 +18,8 @@
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <memory>
+
 #include <boost/lexical_cast.hpp>
 
 bool CDarkSendEntry::AddScriptSig(const CTxIn& txin)
@@ -436,51 +439,40 @@ void CPrivateSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 }
 
 //TODO: Rename/move to core
-void ThreadCheckPrivateSend(CConnman& connman)
+void SchedulePrivateSendMaintenance(CConnman& connman)
 {
     if(fLiteMode) return; // disable all Dash specific functionality
 
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
-
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("dash-ps");
-
-    unsigned int nTick = 0;
-
-    while (true)
-    {
-        MilliSleep(1000);
-
-        // try to sync from all available nodes, one step at a time
+    // try to sync from all available nodes, one step at a time
+    maintenanceScheduler.ScheduleEvery("mnsync", [&connman]() {
         masternodeSync.ProcessTick(connman);
-
-        if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
-
-            nTick++;
-
-            // make sure to check all masternodes first
-            mnodeman.Check();
-
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if(nTick % MASTERNODE_MIN_MNP_SECONDS == 15)
-                activeMasternode.ManageState(connman);
-
-            if(nTick % 60 == 0) {
-                mnodeman.ProcessMasternodeConnections(connman);
-                mnodeman.CheckAndRemove(connman);
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if(fMasterNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep(connman);
-            }
-
-            if(nTick % (60 * 5) == 0) {
-                governance.DoMaintenance(connman);
-            }
-        }
-    }
+    }, 1, 0, 1);
+
+    // the other jobs wait for the blockchain to be synced
+    auto ScheduleWhenSynced = [](const std::string& strName, CMaintenanceScheduler::Function func, int64_t nInterval, int64_t nDelay) {
+        maintenanceScheduler.ScheduleEvery(strName, [func]() {
+            if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) func();
+        }, nInterval, 0, nDelay);
+    };
+
+    // check the masternodes with new pings, bans or expired deadlines,
+    // make sure to check them before our own state, so both run in one job
+    std::shared_ptr<int64_t> pnTicksSynced = std::make_shared<int64_t>(0);
+    ScheduleWhenSynced("mncheck", [&connman, pnTicksSynced]() {
+        mnodeman.CheckScheduled();
+
+        // check if we should activate or ping every few minutes, counting the seconds synced only,
+        // slightly postpone first run to give net thread a chance to connect to some peers
+        if(++*pnTicksSynced % MASTERNODE_MIN_MNP_SECONDS == 15)
+            activeMasternode.ManageState(connman);
+    }, 1, 0);
+
+    // the jobs below start at random times within their interval, so they don't all take cs_main in the same second
+    ScheduleWhenSynced("mnconnections", [&connman]() { mnodeman.ProcessMasternodeConnections(connman); }, 60, -1);
+    ScheduleWhenSynced("mnlist", [&connman]() { mnodeman.CheckAndRemove(connman); }, 60, -1);
+    ScheduleWhenSynced("mnpayments", []() { mnpayments.CheckAndRemove(); }, 60, -1);
+    ScheduleWhenSynced("instantsend", []() { instantsend.CheckAndRemove(); }, 60, -1);
+    if(fMasterNode)
+        ScheduleWhenSynced("mnverify", [&connman]() { mnodeman.DoFullVerificationStep(connman); }, 60 * 5, -1);
+    ScheduleWhenSynced("governance", [&connman]() { governance.DoMaintenance(connman); }, 60 * 5, -1);
 }
@@ -356,6 +356,7 @@ public:
     static void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 };
 
-void ThreadCheckPrivateSend(CConnman& connman);
+/// Schedule the maintenance of the masternode list, payments, InstantSend and governance
+void SchedulePrivateSendMaintenance(CConnman& connman);
 
 #endif
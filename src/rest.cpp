@@ -3,20 +3,24 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "validation.h"
+#include "httprpc.h"
 #include "httpserver.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
 #include "txmempool.h"
+#include "util.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
@@ -24,6 +28,8 @@
 using namespace std;
 
 static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const int MAX_REST_BLOCKRANGE = 2000; //allow a max of 2000 blocks to be queried at once
+static const size_t REST_CHUNK_SIZE = 64 * 1024;
 
 enum RetFormat {
     RF_UNDEF,
@@ -121,6 +127,125 @@ static bool ParseHashStr(const string& strReq, uint256& v)
     return true;
 }
 
+enum ByteRange {
+    RANGE_WHOLE,
+    RANGE_PARTIAL,
+    RANGE_UNSATISFIABLE,
+};
+
+/**
+ * Parse the value of a Range header for a body of nSize bytes into the first
+ * and last byte to send. Only a single byte range is supported, other ranges
+ * are ignored as allowed by RFC 7233 and the whole body is sent.
+ */
+static enum ByteRange ParseByteRange(const std::string& strRange, uint64_t nSize, uint64_t& nFirst, uint64_t& nLast)
+{
+    nFirst = 0;
+    nLast = nSize - 1;
+    if (strRange.compare(0, 6, "bytes=") != 0)
+        return RANGE_WHOLE;
+    std::string strSpec = boost::trim_copy(strRange.substr(6));
+    std::string::size_type pos = strSpec.find('-');
+    if (pos == std::string::npos || strSpec.find(',') != std::string::npos)
+        return RANGE_WHOLE;
+
+    int64_t n, m;
+    if (pos == 0) {
+        // The last n bytes
+        if (!ParseInt64(strSpec.substr(1), &n) || n < 0)
+            return RANGE_WHOLE;
+        if (n == 0 || nSize == 0)
+            return RANGE_UNSATISFIABLE;
+        nFirst = (uint64_t)n < nSize ? nSize - n : 0;
+        return RANGE_PARTIAL;
+    }
+    if (!ParseInt64(strSpec.substr(0, pos), &n) || n < 0)
+        return RANGE_WHOLE;
+    if (pos + 1 < strSpec.size()) {
+        if (!ParseInt64(strSpec.substr(pos + 1), &m) || m < n)
+            return RANGE_WHOLE;
+        if ((uint64_t)m < nLast)
+            nLast = m;
+    }
+    if ((uint64_t)n >= nSize)
+        return RANGE_UNSATISFIABLE;
+    nFirst = n;
+    return RANGE_PARTIAL;
+}
+
+/**
+ * Sends the records of a batch request while they are produced. Once a chunk
+ * is full the reply continues with chunked transfer encoding, so memory use
+ * does not grow with the number of records. The reply ends early when the
+ * records exceed -restmaxbytes, at least one record is always sent.
+ */
+class RESTRecordWriter
+{
+private:
+    HTTPRequest* req;
+    enum RetFormat rf;
+    size_t nMaxBytes;
+    size_t nBytes;
+    std::string strBuffer;
+    bool fStarted;
+
+    std::string ContentType() const
+    {
+        return rf == RF_JSON ? "application/json" : rf == RF_HEX ? "text/plain" : "application/octet-stream";
+    }
+
+public:
+    RESTRecordWriter(HTTPRequest* reqIn, enum RetFormat rfIn) :
+        req(reqIn), rf(rfIn), nMaxBytes(GetArg("-restmaxbytes", DEFAULT_REST_MAX_BYTES)), nBytes(0), fStarted(false) {}
+
+    size_t GetMaxBytes() const { return nMaxBytes; }
+
+    //! Whether another record of nSize bytes fits the byte budget
+    bool Fits(size_t nSize) const { return nBytes == 0 || nBytes + nSize <= nMaxBytes; }
+
+    //! Append output, returns false if the client stopped receiving the reply
+    bool Write(const std::string& str)
+    {
+        nBytes += str.size();
+        strBuffer += str;
+        if (strBuffer.size() < REST_CHUNK_SIZE)
+            return true;
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", ContentType());
+            req->StartChunkedReply(HTTP_OK);
+            fStarted = true;
+        }
+        bool fSent = req->WriteReplyChunk(strBuffer);
+        strBuffer.clear();
+        return fSent;
+    }
+
+    //! Append a binary record in the format of the reply, returns false if the budget is exhausted or the client went away
+    bool WriteRecord(const unsigned char* pbegin, const unsigned char* pend)
+    {
+        size_t nSize = (pend - pbegin) * (rf == RF_HEX ? 2 : 1);
+        if (!Fits(nSize))
+            return false;
+        if (rf == RF_HEX)
+            return Write(HexStr(pbegin, pend));
+        return Write(std::string((const char*)pbegin, (const char*)pend));
+    }
+
+    void Finish()
+    {
+        if (rf != RF_BINARY)
+            strBuffer += "\n";
+        if (!fStarted) {
+            req->WriteHeader("Content-Type", ContentType());
+            req->WriteReply(HTTP_OK, strBuffer);
+            return;
+        }
+        if (!strBuffer.empty())
+            req->WriteReplyChunk(strBuffer);
+        req->EndChunkedReply();
+    }
+};
+
 static bool CheckWarmup(HTTPRequest* req)
 {
     std::string statusmessage;
@@ -203,6 +328,72 @@ static bool rest_headers(HTTPRequest* req,
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** Send a block in binary or hex format straight from the block file, without deserializing it */
+static bool rest_block_raw(HTTPRequest* req, const uint256& hash, const std::string& hashStr, enum RetFormat rf)
+{
+    FILE* file = NULL;
+    unsigned int nSize = 0;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+
+        CBlockIndex* pblockindex = mapBlockIndex[hash];
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
+
+        // Open the file under cs_main, pruning can't remove it from under an open file
+        file = OpenRawBlock(pblockindex, nSize);
+        if (!file)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+    }
+
+    // A block never changes, so its hash is a strong validator of the reply
+    const std::string strETag = "\"" + hash.GetHex() + "\"";
+    std::pair<bool, std::string> ifNoneMatch = req->GetHeader("If-None-Match");
+    if (ifNoneMatch.first && (ifNoneMatch.second.find(strETag) != std::string::npos || boost::trim_copy(ifNoneMatch.second) == "*")) {
+        fclose(file);
+        req->WriteHeader("ETag", strETag);
+        req->WriteReply(HTTP_NOT_MODIFIED);
+        return true;
+    }
+
+    if (rf == RF_HEX) {
+        std::vector<unsigned char> vData(nSize);
+        bool fRead = fread(begin_ptr(vData), 1, nSize, file) == nSize;
+        fclose(file);
+        if (!fRead)
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        req->WriteHeader("ETag", strETag);
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(vData.begin(), vData.end()) + "\n");
+        return true;
+    }
+
+    long nOffset = ftell(file);
+    if (nOffset < 0) {
+        fclose(file);
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, hashStr + " could not be read");
+    }
+
+    uint64_t nFirst, nLast;
+    std::pair<bool, std::string> range = req->GetHeader("Range");
+    enum ByteRange byteRange = ParseByteRange(range.first ? range.second : "", nSize, nFirst, nLast);
+    if (byteRange == RANGE_UNSATISFIABLE) {
+        fclose(file);
+        req->WriteHeader("Content-Range", strprintf("bytes */%u", nSize));
+        return RESTERR(req, HTTP_RANGE_NOT_SATISFIABLE, "Range not satisfiable for " + hashStr);
+    }
+
+    req->WriteHeader("ETag", strETag);
+    req->WriteHeader("Accept-Ranges", "bytes");
+    req->WriteHeader("Content-Type", "application/octet-stream");
+    if (byteRange == RANGE_PARTIAL)
+        req->WriteHeader("Content-Range", strprintf("bytes %u-%u/%u", nFirst, nLast, nSize));
+    req->WriteReplyFile(byteRange == RANGE_PARTIAL ? HTTP_PARTIAL_CONTENT : HTTP_OK, file, nOffset + nFirst, nLast - nFirst + 1);
+    return true;
+}
+
 static bool rest_block(HTTPRequest* req,
                        const std::string& strURIPart,
                        bool showTxDetails)
@@ -216,7 +407,10 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
+    if (rf == RF_BINARY || rf == RF_HEX)
+        return rest_block_raw(req, hash, hashStr, rf);
+
+    std::shared_ptr<const CServedBlock> pblock;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -227,30 +421,14 @@ static bool rest_block(HTTPRequest* req,
         if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
+        pblock = recentBlocks.GetOrRead(pblockindex, Params().GetConsensus());
+        if (!pblock)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
     switch (rf) {
-    case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
-        return true;
-    }
-
-    case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-        req->WriteHeader("Content-Type", "text/plain");
-        req->WriteReply(HTTP_OK, strHex);
-        return true;
-    }
-
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
+        UniValue objBlock = blockToJSON(pblock->block, pblockindex, showTxDetails);
         string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
         req->WriteReply(HTTP_OK, strJSON);
@@ -403,6 +581,211 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_blockrange(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (rf != RF_BINARY && rf != RF_HEX)
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+    int32_t nFrom, nTo;
+    if (path.size() != 2 || !ParseInt32(path[0], &nFrom) || !ParseInt32(path[1], &nTo))
+        return RESTERR(req, HTTP_BAD_REQUEST, "No height range specified. Use /rest/blockrange/<from>/<to>.<ext>.");
+    if (nFrom < 0 || nTo < nFrom || nTo - nFrom >= MAX_REST_BLOCKRANGE)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Height range out of range (max: %d blocks): %s", MAX_REST_BLOCKRANGE, param));
+
+    RESTRecordWriter writer(req, rf);
+    uint256 hashPrev;
+    for (int nHeight = nFrom; nHeight <= nTo; nHeight++) {
+        FILE* file = NULL;
+        unsigned int nSize = 0;
+        {
+            // Hold cs_main only to find and open the block, not while it is read and sent
+            LOCK(cs_main);
+            if (nHeight > chainActive.Height()) {
+                if (nHeight == nFrom)
+                    return RESTERR(req, HTTP_NOT_FOUND, strprintf("block at height %d not found", nHeight));
+                break;
+            }
+            CBlockIndex* pblockindex = chainActive[nHeight];
+            // Stop where the chain was reorganized since the previous block was sent
+            if (nHeight > nFrom && pblockindex->pprev->GetBlockHash() != hashPrev)
+                break;
+            hashPrev = pblockindex->GetBlockHash();
+            if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) || !(file = OpenRawBlock(pblockindex, nSize))) {
+                if (nHeight == nFrom)
+                    return RESTERR(req, HTTP_NOT_FOUND, strprintf("block at height %d not available", nHeight));
+                break;
+            }
+        }
+        std::vector<unsigned char> vData(nSize);
+        bool fRead = fread(begin_ptr(vData), 1, nSize, file) == nSize;
+        fclose(file);
+        if (!fRead || !writer.WriteRecord(begin_ptr(vData), begin_ptr(vData) + vData.size()))
+            break;
+    }
+    writer.Finish();
+    return true;
+}
+
+static bool rest_blockhash_by_height(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string heightStr;
+    const RetFormat rf = ParseDataFormat(heightStr, strURIPart);
+
+    int32_t nHeight;
+    if (!ParseInt32(heightStr, &nHeight) || nHeight < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + heightStr);
+
+    uint256 hash;
+    {
+        LOCK(cs_main);
+        if (nHeight > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        hash = chainActive[nHeight]->GetBlockHash();
+    }
+
+    CDataStream ssHash(SER_NETWORK, PROTOCOL_VERSION);
+    ssHash << hash;
+
+    switch (rf) {
+    case RF_BINARY: {
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, ssHash.str());
+        return true;
+    }
+
+    case RF_HEX: {
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, HexStr(ssHash.begin(), ssHash.end()) + "\n");
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue result(UniValue::VOBJ);
+        result.push_back(Pair("blockhash", hash.GetHex()));
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, result.write() + "\n");
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+/** Thrown out of a CJSONStreamWriter when the client stopped receiving the reply */
+class RESTClientGoneError : public std::runtime_error
+{
+public:
+    RESTClientGoneError() : std::runtime_error("client stopped receiving the reply") {}
+};
+
+static void WriteJSONChunk(RESTRecordWriter& writer, const std::string& strChunk)
+{
+    if (!writer.Write(strChunk))
+        throw RESTClientGoneError();
+}
+
+static bool rest_txs(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    if (!param.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Post the transaction ids to /rest/txs.<ext>.");
+
+    // input-format = output-format: a serialized vector of txids for bin and hex, an array of txids for json
+    std::string strRequest = req->ReadBody();
+    vector<uint256> vTxids;
+    switch (rf) {
+    case RF_HEX: {
+        std::vector<unsigned char> vRequest = ParseHex(strRequest);
+        strRequest.assign(vRequest.begin(), vRequest.end());
+    }
+
+    case RF_BINARY: {
+        try {
+            CDataStream ssRequest(strRequest.data(), strRequest.data() + strRequest.size(), SER_NETWORK, PROTOCOL_VERSION);
+            ssRequest >> vTxids;
+        } catch (const std::ios_base::failure& e) {
+            return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+        }
+        break;
+    }
+
+    case RF_JSON: {
+        UniValue request;
+        if (!request.read(strRequest) || !request.isArray())
+            return RESTERR(req, HTTP_BAD_REQUEST, "Parse error");
+        for (size_t i = 0; i < request.size(); i++) {
+            uint256 txid;
+            if (!request[i].isStr() || !ParseHashStr(request[i].get_str(), txid))
+                return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + request[i].write());
+            vTxids.push_back(txid);
+        }
+        break;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+    if (vTxids.empty())
+        return RESTERR(req, HTTP_BAD_REQUEST, "Error: empty request");
+
+    // One record per txid: a found flag followed by the transaction, or null in json.
+    // Every lookup takes cs_main on its own.
+    RESTRecordWriter writer(req, rf);
+    CJSONStreamWriter jsonWriter(boost::bind(&WriteJSONChunk, boost::ref(writer), _1));
+    try {
+        if (rf == RF_JSON)
+            jsonWriter.BeginArray();
+        BOOST_FOREACH(const uint256& txid, vTxids) {
+            CTransaction tx;
+            uint256 hashBlock;
+            bool fFound = GetTransaction(txid, tx, Params().GetConsensus(), hashBlock, false);
+            if (rf == RF_JSON) {
+                if (jsonWriter.GetSize() > 1 && jsonWriter.GetSize() >= writer.GetMaxBytes())
+                    break;
+                UniValue objTx(fFound ? UniValue::VOBJ : UniValue::VNULL);
+                if (fFound) {
+                    LOCK(cs_main);
+                    TxToJSON(tx, hashBlock, objTx);
+                }
+                jsonWriter.Value(objTx);
+                continue;
+            }
+            CDataStream ssRecord(SER_NETWORK, PROTOCOL_VERSION);
+            ssRecord << fFound;
+            if (fFound)
+                ssRecord << tx;
+            std::string strRecord = ssRecord.str();
+            if (!writer.WriteRecord((const unsigned char*)strRecord.data(), (const unsigned char*)strRecord.data() + strRecord.size()))
+                break;
+        }
+        if (rf == RF_JSON) {
+            jsonWriter.EndArray();
+            jsonWriter.Flush();
+        }
+    } catch (const RESTClientGoneError& e) {
+        // Finish the reply all the same
+    }
+    writer.Finish();
+    return true;
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -599,6 +982,9 @@ static const struct {
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/blockrange/", rest_blockrange},
+      {"/rest/blockhashbyheight/", rest_blockhash_by_height},
+      {"/rest/txs", rest_txs},
 };
 
 bool StartREST()
@@ -0,0 +1,138 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <assert.h>
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+/**
+ * Bounded lock-free queue for many producers and a single consumer.
+ *
+ * Each cell carries a sequence number telling whether it is free for the
+ * producer of a position or filled for the consumer: producers claim a
+ * position with a compare-and-swap and publish the cell by bumping its
+ * sequence number, so a producer never waits for another one. Pushing to a
+ * full buffer fails instead of blocking.
+ */
+template <typename T>
+class CMPSCRingBuffer
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> nSequence;
+        T value;
+    };
+
+    Cell* pCells;
+    const size_t nMask;
+    //! Next position to claim, shared by the producers
+    std::atomic<size_t> nPushPos;
+    //! Next position to take, only used by the consumer
+    std::atomic<size_t> nPopPos;
+
+    CMPSCRingBuffer(const CMPSCRingBuffer&);
+    CMPSCRingBuffer& operator=(const CMPSCRingBuffer&);
+
+public:
+    /** nCapacity must be a power of two */
+    explicit CMPSCRingBuffer(size_t nCapacity) : pCells(new Cell[nCapacity]), nMask(nCapacity - 1), nPushPos(0), nPopPos(0)
+    {
+        assert(nCapacity >= 2 && (nCapacity & nMask) == 0);
+        for (size_t i = 0; i < nCapacity; i++)
+            pCells[i].nSequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~CMPSCRingBuffer() { delete[] pCells; }
+
+    /** Add value at the end, from any thread. Returns false, leaving value alone, if the buffer is full. */
+    bool TryPush(T&& value)
+    {
+        size_t nPos = nPushPos.load(std::memory_order_relaxed);
+        Cell* pCell;
+        while (true) {
+            pCell = &pCells[nPos & nMask];
+            intptr_t nDiff = (intptr_t)pCell->nSequence.load(std::memory_order_acquire) - (intptr_t)nPos;
+            if (nDiff == 0) {
+                if (nPushPos.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (nDiff < 0) {
+                // the consumer hasn't taken the value a lap ago yet
+                return false;
+            } else {
+                nPos = nPushPos.load(std::memory_order_relaxed);
+            }
+        }
+        pCell->value = std::move(value);
+        pCell->nSequence.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Take the first value, from the consumer thread only. Returns false if there is none. */
+    bool TryPop(T& value)
+    {
+        size_t nPos = nPopPos.load(std::memory_order_relaxed);
+        Cell& cell = pCells[nPos & nMask];
+        if (cell.nSequence.load(std::memory_order_acquire) != nPos + 1)
+            return false;
+        value = std::move(cell.value);
+        cell.nSequence.store(nPos + nMask + 1, std::memory_order_release);
+        nPopPos.store(nPos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * The value nOffset places after the first one, from the consumer thread
+     * only, or NULL if there is none. It stays in the buffer, and is seen by
+     * ForEachPending(), until it is taken with Pop().
+     */
+    const T* Peek(size_t nOffset) const
+    {
+        size_t nPos = nPopPos.load(std::memory_order_relaxed) + nOffset;
+        const Cell& cell = pCells[nPos & nMask];
+        if (cell.nSequence.load(std::memory_order_acquire) != nPos + 1)
+            return NULL;
+        return &cell.value;
+    }
+
+    /** Take the first nCount values, which Peek() returned, from the consumer thread only */
+    void Pop(size_t nCount)
+    {
+        size_t nPos = nPopPos.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < nCount; i++, nPos++) {
+            Cell& cell = pCells[nPos & nMask];
+            assert(cell.nSequence.load(std::memory_order_relaxed) == nPos + 1);
+            // ForEachPending() skips the value before it is released
+            nPopPos.store(nPos + 1, std::memory_order_release);
+            T valueTaken(std::move(cell.value));
+            cell.nSequence.store(nPos + nMask + 1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * Call f on the values pushed and not taken yet, without taking them.
+     * Races with the consumer; only meant for crash handlers, with the
+     * consumer thread stopped or about to be killed.
+     */
+    template <typename F>
+    void ForEachPending(F f) const
+    {
+        size_t nEnd = nPushPos.load(std::memory_order_acquire);
+        for (size_t nPos = nPopPos.load(std::memory_order_acquire); nPos != nEnd; nPos++) {
+            const Cell& cell = pCells[nPos & nMask];
+            if (cell.nSequence.load(std::memory_order_acquire) != nPos + 1)
+                break;
+            f(cell.value);
+        }
+    }
+
+    size_t capacity() const { return nMask + 1; }
+};
+
+#endif // RINGBUFFER_H
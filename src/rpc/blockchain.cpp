@@ -5,12 +5,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockcache.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "governance.h"
 #include "validation.h"
+#include "orphanpool.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
@@ -20,12 +23,14 @@
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "hash.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/filesystem.hpp>
 #include <boost/thread/thread.hpp> // boost::thread::interrupt
 
 using namespace std;
@@ -132,6 +137,33 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result;
 }
 
+/**
+ * Write the result of blockToJSON(block, blockindex), with the transactions
+ * decoded one at a time if txDetails is set.
+ */
+void blockToJSONStream(const CBlock& block, const UniValue& result, bool txDetails, CJSONStreamWriter& writer)
+{
+    const std::vector<std::string>& vKeys = result.getKeys();
+    const std::vector<UniValue>& vValues = result.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < vKeys.size(); i++) {
+        if (vKeys[i] != "tx" || !txDetails) {
+            writer.KeyValue(vKeys[i], vValues[i]);
+            continue;
+        }
+        writer.Key("tx");
+        writer.BeginArray();
+        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(tx, uint256(), objTx);
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -145,8 +177,9 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    // Served without cs_main so that polling clients don't queue up behind block connection
+    CBlockIndex* pindexTip = chainActive.AtomicTip();
+    return pindexTip ? pindexTip->nHeight : -1;
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -162,8 +195,10 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    CBlockIndex* pindexTip = chainActive.AtomicTip();
+    if (!pindexTip)
+        throw JSONRPCError(RPC_MISC_ERROR, "No blocks loaded yet");
+    return pindexTip->GetBlockHash().GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -183,6 +218,38 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
     return GetDifficulty();
 }
 
+/** Describe a mempool entry, requires mempool.cs */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
+    info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
+    info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends)
+    {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
@@ -192,33 +259,7 @@ UniValue mempoolToJSON(bool fVerbose = false)
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
         {
             const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            info.push_back(Pair("descendantcount", e.GetCountWithDescendants()));
-            info.push_back(Pair("descendantsize", e.GetSizeWithDescendants()));
-            info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants()));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends)
-            {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
+            o.push_back(Pair(hash.ToString(), mempoolEntryToJSON(e)));
         }
         return o;
     }
@@ -278,6 +319,32 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() != 1 || !params[0].get_bool()) {
+        writer.Value(getrawmempool(params, false));
+        return;
+    }
+
+    // Describe one entry at a time, without holding mempool.cs while the result is sent
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+    writer.BeginObject();
+    BOOST_FOREACH(const uint256& hash, vtxid)
+    {
+        UniValue info;
+        {
+            LOCK(mempool.cs);
+            CTxMemPool::txiter it = mempool.mapTx.find(hash);
+            if (it == mempool.mapTx.end())
+                continue;
+            info = mempoolEntryToJSON(*it);
+        }
+        writer.KeyValue(hash.ToString(), info);
+    }
+    writer.EndObject();
+}
+
 UniValue getblockhashes(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 2)
@@ -484,17 +551,48 @@ UniValue getblockheaders(const UniValue& params, bool fHelp)
     return arrHeaders;
 }
 
+/** Verbosity of getblock: 0 for hex data, 1 for an object with txids, 2 for an object with decoded transactions */
+static int GetBlockVerbosity(const UniValue& params)
+{
+    if (params.size() < 2)
+        return 1;
+    if (params[1].isNum())
+        return params[1].get_int();
+    return params[1].get_bool() ? 1 : 0;
+}
+
+/** Look up the block with the given hash, from the recent blocks or from disk, requires cs_main */
+static CBlockIndex* ReadBlockForRPC(const std::string& strHash, std::shared_ptr<const CServedBlock>& pblock)
+{
+    uint256 hash(uint256S(strHash));
+
+    if (mapBlockIndex.count(hash) == 0)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+    CBlockIndex* pblockindex = mapBlockIndex[hash];
+
+    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+
+    pblock = recentBlocks.GetOrRead(pblockindex, Params().GetConsensus());
+    if (!pblock)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    return pblockindex;
+}
+
 UniValue getblock(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
-            "getblock \"hash\" ( verbose )\n"
-            "\nIf verbose is false, returns a string that is serialized, hex-encoded data for block 'hash'.\n"
-            "If verbose is true, returns an Object with information about block <hash>.\n"
+            "getblock \"hash\" ( verbosity )\n"
+            "\nIf verbosity is 0 or false, returns a string that is serialized, hex-encoded data for block 'hash'.\n"
+            "If verbosity is 1 or true, returns an Object with information about block <hash>.\n"
+            "If verbosity is 2, returns an Object with information about block <hash> and information about each transaction.\n"
             "\nArguments:\n"
             "1. \"hash\"          (string, required) The block hash\n"
-            "2. verbose           (boolean, optional, default=true) true for a json object, false for the hex encoded data\n"
-            "\nResult (for verbose = true):\n"
+            "2. verbosity         (numeric or boolean, optional, default=1) 0 for hex encoded data, 1 for a json object, and 2 for a json object with transaction data\n"
+            "\nResult (for verbosity = 1):\n"
             "{\n"
             "  \"hash\" : \"hash\",     (string) the block hash (same as provided)\n"
             "  \"confirmations\" : n,   (numeric) The number of confirmations, or -1 if the block is not on the main chain\n"
@@ -515,7 +613,15 @@ UniValue getblock(const UniValue& params, bool fHelp)
             "  \"previousblockhash\" : \"hash\",  (string) The hash of the previous block\n"
             "  \"nextblockhash\" : \"hash\"       (string) The hash of the next block\n"
             "}\n"
-            "\nResult (for verbose=false):\n"
+            "\nResult (for verbosity = 2):\n"
+            "{\n"
+            "  ...,                     Same output as verbosity = 1\n"
+            "  \"tx\" : [               (array of Objects) The transactions in the format of the getrawtransaction RPC\n"
+            "         ,...\n"
+            "  ],\n"
+            "  ,...                     Same output as verbosity = 1\n"
+            "}\n"
+            "\nResult (for verbosity = 0):\n"
             "\"data\"             (string) A string that is serialized, hex-encoded data for block 'hash'.\n"
             "\nExamples:\n"
             + HelpExampleCli("getblock", "\"00000000000fd08c2fb661d2fcb0d49abb3a91e5f27082ce64feed3b4dede2e2\"")
@@ -524,34 +630,69 @@ UniValue getblock(const UniValue& params, bool fHelp)
 
     LOCK(cs_main);
 
-    std::string strHash = params[0].get_str();
-    uint256 hash(uint256S(strHash));
+    int nVerbosity = GetBlockVerbosity(params);
 
-    bool fVerbose = true;
-    if (params.size() > 1)
-        fVerbose = params[1].get_bool();
+    std::shared_ptr<const CServedBlock> pblock;
+    CBlockIndex* pblockindex = ReadBlockForRPC(params[0].get_str(), pblock);
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    if (nVerbosity <= 0)
+    {
+        const char* pch = pblock->GetSerialized();
+        std::string strHex = HexStr(pch, pch + pblock->GetSerializedSize());
+        return strHex;
+    }
 
-    CBlock block;
-    CBlockIndex* pblockindex = mapBlockIndex[hash];
+    return blockToJSON(pblock->block, pblockindex, nVerbosity >= 2);
+}
 
-    if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+void getblock_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() < 1 || params.size() > 2 || GetBlockVerbosity(params) <= 0) {
+        writer.Value(getblock(params, false));
+        return;
+    }
+    bool fTxDetails = GetBlockVerbosity(params) >= 2;
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    std::shared_ptr<const CServedBlock> pblock;
+    UniValue result;
+    {
+        LOCK(cs_main);
+        CBlockIndex* pblockindex = ReadBlockForRPC(params[0].get_str(), pblock);
+        result = blockToJSON(pblock->block, pblockindex);
+    }
 
-    if (!fVerbose)
+    // Decode the transactions while the result is sent, without holding cs_main
+    blockToJSONStream(pblock->block, result, fTxDetails, writer);
+}
+
+/** Params: uint256 hash. Result: the serialized block, copied from the block file */
+void getblock_bin(CDataStream& params, CDataStream& result)
+{
+    uint256 hash;
+    params >> hash;
+
+    FILE* file = NULL;
+    unsigned int nSize = 0;
     {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
+        LOCK(cs_main);
+        BlockMap::iterator it = mapBlockIndex.find(hash);
+        if (it == mapBlockIndex.end())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        CBlockIndex* pblockindex = it->second;
+        if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
+        file = OpenRawBlock(pblockindex, nSize);
     }
+    if (!file)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
-    return blockToJSON(block, pblockindex);
+    // Read into the result directly, a block can be large
+    size_t nPos = result.size();
+    result.resize(nPos + nSize);
+    bool fRead = nSize == 0 || fread(&result[nPos], 1, nSize, file) == nSize;
+    fclose(file);
+    if (!fRead)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 }
 
 struct CCoinsStats
@@ -583,11 +724,9 @@ static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash,
     ss << VARINT(0);
 }
 
-//! Calculate statistics about the unspent transaction output set
-static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
+//! Calculate statistics about the unspent transaction output set pcursor walks
+static bool GetUTXOStats(CCoinsView *view, CCoinsViewCursor *pcursor, CCoinsStats &stats)
 {
-    boost::scoped_ptr<CCoinsViewCursor> pcursor(view->Cursor());
-
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = pcursor->GetBestBlock();
     {
@@ -623,42 +762,459 @@ static bool GetUTXOStats(CCoinsView *view, CCoinsStats &stats)
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( full )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "Note this call may take some time, unless full is false.\n"
+            "\nArguments:\n"
+            "1. full          (boolean, optional, default=true) Walk the whole set to count transactions and\n"
+            "                 compute hash_serialized_2. With false, only the fields which are kept up to date\n"
+            "                 as blocks are connected are returned, which is quick.\n"
             "\nResult:\n"
             "{\n"
             "  \"height\":n,     (numeric) The current block height (index)\n"
             "  \"bestblock\": \"hex\",   (string) the best block hash hex\n"
-            "  \"transactions\": n,      (numeric) The number of transactions\n"
+            "  \"transactions\": n,      (numeric) The number of transactions, unless full=false\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized_2\": \"hash\",   (string) The serialized hash, unless full=false\n"
+            "  \"muhash\": \"hash\",      (string) The commitment to the set, as used by loadtxoutset\n"
             "  \"disk_size\": n,         (numeric) The estimated size of the chainstate on disk\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("gettxoutsetinfo", "")
+            + HelpExampleCli("gettxoutsetinfo", "false")
             + HelpExampleRpc("gettxoutsetinfo", "")
         );
 
+    bool fFull = true;
+    if (params.size() > 0)
+        fFull = params[0].get_bool();
+
     UniValue ret(UniValue::VOBJ);
 
-    CCoinsStats stats;
-    FlushStateToDisk();
-    if (GetUTXOStats(pcoinsdbview, stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("disk_size", stats.nDiskSize));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    CCoinsCommitment commitment;
+    if (!pcoinsdbview->GetCommitment(commitment) && !pcoinsdbview->ComputeCommitment())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+
+    if (fFull) {
+        boost::scoped_ptr<CCoinsViewCursor> pcursor;
+        {
+            LOCK(cs_main);
+            FlushStateToDisk();
+            // Nothing is written to the database without cs_main, so these are of the same coins
+            pcursor.reset(pcoinsdbview->Cursor());
+            if (!pcoinsdbview->GetCommitment(commitment))
+                throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+        }
+        CCoinsStats stats;
+        if (GetUTXOStats(pcoinsdbview, pcursor.get(), stats)) {
+            ret.push_back(Pair("height", (int64_t)stats.nHeight));
+            ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+            ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
+            ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+            ret.push_back(Pair("hash_serialized_2", stats.hashSerialized.GetHex()));
+            ret.push_back(Pair("muhash", commitment.GetHash().GetHex()));
+            ret.push_back(Pair("disk_size", stats.nDiskSize));
+            ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        }
+        return ret;
     }
+
+    LOCK(cs_main);
+    // The database can't be written without cs_main, so this is the tip's set
+    if (!pcoinsdbview->GetCommitment(commitment))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+    commitment += pcoinsTip->GetCommitmentDelta();
+    uint256 hashBlock = pcoinsTip->GetBestBlock();
+    ret.push_back(Pair("height", (int64_t)mapBlockIndex.find(hashBlock)->second->nHeight));
+    ret.push_back(Pair("bestblock", hashBlock.GetHex()));
+    ret.push_back(Pair("txouts", commitment.nTransactionOutputs));
+    ret.push_back(Pair("muhash", commitment.GetHash().GetHex()));
+    ret.push_back(Pair("disk_size", (uint64_t)pcoinsdbview->EstimateSize()));
+    ret.push_back(Pair("total_amount", ValueFromAmount(commitment.nTotalAmount)));
     return ret;
 }
 
+/**
+ * The collaterals of the governance objects, which are burnt and so not in the coins,
+ * that are in the blocks up to pindexBase, with the proofs of their blocks
+ */
+static std::vector<CSnapshotTx> GetGovernanceSnapshotTxs(const CBlockIndex* pindexBase)
+{
+    std::set<uint256> setCollateralHashes;
+    {
+        LOCK2(cs_main, governance.cs);
+        std::vector<CGovernanceObject*> objs = governance.GetAllNewerThan(0);
+        BOOST_FOREACH(CGovernanceObject* pGovObj, objs) {
+            if (!pGovObj->GetCollateralHash().IsNull())
+                setCollateralHashes.insert(pGovObj->GetCollateralHash());
+        }
+    }
+
+    std::vector<CSnapshotTx> vTx;
+    BOOST_FOREACH(const uint256& hash, setCollateralHashes) {
+        boost::this_thread::interruption_point();
+        CTransaction tx;
+        uint256 hashBlock;
+        if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true) || hashBlock.IsNull())
+            continue;
+        CSnapshotTx snapshotTx;
+        {
+            LOCK(cs_main);
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (mi == mapBlockIndex.end() || pindexBase->GetAncestor(mi->second->nHeight) != mi->second)
+                continue;
+            CBlock block;
+            if (mi->second->nStatus & BLOCK_HAVE_DATA) {
+                if (!ReadBlockFromDisk(block, mi->second, Params().GetConsensus()))
+                    throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+                snapshotTx = CSnapshotTx(block, tx);
+            } else if (!pblocktree->ReadSnapshotTx(hash, snapshotTx)) {
+                // below a snapshot this node loaded, which didn't have it
+                continue;
+            }
+        }
+        vTx.push_back(snapshotTx);
+    }
+    return vTx;
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite the unspent transaction output set at the tip to a file, which loadtxoutset can load.\n"
+            "To write the set at an earlier block, invalidateblock the block after it first, and\n"
+            "reconsiderblock it afterwards. The collaterals of the governance objects the node knows,\n"
+            "which aren't in the set, are written with the proofs of their blocks, so that a node\n"
+            "loading the set can check those objects.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) The file to write, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,      (numeric) The number of coins written\n"
+            "  \"txs_written\": n,        (numeric) The number of governance collaterals written\n"
+            "  \"base_hash\": \"hash\",     (string) The block the set is at\n"
+            "  \"base_height\": n,        (numeric) The height of the block\n"
+            "  \"muhash\": \"hash\",        (string) The commitment to the set, as in gettxoutsetinfo\n"
+            "  \"path\": \"path\"           (string) The absolute path of the file\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+    // Only a complete file is ever at path
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+
+    CCoinsCommitment commitment;
+    if (!pcoinsdbview->GetCommitment(commitment) && !pcoinsdbview->ComputeCommitment())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+
+    boost::scoped_ptr<CCoinsViewCursor> pcursor;
+    CBlockIndex* pindexBase;
+    {
+        LOCK(cs_main);
+        if (fUTXOSnapshotLoading)
+            throw JSONRPCError(RPC_MISC_ERROR, "A UTXO snapshot is being loaded");
+        FlushStateToDisk();
+        // Nothing is written to the database without cs_main, so these are of the same coins
+        pcursor.reset(pcoinsdbview->Cursor());
+        if (!pcoinsdbview->GetCommitment(commitment))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+        pindexBase = mapBlockIndex.find(pcursor->GetBestBlock())->second;
+    }
+    std::vector<CSnapshotTx> vTx = GetGovernanceSnapshotTxs(pindexBase);
+
+    CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to open " + pathTmp.string());
+    std::string strError;
+    bool fOk = WriteUTXOSnapshot(file, pcursor.get(), commitment, vTx, strError);
+    file.fclose();
+    if (fOk && !RenameOver(pathTmp, path)) {
+        fOk = false;
+        strError = "Unable to rename " + pathTmp.string();
+    }
+    if (!fOk) {
+        boost::filesystem::remove(pathTmp);
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", commitment.nTransactionOutputs));
+    ret.push_back(Pair("txs_written", (uint64_t)vTx.size()));
+    ret.push_back(Pair("base_hash", pcursor->GetBestBlock().GetHex()));
+    ret.push_back(Pair("base_height", pindexBase->nHeight));
+    ret.push_back(Pair("muhash", commitment.GetHash().GetHex()));
+    ret.push_back(Pair("path", path.string()));
+    return ret;
+}
+
+UniValue loadtxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "loadtxoutset \"path\"\n"
+            "\nLoad a UTXO set written by dumptxoutset, and continue the chain from its block. The set\n"
+            "must be one this version assumes valid, the node must be at the genesis block, and its\n"
+            "headers must include the set's block. The blocks up to it are downloaded and validated in\n"
+            "the background afterwards, the set is forgotten once they lead to the same coins (see\n"
+            "getblockchaininfo), and the node is stopped if they don't. Until then the node doesn't offer\n"
+            "to serve blocks to new peers (NODE_NETWORK), and -txindex only covers the blocks validated so\n"
+            "far, so governance objects with collaterals in the other blocks below the set's block are\n"
+            "rejected unless the file has them. Masternodes are checked by their collateral coins and\n"
+            "don't need the blocks. Starting with -reindex-chainstate returns to validating the whole chain.\n"
+            "Loading a large set takes a while, its progress is logged. The node stays responsive meanwhile,\n"
+            "but doesn't download or connect blocks, or accept transactions, until the set is loaded.\n"
+            "\nArguments:\n"
+            "1. \"path\"           (string, required) The file to load, relative to the data directory if not absolute\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"base_hash\": \"hash\",     (string) The block the set is at\n"
+            "  \"base_height\": n,        (numeric) The height of the block\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("loadtxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("loadtxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    std::string strError;
+    if (!ActivateUTXOSnapshot(path, strError))
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+
+    LOCK(cs_main);
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("base_hash", pindexSnapshotBase->GetBlockHash().GetHex()));
+    ret.push_back(Pair("base_height", pindexSnapshotBase->nHeight));
+    return ret;
+}
+
+static UniValue FlushLatencyToJSON(const CCoinsFlushLatency& latency)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("p50", 0.001 * latency.nP50));
+    ret.push_back(Pair("p90", 0.001 * latency.nP90));
+    ret.push_back(Pair("p99", 0.001 * latency.nP99));
+    ret.push_back(Pair("max", 0.001 * latency.nMax));
+    return ret;
+}
+
+UniValue getcoinscacheinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getcoinscacheinfo\n"
+            "\nReturns details on the in-memory coins cache and how it is flushed to disk.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"entries\": n,             (numeric) Number of coins in the cache\n"
+            "  \"usage\": n,               (numeric) Memory used by the cache in bytes\n"
+            "  \"limit\": n,               (numeric) Cache size (-dbcache) above which it is flushed, in bytes\n"
+            "  \"backgroundflush\": true|false, (boolean) Whether flushes are written by a background thread\n"
+            "  \"flushing\": true|false,    (boolean) Whether a background flush is in progress\n"
+            "  \"flushingentries\": n,     (numeric) Number of cache entries being written by the background flush\n"
+            "  \"flushes\": n,             (numeric) Number of flushes since startup\n"
+            "  \"failures\": n,            (numeric) Number of flushes that failed to write\n"
+            "  \"stall_ms\": {             (json object) Time block processing waited for a flush, over the last flushes\n"
+            "    \"p50\": x.xxx,           (numeric) Median, in milliseconds\n"
+            "    \"p90\": x.xxx,           (numeric) 90th percentile, in milliseconds\n"
+            "    \"p99\": x.xxx,           (numeric) 99th percentile, in milliseconds\n"
+            "    \"max\": x.xxx            (numeric) Maximum, in milliseconds\n"
+            "  },\n"
+            "  \"write_ms\": {...}         (json object) Time spent writing a flush to disk, same fields as stall_ms\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getcoinscacheinfo", "")
+            + HelpExampleRpc("getcoinscacheinfo", "")
+        );
+
+    UniValue ret(UniValue::VOBJ);
+    {
+        LOCK(cs_main);
+        ret.push_back(Pair("entries", (uint64_t)pcoinsTip->GetCacheSize()));
+        ret.push_back(Pair("usage", (uint64_t)pcoinsTip->DynamicMemoryUsage()));
+        ret.push_back(Pair("limit", (uint64_t)nCoinCacheUsage));
+    }
+
+    CCoinsFlushStats stats;
+    pcoinsdbview->GetFlushStats(stats);
+    ret.push_back(Pair("backgroundflush", stats.fBackground));
+    ret.push_back(Pair("flushing", stats.fInProgress));
+    ret.push_back(Pair("flushingentries", (uint64_t)stats.nFlushingEntries));
+    ret.push_back(Pair("flushes", stats.nFlushes));
+    ret.push_back(Pair("failures", stats.nFailures));
+    ret.push_back(Pair("stall_ms", FlushLatencyToJSON(stats.stall)));
+    ret.push_back(Pair("write_ms", FlushLatencyToJSON(stats.write)));
+    return ret;
+}
+
+static CDBWrapper& GetDBByName(const std::string& strDB, const DBKeyRanges*& pranges)
+{
+    // Shutdown deletes the databases under cs_main
+    AssertLockHeld(cs_main);
+    if (strDB == "chainstate") {
+        pranges = &CCoinsViewDB::GetKeyRanges();
+        return pcoinsdbview->GetDBWrapper();
+    }
+    if (strDB == "blockindex") {
+        pranges = &CBlockTreeDB::GetKeyRanges();
+        return *pblocktree;
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown database, must be chainstate or blockindex");
+}
+
+static UniValue DBInfoToJSON(const CDBWrapper& db, const DBKeyRanges& ranges, bool fVerbose)
+{
+    UniValue ret(UniValue::VOBJ);
+    const CDBWrapperOptions& dbOptions = db.GetDBOptions();
+    ret.push_back(Pair("maxopenfiles", dbOptions.nMaxOpenFiles));
+    ret.push_back(Pair("bloombitsperkey", dbOptions.nBloomBitsPerKey));
+    ret.push_back(Pair("compression", dbOptions.fCompression));
+    ret.push_back(Pair("blocksize", (uint64_t)dbOptions.nBlockSize));
+
+    uint64_t nSize = 0;
+    UniValue sizes(UniValue::VOBJ);
+    BOOST_FOREACH(const DBKeyRanges::value_type& range, ranges) {
+        uint64_t nRangeSize = db.EstimateSize(range.second, (char)(range.second + 1));
+        sizes.push_back(Pair(range.first, nRangeSize));
+        nSize += nRangeSize;
+    }
+    ret.push_back(Pair("size", nSize));
+    ret.push_back(Pair("ranges", sizes));
+
+    UniValue levels(UniValue::VARR);
+    for (int i = 0; i < DBWRAPPER_NUM_LEVELS; i++)
+        levels.push_back(atoi(db.GetProperty(strprintf("leveldb.num-files-at-level%d", i))));
+    ret.push_back(Pair("filesperlevel", levels));
+
+    CDBCompactionStatus status = db.GetCompactionStatus();
+    UniValue compaction(UniValue::VOBJ);
+    compaction.push_back(Pair("running", status.fRunning));
+    compaction.push_back(Pair("range", status.strRange));
+    compaction.push_back(Pair("starttime", status.nStartTime));
+    compaction.push_back(Pair("duration", status.nDuration));
+    compaction.push_back(Pair("count", status.nCompactions));
+    ret.push_back(Pair("compaction", compaction));
+
+    if (fVerbose)
+        ret.push_back(Pair("stats", db.GetProperty("leveldb.stats")));
+    return ret;
+}
+
+UniValue getdbinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getdbinfo ( verbose )\n"
+            "\nReturns tuning, size and compaction details of the chainstate and blockindex databases.\n"
+            "\nArguments:\n"
+            "1. verbose          (boolean, optional, default=false) Include the LevelDB statistics of each database\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"chainstate\": {            (json object) The coin database, same fields for \"blockindex\"\n"
+            "    \"maxopenfiles\": n,       (numeric) Table files kept open\n"
+            "    \"bloombitsperkey\": n,    (numeric) Bits per key of the bloom filter, 0 if none\n"
+            "    \"compression\": true|false, (boolean) Whether new tables are compressed\n"
+            "    \"blocksize\": n,          (numeric) Size of a table block in bytes\n"
+            "    \"size\": n,               (numeric) Approximate size on disk in bytes\n"
+            "    \"ranges\": {              (json object) Approximate size on disk of each key range in bytes\n"
+            "      \"range\": n,\n"
+            "      ...\n"
+            "    },\n"
+            "    \"filesperlevel\": [n,...], (array) Number of table files at each level\n"
+            "    \"compaction\": {          (json object) Manual compaction, see compactdb\n"
+            "      \"running\": true|false, (boolean) Whether a compaction is running\n"
+            "      \"range\": \"name\",       (string) The range being or last compacted\n"
+            "      \"starttime\": n,        (numeric) Start of the running or last compaction, in seconds since epoch\n"
+            "      \"duration\": n,         (numeric) Seconds the last finished compaction took, -1 if none\n"
+            "      \"count\": n             (numeric) Number of finished compactions\n"
+            "    },\n"
+            "    \"stats\": \"...\"           (string) LevelDB statistics, only if verbose is true\n"
+            "  },\n"
+            "  \"blockindex\": {           (json object) Same fields as \"chainstate\", and\n"
+            "    ...\n"
+            "    \"negativecache\": {       (json object) Address and spent index lookups known to find nothing\n"
+            "      \"entries\": n,          (numeric) Lookups remembered\n"
+            "      \"hits\": n,             (numeric) Lookups answered without reading the database\n"
+            "      \"misses\": n,           (numeric) Lookups that had to read the database\n"
+            "      \"invalidated\": n       (numeric) Entries dropped because data was added\n"
+            "    }\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbinfo", "")
+            + HelpExampleCli("getdbinfo", "true")
+            + HelpExampleRpc("getdbinfo", "true")
+        );
+
+    bool fVerbose = params.size() > 0 && params[0].get_bool();
+
+    LOCK(cs_main);
+    UniValue ret(UniValue::VOBJ);
+    const DBKeyRanges* pranges = NULL;
+    const char* dbs[] = {"chainstate", "blockindex"};
+    BOOST_FOREACH(const char* strDB, dbs) {
+        CDBWrapper& db = GetDBByName(strDB, pranges);
+        UniValue info = DBInfoToJSON(db, *pranges, fVerbose);
+        if (&db == pblocktree) {
+            CIndexNegativeCacheStats stats;
+            pblocktree->GetNegativeCacheStats(stats);
+            UniValue negativeCache(UniValue::VOBJ);
+            negativeCache.push_back(Pair("entries", (uint64_t)stats.nEntries));
+            negativeCache.push_back(Pair("hits", stats.nHits));
+            negativeCache.push_back(Pair("misses", stats.nMisses));
+            negativeCache.push_back(Pair("invalidated", stats.nInvalidated));
+            info.push_back(Pair("negativecache", negativeCache));
+        }
+        ret.push_back(Pair(strDB, info));
+    }
+    return ret;
+}
+
+UniValue compactdb(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2)
+        throw runtime_error(
+            "compactdb \"db\" ( \"range\" )\n"
+            "\nStarts a manual compaction of a database in the background. Its progress is reported by getdbinfo.\n"
+            "Compaction rewrites the tables of the range to drop deleted and overwritten entries and reduce the number of\n"
+            "files a lookup has to check. It adds I/O load while it runs and can't be interrupted; shutdown waits for it.\n"
+            "\nArguments:\n"
+            "1. \"db\"        (string, required) The database, chainstate or blockindex\n"
+            "2. \"range\"     (string, optional, default=all) A key range as listed by getdbinfo, or all\n"
+            "\nResult:\n"
+            "true|false     (boolean) Whether the compaction was started, false if one is already running on that database\n"
+            "\nExamples:\n"
+            + HelpExampleCli("compactdb", "\"blockindex\" \"addressindex\"")
+            + HelpExampleRpc("compactdb", "\"chainstate\"")
+        );
+
+    LOCK(cs_main);
+    const DBKeyRanges* pranges = NULL;
+    CDBWrapper& db = GetDBByName(params[0].get_str(), pranges);
+    std::string strRange = params.size() > 1 ? params[1].get_str() : "all";
+    if (strRange == "all")
+        return db.StartCompaction(strRange);
+
+    BOOST_FOREACH(const DBKeyRanges::value_type& range, *pranges) {
+        if (range.first != strRange)
+            continue;
+        CDataStream ssBegin(SER_DISK, CLIENT_VERSION), ssEnd(SER_DISK, CLIENT_VERSION);
+        ssBegin << range.second;
+        ssEnd << (char)(range.second + 1);
+        return db.StartCompaction(strRange, ssBegin.str(), ssEnd.str());
+    }
+    throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown key range for this database");
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -739,6 +1295,35 @@ UniValue gettxout(const UniValue& params, bool fHelp)
     return ret;
 }
 
+/**
+ * Params: uint256 txid, uint32 n, bool includemempool.
+ * Result: bool found, followed if found by uint256 bestblock, uint32 height
+ * (MEMPOOL_HEIGHT for mempool outputs), bool coinbase and the CTxOut.
+ */
+void gettxout_bin(CDataStream& params, CDataStream& result)
+{
+    uint256 hash;
+    uint32_t n;
+    bool fMempool;
+    params >> hash >> n >> fMempool;
+    COutPoint out(hash, n);
+
+    LOCK(cs_main);
+    Coin coin;
+    bool fFound;
+    if (fMempool) {
+        LOCK(mempool.cs);
+        CCoinsViewMemPool view(pcoinsTip, mempool);
+        fFound = view.GetCoin(out, coin) && !mempool.isSpent(out);
+    } else {
+        fFound = pcoinsTip->GetCoin(out, coin);
+    }
+    result << fFound;
+    if (!fFound)
+        return;
+    result << pcoinsTip->GetBestBlock() << (uint32_t)coin.nHeight << (bool)coin.fCoinBase << coin.out;
+}
+
 UniValue verifychain(const UniValue& params, bool fHelp)
 {
     int nCheckLevel = GetArg("-checklevel", DEFAULT_CHECKLEVEL);
@@ -829,6 +1414,8 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) heighest block available\n"
+            "  \"snapshotheight\": xxxxxx, (numeric) the block a UTXO snapshot was loaded at, until the blocks up to it are validated\n"
+            "  \"snapshotvalidated\": xxxxxx, (numeric) the last of those blocks validated so far, -1 if none\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -887,6 +1474,10 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+    if (pindexSnapshotBase) {
+        obj.push_back(Pair("snapshotheight",     pindexSnapshotBase->nHeight));
+        obj.push_back(Pair("snapshotvalidated",  pindexSnapshotValidated ? pindexSnapshotValidated->nHeight : -1));
+    }
     return obj;
 }
 
@@ -1026,6 +1617,20 @@ UniValue mempoolInfoToJSON()
     ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
     ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
+    COrphanPoolStats orphanStats;
+    orphanpool.GetStats(orphanStats);
+    ret.push_back(Pair("orphans", (int64_t) orphanStats.nOrphans));
+    ret.push_back(Pair("orphanusage", (int64_t) orphanStats.nUsage));
+    ret.push_back(Pair("orphanpeers", (int64_t) orphanStats.nPeers));
+    ret.push_back(Pair("orphansadded", orphanStats.nAdded));
+    ret.push_back(Pair("orphansaccepted", orphanStats.nAccepted));
+    ret.push_back(Pair("orphansinvalid", orphanStats.nInvalid));
+    ret.push_back(Pair("orphansremovedblock", orphanStats.nRemovedBlock));
+    ret.push_back(Pair("orphansremovedpeer", orphanStats.nRemovedPeer));
+    ret.push_back(Pair("orphansexpired", orphanStats.nExpired));
+    ret.push_back(Pair("orphansevictedquota", orphanStats.nEvictedQuota));
+    ret.push_back(Pair("orphansevictedlimit", orphanStats.nEvictedLimit));
+
     return ret;
 }
 
@@ -1041,7 +1646,18 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "  \"bytes\": xxxxx,              (numeric) Sum of all tx sizes\n"
             "  \"usage\": xxxxx,              (numeric) Total memory usage for the mempool\n"
             "  \"maxmempool\": xxxxx,         (numeric) Maximum memory usage for the mempool\n"
-            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee for tx to be accepted\n"
+            "  \"mempoolminfee\": xxxxx,      (numeric) Minimum fee for tx to be accepted\n"
+            "  \"orphans\": xxxxx,            (numeric) Current orphan tx count\n"
+            "  \"orphanusage\": xxxxx,        (numeric) Total memory usage for orphan txes\n"
+            "  \"orphanpeers\": xxxxx,        (numeric) Number of peers with orphan txes\n"
+            "  \"orphansadded\": xxxxx,       (numeric) Orphan txes stored since startup\n"
+            "  \"orphansaccepted\": xxxxx,    (numeric) Orphan txes accepted to the mempool once their parents arrived\n"
+            "  \"orphansinvalid\": xxxxx,     (numeric) Orphan txes rejected once their parents arrived\n"
+            "  \"orphansremovedblock\": xxxxx, (numeric) Orphan txes included in or conflicted by a block\n"
+            "  \"orphansremovedpeer\": xxxxx, (numeric) Orphan txes dropped because their peer disconnected\n"
+            "  \"orphansexpired\": xxxxx,     (numeric) Orphan txes expired before their parents arrived\n"
+            "  \"orphansevictedquota\": xxxxx, (numeric) Orphan txes evicted by the per-peer memory quota\n"
+            "  \"orphansevictedlimit\": xxxxx  (numeric) Orphan txes evicted by the -maxorphantx limit\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getmempoolinfo", "")
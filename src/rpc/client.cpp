@@ -104,6 +104,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "gettxout", 1 },
     { "gettxout", 2 },
     { "gettxoutproof", 0 },
+    { "gettxoutsetinfo", 0 },
+    { "getdbinfo", 0 },
     { "lockunspent", 0 },
     { "lockunspent", 1 },
     { "importprivkey", 2 },
@@ -10,7 +10,9 @@
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
+#include "streams.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
@@ -20,6 +22,7 @@
 #include "wallet/walletdb.h"
 #endif
 
+#include "maintenance.h"
 #include "masternode-sync.h"
 #include "spork.h"
 
@@ -27,6 +30,7 @@
 
 #include <boost/assign/list_of.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include <univalue.h>
 
@@ -180,6 +184,64 @@ UniValue mnsync(const UniValue& params, bool fHelp)
     return "failure";
 }
 
+UniValue getmaintenanceinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getmaintenanceinfo\n"
+            "Returns the periodic maintenance jobs of the Dash modules and their run times.\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\": \"name\",      (string) The name of the job\n"
+            "    \"interval\": n,         (numeric) The job runs every this many seconds\n"
+            "    \"jitter\": n,           (numeric) Up to this many seconds are added to the interval at random\n"
+            "    \"next\": ttt,           (numeric) The time the job runs next, 0 while it is running\n"
+            "    \"runs\": n,             (numeric) The number of times the job ran\n"
+            "    \"overruns\": n,         (numeric) The number of runs which took longer than the interval\n"
+            "    \"total_ms\": x.xxx,     (numeric) The time spent in the job\n"
+            "    \"last_ms\": x.xxx,      (numeric) The duration of the last run\n"
+            "    \"max_ms\": x.xxx,       (numeric) The duration of the longest run\n"
+            "    \"max_late\": n,         (numeric) The longest a run waited for a worker thread, in seconds\n"
+            "    \"histogram\": {         (json object) The number of runs by duration, for the durations seen\n"
+            "      \"<1ms\": n,           (numeric) Runs shorter than 1ms, then 2ms, 4ms, ...\n"
+            "      ...\n"
+            "    }\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getmaintenanceinfo", "")
+            + HelpExampleRpc("getmaintenanceinfo", "")
+        );
+
+    UniValue ret(UniValue::VARR);
+    BOOST_FOREACH(const CMaintenanceJobStats& stats, maintenanceScheduler.GetStats()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("name", stats.strName));
+        obj.push_back(Pair("interval", stats.nInterval));
+        obj.push_back(Pair("jitter", stats.nJitter));
+        obj.push_back(Pair("next", stats.nTimeNext));
+        obj.push_back(Pair("runs", stats.nRuns));
+        obj.push_back(Pair("overruns", stats.nOverruns));
+        obj.push_back(Pair("total_ms", stats.nTotalMicros * 0.001));
+        obj.push_back(Pair("last_ms", stats.nLastMicros * 0.001));
+        obj.push_back(Pair("max_ms", stats.nMaxMicros * 0.001));
+        obj.push_back(Pair("max_late", stats.nMaxLateSeconds));
+        UniValue histogram(UniValue::VOBJ);
+        for (int i = 0; i < MAINTENANCE_HISTOGRAM_BUCKETS; i++) {
+            if (stats.vHistogram[i] == 0)
+                continue;
+            int64_t nBound = CMaintenanceScheduler::GetHistogramBound(i);
+            std::string strBucket = nBound < 0 ? strprintf(">=%dms", CMaintenanceScheduler::GetHistogramBound(i - 1)) : strprintf("<%dms", nBound);
+            histogram.push_back(Pair(strBucket, stats.vHistogram[i]));
+        }
+        obj.push_back(Pair("histogram", histogram));
+        ret.push_back(obj);
+    }
+    return ret;
+}
+
 #ifdef ENABLE_WALLET
 class DescribeAddressVisitor : public boost::static_visitor<UniValue>
 {
@@ -589,6 +651,164 @@ bool timestampSort(std::pair<CMempoolAddressDeltaKey, CMempoolAddressDelta> a,
     return a.second.time < b.second.time;
 }
 
+static const size_t DEFAULT_ADDRESS_PAGE_LIMIT = 1000;
+static const size_t MAX_ADDRESS_PAGE_LIMIT = 100000;
+
+/** Paging options of the address index RPCs, paging is used if any of them is given */
+struct CAddressPage
+{
+    bool fPaginate;
+    size_t nLimit;
+    bool fReverse;
+    std::string strCursor;
+
+    CAddressPage() : fPaginate(false), nLimit(DEFAULT_ADDRESS_PAGE_LIMIT), fReverse(false) {}
+};
+
+static CAddressPage getPageFromParams(const UniValue& params)
+{
+    CAddressPage page;
+    if (!params[0].isObject())
+        return page;
+
+    UniValue limitValue = find_value(params[0].get_obj(), "limit");
+    UniValue cursorValue = find_value(params[0].get_obj(), "cursor");
+    UniValue reverseValue = find_value(params[0].get_obj(), "reverse");
+    if (!limitValue.isNull()) {
+        int64_t nLimit = limitValue.get_int64();
+        if (nLimit < 1 || nLimit > (int64_t)MAX_ADDRESS_PAGE_LIMIT)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Limit must be between 1 and %u", MAX_ADDRESS_PAGE_LIMIT));
+        page.nLimit = nLimit;
+        page.fPaginate = true;
+    }
+    if (!cursorValue.isNull()) {
+        page.strCursor = cursorValue.get_str();
+        page.fPaginate = true;
+    }
+    if (!reverseValue.isNull()) {
+        page.fReverse = reverseValue.get_bool();
+        page.fPaginate = true;
+    }
+    return page;
+}
+
+/**
+ * A cursor is the hex encoded key of the last entry of a page without the
+ * address, i.e. the position to continue at. Every entry belongs to a single
+ * address, so the position alone identifies it.
+ */
+template <typename K>
+static UniValue EncodeAddressCursor(const K& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << key;
+    return HexStr(ss.begin() + CAddressIndexIteratorKey().GetSerializeSize(SER_DISK, CLIENT_VERSION), ss.end());
+}
+
+template <typename K>
+static void DecodeAddressCursor(const std::string& strCursor, K& key)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << CAddressIndexIteratorKey();
+    std::vector<unsigned char> vch = ParseHex(strCursor);
+    ss.write((const char*)vch.data(), vch.size());
+    if (!IsHex(strCursor) || ss.size() != key.GetSerializeSize(SER_DISK, CLIENT_VERSION))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    ss >> key;
+}
+
+template <typename K, typename V, typename Compare>
+struct CAddressPageCompare
+{
+    bool fReverse;
+    Compare comp;
+
+    CAddressPageCompare(bool fReverseIn) : fReverse(fReverseIn) {}
+    bool operator()(const std::pair<K, V>& a, const std::pair<K, V>& b) const {
+        return fReverse ? comp(b.first, a.first) : comp(a.first, b.first);
+    }
+};
+
+/**
+ * Read one page of address index entries of all addresses, ordered by their
+ * position in the chain. The addresses are merged up to one entry past the
+ * page, which tells whether another page follows. Returns the cursor of that
+ * page or null if there is none. With fWholeTransactions, a page does not end
+ * in the middle of a transaction unless that transaction fills the whole page.
+ */
+static UniValue getAddressIndexPage(const std::vector<std::pair<uint160, int> >& addresses, const CAddressPage& page,
+                                    int start, int end, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+                                    bool fWholeTransactions = false)
+{
+    CAddressIndexKey cursor;
+    if (!page.strCursor.empty())
+        DecodeAddressCursor(page.strCursor, cursor);
+
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+    CAddressIndexMerger merger(*pblocktree, addresses, page.fReverse, page.strCursor.empty() ? NULL : &cursor, start, end);
+    for (merger.Seek(); merger.Valid() && addressIndex.size() <= page.nLimit; merger.Next())
+        addressIndex.push_back(std::make_pair(merger.GetKey(), merger.GetValue()));
+    if (merger.Failed())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+
+    if (addressIndex.size() <= page.nLimit)
+        return NullUniValue;
+    size_t nSize = page.nLimit;
+    if (fWholeTransactions) {
+        const uint256& txhashNext = addressIndex[nSize].first.txhash;
+        while (nSize > 1 && addressIndex[nSize - 1].first.txhash == txhashNext)
+            nSize--;
+        if (addressIndex[nSize - 1].first.txhash == txhashNext)
+            nSize = page.nLimit;
+    }
+    addressIndex.resize(nSize);
+    return EncodeAddressCursor(addressIndex.back().first);
+}
+
+/**
+ * Read all address index entries of all addresses in chain order. The
+ * addresses are merged while they are read, rather than sorted afterwards.
+ * Like before paging, a height range is only used if both ends are given.
+ */
+static void getAddressIndexAll(const std::vector<std::pair<uint160, int> >& addresses, int start, int end,
+                               std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex)
+{
+    if (start <= 0 || end <= 0)
+        start = end = 0;
+
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+    CAddressIndexMerger merger(*pblocktree, addresses, false, NULL, start, end);
+    for (merger.Seek(); merger.Valid(); merger.Next())
+        addressIndex.push_back(std::make_pair(merger.GetKey(), merger.GetValue()));
+    if (merger.Failed())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+}
+
+static UniValue getAddressUnspentPage(const std::vector<std::pair<uint160, int> >& addresses, const CAddressPage& page,
+                                      std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs)
+{
+    CAddressUnspentKey cursor;
+    if (!page.strCursor.empty())
+        DecodeAddressCursor(page.strCursor, cursor);
+
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        if (!GetAddressUnspentPage((*it).first, (*it).second, unspentOutputs, page.nLimit + 1, page.fReverse,
+                                   page.strCursor.empty() ? NULL : &cursor)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+    }
+
+    std::sort(unspentOutputs.begin(), unspentOutputs.end(), CAddressPageCompare<CAddressUnspentKey, CAddressUnspentValue, CAddressUnspentPositionCompare>(page.fReverse));
+    if (unspentOutputs.size() <= page.nLimit)
+        return NullUniValue;
+    unspentOutputs.resize(page.nLimit);
+    return EncodeAddressCursor(unspentOutputs.back().first);
+}
+
 UniValue getaddressmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -673,6 +893,9 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "      \"address\"  (string) The base58check encoded address\n"
             "      ,...\n"
             "    ]\n"
+            "  \"limit\" (number, optional) Return a page of at most this many outputs, ordered by txid and output index\n"
+            "  \"cursor\" (string, optional) Continue after the previous page\n"
+            "  \"reverse\" (boolean, optional, default=false) Page through the outputs in reverse order\n"
             "}\n"
             "\nResult\n"
             "[\n"
@@ -685,8 +908,14 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
             "    \"height\"  (number) The block height\n"
             "  }\n"
             "]\n"
+            "\nResult (if any of limit, cursor or reverse is given):\n"
+            "{\n"
+            "  \"utxos\": [...]  (array) The outputs, as above\n"
+            "  \"cursor\"  (string) Pass this to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 100}'")
             + HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -696,15 +925,21 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAddressPage page = getPageFromParams(params);
     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    UniValue cursor;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    if (page.fPaginate) {
+        cursor = getAddressUnspentPage(addresses, page, unspentOutputs);
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!GetAddressUnspent((*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
         }
-    }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     UniValue result(UniValue::VARR);
 
@@ -724,9 +959,49 @@ UniValue getaddressutxos(const UniValue& params, bool fHelp)
         result.push_back(output);
     }
 
+    if (page.fPaginate) {
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("utxos", result));
+        ret.push_back(Pair("cursor", cursor));
+        return ret;
+    }
     return result;
 }
 
+static UniValue addressDeltaToJSON(const CAddressIndexKey& key, CAmount nValue)
+{
+    std::string address;
+    if (!getAddressFromIndex(key.type, key.hashBytes, address)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
+    }
+
+    UniValue delta(UniValue::VOBJ);
+    delta.push_back(Pair("satoshis", nValue));
+    delta.push_back(Pair("txid", key.txhash.GetHex()));
+    delta.push_back(Pair("index", (int)key.index));
+    delta.push_back(Pair("blockindex", (int)key.txindex));
+    delta.push_back(Pair("height", key.blockHeight));
+    delta.push_back(Pair("address", address));
+    return delta;
+}
+
+static void getRangeFromParams(const UniValue& params, int& start, int& end)
+{
+    UniValue startValue = find_value(params[0].get_obj(), "start");
+    UniValue endValue = find_value(params[0].get_obj(), "end");
+
+    start = 0;
+    end = 0;
+
+    if (startValue.isNum() && endValue.isNum()) {
+        start = startValue.get_int();
+        end = endValue.get_int();
+        if (end < start) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
+        }
+    }
+}
+
 UniValue getaddressdeltas(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1 || !params[0].isObject())
@@ -742,6 +1017,9 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return a page of at most this many changes, ordered by height\n"
+            "  \"cursor\" (string, optional) Continue after the previous page\n"
+            "  \"reverse\" (boolean, optional, default=false) Page through the changes from the newest to the oldest\n"
             "}\n"
             "\nResult:\n"
             "[\n"
@@ -754,25 +1032,20 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
             "    \"address\"  (string) The base58check encoded address\n"
             "  }\n"
             "]\n"
+            "\nResult (if any of limit, cursor or reverse is given):\n"
+            "{\n"
+            "  \"deltas\": [...]  (array) The changes, as above\n"
+            "  \"cursor\"  (string) Pass this to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddressdeltas", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 100, \"reverse\": true}'")
             + HelpExampleRpc("getaddressdeltas", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
 
-    UniValue startValue = find_value(params[0].get_obj(), "start");
-    UniValue endValue = find_value(params[0].get_obj(), "end");
-
-    int start = 0;
-    int end = 0;
-
-    if (startValue.isNum() && endValue.isNum()) {
-        start = startValue.get_int();
-        end = endValue.get_int();
-        if (end < start) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "End value is expected to be greater than start");
-        }
-    }
+    int start, end;
+    getRangeFromParams(params, start, end);
 
     std::vector<std::pair<uint160, int> > addresses;
 
@@ -780,41 +1053,61 @@ UniValue getaddressdeltas(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
+    CAddressPage page = getPageFromParams(params);
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    UniValue cursor;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        }
-    }
+    if (page.fPaginate)
+        cursor = getAddressIndexPage(addresses, page, start, end, addressIndex);
+    else
+        getAddressIndexAll(addresses, start, end, addressIndex);
 
     UniValue result(UniValue::VARR);
 
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        std::string address;
-        if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
-        }
-
-        UniValue delta(UniValue::VOBJ);
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        result.push_back(delta);
+        result.push_back(addressDeltaToJSON(it->first, it->second));
     }
 
+    if (page.fPaginate) {
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("deltas", result));
+        ret.push_back(Pair("cursor", cursor));
+        return ret;
+    }
     return result;
 }
 
+void getaddressdeltas_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() != 1 || !params[0].isObject() || getPageFromParams(params).fPaginate) {
+        writer.Value(getaddressdeltas(params, false));
+        return;
+    }
+
+    int start, end;
+    getRangeFromParams(params, start, end);
+    if (start <= 0 || end <= 0)
+        start = end = 0;
+
+    std::vector<std::pair<uint160, int> > addresses;
+
+    if (!getAddressesFromParams(params, addresses)) {
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+
+    // Read the changes while they are sent, instead of loading all of them first
+    CAddressIndexMerger merger(*pblocktree, addresses, false, NULL, start, end);
+    writer.BeginArray();
+    for (merger.Seek(); merger.Valid(); merger.Next())
+        writer.Value(addressDeltaToJSON(merger.GetKey(), merger.GetValue()));
+    if (merger.Failed())
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+    writer.EndArray();
+}
+
 UniValue getaddressbalance(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -845,22 +1138,16 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressSummary summary;
+        if (!GetAddressSummary((*it).first, (*it).second, summary)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += summary.balance;
+        received += summary.received;
     }
 
     UniValue result(UniValue::VOBJ);
@@ -871,6 +1158,49 @@ UniValue getaddressbalance(const UniValue& params, bool fHelp)
 
 }
 
+/** The addresses of a binary call: a vector of (uint160 hash, int32 type), type 1 for P2PKH and 2 for P2SH */
+static void getAddressesFromStream(CDataStream& params, std::vector<std::pair<uint160, int> >& addresses)
+{
+    params >> addresses;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (addresses[i].second != 1 && addresses[i].second != 2)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+    }
+}
+
+/** Params: the addresses. Result: int64 balance and int64 received, in duffs */
+void getaddressbalance_bin(CDataStream& params, CDataStream& result)
+{
+    std::vector<std::pair<uint160, int> > addresses;
+    getAddressesFromStream(params, addresses);
+
+    CAmount balance = 0;
+    CAmount received = 0;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        CAddressSummary summary;
+        if (!GetAddressSummary(addresses[i].first, addresses[i].second, summary))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        balance += summary.balance;
+        received += summary.received;
+    }
+    result << balance << received;
+}
+
+/** Params: the addresses. Result: vector of (CAddressUnspentKey, CAddressUnspentValue), ordered by height */
+void getaddressutxos_bin(CDataStream& params, CDataStream& result)
+{
+    std::vector<std::pair<uint160, int> > addresses;
+    getAddressesFromStream(params, addresses);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    for (size_t i = 0; i < addresses.size(); i++) {
+        if (!GetAddressUnspent(addresses[i].first, addresses[i].second, unspentOutputs))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    result << unspentOutputs;
+}
+
 UniValue getaddresstxids(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -886,14 +1216,25 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
             "    ]\n"
             "  \"start\" (number) The start block height\n"
             "  \"end\" (number) The end block height\n"
+            "  \"limit\" (number, optional) Return a page of the transactions of at most this many inputs and outputs, ordered by height.\n"
+            "                     A page only ends in the middle of a transaction if that transaction has more inputs and outputs\n"
+            "                     of the addresses than the limit.\n"
+            "  \"cursor\" (string, optional) Continue after the previous page\n"
+            "  \"reverse\" (boolean, optional, default=false) Page through the transactions from the newest to the oldest\n"
             "}\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (if any of limit, cursor or reverse is given):\n"
+            "{\n"
+            "  \"txids\": [...]  (array) The transaction ids, as above\n"
+            "  \"cursor\"  (string) Pass this to get the next page, null on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}'")
+            + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"], \"limit\": 100, \"reverse\": true}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"XwnLY9Tf7Zsef8gMGL2fhWA9ZmMjt4KPwg\"]}")
         );
 
@@ -914,40 +1255,30 @@ UniValue getaddresstxids(const UniValue& params, bool fHelp)
         }
     }
 
+    CAddressPage page = getPageFromParams(params);
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (start > 0 && end > 0) {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex, start, end)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
-        } else {
-            if (!GetAddressIndex((*it).first, (*it).second, addressIndex)) {
-                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-            }
+    if (page.fPaginate) {
+        // Entries of a transaction are adjacent, so a page holds each transaction once
+        UniValue cursor = getAddressIndexPage(addresses, page, start, end, addressIndex, true);
+        UniValue result(UniValue::VARR);
+        for (size_t i = 0; i < addressIndex.size(); i++) {
+            if (i == 0 || addressIndex[i].first.txhash != addressIndex[i - 1].first.txhash)
+                result.push_back(addressIndex[i].first.txhash.GetHex());
         }
+        UniValue ret(UniValue::VOBJ);
+        ret.push_back(Pair("txids", result));
+        ret.push_back(Pair("cursor", cursor));
+        return ret;
     }
 
-    std::set<std::pair<int, std::string> > txids;
+    // In chain order the entries of a transaction are adjacent, of all addresses
+    getAddressIndexAll(addresses, start, end, addressIndex);
     UniValue result(UniValue::VARR);
-
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        int height = it->first.blockHeight;
-        std::string txid = it->first.txhash.GetHex();
-
-        if (addresses.size() > 1) {
-            txids.insert(std::make_pair(height, txid));
-        } else {
-            if (txids.insert(std::make_pair(height, txid)).second) {
-                result.push_back(txid);
-            }
-        }
-    }
-
-    if (addresses.size() > 1) {
-        for (std::set<std::pair<int, std::string> >::const_iterator it=txids.begin(); it!=txids.end(); it++) {
-            result.push_back(it->second);
-        }
+    for (size_t i = 0; i < addressIndex.size(); i++) {
+        if (i == 0 || addressIndex[i].first.txhash != addressIndex[i - 1].first.txhash ||
+            addressIndex[i].first.blockHeight != addressIndex[i - 1].first.blockHeight)
+            result.push_back(addressIndex[i].first.txhash.GetHex());
     }
 
     return result;
@@ -5,6 +5,7 @@
 
 #include "rpc/server.h"
 
+#include "blockcache.h"
 #include "chainparams.h"
 #include "clientversion.h"
 #include "validation.h"
@@ -100,7 +101,12 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"blockwindow\": n,          (numeric) Number of blocks kept in flight from this peer during parallel download\n"
+            "    \"blocksreceived\": n,       (numeric) Number of requested blocks received from this peer\n"
+            "    \"blockdownloadrate\": n,    (numeric) Average bytes per second this peer sends requested blocks at\n"
+            "    \"blockresponsetime\": n,    (numeric) Average time in seconds from a block request to its arrival\n"
+            "    \"blocksstalled\": n,        (numeric) Blocks requested from this peer which were requested again from other peers after it stalled\n"
             "    \"bytessent_per_msg\": {\n"
             "       \"addr\": n,             (numeric) The total bytes sent aggregated by message type\n"
             "       ...\n"
@@ -163,6 +169,11 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("blockwindow", statestats.nBlockWindow));
+            obj.push_back(Pair("blocksreceived", statestats.nBlocksReceived));
+            obj.push_back(Pair("blockdownloadrate", statestats.dBlockDownloadRate));
+            obj.push_back(Pair("blockresponsetime", statestats.dBlockResponseTime));
+            obj.push_back(Pair("blocksstalled", statestats.nBlocksStalled));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
@@ -343,6 +354,14 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
             "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  },\n"
+            "  \"recentblocks\":\n"
+            "  {\n"
+            "    \"hits\": n,          (numeric) Blocks served to peers, RPC and ZMQ clients from the recent blocks\n"
+            "    \"misses\": n,        (numeric) Blocks served from disk\n"
+            "    \"blocks\": n,        (numeric) Number of recent blocks kept\n"
+            "    \"usage\": n,         (numeric) Memory used by the recent blocks in bytes\n"
+            "    \"maxusage\": n       (numeric) Maximum memory used by the recent blocks in bytes (see -recentblockcache)\n"
             "  }\n"
             "}\n"
             "\nExamples:\n"
@@ -365,6 +384,15 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     outboundLimit.push_back(Pair("bytes_left_in_cycle", g_connman->GetOutboundTargetBytesLeft()));
     outboundLimit.push_back(Pair("time_left_in_cycle", g_connman->GetMaxOutboundTimeLeftInCycle()));
     obj.push_back(Pair("uploadtarget", outboundLimit));
+
+    CRecentBlockCacheStats stats = recentBlocks.GetStats();
+    UniValue recent(UniValue::VOBJ);
+    recent.push_back(Pair("hits", stats.nHits));
+    recent.push_back(Pair("misses", stats.nMisses));
+    recent.push_back(Pair("blocks", (uint64_t)stats.nBlocks));
+    recent.push_back(Pair("usage", (uint64_t)stats.nUsage));
+    recent.push_back(Pair("maxusage", (uint64_t)stats.nMaxUsage));
+    obj.push_back(Pair("recentblocks", recent));
     return obj;
 }
 
@@ -62,6 +62,84 @@ UniValue JSONRPCError(int code, const string& message)
     return error;
 }
 
+CJSONStreamWriter::CJSONStreamWriter(const SinkFn& sinkIn, size_t nChunkSizeIn) :
+    sink(sinkIn), nChunkSize(nChunkSizeIn), fAfterKey(false), nFlushed(0)
+{
+    strBuffer.reserve(nChunkSize + 1024);
+}
+
+void CJSONStreamWriter::Separate()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (vEmpty.empty())
+        return;
+    if (!vEmpty.back())
+        strBuffer += ',';
+    vEmpty.back() = false;
+}
+
+void CJSONStreamWriter::Write(const std::string& str)
+{
+    strBuffer += str;
+    if (strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    Separate();
+    vEmpty.push_back(true);
+    Write("{");
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    Write("}");
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    Separate();
+    vEmpty.push_back(true);
+    Write("[");
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    Write("]");
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    Separate();
+    strBuffer += UniValue(key).write();
+    strBuffer += ':';
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& value)
+{
+    Separate();
+    Write(value.write());
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    nFlushed += strBuffer.size();
+    sink(strBuffer);
+    strBuffer.clear();
+}
+
 /** Username used when cookie authentication is in use (arbitrary, only for
  * recognizability in debugging/logging purposes)
  */
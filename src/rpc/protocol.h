@@ -10,7 +10,9 @@
 #include <map>
 #include <stdint.h>
 #include <string>
+#include <vector>
 #include <boost/filesystem.hpp>
+#include <boost/function.hpp>
 
 #include <univalue.h>
 
@@ -18,11 +20,14 @@
 enum HTTPStatusCode
 {
     HTTP_OK                    = 200,
+    HTTP_PARTIAL_CONTENT       = 206,
+    HTTP_NOT_MODIFIED          = 304,
     HTTP_BAD_REQUEST           = 400,
     HTTP_UNAUTHORIZED          = 401,
     HTTP_FORBIDDEN             = 403,
     HTTP_NOT_FOUND             = 404,
     HTTP_BAD_METHOD            = 405,
+    HTTP_RANGE_NOT_SATISFIABLE = 416,
     HTTP_INTERNAL_SERVER_ERROR = 500,
     HTTP_SERVICE_UNAVAILABLE   = 503,
 };
@@ -82,6 +87,54 @@ UniValue JSONRPCReplyObj(const UniValue& result, const UniValue& error, const Un
 std::string JSONRPCReply(const UniValue& result, const UniValue& error, const UniValue& id);
 UniValue JSONRPCError(int code, const std::string& message);
 
+//! Size of the chunks a streamed JSON document is handed out in
+static const size_t DEFAULT_JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Writes a JSON document token by token and hands the output to a sink in
+ * chunks of about nChunkSize bytes, so that large RPC results need not be
+ * held in memory as a whole, neither as UniValue tree nor as string.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> SinkFn;
+
+private:
+    SinkFn sink;
+    size_t nChunkSize;
+    std::string strBuffer;
+    //! For every open object or array, whether it has no members yet
+    std::vector<bool> vEmpty;
+    bool fAfterKey;
+    size_t nFlushed;
+
+    void Separate();
+    void Write(const std::string& str);
+
+public:
+    CJSONStreamWriter(const SinkFn& sinkIn, size_t nChunkSizeIn = DEFAULT_JSON_STREAM_CHUNK_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+    //! Start a member of the current object, its value is written next
+    void Key(const std::string& key);
+    //! Write a complete value, an array element or the value of the last key
+    void Value(const UniValue& value);
+    void KeyValue(const std::string& key, const UniValue& value) { Key(key); Value(value); }
+
+    //! Hand the buffered output to the sink
+    void Flush();
+    //! Whether any output was handed to the sink already
+    bool Flushed() const { return nFlushed > 0; }
+    //! Size of the output so far
+    size_t GetSize() const { return nFlushed + strBuffer.size(); }
+    //! Output that was not handed to the sink yet
+    const std::string& GetBuffer() const { return strBuffer; }
+};
+
 /** Get name of RPC authentication cookie file */
 boost::filesystem::path GetAuthCookieFile();
 /** Generate a new RPC authentication cookie and write it to disk */
@@ -21,6 +21,7 @@
 #include "script/script_error.h"
 #include "script/sign.h"
 #include "script/standard.h"
+#include "streams.h"
 #include "txmempool.h"
 #include "uint256.h"
 #include "utilstrencodings.h"
@@ -232,6 +233,22 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
     return result;
 }
 
+/** Params: uint256 txid. Result: uint256 hash of the block (null for mempool transactions) and the transaction */
+void getrawtransaction_bin(CDataStream& params, CDataStream& result)
+{
+    uint256 hash;
+    params >> hash;
+
+    CTransaction tx;
+    uint256 hashBlock;
+    {
+        LOCK(cs_main);
+        if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
+    }
+    result << hashBlock << tx;
+}
+
 UniValue gettxoutproof(const UniValue& params, bool fHelp)
 {
     if (fHelp || (params.size() != 1 && params.size() != 2))
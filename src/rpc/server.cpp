@@ -9,10 +9,15 @@
 #include "base58.h"
 #include "init.h"
 #include "random.h"
+#include "streams.h"
 #include "sync.h"
 #include "ui_interface.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "utiltime.h"
+
+#include <atomic>
+#include <deque>
 
 #include <univalue.h>
 
@@ -39,6 +44,13 @@ static std::vector<RPCTimerInterface*> timerInterfaces;
  * @note Can be changed to std::unique_ptr when C++11 */
 static std::map<std::string, boost::shared_ptr<RPCTimerBase> > deadlineTimers;
 
+/* Batch statistics, see getrpcbatchinfo */
+static CCriticalSection cs_rpcBatchStats;
+static uint64_t nBatches = 0;
+static uint64_t nBatchEntries = 0;
+static uint64_t nBatchesParallel = 0;
+static std::deque<int64_t> vBatchMicros;
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -261,6 +273,7 @@ static const CRPCCommand vRPCCommands[] =
     { "control",            "debug",                  &debug,                  true  },
     { "control",            "help",                   &help,                   true  },
     { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getrpcbatchinfo",        &getrpcbatchinfo,        true  },
 
     /* P2P networking */
     { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
@@ -293,6 +306,11 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
+    { "blockchain",         "loadtxoutset",           &loadtxoutset,           false },
+    { "blockchain",         "getcoinscacheinfo",      &getcoinscacheinfo,      true  },
+    { "blockchain",         "getdbinfo",              &getdbinfo,              true  },
+    { "blockchain",         "compactdb",              &compactdb,              true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
     { "blockchain",         "getspentinfo",           &getspentinfo,           false },
 
@@ -352,6 +370,7 @@ static const CRPCCommand vRPCCommands[] =
     { "dash",               "getsuperblockbudget",    &getsuperblockbudget,    true  },
     { "dash",               "voteraw",                &voteraw,                true  },
     { "dash",               "mnsync",                 &mnsync,                 true  },
+    { "dash",               "getmaintenanceinfo",     &getmaintenanceinfo,     true  },
     { "dash",               "spork",                  &spork,                  true  },
     { "dash",               "getpoolinfo",            &getpoolinfo,            true  },
     { "dash",               "sentinelping",           &sentinelping,           true  },
@@ -407,6 +426,65 @@ static const CRPCCommand vRPCCommands[] =
 #endif // ENABLE_WALLET
 };
 
+/** Commands with large results that can be written out while they are produced */
+static const CRPCStreamCommand vRPCStreamCommands[] =
+{ //  name                      actor (function)
+  //  ------------------------  -----------------------
+    { "getaddressdeltas",       &getaddressdeltas_stream },
+    { "getblock",               &getblock_stream         },
+    { "getrawmempool",          &getrawmempool_stream    },
+};
+
+static const CRPCBinaryCommand vRPCBinaryCommands[] =
+{ //  name                      actor (function)
+  //  ------------------------  -----------------------
+    { "getaddressbalance",      &getaddressbalance_bin   },
+    { "getaddressutxos",        &getaddressutxos_bin     },
+    { "getblock",               &getblock_bin            },
+    { "getrawtransaction",      &getrawtransaction_bin   },
+    { "gettxout",               &gettxout_bin            },
+};
+
+/**
+ * Methods outside of RPC_CLASS_CHAIN. Methods of the "wallet" category are
+ * RPC_CLASS_WALLET unless listed here.
+ */
+static const struct {
+    const char* name;
+    RPCMethodClass methodClass;
+} vRPCMethodClasses[] =
+{ //  name                      class
+  //  ------------------------  ----------------
+    { "getbestblockhash",       RPC_CLASS_FAST   },
+    { "getblockcount",          RPC_CLASS_FAST   },
+    { "getmaintenanceinfo",     RPC_CLASS_FAST   },
+    { "dumptxoutset",           RPC_CLASS_HEAVY  },
+    { "getaddressdeltas",       RPC_CLASS_HEAVY  },
+    { "getaddresstxids",        RPC_CLASS_HEAVY  },
+    { "getaddressutxos",        RPC_CLASS_HEAVY  },
+    { "getblockhashes",         RPC_CLASS_HEAVY  },
+    { "getchaintips",           RPC_CLASS_HEAVY  },
+    { "gettxoutsetinfo",        RPC_CLASS_HEAVY  },
+    { "gobject",                RPC_CLASS_HEAVY  },
+    { "loadtxoutset",           RPC_CLASS_HEAVY  },
+    { "masternodelist",         RPC_CLASS_HEAVY  },
+    { "verifychain",            RPC_CLASS_HEAVY  },
+};
+
+/**
+ * Methods with effects later entries of a batch may depend on, like a
+ * sendrawtransaction of a parent and a child. Batches with any of these or a
+ * RPC_CLASS_WALLET method are executed one entry after the other.
+ */
+static const char* vRPCOrderedMethods[] =
+{
+    "addnode", "clearbanned", "compactdb", "debug", "disconnectnode", "generate",
+    "gobject", "invalidateblock", "loadtxoutset", "masternode", "masternodebroadcast", "mnsync",
+    "prioritisetransaction", "privatesend", "reconsiderblock", "resendwallettransactions",
+    "sendrawtransaction", "sentinelping", "setban", "setgenerate", "setmocktime",
+    "setnetworkactive", "spork", "stop", "submitblock", "voteraw",
+};
+
 CRPCTable::CRPCTable()
 {
     unsigned int vcidx;
@@ -417,6 +495,30 @@ CRPCTable::CRPCTable()
         pcmd = &vRPCCommands[vcidx];
         mapCommands[pcmd->name] = pcmd;
     }
+    for (vcidx = 0; vcidx < (sizeof(vRPCStreamCommands) / sizeof(vRPCStreamCommands[0])); vcidx++)
+    {
+        const CRPCStreamCommand *pcmd = &vRPCStreamCommands[vcidx];
+        assert(mapCommands.count(pcmd->name));
+        mapStreamCommands[pcmd->name] = pcmd;
+    }
+    for (vcidx = 0; vcidx < (sizeof(vRPCBinaryCommands) / sizeof(vRPCBinaryCommands[0])); vcidx++)
+    {
+        const CRPCBinaryCommand *pcmd = &vRPCBinaryCommands[vcidx];
+        assert(mapCommands.count(pcmd->name));
+        mapBinaryCommands[pcmd->name] = pcmd;
+    }
+    for (std::map<std::string, const CRPCCommand*>::const_iterator it = mapCommands.begin(); it != mapCommands.end(); ++it)
+    {
+        if (it->second->category == "wallet")
+            mapMethodClasses[it->first] = RPC_CLASS_WALLET;
+    }
+    for (vcidx = 0; vcidx < (sizeof(vRPCMethodClasses) / sizeof(vRPCMethodClasses[0])); vcidx++)
+    {
+        // Methods of optional modules may be missing from mapCommands
+        mapMethodClasses[vRPCMethodClasses[vcidx].name] = vRPCMethodClasses[vcidx].methodClass;
+    }
+    for (vcidx = 0; vcidx < (sizeof(vRPCOrderedMethods) / sizeof(vRPCOrderedMethods[0])); vcidx++)
+        setOrderedMethods.insert(vRPCOrderedMethods[vcidx]);
 }
 
 const CRPCCommand *CRPCTable::operator[](const std::string &name) const
@@ -427,6 +529,19 @@ const CRPCCommand *CRPCTable::operator[](const std::string &name) const
     return (*it).second;
 }
 
+RPCMethodClass CRPCTable::methodClass(const std::string &method) const
+{
+    std::map<std::string, RPCMethodClass>::const_iterator it = mapMethodClasses.find(method);
+    if (it == mapMethodClasses.end())
+        return RPC_CLASS_CHAIN;
+    return it->second;
+}
+
+bool CRPCTable::isOrdered(const std::string &method) const
+{
+    return methodClass(method) == RPC_CLASS_WALLET || setOrderedMethods.count(method);
+}
+
 bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
@@ -529,15 +644,135 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+/**
+ * Entries of a batch, claimed one by one by the thread handling the request
+ * and the helpers it started. A helper that starts late finds nothing left
+ * to claim, so it never touches the requests after the batch returned.
+ */
+class CRPCBatch
 {
+private:
+    const UniValue* pvReq;
+    std::vector<UniValue> vReplies;
+    std::atomic<size_t> nNext;
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    size_t nDone;
+
+public:
+    CRPCBatch(const UniValue& vReq) : pvReq(&vReq), vReplies(vReq.size()), nNext(0), nDone(0) {}
+
+    /** Execute entries until none is left to claim */
+    void Work()
+    {
+        while (true) {
+            size_t i = nNext++;
+            if (i >= vReplies.size())
+                return;
+            vReplies[i] = JSONRPCExecOne((*pvReq)[i]);
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (++nDone == vReplies.size())
+                cond.notify_all();
+        }
+    }
+
+    /** Wait for the entries claimed by helpers, call after Work */
+    void WaitDone()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (nDone < vReplies.size())
+            cond.wait(lock);
+    }
+
+    const std::vector<UniValue>& GetReplies() const { return vReplies; }
+};
+
+static bool IsBatchOrdered(const UniValue& vReq)
+{
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        if (!vReq[reqIdx].isObject())
+            continue;
+        const UniValue& method = find_value(vReq[reqIdx].get_obj(), "method");
+        if (method.isStr() && tableRPC.isOrdered(method.get_str()))
+            return true;
+    }
+    return false;
+}
+
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCTaskRunner& runner, int nParallel)
+{
+    int64_t nStart = GetTimeMicros();
+    boost::shared_ptr<CRPCBatch> batch(new CRPCBatch(vReq));
+    int nHelpers = 0;
+    if (runner && nParallel > 1 && vReq.size() > 1 && !IsBatchOrdered(vReq)) {
+        int nWanted = std::min((int64_t)nParallel, (int64_t)vReq.size()) - 1;
+        while (nHelpers < nWanted && runner(boost::bind(&CRPCBatch::Work, batch)))
+            nHelpers++;
+    }
+    batch->Work();
+    batch->WaitDone();
+
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    BOOST_FOREACH(const UniValue& reply, batch->GetReplies())
+        ret.push_back(reply);
 
+    int64_t nTime = GetTimeMicros() - nStart;
+    {
+        LOCK(cs_rpcBatchStats);
+        nBatches++;
+        nBatchEntries += vReq.size();
+        if (nHelpers > 0)
+            nBatchesParallel++;
+        vBatchMicros.push_back(nTime);
+        if (vBatchMicros.size() > RPC_BATCH_LATENCY_SAMPLES)
+            vBatchMicros.pop_front();
+    }
+    LogPrint("rpc", "Executed batch of %u requests on %d threads in %.2fms\n", vReq.size(), nHelpers + 1, 0.001 * nTime);
     return ret.write() + "\n";
 }
 
+UniValue getrpcbatchinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcbatchinfo\n"
+            "\nReturns statistics on the JSON-RPC batch requests executed since startup.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"batches\": n,             (numeric) Number of batches\n"
+            "  \"entries\": n,             (numeric) Number of requests in these batches\n"
+            "  \"parallel\": n,            (numeric) Number of batches whose entries ran on several threads\n"
+            "  \"latency_ms\": {          (json object) Time to execute a batch, over the last batches\n"
+            "    \"p50\": x.xxx,           (numeric) Median, in milliseconds\n"
+            "    \"p90\": x.xxx,           (numeric) 90th percentile, in milliseconds\n"
+            "    \"p99\": x.xxx,           (numeric) 99th percentile, in milliseconds\n"
+            "    \"max\": x.xxx            (numeric) Maximum, in milliseconds\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getrpcbatchinfo", "")
+            + HelpExampleRpc("getrpcbatchinfo", "")
+        );
+
+    std::vector<int64_t> vSorted;
+    UniValue ret(UniValue::VOBJ);
+    {
+        LOCK(cs_rpcBatchStats);
+        ret.push_back(Pair("batches", nBatches));
+        ret.push_back(Pair("entries", nBatchEntries));
+        ret.push_back(Pair("parallel", nBatchesParallel));
+        vSorted.assign(vBatchMicros.begin(), vBatchMicros.end());
+    }
+    std::sort(vSorted.begin(), vSorted.end());
+    UniValue latency(UniValue::VOBJ);
+    latency.push_back(Pair("p50", vSorted.empty() ? 0 : 0.001 * vSorted[(vSorted.size() - 1) * 50 / 100]));
+    latency.push_back(Pair("p90", vSorted.empty() ? 0 : 0.001 * vSorted[(vSorted.size() - 1) * 90 / 100]));
+    latency.push_back(Pair("p99", vSorted.empty() ? 0 : 0.001 * vSorted[(vSorted.size() - 1) * 99 / 100]));
+    latency.push_back(Pair("max", vSorted.empty() ? 0 : 0.001 * vSorted.back()));
+    ret.push_back(Pair("latency_ms", latency));
+    return ret;
+}
+
 UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
 {
     // Return immediately if in warmup
@@ -567,6 +802,82 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::canStream(const std::string &strMethod) const
+{
+    return mapStreamCommands.count(strMethod) > 0;
+}
+
+void CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStreamWriter &writer) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    // Find method
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    map<string, const CRPCStreamCommand*>::const_iterator it = mapStreamCommands.find(strMethod);
+    if (!pcmd || it == mapStreamCommands.end())
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        // Execute
+        it->second->actor(params, writer);
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+}
+
+bool CRPCTable::canExecuteBinary(const std::string &strMethod) const
+{
+    return mapBinaryCommands.count(strMethod) > 0;
+}
+
+void CRPCTable::executeBinary(const std::string &strMethod, CDataStream &params, CDataStream &result) const
+{
+    // Return immediately if in warmup
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    // Find method
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    map<string, const CRPCBinaryCommand*>::const_iterator it = mapBinaryCommands.find(strMethod);
+    if (!pcmd || it == mapBinaryCommands.end())
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        // Execute
+        it->second->actor(params, result);
+    }
+    catch (const std::ios_base::failure& e)
+    {
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, strprintf("Parameter decode failed: %s", e.what()));
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+    if (!params.empty())
+        throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Unexpected data after the parameters");
+
+    g_rpcSignals.PostCommand(*pcmd);
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
@@ -12,6 +12,7 @@
 
 #include <list>
 #include <map>
+#include <set>
 #include <stdint.h>
 #include <string>
 
@@ -19,6 +20,7 @@
 
 #include <univalue.h>
 
+class CDataStream;
 class CRPCCommand;
 
 namespace RPCServer
@@ -113,6 +115,14 @@ void RPCRunLater(const std::string& name, boost::function<void(void)> func, int6
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
 
+/** Runs a task on another thread, returns false if it can't be queued */
+typedef boost::function<bool(const boost::function<void()>&)> RPCTaskRunner;
+
+//! Entries of a batch executed at once, including the thread handling the request
+static const int DEFAULT_RPC_BATCH_PARALLEL = 4;
+//! Number of recent batches kept for the latency percentiles
+static const size_t RPC_BATCH_LATENCY_SAMPLES = 1000;
+
 class CRPCCommand
 {
 public:
@@ -122,6 +132,47 @@ public:
     bool okSafeMode;
 };
 
+/** Writes the result of a command into a CJSONStreamWriter instead of returning it */
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
+
+/**
+ * Alternative implementation of a CRPCCommand for large results, used when the
+ * result is sent to a client that accepts it in pieces.
+ */
+class CRPCStreamCommand
+{
+public:
+    std::string name;
+    rpcstreamfn_type actor;
+};
+
+/** Reads the parameters of a call from params and writes the result into result, both serialized */
+typedef void(*rpcbinfn_type)(CDataStream& params, CDataStream& result);
+
+/**
+ * Alternative implementation of a CRPCCommand that takes and returns
+ * serialized Dash types instead of JSON, used by the binary RPC transport.
+ */
+class CRPCBinaryCommand
+{
+public:
+    std::string name;
+    rpcbinfn_type actor;
+};
+
+/**
+ * Classes of RPC methods, each served by its own workers (see httprpc.cpp) so
+ * that slow methods can't hold up the cheap ones.
+ */
+enum RPCMethodClass
+{
+    RPC_CLASS_FAST,   //!< Lock-free reads of published state
+    RPC_CLASS_CHAIN,  //!< Everything else, typically short reads under cs_main
+    RPC_CLASS_WALLET, //!< Methods of the "wallet" category, serialized by cs_wallet
+    RPC_CLASS_HEAVY,  //!< Scans of the UTXO set, indexes or all masternodes/governance objects
+    RPC_CLASS_COUNT
+};
+
 /**
  * Dash RPC command dispatcher.
  */
@@ -129,6 +180,10 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, const CRPCStreamCommand*> mapStreamCommands;
+    std::map<std::string, RPCMethodClass> mapMethodClasses;
+    std::set<std::string> setOrderedMethods;
+    std::map<std::string, const CRPCBinaryCommand*> mapBinaryCommands;
 public:
     CRPCTable();
     const CRPCCommand* operator[](const std::string& name) const;
@@ -143,6 +198,32 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /** The class of a method, RPC_CLASS_CHAIN for unknown ones */
+    RPCMethodClass methodClass(const std::string &method) const;
+
+    /** Whether later entries of a batch may depend on the effects of the method */
+    bool isOrdered(const std::string &method) const;
+
+    /** Whether the method can write its result into a CJSONStreamWriter */
+    bool canStream(const std::string &method) const;
+
+    /**
+     * Execute a method, writing the result into writer.
+     * @throws an exception (UniValue) when an error happens, possibly after
+     * part of the result was written.
+     */
+    void executeStream(const std::string &method, const UniValue &params, CJSONStreamWriter &writer) const;
+
+    /** Whether the method takes and returns serialized data */
+    bool canExecuteBinary(const std::string &method) const;
+
+    /**
+     * Execute a method with serialized parameters, appending the serialized
+     * result to result.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    void executeBinary(const std::string &method, CDataStream &params, CDataStream &result) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -175,8 +256,11 @@ extern UniValue getconnectioncount(const UniValue& params, bool fHelp); // in rp
 extern UniValue getaddressmempool(const UniValue& params, bool fHelp);
 extern UniValue getaddressutxos(const UniValue& params, bool fHelp);
 extern UniValue getaddressdeltas(const UniValue& params, bool fHelp);
+extern void getaddressdeltas_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getaddresstxids(const UniValue& params, bool fHelp);
 extern UniValue getaddressbalance(const UniValue& params, bool fHelp);
+extern void getaddressutxos_bin(CDataStream& params, CDataStream& result);
+extern void getaddressbalance_bin(CDataStream& params, CDataStream& result);
 
 extern UniValue getpeerinfo(const UniValue& params, bool fHelp);
 extern UniValue ping(const UniValue& params, bool fHelp);
@@ -255,6 +339,7 @@ extern UniValue setmocktime(const UniValue& params, bool fHelp);
 extern UniValue resendwallettransactions(const UniValue& params, bool fHelp);
 
 extern UniValue getrawtransaction(const UniValue& params, bool fHelp); // in rpc/rawtransaction.cpp
+extern void getrawtransaction_bin(CDataStream& params, CDataStream& result);
 extern UniValue listunspent(const UniValue& params, bool fHelp);
 extern UniValue lockunspent(const UniValue& params, bool fHelp);
 extern UniValue listlockunspent(const UniValue& params, bool fHelp);
@@ -278,6 +363,7 @@ extern UniValue getgovernanceinfo(const UniValue& params, bool fHelp);
 extern UniValue getsuperblockbudget(const UniValue& params, bool fHelp);
 extern UniValue voteraw(const UniValue& params, bool fHelp);
 extern UniValue mnsync(const UniValue& params, bool fHelp);
+extern UniValue getmaintenanceinfo(const UniValue& params, bool fHelp);
 
 extern UniValue getblockcount(const UniValue& params, bool fHelp); // in rpc/blockchain.cpp
 extern UniValue getbestblockhash(const UniValue& params, bool fHelp);
@@ -285,23 +371,38 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockhashes(const UniValue& params, bool fHelp);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getblockheaders(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
+extern void getblock_stream(const UniValue& params, CJSONStreamWriter& writer);
+extern void getblock_bin(CDataStream& params, CDataStream& result);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
+extern UniValue dumptxoutset(const UniValue& params, bool fHelp);
+extern UniValue loadtxoutset(const UniValue& params, bool fHelp);
+extern UniValue getcoinscacheinfo(const UniValue& params, bool fHelp);
+extern UniValue getdbinfo(const UniValue& params, bool fHelp);
+extern UniValue compactdb(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
+extern void gettxout_bin(CDataStream& params, CDataStream& result);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
 extern UniValue invalidateblock(const UniValue& params, bool fHelp);
 extern UniValue reconsiderblock(const UniValue& params, bool fHelp);
 extern UniValue getspentinfo(const UniValue& params, bool fHelp);
 extern UniValue sentinelping(const UniValue& params, bool fHelp);
+extern UniValue getrpcbatchinfo(const UniValue& params, bool fHelp);
 
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
-std::string JSONRPCExecBatch(const UniValue& vReq);
+/**
+ * Execute a batch of requests. Unless one of them isOrdered, up to nParallel
+ * entries run at once: on the calling thread and on threads runner hands
+ * tasks to. The replies keep the order of the requests.
+ */
+std::string JSONRPCExecBatch(const UniValue& vReq, const RPCTaskRunner& runner = RPCTaskRunner(), int nParallel = 1);
 
 #endif // BITCOIN_RPCSERVER_H
@@ -9,6 +9,7 @@
 #include "uint256.h"
 #include "amount.h"
 #include "script/script.h"
+#include "compat/byteswap.h"
 
 struct CSpentIndexKey {
     uint256 txid;
@@ -200,6 +201,20 @@ struct CAddressUnspentKey {
     }
 };
 
+/**
+ * Orders unspent index entries the way the database does within an address.
+ * An output belongs to one address, so this is a total order across addresses.
+ */
+struct CAddressUnspentPositionCompare
+{
+    bool operator()(const CAddressUnspentKey& a, const CAddressUnspentKey& b) const {
+        if (a.txhash != b.txhash)
+            return a.txhash < b.txhash;
+        // the output index is stored little endian
+        return bswap_32((uint32_t)a.index) < bswap_32((uint32_t)b.index);
+    }
+};
+
 struct CAddressUnspentValue {
     CAmount satoshis;
     CScript script;
@@ -298,6 +313,27 @@ struct CAddressIndexKey {
 
 };
 
+/**
+ * Orders address index entries the way the database does within an address,
+ * i.e. by height and position in the block. Every input and output belongs to
+ * one address, so this is a total order across addresses.
+ */
+struct CAddressIndexPositionCompare
+{
+    bool operator()(const CAddressIndexKey& a, const CAddressIndexKey& b) const {
+        if (a.blockHeight != b.blockHeight)
+            return a.blockHeight < b.blockHeight;
+        if (a.txindex != b.txindex)
+            return a.txindex < b.txindex;
+        if (a.txhash != b.txhash)
+            return a.txhash < b.txhash;
+        // the input or output index is stored little endian
+        if (a.index != b.index)
+            return bswap_32((uint32_t)a.index) < bswap_32((uint32_t)b.index);
+        return a.spending < b.spending;
+    }
+};
+
 struct CAddressIndexIteratorKey {
     unsigned int type;
     uint160 hashBytes;
@@ -369,5 +405,39 @@ struct CAddressIndexIteratorHeightKey {
     }
 };
 
+struct CAddressSummary {
+    CAmount balance;
+    CAmount received;
+    uint64_t txCount;
+    int firstHeight;
+    int lastHeight;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(balance);
+        READWRITE(received);
+        READWRITE(VARINT(txCount));
+        READWRITE(firstHeight);
+        READWRITE(lastHeight);
+    }
+
+    CAddressSummary() {
+        SetNull();
+    }
+
+    void SetNull() {
+        balance = 0;
+        received = 0;
+        txCount = 0;
+        firstHeight = -1;
+        lastHeight = -1;
+    }
+
+    bool IsNull() const {
+        return txCount == 0;
+    }
+};
 
 #endif // BITCOIN_SPENTINDEX_H
@@ -341,6 +341,50 @@ public:
 
 
 
+/** Stream reading from memory it doesn't own, like a mapped file, without copying it first */
+class CSpanReader
+{
+private:
+    const char* pch;
+    const char* pchEnd;
+    int nType;
+    int nVersion;
+
+public:
+    CSpanReader(const char* pchIn, size_t nSizeIn, int nTypeIn, int nVersionIn) :
+        pch(pchIn), pchEnd(pchIn + nSizeIn), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const          { return nType; }
+    int GetVersion() const       { return nVersion; }
+    size_t size() const          { return pchEnd - pch; }
+    bool empty() const           { return pch == pchEnd; }
+
+    CSpanReader& read(char* pchOut, size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CSpanReader::read(): end of data");
+        memcpy(pchOut, pch, nSize);
+        pch += nSize;
+        return (*this);
+    }
+
+    CSpanReader& ignore(size_t nSize)
+    {
+        if (nSize > size())
+            throw std::ios_base::failure("CSpanReader::ignore(): end of data");
+        pch += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    CSpanReader& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
 /** Non-refcounted RAII wrapper for FILE*
  *
  * Will automatically close the file when it goes out of scope if not null.
@@ -0,0 +1,191 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+#define BITCOIN_SUPPORT_ALLOCATORS_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Arena for the single-object allocations of node based containers.
+ *
+ * Blocks are carved out of chunks which start small and double in size up to
+ * MAX_CHUNK_BYTES, so a container holding a handful of nodes does not pay for a
+ * big chunk. Freed blocks go onto a free list per size class and are reused by
+ * later allocations. Chunks are only returned to the system when the resource
+ * is destroyed, which makes ChunkBytes() the real memory footprint.
+ *
+ * Not thread-safe: a resource must only be used by one thread at a time.
+ */
+template <size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+class PoolResource
+{
+    static_assert(ALIGN_BYTES >= sizeof(void*), "ALIGN_BYTES must fit a free list pointer");
+    static_assert((ALIGN_BYTES & (ALIGN_BYTES - 1)) == 0, "ALIGN_BYTES must be a power of two");
+
+public:
+    static const size_t MIN_CHUNK_BYTES = 4096;
+    static const size_t MAX_CHUNK_BYTES = 1024 * 1024;
+
+private:
+    struct ListNode {
+        ListNode* next;
+    };
+
+    //! Free list for every multiple of ALIGN_BYTES up to MAX_BLOCK_SIZE_BYTES, indexed by size class
+    std::vector<ListNode*> vFreeLists;
+    std::vector<void*> vChunks;
+    char* pAvailableBegin;
+    char* pAvailableEnd;
+    size_t nNextChunkBytes;
+    size_t nChunkBytes;
+
+    static size_t SizeClass(size_t bytes)
+    {
+        return std::max<size_t>(1, (bytes + ALIGN_BYTES - 1) / ALIGN_BYTES);
+    }
+
+    void PushFree(void* p, size_t nClass)
+    {
+        ListNode* node = new (p) ListNode;
+        node->next = vFreeLists[nClass];
+        vFreeLists[nClass] = node;
+    }
+
+    void AllocateChunk()
+    {
+        // Don't waste the tail of the current chunk
+        size_t nRemaining = pAvailableEnd - pAvailableBegin;
+        if (nRemaining > 0)
+            PushFree(pAvailableBegin, nRemaining / ALIGN_BYTES);
+
+        void* pChunk = ::operator new(nNextChunkBytes);
+        vChunks.push_back(pChunk);
+        pAvailableBegin = static_cast<char*>(pChunk);
+        pAvailableEnd = pAvailableBegin + nNextChunkBytes;
+        nChunkBytes += nNextChunkBytes;
+        nNextChunkBytes = std::min(nNextChunkBytes * 2, (size_t)MAX_CHUNK_BYTES);
+    }
+
+public:
+    PoolResource() :
+        vFreeLists(SizeClass(MAX_BLOCK_SIZE_BYTES) + 1, NULL),
+        pAvailableBegin(NULL),
+        pAvailableEnd(NULL),
+        nNextChunkBytes(MIN_CHUNK_BYTES),
+        nChunkBytes(0)
+    {
+    }
+
+    ~PoolResource()
+    {
+        for (std::vector<void*>::iterator it = vChunks.begin(); it != vChunks.end(); ++it)
+            ::operator delete(*it);
+    }
+
+    static bool IsPooled(size_t bytes, size_t alignment)
+    {
+        return bytes <= MAX_BLOCK_SIZE_BYTES && alignment <= ALIGN_BYTES;
+    }
+
+    void* Allocate(size_t bytes, size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment))
+            return ::operator new(bytes);
+
+        const size_t nClass = SizeClass(bytes);
+        if (vFreeLists[nClass] != NULL) {
+            ListNode* node = vFreeLists[nClass];
+            vFreeLists[nClass] = node->next;
+            return node;
+        }
+        const size_t nRounded = nClass * ALIGN_BYTES;
+        if ((size_t)(pAvailableEnd - pAvailableBegin) < nRounded)
+            AllocateChunk();
+        void* p = pAvailableBegin;
+        pAvailableBegin += nRounded;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t bytes, size_t alignment)
+    {
+        if (!IsPooled(bytes, alignment)) {
+            ::operator delete(p);
+            return;
+        }
+        PushFree(p, SizeClass(bytes));
+    }
+
+    //! Memory obtained from the system, including blocks sitting on the free lists
+    size_t ChunkBytes() const { return nChunkBytes; }
+
+private:
+    PoolResource(const PoolResource&);
+    PoolResource& operator=(const PoolResource&);
+};
+
+/**
+ * Allocator serving single objects from a PoolResource and everything else
+ * (e.g. the bucket array of an unordered_map) from the global heap.
+ *
+ * A default constructed allocator creates its own resource, copies and rebinds
+ * share it. The resource moves together with the container on move and swap,
+ * so handing a whole container to another thread is safe as long as no other
+ * container still shares the resource.
+ */
+template <class T, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES = sizeof(void*)>
+struct pool_allocator
+{
+    typedef PoolResource<MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> resource_type;
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    std::shared_ptr<resource_type> resource;
+
+    pool_allocator() : resource(std::make_shared<resource_type>()) {}
+    template <typename U>
+    pool_allocator(const pool_allocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& other) : resource(other.resource) {}
+
+    template <typename U>
+    struct rebind {
+        typedef pool_allocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES> other;
+    };
+
+    T* allocate(size_t n)
+    {
+        if (n != 1)
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(resource->Allocate(sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (n != 1) {
+            ::operator delete(p);
+            return;
+        }
+        resource->Deallocate(p, sizeof(T), alignof(T));
+    }
+};
+
+template <class T, class U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator==(const pool_allocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const pool_allocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return a.resource == b.resource;
+}
+
+template <class T, class U, size_t MAX_BLOCK_SIZE_BYTES, size_t ALIGN_BYTES>
+bool operator!=(const pool_allocator<T, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& a, const pool_allocator<U, MAX_BLOCK_SIZE_BYTES, ALIGN_BYTES>& b)
+{
+    return !(a == b);
+}
+
+#endif // BITCOIN_SUPPORT_ALLOCATORS_POOL_H
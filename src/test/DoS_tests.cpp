@@ -8,6 +8,7 @@
 #include "keystore.h"
 #include "net.h"
 #include "net_processing.h"
+#include "orphanpool.h"
 #include "pow.h"
 #include "script/sign.h"
 #include "serialize.h"
@@ -22,17 +23,6 @@
 #include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
 
-// Tests this internal-to-main.cpp method:
-extern bool AddOrphanTx(const CTransaction& tx, NodeId peer);
-extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
-struct COrphanTx {
-    CTransaction tx;
-    NodeId fromPeer;
-};
-extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
-
 CService ip(uint32_t i)
 {
     struct in_addr s;
@@ -125,13 +115,12 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     BOOST_CHECK(!connman->IsBanned(addr));
 }
 
-CTransaction RandomOrphan()
+CTransaction RandomOrphan(const COrphanPool& pool, const std::vector<uint256>& vHashes)
 {
-    std::map<uint256, COrphanTx>::iterator it;
-    it = mapOrphanTransactions.lower_bound(GetRandHash());
-    if (it == mapOrphanTransactions.end())
-        it = mapOrphanTransactions.begin();
-    return it->second.tx;
+    CTransaction tx;
+    NodeId peer;
+    BOOST_CHECK(pool.GetTx(vHashes[GetRand(vHashes.size())], tx, peer));
+    return tx;
 }
 
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
@@ -141,6 +130,10 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     CBasicKeyStore keystore;
     keystore.AddKey(key);
 
+    COrphanPool pool;
+    std::vector<uint256> vHashes;
+    int64_t nNow = GetTime();
+
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++)
     {
@@ -153,13 +146,14 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].nValue = 1*CENT;
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
 
-        AddOrphanTx(tx, i);
+        BOOST_CHECK(pool.AddTx(tx, i, nNow));
+        vHashes.push_back(tx.GetHash());
     }
 
     // ... and 50 that depend on other orphans:
     for (int i = 0; i < 50; i++)
     {
-        CTransaction txPrev = RandomOrphan();
+        CTransaction txPrev = RandomOrphan(pool, vHashes);
 
         CMutableTransaction tx;
         tx.vin.resize(1);
@@ -170,13 +164,15 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         tx.vout[0].scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
         SignSignature(keystore, txPrev, tx, 0);
 
-        AddOrphanTx(tx, i);
+        // picking the same parent twice makes the same transaction
+        BOOST_CHECK(pool.AddTx(tx, i, nNow) || pool.HaveTx(tx.GetHash()));
+        vHashes.push_back(tx.GetHash());
     }
 
     // This really-big orphan should be ignored:
     for (int i = 0; i < 10; i++)
     {
-        CTransaction txPrev = RandomOrphan();
+        CTransaction txPrev = RandomOrphan(pool, vHashes);
 
         CMutableTransaction tx;
         tx.vout.resize(1);
@@ -194,25 +190,29 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
         for (unsigned int j = 1; j < tx.vin.size(); j++)
             tx.vin[j].scriptSig = tx.vin[0].scriptSig;
 
-        BOOST_CHECK(!AddOrphanTx(tx, i));
+        BOOST_CHECK(!pool.AddTx(tx, i, nNow));
     }
 
-    // Test EraseOrphansFor:
+    // Test RemoveForPeer:
     for (NodeId i = 0; i < 3; i++)
     {
-        size_t sizeBefore = mapOrphanTransactions.size();
-        EraseOrphansFor(i);
-        BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        size_t sizeBefore = pool.Size();
+        pool.RemoveForPeer(i);
+        BOOST_CHECK(pool.Size() < sizeBefore);
     }
 
-    // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
-    BOOST_CHECK(mapOrphanTransactions.empty());
-    BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    // Test LimitOrphans() function:
+    pool.LimitOrphans(40);
+    BOOST_CHECK(pool.Size() <= 40);
+    pool.LimitOrphans(10);
+    BOOST_CHECK(pool.Size() <= 10);
+    pool.LimitOrphans(0);
+    BOOST_CHECK(pool.Size() == 0);
+
+    COrphanPoolStats stats;
+    pool.GetStats(stats);
+    BOOST_CHECK(stats.nUsage == 0);
+    BOOST_CHECK(stats.nPeers == 0);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,9 +4,12 @@
 
 #include "util.h"
 
+#include "support/allocators/pool.h"
 #include "support/allocators/secure.h"
 #include "test/test_dash.h"
 
+#include <unordered_map>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_FIXTURE_TEST_SUITE(allocator_tests, BasicTestingSetup)
@@ -117,4 +120,62 @@ BOOST_AUTO_TEST_CASE(test_LockedPageManagerBase)
     BOOST_CHECK((last_unlock_len & (test_page_size-1)) == 0); // always unlock entire pages
 }
 
+BOOST_AUTO_TEST_CASE(pool_resource_reuse)
+{
+    typedef PoolResource<64, 8> Resource;
+    Resource resource;
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), 0U);
+
+    void* a = resource.Allocate(24, 8);
+    void* b = resource.Allocate(24, 8);
+    BOOST_CHECK(a != b);
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), (size_t)Resource::MIN_CHUNK_BYTES);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(a) % 8, 0U);
+
+    // freed blocks are handed out again for the same size class only
+    resource.Deallocate(a, 24, 8);
+    void* c = resource.Allocate(40, 8);
+    BOOST_CHECK(c != a);
+    void* d = resource.Allocate(20, 8);
+    BOOST_CHECK(d == a);
+
+    // too big to pool
+    BOOST_CHECK(!Resource::IsPooled(65, 8));
+    void* e = resource.Allocate(1000, 8);
+    resource.Deallocate(e, 1000, 8);
+    BOOST_CHECK_EQUAL(resource.ChunkBytes(), (size_t)Resource::MIN_CHUNK_BYTES);
+
+    resource.Deallocate(b, 24, 8);
+    resource.Deallocate(c, 40, 8);
+    resource.Deallocate(d, 20, 8);
+}
+
+BOOST_AUTO_TEST_CASE(pool_allocator_map)
+{
+    typedef pool_allocator<std::pair<const int, int>, 64> Alloc;
+    typedef std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, Alloc> Map;
+
+    Map m;
+    for (int i = 0; i < 10000; i++)
+        m[i] = i;
+    size_t nChunkBytes = m.get_allocator().resource->ChunkBytes();
+    BOOST_CHECK(nChunkBytes > 0);
+
+    // erased nodes are recycled instead of growing the pool
+    m.clear();
+    for (int i = 0; i < 10000; i++)
+        m[i] = -i;
+    BOOST_CHECK_EQUAL(m.get_allocator().resource->ChunkBytes(), nChunkBytes);
+    BOOST_CHECK_EQUAL(m[42], -42);
+
+    // swapping moves the pool along with the nodes
+    Map other;
+    Alloc allocOld = m.get_allocator();
+    other.swap(m);
+    BOOST_CHECK(other.get_allocator() == allocOld);
+    BOOST_CHECK(m.get_allocator() != allocOld);
+    BOOST_CHECK_EQUAL(other.size(), 10000U);
+    BOOST_CHECK(m.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,148 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "hash.h"
+#include "random.h"
+#include "streams.h"
+#include "version.h"
+#include "test/test_dash.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct BlockCacheSetup : public BasicTestingSetup
+{
+    ~BlockCacheSetup()
+    {
+        recentBlocks.SetMaxUsage(0);
+    }
+};
+
+static CBlock MakeBlock(int nTxs)
+{
+    CBlock block;
+    block.nNonce = GetRand(1 << 30);
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(tx);
+    }
+    return block;
+}
+
+/** An index entry for block, without block data on disk */
+struct CTestIndex
+{
+    uint256 hash;
+    CBlockIndex index;
+
+    explicit CTestIndex(const CBlock& block) : hash(block.GetHash()), index(block)
+    {
+        index.phashBlock = &hash;
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(blockcache_tests, BlockCacheSetup)
+
+BOOST_AUTO_TEST_CASE(blockcache_message)
+{
+    CBlock block = MakeBlock(5);
+    CBlock blockCopy(block);
+    CServedBlock served(std::move(blockCopy), block.GetHash(), true);
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    BOOST_CHECK_EQUAL(served.GetSerializedSize(), ss.size());
+    BOOST_CHECK(std::equal(ss.begin(), ss.end(), served.GetSerialized()));
+
+    // the same payload for a block which isn't cached
+    CBlock blockOnce(block);
+    CServedBlock servedOnce(std::move(blockOnce), block.GetHash(), false);
+    BOOST_CHECK_EQUAL(servedOnce.GetSerializedSize(), ss.size());
+    BOOST_CHECK(std::equal(ss.begin(), ss.end(), servedOnce.GetSerialized()));
+
+    // the header as CConnman would set it
+    const CSerializeData& vMessage = served.GetMessage();
+    CDataStream ssHeader(&vMessage[0], &vMessage[CMessageHeader::HEADER_SIZE], SER_NETWORK, PROTOCOL_VERSION);
+    CMessageHeader header(Params().MessageStart());
+    ssHeader >> header;
+    BOOST_CHECK(header.IsValid(Params().MessageStart()));
+    BOOST_CHECK_EQUAL(header.GetCommand(), NetMsgType::BLOCK);
+    BOOST_CHECK_EQUAL(header.nMessageSize, ss.size());
+    uint256 hashData = Hash(ss.begin(), ss.end());
+    BOOST_CHECK(memcmp(header.pchChecksum, hashData.begin(), CMessageHeader::CHECKSUM_SIZE) == 0);
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_get)
+{
+    CBlock block = MakeBlock(5);
+    CTestIndex index(block);
+
+    // disabled by default, and the block isn't on disk
+    recentBlocks.Add(block);
+    BOOST_CHECK(!recentBlocks.GetOrRead(&index.index, Params().GetConsensus()));
+    CRecentBlockCacheStats stats = recentBlocks.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 0U);
+    uint64_t nHits = stats.nHits, nMisses = stats.nMisses;
+    BOOST_CHECK(nMisses > 0);
+
+    recentBlocks.SetMaxUsage(1 << 20);
+    recentBlocks.Add(block);
+    recentBlocks.Add(block);
+    std::shared_ptr<const CServedBlock> pblock = recentBlocks.GetOrRead(&index.index, Params().GetConsensus());
+    BOOST_REQUIRE(pblock);
+    BOOST_CHECK(pblock->hash == index.hash);
+    BOOST_CHECK_EQUAL(pblock->block.vtx.size(), 5U);
+    BOOST_CHECK(recentBlocks.GetOrRead(&index.index, Params().GetConsensus()) == pblock);
+
+    stats = recentBlocks.GetStats();
+    BOOST_CHECK_EQUAL(stats.nBlocks, 1U);
+    BOOST_CHECK_EQUAL(stats.nHits, nHits + 2);
+    BOOST_CHECK_EQUAL(stats.nMisses, nMisses);
+    BOOST_CHECK(stats.nUsage > ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+
+    // served blocks stay valid after they are dropped
+    recentBlocks.Clear();
+    BOOST_CHECK_EQUAL(recentBlocks.GetStats().nUsage, 0U);
+    BOOST_CHECK(pblock->GetSerializedSize() == ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_evict)
+{
+    std::vector<CBlock> vBlocks;
+    for (int i = 0; i < 3; i++)
+        vBlocks.push_back(MakeBlock(20));
+
+    // room for two of the blocks
+    recentBlocks.SetMaxUsage(1 << 20);
+    recentBlocks.Add(vBlocks[0]);
+    size_t nBlockUsage = recentBlocks.GetStats().nUsage;
+    recentBlocks.Clear();
+    recentBlocks.SetMaxUsage(nBlockUsage * 5 / 2);
+
+    CTestIndex index0(vBlocks[0]), index1(vBlocks[1]), index2(vBlocks[2]);
+    recentBlocks.Add(vBlocks[0]);
+    recentBlocks.Add(vBlocks[1]);
+    // the first block was served last, the second one is dropped
+    BOOST_CHECK(recentBlocks.GetOrRead(&index0.index, Params().GetConsensus()));
+    recentBlocks.Add(vBlocks[2]);
+    BOOST_CHECK_EQUAL(recentBlocks.GetStats().nBlocks, 2U);
+    BOOST_CHECK(recentBlocks.GetOrRead(&index0.index, Params().GetConsensus()));
+    BOOST_CHECK(!recentBlocks.GetOrRead(&index1.index, Params().GetConsensus()));
+    BOOST_CHECK(recentBlocks.GetOrRead(&index2.index, Params().GetConsensus()));
+
+    // blocks over the budget aren't cached
+    recentBlocks.Clear();
+    recentBlocks.SetMaxUsage(nBlockUsage / 2);
+    recentBlocks.Add(vBlocks[0]);
+    BOOST_CHECK_EQUAL(recentBlocks.GetStats().nBlocks, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,167 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/merkle.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "net.h"
+#include "net_processing.h"
+#include "pow.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "test/test_dash.h"
+
+#include <limits>
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockdownload_tests, TestingSetup)
+
+BOOST_AUTO_TEST_CASE(blockdownload_window)
+{
+    // Until enough blocks were received from a peer, the fixed limit applies
+    for (int i = 0; i < BLOCK_DOWNLOAD_MIN_SAMPLES; i++)
+        BOOST_CHECK_EQUAL(GetBlockDownloadWindow(i, 1000, 100000), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // Afterwards the window covers the round trip plus BLOCK_DOWNLOAD_BUFFER_TIME
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(BLOCK_DOWNLOAD_MIN_SAMPLES, 100000, 0), BLOCK_DOWNLOAD_BUFFER_TIME / 100000 + 1);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(BLOCK_DOWNLOAD_MIN_SAMPLES, 100000, 1000000), (1000000 + BLOCK_DOWNLOAD_BUFFER_TIME) / 100000 + 1);
+    // No ping measured yet
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(BLOCK_DOWNLOAD_MIN_SAMPLES, 100000, std::numeric_limits<int64_t>::max()), BLOCK_DOWNLOAD_BUFFER_TIME / 100000 + 1);
+
+    // A fast peer is capped, a slow one still has a block queued behind the one it's sending
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(BLOCK_DOWNLOAD_MIN_SAMPLES, 1, 0), MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(BLOCK_DOWNLOAD_MIN_SAMPLES, 60 * 1000000, 0), MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+}
+
+//! A block with only a coinbase on top of pindexPrev
+static CBlock MakeBlock(const CBlockIndex* pindexPrev)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CBlock block;
+    block.nVersion = ComputeBlockVersion(pindexPrev, consensusParams);
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->GetBlockTime() + 1;
+    block.nBits = GetNextWorkRequired(pindexPrev, &block, consensusParams);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << (pindexPrev->nHeight + 1) << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    coinbase.vout[0].nValue = 0;
+    block.vtx.push_back(coinbase);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, consensusParams))
+        ++block.nNonce;
+    return block;
+}
+
+//! Have node receive a message, as the socket handler would pass it on
+template <typename T>
+static void ReceiveMessage(CNode& node, CConnman& connman, const char* pszCommand, const T& payload)
+{
+    CNetMessage msg(Params().MessageStart(), SER_NETWORK, PROTOCOL_VERSION);
+    msg.vRecv << payload;
+    msg.hdr = CMessageHeader(Params().MessageStart(), pszCommand, msg.vRecv.size());
+    uint256 hash = Hash(msg.vRecv.begin(), msg.vRecv.end());
+    memcpy(msg.hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+    msg.in_data = true;
+    msg.nDataPos = msg.vRecv.size();
+    {
+        LOCK(node.cs_vProcessMsg);
+        node.vProcessMsg.push_back(msg);
+        node.nProcessQueueSize += msg.vRecv.size() + CMessageHeader::HEADER_SIZE;
+    }
+    std::atomic<bool> interruptDummy(false);
+    ProcessMessages(&node, connman, interruptDummy);
+}
+
+static CAddress PeerAddress(uint32_t i)
+{
+    struct in_addr s;
+    s.s_addr = htonl(0x0a000000 | i);
+    return CAddress(CService(CNetAddr(s), Params().GetDefaultPort()), NODE_NONE);
+}
+
+static std::vector<int> GetHeightsInFlight(const CNode& node)
+{
+    CNodeStateStats stats;
+    BOOST_CHECK(GetNodeStateStats(node.GetId(), stats));
+    return stats.vHeightInFlight;
+}
+
+static int GetBlocksStalled(const CNode& node)
+{
+    CNodeStateStats stats;
+    BOOST_CHECK(GetNodeStateStats(node.GetId(), stats));
+    return stats.nBlocksStalled;
+}
+
+BOOST_FIXTURE_TEST_CASE(blockdownload_stalled_rerequest, TestChain100Setup)
+{
+    std::atomic<bool> interruptDummy(false);
+    int nTipHeight = chainActive.Height();
+
+    // Headers for a full download window and a bit more. Except for the first
+    // MAX_BLOCKS_IN_TRANSIT_PER_PEER ones, the blocks of the window are there,
+    // but can't be connected until the first ones arrive.
+    std::vector<CBlock> vBlocks;
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    for (unsigned int i = 0; i < BLOCK_DOWNLOAD_WINDOW + 10; i++) {
+        CBlock block = MakeBlock(pindexPrev);
+        CValidationState state;
+        BOOST_REQUIRE(ProcessNewBlockHeaders(std::vector<CBlockHeader>(1, block.GetBlockHeader()), state, Params(), &pindexPrev));
+        vBlocks.push_back(block);
+    }
+    for (unsigned int i = MAX_BLOCKS_IN_TRANSIT_PER_PEER; i < BLOCK_DOWNLOAD_WINDOW; i++)
+        BOOST_REQUIRE(ProcessNewBlock(Params(), &vBlocks[i], true, NULL, NULL));
+    BOOST_CHECK_EQUAL(chainActive.Height(), nTipHeight);
+
+    CNode staller(1001, NODE_NETWORK, 0, INVALID_SOCKET, PeerAddress(1), "", true);
+    CNode peer(1002, NODE_NETWORK, 0, INVALID_SOCKET, PeerAddress(2), "", true);
+    CNode* vNodes[] = {&staller, &peer};
+    BOOST_FOREACH(CNode* pnode, vNodes) {
+        pnode->SetSendVersion(PROTOCOL_VERSION);
+        GetNodeSignals().InitializeNode(pnode, *connman);
+        pnode->nVersion = PROTOCOL_VERSION;
+        pnode->fSuccessfullyConnected = true;
+        ReceiveMessage(*pnode, *connman, NetMsgType::INV, std::vector<CInv>(1, CInv(MSG_BLOCK, pindexPrev->GetBlockHash())));
+    }
+
+    // The first peer takes the start of the window
+    SendMessages(&staller, *connman, interruptDummy);
+    std::vector<int> vHeights = GetHeightsInFlight(staller);
+    BOOST_CHECK_EQUAL(vHeights.size(), (size_t)MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(vHeights.front(), nTipHeight + 1);
+
+    // The other can't fetch anything, the staller's blocks aren't overdue yet
+    SendMessages(&peer, *connman, interruptDummy);
+    BOOST_CHECK(GetHeightsInFlight(peer).empty());
+    BOOST_CHECK_EQUAL(GetBlocksStalled(staller), 0);
+
+    // Once they are, they're requested from the other peer as well, before the staller is disconnected
+    MilliSleep(BLOCK_STALLED_REREQUEST_MIN / 1000 + 100);
+    SendMessages(&peer, *connman, interruptDummy);
+    BOOST_CHECK(GetHeightsInFlight(peer) == vHeights);
+    BOOST_CHECK(GetHeightsInFlight(staller).empty());
+    BOOST_CHECK_EQUAL(GetBlocksStalled(staller), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK(!staller.fDisconnect);
+
+    // The blocks arriving complete the window
+    for (int i = 0; i < MAX_BLOCKS_IN_TRANSIT_PER_PEER; i++)
+        ReceiveMessage(peer, *connman, NetMsgType::BLOCK, vBlocks[i]);
+    BOOST_CHECK(GetHeightsInFlight(peer).empty());
+    BOOST_CHECK_EQUAL(chainActive.Height(), nTipHeight + (int)BLOCK_DOWNLOAD_WINDOW);
+
+    bool fUpdateConnectionTime = false;
+    GetNodeSignals().FinalizeNode(staller.GetId(), fUpdateConnectionTime);
+    GetNodeSignals().FinalizeNode(peer.GetId(), fUpdateConnectionTime);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilemap.h"
+
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "pow.h"
+#include "random.h"
+#include "validation.h"
+#include "test/test_dash.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+struct BlockFileMapSetup : public BasicTestingSetup
+{
+    boost::filesystem::path pathTemp;
+
+    BlockFileMapSetup() : BasicTestingSetup(CBaseChainParams::REGTEST)
+    {
+        pathTemp = GetTempPath() / strprintf("test_dash_blockfilemap_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+        boost::filesystem::create_directories(pathTemp);
+        mapArgs["-datadir"] = pathTemp.string();
+        ClearDatadirCache();
+    }
+
+    ~BlockFileMapSetup()
+    {
+        blockFileMaps.SetMaxFiles(0);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+        boost::filesystem::remove_all(pathTemp);
+    }
+};
+
+static CBlock MakeBlock(int nTxs)
+{
+    CBlock block;
+    for (int i = 0; i < nTxs; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        block.vtx.push_back(tx);
+    }
+    const Consensus::Params& params = Params().GetConsensus();
+    block.nBits = UintToArith256(params.powLimit).GetCompact();
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, params))
+        block.nNonce++;
+    return block;
+}
+
+/** Append block to the block file of pos, pos is set to where it was written */
+static void AppendBlock(const CBlock& block, CDiskBlockPos& pos)
+{
+    BOOST_REQUIRE(WriteBlockToDisk(block, pos, Params().MessageStart()));
+}
+
+BOOST_FIXTURE_TEST_SUITE(blockfilemap_tests, BlockFileMapSetup)
+
+BOOST_AUTO_TEST_CASE(blockfilemap_read)
+{
+    CBlock blockFirst = MakeBlock(10);
+    CDiskBlockPos posFirst(0, 0);
+    AppendBlock(blockFirst, posFirst);
+
+    // disabled by default
+    CBlockFileView view;
+    BOOST_CHECK(!blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, posFirst, 0, view));
+
+    blockFileMaps.SetMaxFiles(2);
+    BOOST_CHECK(blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, posFirst, 0, view));
+    BOOST_CHECK_EQUAL(view.nSize, ::GetSerializeSize(blockFirst, SER_DISK, CLIENT_VERSION));
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, posFirst, Params().GetConsensus()));
+    BOOST_CHECK(block.GetHash() == blockFirst.GetHash());
+    BOOST_CHECK_EQUAL(block.vtx.size(), 10U);
+
+    // a block written after the file was mapped
+    CBlock blockSecond = MakeBlock(3);
+    CDiskBlockPos posSecond(0, posFirst.nPos + view.nSize);
+    AppendBlock(blockSecond, posSecond);
+    BOOST_CHECK(ReadBlockFromDisk(block, posSecond, Params().GetConsensus()));
+    BOOST_CHECK(block.GetHash() == blockSecond.GetHash());
+    // views stay valid after the file was mapped again
+    CSpanReader reader(view.pch, view.nSize, SER_DISK, CLIENT_VERSION);
+    reader >> block;
+    BOOST_CHECK(block.GetHash() == blockFirst.GetHash());
+
+    // records past the end of the file aren't mapped
+    CDiskBlockPos posMissing(0, posSecond.nPos + 1000000);
+    BOOST_CHECK(!blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, posMissing, 0, view));
+    BOOST_CHECK(!blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, CDiskBlockPos(5, 8), 0, view));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilemap_lru)
+{
+    blockFileMaps.SetMaxFiles(2);
+    std::vector<CDiskBlockPos> vPos;
+    for (int nFile = 0; nFile < 3; nFile++) {
+        CDiskBlockPos pos(nFile, 0);
+        AppendBlock(MakeBlock(1), pos);
+        vPos.push_back(pos);
+        CBlock block;
+        BOOST_CHECK(ReadBlockFromDisk(block, pos, Params().GetConsensus()));
+    }
+    BOOST_CHECK_EQUAL(blockFileMaps.GetMappedFiles(), 2U);
+
+    blockFileMaps.Invalidate(2);
+    BOOST_CHECK_EQUAL(blockFileMaps.GetMappedFiles(), 1U);
+    blockFileMaps.SetMaxFiles(0);
+    BOOST_CHECK_EQUAL(blockFileMaps.GetMappedFiles(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,252 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/validation.h"
+#include "streams.h"
+#include "txdb.h"
+#include "utiltime.h"
+#include "validation.h"
+#include "test/test_dash.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockimport_tests, BasicTestingSetup)
+
+//! A header-only block, which the readers find, deserialize and fail to check
+static CBlock MakeImportBlock(uint32_t n)
+{
+    CBlock block;
+    block.nVersion = 1;
+    block.nTime = n;
+    block.nNonce = n;
+    return block;
+}
+
+/** Write blocks to a temporary file the way they are in block files, positioned at its start */
+static FILE* WriteImportFile(const std::vector<CBlock>& vBlocks)
+{
+    CAutoFile file(tmpfile(), SER_DISK, CLIENT_VERSION);
+    BOOST_FOREACH(const CBlock& block, vBlocks) {
+        unsigned int nSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        file << FLATDATA(Params().MessageStart()) << nSize << block;
+    }
+    rewind(file.Get());
+    return file.release();
+}
+
+/** Files of nBlocks blocks each, read by nThreads threads of an importer */
+struct ImportFiles
+{
+    std::vector<std::vector<CBlock> > vvBlocks;
+    std::vector<CImportFile> vFiles;
+    uint64_t nFileSize;
+
+    ImportFiles(int nFiles, int nBlocks) : nFileSize(0)
+    {
+        for (int i = 0; i < nFiles; i++) {
+            std::vector<CBlock> vBlocks;
+            for (int j = 0; j < nBlocks; j++)
+                vBlocks.push_back(MakeImportBlock(i * nBlocks + j + 1));
+            nFileSize = nBlocks * ::GetSerializeSize(vBlocks[0], SER_DISK, CLIENT_VERSION);
+            vFiles.push_back(CImportFile(WriteImportFile(vBlocks), -1, strprintf("import%d", i)));
+            vvBlocks.push_back(vBlocks);
+        }
+    }
+};
+
+static void StartReaders(CBlockImporter& importer, boost::thread_group& threads, int nThreads)
+{
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CBlockImporter::ThreadRead, &importer));
+}
+
+//! Pop the remaining blocks of file nIndex and check they are the next ones of vBlocks, starting at nFirst
+static void CheckPopFile(CBlockImporter& importer, size_t nIndex, const std::vector<CBlock>& vBlocks, size_t nFirst = 0)
+{
+    CImportBlock imported;
+    size_t i = nFirst;
+    while (importer.Pop(nIndex, imported)) {
+        BOOST_REQUIRE(i < vBlocks.size());
+        BOOST_CHECK(imported.hash == vBlocks[i].GetHash());
+        BOOST_CHECK_EQUAL(imported.nSize, ::GetSerializeSize(vBlocks[i], SER_DISK, CLIENT_VERSION));
+        i++;
+    }
+    BOOST_CHECK_EQUAL(i, vBlocks.size());
+}
+
+//! Wait up to 10s for the importer to hold nBuffered bytes
+static bool WaitForBuffered(CBlockImporter& importer, uint64_t nBuffered)
+{
+    for (int i = 0; i < 1000 && importer.GetBuffered() != nBuffered; i++)
+        MilliSleep(10);
+    return importer.GetBuffered() == nBuffered;
+}
+
+BOOST_AUTO_TEST_CASE(blockimport_file_order)
+{
+    ImportFiles files(4, 10);
+    CBlockImporter importer(Params(), files.vFiles);
+    boost::thread_group threads;
+    StartReaders(importer, threads, 3);
+
+    // whichever thread reads a file, its blocks come in file order
+    for (size_t i = 0; i < files.vFiles.size(); i++)
+        CheckPopFile(importer, i, files.vvBlocks[i]);
+    BOOST_CHECK_EQUAL(importer.GetBuffered(), 0U);
+
+    importer.Stop();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(blockimport_skip)
+{
+    ImportFiles files(2, 10);
+    CBlockImporter importer(Params(), files.vFiles);
+    boost::thread_group threads;
+    StartReaders(importer, threads, 2);
+
+    // as after an error accepting the first block
+    CImportBlock imported;
+    BOOST_CHECK(importer.Pop(0, imported));
+    importer.Skip(0);
+    BOOST_CHECK(!importer.Pop(0, imported));
+
+    // the next file is read in full
+    CheckPopFile(importer, 1, files.vvBlocks[1]);
+    BOOST_CHECK_EQUAL(importer.GetBuffered(), 0U);
+
+    importer.Stop();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(blockimport_buffer_limit)
+{
+    // no room to read ahead at all
+    ImportFiles files(3, 10);
+    CBlockImporter importer(Params(), files.vFiles, 1);
+    boost::thread_group threads;
+    StartReaders(importer, threads, 3);
+
+    // the file being accepted is read regardless, the others wait for their turn
+    BOOST_CHECK(WaitForBuffered(importer, files.nFileSize));
+    MilliSleep(100);
+    BOOST_CHECK_EQUAL(importer.GetBuffered(), files.nFileSize);
+
+    for (size_t i = 0; i < files.vFiles.size(); i++)
+        CheckPopFile(importer, i, files.vvBlocks[i]);
+    BOOST_CHECK_EQUAL(importer.GetBuffered(), 0U);
+    BOOST_CHECK(importer.GetReadWaitMicros() > 0);
+
+    importer.Stop();
+    threads.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(blockimport_stop)
+{
+    ImportFiles files(3, 10);
+    CBlockImporter importer(Params(), files.vFiles, 1);
+    boost::thread_group threads;
+    StartReaders(importer, threads, 3);
+
+    // readers waiting for room return when stopped, with their files not done
+    BOOST_CHECK(WaitForBuffered(importer, files.nFileSize));
+    importer.Stop();
+    threads.join_all();
+}
+
+//! The block index entries which the import is expected to reproduce
+static std::map<uint256, std::string> GetBlockIndexSummary()
+{
+    LOCK(cs_main);
+    std::map<uint256, std::string> mapSummary;
+    for (BlockMap::const_iterator it = mapBlockIndex.begin(); it != mapBlockIndex.end(); ++it) {
+        const CBlockIndex* pindex = it->second;
+        mapSummary[it->first] = strprintf("height=%d file=%d data=%u undo=%u status=%u chaintx=%u", pindex->nHeight,
+                                          pindex->nFile, pindex->nDataPos, pindex->nUndoPos, pindex->nStatus, pindex->nChainTx);
+    }
+    return mapSummary;
+}
+
+/** Start over with an empty block index and coins database, keeping the block files */
+static void ResetChainState()
+{
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+}
+
+static void ImportBlockFiles(const std::vector<CImportFile>& vFiles, int nThreads, uint64_t nMaxBuffered)
+{
+    ResetChainState();
+    int nImportThreadsSaved = nImportThreads;
+    nImportThreads = nThreads;
+    BOOST_CHECK(LoadExternalBlockFiles(Params(), vFiles, nMaxBuffered));
+    nImportThreads = nImportThreadsSaved;
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, Params()));
+}
+
+BOOST_FIXTURE_TEST_CASE(blockimport_reindex, TestChain100Setup)
+{
+    std::vector<CBlock> vBlocks;
+    for (int nHeight = 0; nHeight <= chainActive.Height(); nHeight++) {
+        CBlock block;
+        BOOST_REQUIRE(ReadBlockFromDisk(block, chainActive[nHeight], Params().GetConsensus()));
+        vBlocks.push_back(block);
+    }
+    uint256 hashTip = chainActive.Tip()->GetBlockHash();
+
+    // Three block files to reindex: the top of the chain first, then its start
+    // with every pair of blocks swapped, then the middle in reverse. Most
+    // blocks come before their parents, many in an earlier file.
+    std::vector<std::vector<int> > vvHeights(3);
+    for (int nHeight = 60; nHeight <= 100; nHeight++)
+        vvHeights[0].push_back(nHeight);
+    for (int nHeight = 0; nHeight < 30; nHeight++)
+        vvHeights[1].push_back(nHeight ^ 1);
+    for (int nHeight = 59; nHeight >= 30; nHeight--)
+        vvHeights[2].push_back(nHeight);
+
+    std::vector<CImportFile> vFiles;
+    for (size_t i = 0; i < vvHeights.size(); i++) {
+        int nFile = i + 1;
+        CDiskBlockPos pos(nFile, 0);
+        BOOST_FOREACH(int nHeight, vvHeights[i]) {
+            BOOST_REQUIRE(WriteBlockToDisk(vBlocks[nHeight], pos, Params().MessageStart()));
+            pos.nPos += ::GetSerializeSize(vBlocks[nHeight], SER_DISK, CLIENT_VERSION);
+        }
+        vFiles.push_back(CImportFile(NULL, nFile, GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk").string()));
+    }
+
+    // one reader thread with plenty of room to read ahead
+    ImportBlockFiles(vFiles, 1, MAX_IMPORT_BUFFER_SIZE);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+    std::map<uint256, std::string> mapSummary = GetBlockIndexSummary();
+    BOOST_CHECK_EQUAL(mapSummary.size(), vBlocks.size());
+
+    // several readers which mostly wait for the file being accepted end up with the same index
+    ImportBlockFiles(vFiles, 3, 1);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+    BOOST_CHECK(GetBlockIndexSummary() == mapSummary);
+
+    // interrupting the import stops the readers too
+    ResetChainState();
+    int nImportThreadsSaved = nImportThreads;
+    nImportThreads = 3;
+    boost::thread threadImport(boost::bind(&LoadExternalBlockFiles, boost::cref(Params()), boost::cref(vFiles), 1));
+    threadImport.interrupt();
+    threadImport.join();
+    nImportThreads = nImportThreadsSaved;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -9,6 +9,7 @@
 #include "undo.h"
 #include "utilstrencodings.h"
 #include "test/test_dash.h"
+#include "txdb.h"
 #include "validation.h"
 #include "consensus/validation.h"
 
@@ -35,6 +36,7 @@ class CCoinsViewTest : public CCoinsView
 {
     uint256 hashBestBlock_;
     std::map<COutPoint, Coin> map_;
+    CCoinsCommitment commitment_;
 
 public:
     bool GetCoin(const COutPoint& outpoint, Coin& coin) const override
@@ -53,7 +55,9 @@ public:
 
     uint256 GetBestBlock() const override { return hashBestBlock_; }
 
-    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock) override
+    const CCoinsCommitment& GetCommitment() const { return commitment_; }
+
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock, const CCoinsCommitment& commitmentDelta) override
     {
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
@@ -68,6 +72,7 @@ public:
         }
         if (!hashBlock.IsNull())
             hashBestBlock_ = hashBlock;
+        commitment_ += commitmentDelta;
         return true;
     }
 };
@@ -94,6 +99,22 @@ public:
     size_t& usage() { return cachedCoinsUsage; }
 };
 
+//! Check that the commitment of the base and the changes of the caches add up to the one of the coins
+void CheckCommitment(const CCoinsViewTest& base, const std::vector<CCoinsViewCacheTest*>& stack, const std::map<COutPoint, Coin>& result)
+{
+    CCoinsCommitment commitment = base.GetCommitment();
+    BOOST_FOREACH(const CCoinsViewCacheTest* cache, stack)
+        commitment += cache->GetCommitmentDelta();
+    CCoinsCommitment expected;
+    for (auto it = result.begin(); it != result.end(); it++) {
+        if (!it->second.IsSpent())
+            expected.Add(it->first, it->second);
+    }
+    BOOST_CHECK_EQUAL(commitment.nTransactionOutputs, expected.nTransactionOutputs);
+    BOOST_CHECK_EQUAL(commitment.nTotalAmount, expected.nTotalAmount);
+    BOOST_CHECK(commitment.GetHash() == expected.GetHash());
+}
+
 }
 
 BOOST_FIXTURE_TEST_SUITE(coins_tests, BasicTestingSetup)
@@ -206,6 +227,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
             BOOST_FOREACH(const CCoinsViewCacheTest *test, stack) {
                 test->SelfTest();
             }
+            CheckCommitment(base, stack, result);
         }
 
         if (insecure_rand() % 100 == 0) {
@@ -430,6 +452,7 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
                 BOOST_CHECK(have == !coin.IsSpent());
                 BOOST_CHECK(coin == it->second);
             }
+            CheckCommitment(base, stack, result);
         }
 
         // One every 10 iterations, remove a random entry from the cache
@@ -593,7 +616,7 @@ void WriteCoinsViewEntry(CCoinsView& view, CAmount value, char flags)
 {
     CCoinsMap map;
     InsertCoinsMapEntry(map, value, flags);
-    view.BatchWrite(map, {});
+    view.BatchWrite(map, {}, CCoinsCommitment());
 }
 
 class SingleEntryCacheTest
@@ -860,4 +883,169 @@ BOOST_AUTO_TEST_CASE(ccoins_write)
                     CheckWriteCoins(parent_value, child_value, parent_value, parent_flags, child_flags, parent_flags);
 }
 
+BOOST_AUTO_TEST_CASE(ccoins_cache_coin)
+{
+    CCoinsView base;
+    CCoinsViewCache cache(&base);
+    COutPoint outpoint(GetRandHash(), 0);
+    CTxOut txout;
+    txout.nValue = 5;
+    txout.scriptPubKey.assign(20, OP_TRUE);
+
+    // spent coins are never cached
+    BOOST_CHECK(!cache.CacheCoin(outpoint, Coin()));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+    size_t nUsage = cache.DynamicMemoryUsage();
+    BOOST_CHECK(cache.CacheCoin(outpoint, Coin(txout, 1, false)));
+    BOOST_CHECK(cache.HaveCoinInCache(outpoint));
+    BOOST_CHECK(cache.DynamicMemoryUsage() > nUsage);
+
+    // an entry that is already cached is left alone, even if it was spent
+    BOOST_CHECK(cache.SpendCoin(outpoint));
+    BOOST_CHECK(!cache.CacheCoin(outpoint, Coin(txout, 1, false)));
+    BOOST_CHECK(!cache.HaveCoin(outpoint));
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_background_flush)
+{
+    // CCoinsViewDB lives in the data directory even when kept in memory
+    boost::filesystem::path pathTemp = GetTempPath() / strprintf("test_dash_coinsflush_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+    {
+        CCoinsViewDB base(1 << 20, true, false, true);
+        CCoinsViewCache cache(&base);
+
+        std::vector<COutPoint> vOutpoints;
+        for (int i = 0; i < 1000; i++) {
+            COutPoint outpoint(GetRandHash(), i % 4);
+            CTxOut txout;
+            txout.nValue = i + 1;
+            txout.scriptPubKey.assign(i % 10 + 1, OP_TRUE);
+            cache.AddCoin(outpoint, Coin(txout, 1, false), false);
+            vOutpoints.push_back(outpoint);
+        }
+        uint256 hashBlock1 = GetRandHash();
+        cache.SetBestBlock(hashBlock1);
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+
+        // Whether or not the writer is done yet, the flushed state is visible
+        BOOST_CHECK(base.GetBestBlock() == hashBlock1);
+        for (size_t i = 0; i < vOutpoints.size(); i++) {
+            Coin coin;
+            BOOST_CHECK(base.GetCoin(vOutpoints[i], coin));
+            BOOST_CHECK_EQUAL(coin.out.nValue, (CAmount)(i + 1));
+        }
+
+        // Spend half of them in a second flush, which has to wait for the first one
+        for (size_t i = 0; i < vOutpoints.size(); i += 2)
+            BOOST_CHECK(cache.SpendCoin(vOutpoints[i]));
+        uint256 hashBlock2 = GetRandHash();
+        cache.SetBestBlock(hashBlock2);
+        BOOST_CHECK(cache.Flush());
+        for (size_t i = 0; i < vOutpoints.size(); i++)
+            BOOST_CHECK_EQUAL(base.HaveCoin(vOutpoints[i]), i % 2 == 1);
+
+        BOOST_CHECK(base.WaitForFlush());
+        BOOST_CHECK(base.GetBestBlock() == hashBlock2);
+        for (size_t i = 0; i < vOutpoints.size(); i++)
+            BOOST_CHECK_EQUAL(base.HaveCoin(vOutpoints[i]), i % 2 == 1);
+
+        CCoinsFlushStats stats;
+        base.GetFlushStats(stats);
+        BOOST_CHECK(stats.fBackground);
+        BOOST_CHECK(!stats.fInProgress);
+        BOOST_CHECK_EQUAL(stats.nFlushes, 2U);
+        BOOST_CHECK_EQUAL(stats.nFailures, 0U);
+        BOOST_CHECK(stats.write.nMax >= stats.write.nP50);
+    }
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    boost::filesystem::remove_all(pathTemp);
+}
+
+BOOST_AUTO_TEST_CASE(ccoins_db_commitment)
+{
+    boost::filesystem::path pathTemp = GetTempPath() / strprintf("test_dash_coinscommitment_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    boost::filesystem::create_directories(pathTemp);
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+
+    std::map<COutPoint, Coin> result;
+    CCoinsCommitment commitment;
+    {
+        // A new database commits to the empty set
+        CCoinsViewDB base(1 << 20, false, true, true);
+        BOOST_CHECK(base.GetCommitment(commitment));
+        BOOST_CHECK_EQUAL(commitment.nTransactionOutputs, 0);
+        BOOST_CHECK(commitment.GetHash() == CCoinsCommitment().GetHash());
+
+        CCoinsViewCache cache(&base);
+        for (int i = 0; i < 200; i++) {
+            COutPoint outpoint(GetRandHash(), i % 3);
+            CTxOut txout;
+            txout.nValue = i + 1;
+            txout.scriptPubKey.assign(i % 10 + 1, OP_TRUE);
+            cache.AddCoin(outpoint, Coin(txout, i, i % 7 == 0), false);
+            result[outpoint] = Coin(txout, i, i % 7 == 0);
+        }
+        cache.SetBestBlock(GetRandHash());
+        BOOST_CHECK(cache.Flush());
+
+        // Spent coins are taken out again, whether they were flushed or not
+        std::map<COutPoint, Coin>::iterator it = result.begin();
+        for (int i = 0; it != result.end(); i++) {
+            if (i % 3 == 0) {
+                BOOST_CHECK(cache.SpendCoin(it->first));
+                result.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        cache.SetBestBlock(GetRandHash());
+        BOOST_CHECK(cache.Flush());
+        BOOST_CHECK(base.WaitForFlush());
+        BOOST_CHECK(base.GetCommitment(commitment));
+    }
+    CCoinsCommitment expected;
+    for (auto it = result.begin(); it != result.end(); it++)
+        expected.Add(it->first, it->second);
+    BOOST_CHECK_EQUAL(commitment.nTransactionOutputs, (int64_t)result.size());
+    BOOST_CHECK_EQUAL(commitment.nTotalAmount, expected.nTotalAmount);
+    BOOST_CHECK(commitment.GetHash() == expected.GetHash());
+
+    {
+        // The commitment is kept with the coins
+        CCoinsViewDB base(1 << 20, false, false, false);
+        CCoinsCommitment commitmentRead;
+        BOOST_CHECK(base.GetCommitment(commitmentRead));
+        BOOST_CHECK(commitmentRead.GetHash() == expected.GetHash());
+
+        // Without the record, as after an older version wrote, it is computed from the coins
+        BOOST_CHECK(base.GetDBWrapper().Erase('M', true));
+    }
+    {
+        CCoinsViewDB base(1 << 20, false, false, false);
+        CCoinsCommitment commitmentRead;
+        BOOST_CHECK(!base.GetCommitment(commitmentRead));
+        BOOST_CHECK(base.ComputeCommitment());
+        BOOST_CHECK(base.GetCommitment(commitmentRead));
+        BOOST_CHECK_EQUAL(commitmentRead.nTransactionOutputs, (int64_t)result.size());
+        BOOST_CHECK(commitmentRead.GetHash() == expected.GetHash());
+    }
+    {
+        CCoinsViewDB base(1 << 20, false, false, false);
+        CCoinsCommitment commitmentRead;
+        BOOST_CHECK(base.GetCommitment(commitmentRead));
+        BOOST_CHECK(commitmentRead.GetHash() == expected.GetHash());
+    }
+
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    boost::filesystem::remove_all(pathTemp);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
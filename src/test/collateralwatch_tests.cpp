@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "collateralwatch.h"
+
+#include "chain.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "test/test_dash.h"
+
+#include <boost/test/unit_test.hpp>
+
+class CTestWatcher : public CCollateralWatcher
+{
+public:
+    std::vector<COutPoint> vSpent;
+    std::vector<COutPoint> vUnspent;
+
+    void CollateralSpent(const COutPoint& outpoint, const CTransaction& tx, const CBlockIndex* pindex) { vSpent.push_back(outpoint); }
+    void CollateralUnspent(const COutPoint& outpoint, const CBlockIndex* pindex) { vUnspent.push_back(outpoint); }
+};
+
+static CBlock BlockSpending(const std::vector<COutPoint>& vOutpoints)
+{
+    CBlock block;
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vout.resize(1);
+    block.vtx.push_back(coinbase);
+
+    CMutableTransaction tx;
+    for (size_t i = 0; i < vOutpoints.size(); i++)
+        tx.vin.push_back(CTxIn(vOutpoints[i]));
+    tx.vout.resize(1);
+    block.vtx.push_back(tx);
+    return block;
+}
+
+BOOST_FIXTURE_TEST_SUITE(collateralwatch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(collateralwatch_notify)
+{
+    CCollateralWatch watch;
+    CTestWatcher watcher1, watcher2;
+    CBlockIndex index;
+    uint256 hash = GetRandHash();
+    index.phashBlock = &hash;
+
+    COutPoint outpoint1(GetRandHash(), 0), outpoint2(GetRandHash(), 1), outpointOther(GetRandHash(), 0);
+    watch.Watch(outpoint1, &watcher1);
+    watch.Watch(outpoint1, &watcher1);
+    watch.Watch(outpoint2, &watcher1);
+    watch.Watch(outpoint2, &watcher2);
+    BOOST_CHECK_EQUAL(watch.size(), 3);
+    BOOST_CHECK(watch.IsWatched(outpoint1));
+    BOOST_CHECK(!watch.IsWatched(outpointOther));
+
+    std::vector<COutPoint> vSpends;
+    vSpends.push_back(outpointOther);
+    vSpends.push_back(outpoint1);
+    vSpends.push_back(outpoint2);
+    CBlock block = BlockSpending(vSpends);
+
+    watch.BlockConnected(block, &index);
+    BOOST_CHECK_EQUAL(watcher1.vSpent.size(), 2);
+    BOOST_CHECK(watcher1.vSpent[0] == outpoint1);
+    BOOST_CHECK(watcher1.vSpent[1] == outpoint2);
+    BOOST_CHECK_EQUAL(watcher2.vSpent.size(), 1);
+    BOOST_CHECK(watcher2.vSpent[0] == outpoint2);
+    BOOST_CHECK(watcher1.vUnspent.empty());
+
+    watch.BlockDisconnected(block, &index);
+    BOOST_CHECK_EQUAL(watcher1.vUnspent.size(), 2);
+    BOOST_CHECK_EQUAL(watcher2.vUnspent.size(), 1);
+
+    // watchers which stopped watching aren't told
+    watch.Unwatch(outpoint2, &watcher2);
+    watch.UnwatchAll(&watcher1);
+    BOOST_CHECK_EQUAL(watch.size(), 0);
+    watch.BlockConnected(block, &index);
+    BOOST_CHECK_EQUAL(watcher1.vSpent.size(), 2);
+    BOOST_CHECK_EQUAL(watcher2.vSpent.size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,8 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/chacha20.h"
+#include "crypto/muhash.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
 #include "crypto/sha256.h"
@@ -9,6 +11,8 @@
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
 #include "random.h"
+#include "streams.h"
+#include "uint256.h"
 #include "utilstrencodings.h"
 #include "test/test_dash.h"
 
@@ -273,4 +277,87 @@ BOOST_AUTO_TEST_CASE(pbkdf2_hmac_sha512_test) {
     BOOST_CHECK(HexStr(k, k + 64) == "8c0511f4c6e597c6ac6315d8f0362e225f3c501495ba23b868c005174dc4ee71115b59f9e60cd9532fa33e0f75aefe30225c583a186cd82bd4daea9724a3d3b8");
 }
 
+void TestChaCha20(const std::string &hexkey, uint64_t nonce, uint64_t seek, const std::string& hexout)
+{
+    std::vector<unsigned char> key = ParseHex(hexkey);
+    CChaCha20 rng(&key[0]);
+    rng.SetIV(nonce);
+    rng.Seek(seek);
+    std::vector<unsigned char> out = ParseHex(hexout);
+    std::vector<unsigned char> outres;
+    outres.resize(out.size());
+    rng.Output(&outres[0], outres.size());
+    BOOST_CHECK(out == outres);
+}
+
+BOOST_AUTO_TEST_CASE(chacha20_testvector)
+{
+    // Test vector from RFC 7539
+    TestChaCha20("0000000000000000000000000000000000000000000000000000000000000000", 0, 0,
+                 "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+                 "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586");
+}
+
+static CMuHash3072 FromInt(unsigned char i)
+{
+    unsigned char tmp[32] = {i, 0};
+    return CMuHash3072(tmp, 32);
+}
+
+static uint256 MuHashFinalize(const CMuHash3072& muhash)
+{
+    uint256 out;
+    muhash.Finalize(out.begin());
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(muhash_tests)
+{
+    BOOST_CHECK_EQUAL(HexStr(MuHashFinalize(CMuHash3072())), "c85525462fdcf30a2c18d6f4b92923000974355c2477f59594d2c205a1d25add");
+    BOOST_CHECK_EQUAL(HexStr(MuHashFinalize(FromInt(0))), "4d9ae4338185474b7d29c730d850954f296d3afbae38438ded3bd6478494b546");
+
+    CMuHash3072 z = FromInt(0);
+    z *= FromInt(1);
+    z /= FromInt(2);
+    BOOST_CHECK_EQUAL(MuHashFinalize(z).GetHex(), "10d312b100cbd32ada024a6646e40d3482fcff103668d2625f10002a607d5863");
+
+    // The order of insertions and removals doesn't matter
+    for (int i = 0; i < 10; ++i) {
+        uint256 res;
+        int table[4];
+        for (int j = 0; j < 4; ++j)
+            table[j] = insecure_rand() % 256;
+        for (int order = 0; order < 4; ++order) {
+            CMuHash3072 acc;
+            for (int j = 0; j < 4; ++j) {
+                int t = table[j ^ order];
+                if (t & 4)
+                    acc /= FromInt(t);
+                else
+                    acc *= FromInt(t);
+            }
+            if (order == 0)
+                res = MuHashFinalize(acc);
+            else
+                BOOST_CHECK(res == MuHashFinalize(acc));
+        }
+
+        // Elements are removed the same way whether one at a time or as a set
+        unsigned char tmp[32] = {(unsigned char)table[0], 0};
+        CMuHash3072 x = FromInt(table[0]);
+        x *= FromInt(table[1]);
+        x.Remove(tmp, sizeof(tmp));
+        BOOST_CHECK(MuHashFinalize(x) == MuHashFinalize(FromInt(table[1])));
+        x /= FromInt(table[1]);
+        BOOST_CHECK(MuHashFinalize(x) == MuHashFinalize(CMuHash3072()));
+    }
+
+    // Serialization keeps the set
+    CDataStream ss(SER_DISK, 0);
+    ss << z;
+    CMuHash3072 z2;
+    ss >> z2;
+    BOOST_CHECK(MuHashFinalize(z) == MuHashFinalize(z2));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
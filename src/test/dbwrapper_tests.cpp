@@ -2,14 +2,22 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "arith_uint256.h"
+#include "chain.h"
+#include "chainparams.h"
 #include "dbwrapper.h"
+#include "txdb.h"
 #include "uint256.h"
 #include "random.h"
 #include "test/test_dash.h"
+#include "util.h"
+#include "utiltime.h"
 
 #include <boost/assign/std/vector.hpp> // for 'operator+=()'
 #include <boost/assert.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
                     
 using namespace std;
 using namespace boost::assign; // bring 'operator+=()' into scope
@@ -85,6 +93,291 @@ BOOST_AUTO_TEST_CASE(dbwrapper_batch)
     }
 }
 
+BOOST_AUTO_TEST_CASE(dbwrapper_compaction)
+{
+    path ph = temp_directory_path() / unique_path();
+    CDBWrapperOptions dbOptions;
+    dbOptions.nMaxOpenFiles = 100;
+    dbOptions.nBloomBitsPerKey = 0;
+    dbOptions.nBlockSize = 16 * 1024;
+    CDBWrapper dbw(ph, (1 << 20), true, false, false, dbOptions);
+    BOOST_CHECK_EQUAL(dbw.GetDBOptions().nMaxOpenFiles, 100);
+
+    for (int i = 0; i < 1000; i++)
+        BOOST_CHECK(dbw.Write(std::make_pair('a', i), GetRandHash()));
+    BOOST_CHECK(!dbw.GetProperty("leveldb.stats").empty());
+    BOOST_CHECK(dbw.GetProperty("leveldb.no-such-property").empty());
+
+    CDBCompactionStatus status = dbw.GetCompactionStatus();
+    BOOST_CHECK(!status.fRunning);
+    BOOST_CHECK_EQUAL(status.nDuration, -1);
+
+    CDataStream ssBegin(SER_DISK, CLIENT_VERSION), ssEnd(SER_DISK, CLIENT_VERSION);
+    ssBegin << 'a';
+    ssEnd << 'b';
+    BOOST_CHECK(dbw.StartCompaction("a", ssBegin.str(), ssEnd.str()));
+    for (int i = 0; i < 1000 && dbw.GetCompactionStatus().fRunning; i++)
+        MilliSleep(10);
+    status = dbw.GetCompactionStatus();
+    BOOST_CHECK(!status.fRunning);
+    BOOST_CHECK_EQUAL(status.strRange, "a");
+    BOOST_CHECK_EQUAL(status.nCompactions, 1U);
+
+    // compacted data is still there, and a whole database compaction can follow
+    uint256 res;
+    BOOST_CHECK(dbw.Read(std::make_pair('a', 999), res));
+    BOOST_CHECK(dbw.StartCompaction("all"));
+}
+
+BOOST_AUTO_TEST_CASE(address_summary)
+{
+    path pathTemp = GetTempPath() / strprintf("test_dash_addresssummary_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    create_directories(pathTemp / "blocks");
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+    {
+        CBlockTreeDB db(1 << 20, true, false);
+        uint160 hash;
+        hash.SetHex("1234");
+        CAddressSummary summary;
+        BOOST_CHECK(!db.ReadAddressSummary(hash, 1, summary));
+
+        // block 10 pays the address twice in one transaction, block 11 spends one output
+        uint256 tx1 = GetRandHash(), tx2 = GetRandHash();
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vBlock10, vBlock11;
+        vBlock10.push_back(std::make_pair(CAddressIndexKey(1, hash, 10, 1, tx1, 0, false), 500));
+        vBlock10.push_back(std::make_pair(CAddressIndexKey(1, hash, 10, 1, tx1, 1, false), 300));
+        vBlock11.push_back(std::make_pair(CAddressIndexKey(1, hash, 11, 1, tx2, 0, true), -500));
+        BOOST_CHECK(db.WriteAddressIndex(vBlock10));
+        BOOST_CHECK(db.WriteAddressIndex(vBlock11));
+
+        BOOST_CHECK(db.ReadAddressSummary(hash, 1, summary));
+        BOOST_CHECK_EQUAL(summary.balance, 300);
+        BOOST_CHECK_EQUAL(summary.received, 800);
+        BOOST_CHECK_EQUAL(summary.txCount, 2U);
+        BOOST_CHECK_EQUAL(summary.firstHeight, 10);
+        BOOST_CHECK_EQUAL(summary.lastHeight, 11);
+        BOOST_CHECK(!db.ReadAddressSummary(hash, 2, summary));
+
+        // connecting a block again, as after -reindex-chainstate, doesn't count it twice
+        BOOST_CHECK(db.WriteAddressIndex(vBlock11));
+        BOOST_CHECK(db.ReadAddressSummary(hash, 1, summary));
+        BOOST_CHECK_EQUAL(summary.balance, 300);
+        BOOST_CHECK_EQUAL(summary.received, 800);
+        BOOST_CHECK_EQUAL(summary.txCount, 2U);
+
+        // rebuilding from the index gives the same result
+        BOOST_CHECK(db.BuildAddressSummaries());
+        BOOST_CHECK(db.ReadAddressSummary(hash, 1, summary));
+        BOOST_CHECK_EQUAL(summary.balance, 300);
+        BOOST_CHECK_EQUAL(summary.txCount, 2U);
+        BOOST_CHECK_EQUAL(summary.lastHeight, 11);
+
+        // disconnecting block 11 moves the last height back
+        BOOST_CHECK(db.EraseAddressIndex(vBlock11));
+        BOOST_CHECK(db.ReadAddressSummary(hash, 1, summary));
+        BOOST_CHECK_EQUAL(summary.balance, 800);
+        BOOST_CHECK_EQUAL(summary.received, 800);
+        BOOST_CHECK_EQUAL(summary.txCount, 1U);
+        BOOST_CHECK_EQUAL(summary.lastHeight, 10);
+
+        // and neither does disconnecting it again
+        BOOST_CHECK(db.EraseAddressIndex(vBlock11));
+        BOOST_CHECK(db.ReadAddressSummary(hash, 1, summary));
+        BOOST_CHECK_EQUAL(summary.balance, 800);
+        BOOST_CHECK_EQUAL(summary.txCount, 1U);
+
+        BOOST_CHECK(db.EraseAddressIndex(vBlock10));
+        BOOST_CHECK(!db.ReadAddressSummary(hash, 1, summary));
+    }
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    remove_all(pathTemp);
+}
+
+BOOST_AUTO_TEST_CASE(address_index_page)
+{
+    path pathTemp = GetTempPath() / strprintf("test_dash_addresspage_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000));
+    create_directories(pathTemp / "blocks");
+    mapArgs["-datadir"] = pathTemp.string();
+    ClearDatadirCache();
+    {
+        CBlockTreeDB db(1 << 20, true, false);
+        uint160 hash, hashOther;
+        hash.SetHex("1234");
+        hashOther.SetHex("1235");
+
+        // output indexes above 255 sort differently than their numbers
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vIndex;
+        uint256 txid = GetRandHash();
+        for (int i = 0; i < 10; i++)
+            vIndex.push_back(std::make_pair(CAddressIndexKey(1, hash, 100 + i / 2, 1, txid, i * 200, false), i));
+        vIndex.push_back(std::make_pair(CAddressIndexKey(1, hashOther, 100, 2, GetRandHash(), 0, false), 10));
+        BOOST_CHECK(db.WriteAddressIndex(vIndex));
+
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vAll, vPage;
+        BOOST_CHECK(db.ReadAddressIndex(hash, 1, vAll));
+        BOOST_CHECK_EQUAL(vAll.size(), 10U);
+        for (size_t i = 1; i < vAll.size(); i++)
+            BOOST_CHECK(CAddressIndexPositionCompare()(vAll[i - 1].first, vAll[i].first));
+
+        // pages continue right after the cursor in both directions
+        for (int nReverse = 0; nReverse < 2; nReverse++) {
+            std::vector<std::pair<CAddressIndexKey, CAmount> > vPaged;
+            const CAddressIndexKey* pCursor = NULL;
+            CAddressIndexKey cursor;
+            do {
+                vPage.clear();
+                BOOST_CHECK(db.ReadAddressIndexPage(hash, 1, vPage, 3, nReverse, pCursor));
+                BOOST_CHECK(vPage.size() <= 3);
+                vPaged.insert(vPaged.end(), vPage.begin(), vPage.end());
+                if (!vPage.empty()) {
+                    cursor = vPage.back().first;
+                    pCursor = &cursor;
+                }
+            } while (!vPage.empty());
+            BOOST_CHECK_EQUAL(vPaged.size(), vAll.size());
+            for (size_t i = 0; i < vPaged.size(); i++)
+                BOOST_CHECK_EQUAL(vPaged[i].second, vAll[nReverse ? vAll.size() - 1 - i : i].second);
+        }
+
+        // height range
+        vPage.clear();
+        BOOST_CHECK(db.ReadAddressIndexPage(hash, 1, vPage, 100, true, NULL, 101, 102));
+        BOOST_CHECK_EQUAL(vPage.size(), 4U);
+        BOOST_CHECK_EQUAL(vPage.front().second, 5);
+        BOOST_CHECK_EQUAL(vPage.back().second, 3);
+
+        // merging addresses, on the seek threads or not
+        std::vector<std::pair<uint160, int> > addresses;
+        addresses.push_back(std::make_pair(hash, 1));
+        addresses.push_back(std::make_pair(hashOther, 1));
+        addresses.push_back(std::make_pair(hashOther, 2));
+        boost::thread_group threadGroup;
+        nAddressSeekThreads = 2;
+        for (int i = 0; i < nAddressSeekThreads; i++)
+            threadGroup.create_thread(&ThreadAddressSeek);
+        for (int nParallel = 0; nParallel < 2; nParallel++) {
+            CAddressIndexMerger merger(db, addresses, false);
+            std::vector<CAmount> vValues;
+            for (merger.Seek(nParallel); merger.Valid(); merger.Next())
+                vValues.push_back(merger.GetValue());
+            BOOST_CHECK(!merger.Failed());
+            BOOST_CHECK_EQUAL(vValues.size(), 11U);
+            // the other address has an entry at height 100 after all of the first one's
+            BOOST_CHECK_EQUAL(vValues[0], vAll[0].second);
+            BOOST_CHECK_EQUAL(vValues[1], vAll[1].second);
+            BOOST_CHECK_EQUAL(vValues[2], 10);
+            BOOST_CHECK_EQUAL(vValues[10], vAll[9].second);
+        }
+        threadGroup.interrupt_all();
+        threadGroup.join_all();
+        nAddressSeekThreads = 0;
+    }
+    mapArgs.erase("-datadir");
+    ClearDatadirCache();
+    remove_all(pathTemp);
+}
+
+BOOST_AUTO_TEST_CASE(index_negative_cache)
+{
+    CIndexNegativeCache cache(2);
+    std::string a = CIndexNegativeCache::MakeKey('a', 1), b = CIndexNegativeCache::MakeKey('a', 2), c = CIndexNegativeCache::MakeKey('b', 1);
+    BOOST_CHECK(a != c);
+
+    cache.Add(a, cache.GetEpoch());
+    BOOST_CHECK(cache.Contains(a));
+    BOOST_CHECK(!cache.Contains(b));
+
+    // a miss that raced with a write is not remembered
+    uint64_t nEpoch = cache.GetEpoch();
+    cache.Invalidate(std::vector<std::string>(1, a));
+    BOOST_CHECK(!cache.Contains(a));
+    cache.Add(b, nEpoch);
+    BOOST_CHECK(!cache.Contains(b));
+
+    // oldest entries are evicted once full
+    cache.Add(a, cache.GetEpoch());
+    cache.Add(b, cache.GetEpoch());
+    cache.Add(c, cache.GetEpoch());
+    BOOST_CHECK(!cache.Contains(a));
+    BOOST_CHECK(cache.Contains(b));
+    BOOST_CHECK(cache.Contains(c));
+
+    CIndexNegativeCacheStats stats;
+    cache.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nEntries, 2U);
+    BOOST_CHECK_EQUAL(stats.nHits, 3U);
+    BOOST_CHECK_EQUAL(stats.nMisses, 4U);
+    BOOST_CHECK_EQUAL(stats.nInvalidated, 1U);
+
+    // a key added again after being invalidated is evicted by its latest entry only
+    cache.Invalidate(std::vector<std::string>(1, b));
+    cache.Add(a, cache.GetEpoch());
+    cache.Add(b, cache.GetEpoch());
+    cache.Invalidate(std::vector<std::string>(1, a));
+    cache.Add(a, cache.GetEpoch());
+    BOOST_CHECK(!cache.Contains(c));
+    BOOST_CHECK(cache.Contains(a));
+    BOOST_CHECK(cache.Contains(b));
+    cache.Add(c, cache.GetEpoch());
+    BOOST_CHECK(cache.Contains(a));
+    BOOST_CHECK(!cache.Contains(b));
+    BOOST_CHECK(cache.Contains(c));
+}
+
+static CBlockIndex* InsertTestBlockIndex(std::map<uint256, CBlockIndex>* pmapIndex, const uint256& hash)
+{
+    if (hash.IsNull())
+        return NULL;
+    std::map<uint256, CBlockIndex>::iterator it = pmapIndex->insert(std::make_pair(hash, CBlockIndex())).first;
+    it->second.phashBlock = &it->first;
+    return &it->second;
+}
+
+BOOST_AUTO_TEST_CASE(block_index_load)
+{
+    // a chain of random hashes, spread over all key ranges
+    const int nBlocks = 300;
+    std::vector<uint256> vHashes(nBlocks);
+    std::vector<CBlockIndex> vIndex(nBlocks);
+    std::vector<const CBlockIndex*> vWrite;
+    for (int i = 0; i < nBlocks; i++) {
+        vHashes[i] = GetRandHash();
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+        vIndex[i].nHeight = i;
+        vIndex[i].nBits = UintToArith256(Params().GetConsensus().powLimit).GetCompact();
+        vIndex[i].nTx = i + 1;
+        vWrite.push_back(&vIndex[i]);
+    }
+
+    CBlockTreeDB db(1 << 20, true, false);
+    BOOST_CHECK(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*> >(), 0, vWrite));
+
+    std::map<uint256, CBlockIndex> mapIndex;
+    BOOST_CHECK(db.LoadBlockIndexGuts(boost::bind(&InsertTestBlockIndex, &mapIndex, _1), nBlocks));
+    BOOST_CHECK_EQUAL(mapIndex.size(), nBlocks);
+    for (int i = 0; i < nBlocks; i++) {
+        const CBlockIndex& index = mapIndex[vHashes[i]];
+        BOOST_CHECK_EQUAL(index.nHeight, i);
+        BOOST_CHECK_EQUAL(index.nTx, i + 1);
+        BOOST_CHECK(index.pprev == (i > 0 ? &mapIndex[vHashes[i - 1]] : NULL));
+    }
+
+    // the proof of work is only checked above the given height
+    uint256 hashInvalid = uint256S("ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff");
+    CBlockIndex indexInvalid = vIndex[nBlocks - 1];
+    indexInvalid.phashBlock = &hashInvalid;
+    indexInvalid.nHeight = nBlocks;
+    BOOST_CHECK(db.WriteBatchSync(std::vector<std::pair<int, const CBlockFileInfo*> >(), 0, std::vector<const CBlockIndex*>(1, &indexInvalid)));
+    mapIndex.clear();
+    BOOST_CHECK(!db.LoadBlockIndexGuts(boost::bind(&InsertTestBlockIndex, &mapIndex, _1), nBlocks - 1));
+    mapIndex.clear();
+    BOOST_CHECK(db.LoadBlockIndexGuts(boost::bind(&InsertTestBlockIndex, &mapIndex, _1), nBlocks));
+    BOOST_CHECK_EQUAL(mapIndex.size(), nBlocks + 1);
+}
+
 BOOST_AUTO_TEST_CASE(dbwrapper_iterator)
 {
     // Perform tests both obfuscated and non-obfuscated.
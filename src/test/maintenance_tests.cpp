@@ -0,0 +1,104 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "maintenance.h"
+
+#include "test/test_dash.h"
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(maintenance_tests, BasicTestingSetup)
+
+static CMaintenanceJobStats GetJobStats(const CMaintenanceScheduler& scheduler, const std::string& strName)
+{
+    std::vector<CMaintenanceJobStats> vStats = scheduler.GetStats();
+    for (size_t i = 0; i < vStats.size(); i++) {
+        if (vStats[i].strName == strName)
+            return vStats[i];
+    }
+    BOOST_ERROR("no job " + strName);
+    return CMaintenanceJobStats();
+}
+
+BOOST_AUTO_TEST_CASE(maintenance_schedule)
+{
+    CMaintenanceScheduler scheduler;
+    int nRuns = 0;
+    scheduler.ScheduleEvery("job", [&nRuns]() { nRuns++; }, 10, 0, 5);
+    int64_t nFirst = GetJobStats(scheduler, "job").nTimeNext;
+
+    scheduler.Dispatch(nFirst - 1);
+    BOOST_CHECK(!scheduler.RunQueued());
+    scheduler.Dispatch(nFirst);
+    // queued jobs aren't queued again
+    scheduler.Dispatch(nFirst + 1);
+    BOOST_CHECK_EQUAL(GetJobStats(scheduler, "job").nTimeNext, 0);
+    BOOST_CHECK(scheduler.RunQueued());
+    BOOST_CHECK(!scheduler.RunQueued());
+    BOOST_CHECK_EQUAL(nRuns, 1);
+
+    // the next run is an interval after the previous one was due
+    CMaintenanceJobStats stats = GetJobStats(scheduler, "job");
+    BOOST_CHECK_EQUAL(stats.nTimeNext, nFirst + 10);
+    BOOST_CHECK_EQUAL(stats.nRuns, 1);
+    BOOST_CHECK_EQUAL(stats.nOverruns, 0);
+    uint64_t nHistogramRuns = 0;
+    for (int i = 0; i < MAINTENANCE_HISTOGRAM_BUCKETS; i++)
+        nHistogramRuns += stats.vHistogram[i];
+    BOOST_CHECK_EQUAL(nHistogramRuns, 1);
+
+    scheduler.Dispatch(nFirst + 9);
+    BOOST_CHECK(!scheduler.RunQueued());
+    scheduler.Dispatch(nFirst + 10);
+    BOOST_CHECK(scheduler.RunQueued());
+    BOOST_CHECK_EQUAL(nRuns, 2);
+}
+
+BOOST_AUTO_TEST_CASE(maintenance_jitter)
+{
+    int64_t nNow = GetTimeMillis() / 1000;
+    for (int i = 0; i < 20; i++) {
+        // jobs without a delay start at random within their interval
+        CMaintenanceScheduler scheduler;
+        std::string strName = strprintf("job%d", i);
+        scheduler.ScheduleEvery(strName, []() {}, 60, 5);
+        int64_t nFirst = GetJobStats(scheduler, strName).nTimeNext;
+        BOOST_CHECK(nFirst >= nNow + 1 && nFirst <= nNow + 61);
+
+        scheduler.Dispatch(nFirst);
+        BOOST_CHECK(scheduler.RunQueued());
+        int64_t nNext = GetJobStats(scheduler, strName).nTimeNext;
+        BOOST_CHECK(nNext >= nFirst + 60 && nNext <= nFirst + 65);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(maintenance_replace_and_throw)
+{
+    CMaintenanceScheduler scheduler;
+    int nRunsOld = 0, nRunsNew = 0;
+    scheduler.ScheduleEvery("job", [&nRunsOld]() { nRunsOld++; }, 1, 0, 1);
+    scheduler.ScheduleEvery("job", [&nRunsNew]() { nRunsNew++; throw std::runtime_error("job failed"); }, 1, 0, 2);
+    BOOST_CHECK_EQUAL(scheduler.GetStats().size(), 1);
+
+    int64_t nFirst = GetJobStats(scheduler, "job").nTimeNext;
+    scheduler.Dispatch(nFirst);
+    BOOST_CHECK(scheduler.RunQueued());
+    BOOST_CHECK(!scheduler.RunQueued());
+    BOOST_CHECK_EQUAL(nRunsOld, 0);
+    BOOST_CHECK_EQUAL(nRunsNew, 1);
+    // a job which throws is still scheduled again
+    BOOST_CHECK_EQUAL(GetJobStats(scheduler, "job").nRuns, 1);
+    BOOST_CHECK(GetJobStats(scheduler, "job").nTimeNext > nFirst);
+}
+
+BOOST_AUTO_TEST_CASE(maintenance_histogram_bounds)
+{
+    BOOST_CHECK_EQUAL(CMaintenanceScheduler::GetHistogramBound(0), 1);
+    BOOST_CHECK_EQUAL(CMaintenanceScheduler::GetHistogramBound(3), 8);
+    BOOST_CHECK_EQUAL(CMaintenanceScheduler::GetHistogramBound(MAINTENANCE_HISTOGRAM_BUCKETS - 1), -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,7 @@
 
 #include "txmempool.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #include "test/test_dash.h"
 
@@ -473,4 +474,65 @@ BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
     SetMockTime(0);
 }
 
+/** Records the transactions removed from the mempool, with the reason */
+class CRemovalRecorder : public CValidationInterface
+{
+public:
+    std::vector<std::pair<uint256, MemPoolRemovalReason> > vRemoved;
+
+protected:
+    void TransactionRemovedFromMempool(const CTransaction &tx, MemPoolRemovalReason reason)
+    {
+        vRemoved.push_back(std::make_pair(tx.GetHash(), reason));
+    }
+};
+
+BOOST_AUTO_TEST_CASE(MempoolRemovalReasonTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    TestMemPoolEntryHelper entry;
+    CRemovalRecorder recorder;
+    RegisterValidationInterface(&recorder);
+
+    CMutableTransaction tx1 = CMutableTransaction();
+    tx1.vin.resize(1);
+    tx1.vin[0].scriptSig = CScript() << OP_1;
+    tx1.vout.resize(1);
+    tx1.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    tx1.vout[0].nValue = 10 * COIN;
+    CMutableTransaction tx2 = CMutableTransaction();
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vin[0].scriptSig = CScript() << OP_2;
+    tx2.vout.resize(1);
+    tx2.vout[0].scriptPubKey = CScript() << OP_2 << OP_EQUAL;
+    tx2.vout[0].nValue = 9 * COIN;
+
+    // The descendants go for the same reason
+    pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+    pool.addUnchecked(tx2.GetHash(), entry.FromTx(tx2));
+    std::list<CTransaction> removed;
+    pool.remove(tx1, removed, true, MemPoolRemovalReason::CONFLICT);
+    BOOST_CHECK_EQUAL(recorder.vRemoved.size(), 2);
+    for (size_t i = 0; i < recorder.vRemoved.size(); i++)
+        BOOST_CHECK(recorder.vRemoved[i].second == MemPoolRemovalReason::CONFLICT);
+    recorder.vRemoved.clear();
+
+    pool.addUnchecked(tx1.GetHash(), entry.Time(10).FromTx(tx1));
+    BOOST_CHECK_EQUAL(pool.Expire(11), 1);
+    BOOST_CHECK_EQUAL(recorder.vRemoved.size(), 1);
+    BOOST_CHECK(recorder.vRemoved[0].first == tx1.GetHash());
+    BOOST_CHECK(recorder.vRemoved[0].second == MemPoolRemovalReason::EXPIRY);
+    recorder.vRemoved.clear();
+
+    pool.addUnchecked(tx1.GetHash(), entry.FromTx(tx1));
+    std::vector<CTransaction> vtx(1, tx1);
+    std::list<CTransaction> conflicts;
+    pool.removeForBlock(vtx, 1, conflicts);
+    BOOST_CHECK_EQUAL(recorder.vRemoved.size(), 1);
+    BOOST_CHECK(recorder.vRemoved[0].second == MemPoolRemovalReason::BLOCK);
+
+    UnregisterValidationInterface(&recorder);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "core_memusage.h"
+#include "orphanpool.h"
+#include "random.h"
+
+#include "test/test_dash.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(orphanpool_tests, BasicTestingSetup)
+
+static CTransaction MakeOrphan(const std::vector<COutPoint>& vPrevouts)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(vPrevouts.size());
+    for (size_t i = 0; i < vPrevouts.size(); i++) {
+        tx.vin[i].prevout = vPrevouts[i];
+        tx.vin[i].scriptSig << OP_1;
+    }
+    tx.vout.resize(2);
+    tx.vout[0].nValue = 1*CENT;
+    tx.vout[0].scriptPubKey << OP_TRUE;
+    tx.vout[1].nValue = 1*CENT;
+    tx.vout[1].scriptPubKey << OP_TRUE;
+    return tx;
+}
+
+static CTransaction MakeOrphan(const uint256& hashPrev, uint32_t n = 0)
+{
+    return MakeOrphan(std::vector<COutPoint>(1, COutPoint(hashPrev, n)));
+}
+
+BOOST_AUTO_TEST_CASE(orphanpool_peer_quota)
+{
+    COrphanPool pool;
+    int64_t nNow = 1000000;
+
+    CTransaction txFirst = MakeOrphan(GetRandHash());
+    size_t nUsage = RecursiveDynamicUsage(txFirst);
+    // room for exactly three orphans of this shape per peer
+    pool.SetMaxPeerUsage(nUsage * 3);
+
+    BOOST_CHECK(pool.AddTx(txFirst, 1, nNow));
+    BOOST_CHECK(!pool.AddTx(txFirst, 1, nNow)); // duplicate
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(pool.AddTx(MakeOrphan(GetRandHash()), 1, nNow));
+
+    // peer 1 evicted its own oldest orphans
+    BOOST_CHECK_EQUAL(pool.Size(), 3U);
+    BOOST_CHECK(!pool.HaveTx(txFirst.GetHash()));
+
+    // another peer is not affected by peer 1
+    CTransaction txOther = MakeOrphan(GetRandHash());
+    BOOST_CHECK(pool.AddTx(txOther, 2, nNow));
+    BOOST_CHECK_EQUAL(pool.Size(), 4U);
+
+    // the global limit evicts from the heaviest peer first
+    BOOST_CHECK_EQUAL(pool.LimitOrphans(3), 1U);
+    BOOST_CHECK(pool.HaveTx(txOther.GetHash()));
+
+    COrphanPoolStats stats;
+    pool.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nOrphans, 3U);
+    BOOST_CHECK_EQUAL(stats.nPeers, 2U);
+    BOOST_CHECK_EQUAL(stats.nUsage, nUsage * 3);
+    BOOST_CHECK_EQUAL(stats.nEvictedQuota, 2U);
+    BOOST_CHECK_EQUAL(stats.nEvictedLimit, 1U);
+
+    BOOST_CHECK_EQUAL(pool.RemoveForPeer(1), 2);
+    BOOST_CHECK_EQUAL(pool.Size(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(orphanpool_expire)
+{
+    COrphanPool pool;
+    int64_t nNow = 1000000;
+
+    CTransaction tx1 = MakeOrphan(GetRandHash());
+    CTransaction tx2 = MakeOrphan(GetRandHash());
+    BOOST_CHECK(pool.AddTx(tx1, 1, nNow));
+    BOOST_CHECK(pool.AddTx(tx2, 1, nNow + ORPHAN_TX_EXPIRE_INTERVAL * 2));
+
+    BOOST_CHECK_EQUAL(pool.ExpireOrphans(nNow), 0U);
+    BOOST_CHECK_EQUAL(pool.ExpireOrphans(nNow + ORPHAN_TX_EXPIRE_TIME - 1), 0U);
+    BOOST_CHECK_EQUAL(pool.ExpireOrphans(nNow + ORPHAN_TX_EXPIRE_TIME), 1U);
+    BOOST_CHECK(!pool.HaveTx(tx1.GetHash()));
+    BOOST_CHECK(pool.HaveTx(tx2.GetHash()));
+
+    // skipping more than a full turn of the wheel still expires everything due
+    CTransaction tx3 = MakeOrphan(GetRandHash());
+    BOOST_CHECK(pool.AddTx(tx3, 2, nNow + ORPHAN_TX_EXPIRE_TIME));
+    BOOST_CHECK_EQUAL(pool.ExpireOrphans(nNow + ORPHAN_TX_EXPIRE_TIME * 5), 2U);
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+
+    COrphanPoolStats stats;
+    pool.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nExpired, 3U);
+}
+
+BOOST_AUTO_TEST_CASE(orphanpool_children_sorted)
+{
+    COrphanPool pool;
+    int64_t nNow = 1000000;
+
+    // parent -> A -> B -> D, parent -> C -> D, added in reverse dependency order
+    uint256 hashParent = GetRandHash();
+    CTransaction txA = MakeOrphan(hashParent, 0);
+    CTransaction txC = MakeOrphan(hashParent, 1);
+    CTransaction txB = MakeOrphan(txA.GetHash());
+    std::vector<COutPoint> vPrevouts;
+    vPrevouts.push_back(COutPoint(txB.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txC.GetHash(), 0));
+    vPrevouts.push_back(COutPoint(txC.GetHash(), 1));
+    CTransaction txD = MakeOrphan(vPrevouts);
+    CTransaction txUnrelated = MakeOrphan(GetRandHash());
+
+    BOOST_CHECK(pool.AddTx(txD, 1, nNow));
+    BOOST_CHECK(pool.AddTx(txB, 2, nNow));
+    BOOST_CHECK(pool.AddTx(txC, 1, nNow));
+    BOOST_CHECK(pool.AddTx(txA, 3, nNow));
+    BOOST_CHECK(pool.AddTx(txUnrelated, 3, nNow));
+
+    std::vector<uint256> vSorted;
+    pool.GetChildrenSorted(std::vector<uint256>(1, hashParent), vSorted);
+    BOOST_CHECK_EQUAL(vSorted.size(), 4U);
+
+    std::map<uint256, size_t> mapPos;
+    for (size_t i = 0; i < vSorted.size(); i++)
+        mapPos[vSorted[i]] = i;
+    BOOST_CHECK(!mapPos.count(txUnrelated.GetHash()));
+    BOOST_CHECK(mapPos[txA.GetHash()] < mapPos[txB.GetHash()]);
+    BOOST_CHECK(mapPos[txB.GetHash()] < mapPos[txD.GetHash()]);
+    BOOST_CHECK(mapPos[txC.GetHash()] < mapPos[txD.GetHash()]);
+
+    // a batch of unrelated parents resolves nothing
+    pool.GetChildrenSorted(std::vector<uint256>(1, GetRandHash()), vSorted);
+    BOOST_CHECK(vSorted.empty());
+
+    pool.RemoveTx(txA.GetHash(), ORPHAN_REMOVED_ACCEPTED);
+    pool.GetChildrenSorted(std::vector<uint256>(1, txA.GetHash()), vSorted);
+    BOOST_CHECK_EQUAL(vSorted.size(), 2U);
+    BOOST_CHECK(vSorted[0] == txB.GetHash());
+    BOOST_CHECK(vSorted[1] == txD.GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(orphanpool_block_conflicts)
+{
+    COrphanPool pool;
+    int64_t nNow = 1000000;
+
+    uint256 hashParent = GetRandHash();
+    CTransaction txOrphan = MakeOrphan(hashParent, 0);
+    CTransaction txChild = MakeOrphan(txOrphan.GetHash(), 0);
+    BOOST_CHECK(pool.AddTx(txOrphan, 1, nNow));
+    BOOST_CHECK(pool.AddTx(txChild, 1, nNow));
+
+    // a mined double-spend of the orphan's input removes the orphan only
+    CMutableTransaction txConflict = MakeOrphan(hashParent, 0);
+    txConflict.nLockTime = 1;
+    BOOST_CHECK_EQUAL(pool.RemoveForBlockTx(txConflict), 1);
+    BOOST_CHECK(!pool.HaveTx(txOrphan.GetHash()));
+    BOOST_CHECK(pool.HaveTx(txChild.GetHash()));
+
+    // mining the orphan itself removes it too
+    BOOST_CHECK_EQUAL(pool.RemoveForBlockTx(txChild), 1);
+    BOOST_CHECK_EQUAL(pool.Size(), 0U);
+
+    COrphanPoolStats stats;
+    pool.GetStats(stats);
+    BOOST_CHECK_EQUAL(stats.nRemovedBlock, 2U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,107 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "ringbuffer.h"
+#include "test/test_dash.h"
+
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(ringbuffer_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(ringbuffer_basics)
+{
+    CMPSCRingBuffer<std::string> buffer(4);
+    std::string str;
+    BOOST_CHECK(!buffer.TryPop(str));
+
+    for (int i = 0; i < 4; i++) {
+        std::string strPush = strprintf("line%d", i);
+        BOOST_CHECK(buffer.TryPush(std::move(strPush)));
+    }
+    // full, the value is left alone
+    std::string strFull = "full";
+    BOOST_CHECK(!buffer.TryPush(std::move(strFull)));
+    BOOST_CHECK_EQUAL(strFull, "full");
+
+    std::vector<std::string> vPending;
+    buffer.ForEachPending([&vPending](const std::string& str) { vPending.push_back(str); });
+    BOOST_CHECK_EQUAL(vPending.size(), 4);
+    BOOST_CHECK_EQUAL(vPending[3], "line3");
+
+    // peeked values stay pending until they are popped
+    BOOST_CHECK_EQUAL(*buffer.Peek(0), "line0");
+    BOOST_CHECK_EQUAL(*buffer.Peek(3), "line3");
+    BOOST_CHECK(buffer.Peek(4) == NULL);
+    buffer.Pop(2);
+    vPending.clear();
+    buffer.ForEachPending([&vPending](const std::string& str) { vPending.push_back(str); });
+    BOOST_CHECK_EQUAL(vPending.size(), 2);
+    BOOST_CHECK_EQUAL(*buffer.Peek(0), "line2");
+    for (int i = 0; i < 2; i++) {
+        std::string strPush = strprintf("line%d", i);
+        BOOST_CHECK(buffer.TryPush(std::move(strPush)));
+    }
+    BOOST_CHECK(buffer.TryPop(str));
+    BOOST_CHECK_EQUAL(str, "line2");
+    BOOST_CHECK(buffer.TryPop(str));
+    BOOST_CHECK_EQUAL(str, "line3");
+    for (int i = 2; i < 4; i++) {
+        std::string strPush = strprintf("line%d", i);
+        BOOST_CHECK(buffer.TryPush(std::move(strPush)));
+    }
+
+    // the positions wrap around
+    for (int nLap = 0; nLap < 3; nLap++) {
+        for (int i = 0; i < 4; i++) {
+            BOOST_CHECK(buffer.TryPop(str));
+            BOOST_CHECK_EQUAL(str, strprintf("line%d", i));
+        }
+        BOOST_CHECK(!buffer.TryPop(str));
+        for (int i = 0; i < 4; i++) {
+            std::string strPush = strprintf("line%d", i);
+            BOOST_CHECK(buffer.TryPush(std::move(strPush)));
+        }
+    }
+}
+
+static void PushValues(CMPSCRingBuffer<int>* pbuffer, int nProducer, int nValues)
+{
+    for (int i = 0; i < nValues; i++) {
+        int nValue = nProducer * nValues + i;
+        while (!pbuffer->TryPush(std::move(nValue)))
+            boost::this_thread::yield();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ringbuffer_producers)
+{
+    const int nProducers = 4;
+    const int nValues = 20000;
+    CMPSCRingBuffer<int> buffer(64);
+    boost::thread_group threads;
+    for (int i = 0; i < nProducers; i++)
+        threads.create_thread(boost::bind(&PushValues, &buffer, i, nValues));
+
+    // every value arrives once, and in the order of its producer
+    std::vector<int> vLast(nProducers, -1);
+    int nReceived = 0;
+    while (nReceived < nProducers * nValues) {
+        int nValue;
+        if (!buffer.TryPop(nValue)) {
+            boost::this_thread::yield();
+            continue;
+        }
+        int nProducer = nValue / nValues;
+        BOOST_REQUIRE(nProducer >= 0 && nProducer < nProducers);
+        BOOST_REQUIRE(nValue % nValues == vLast[nProducer] + 1);
+        vLast[nProducer] = nValue % nValues;
+        nReceived++;
+    }
+    threads.join_all();
+    int nValue;
+    BOOST_CHECK(!buffer.TryPop(nValue));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
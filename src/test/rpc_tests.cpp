@@ -6,12 +6,18 @@
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "chainparams.h"
 #include "netbase.h"
+#include "streams.h"
+#include "unixrpc.h"
+#include "validation.h"
 
 #include "test/test_dash.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 #include <univalue.h>
 
@@ -246,6 +252,219 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_THROW(ParseNonRFCJSONValue("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), std::runtime_error);
 }
 
+static void AppendChunk(const std::string& strChunk, std::vector<std::string>& vChunks)
+{
+    vChunks.push_back(strChunk);
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_writer)
+{
+    UniValue entry(UniValue::VOBJ);
+    entry.push_back(Pair("txid", "\"quoted\""));
+    entry.push_back(Pair("vout", 1));
+    UniValue entries(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        entries.push_back(entry);
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("result", entries));
+    expected.push_back(Pair("empty", UniValue(UniValue::VARR)));
+    expected.push_back(Pair("nested", UniValue(UniValue::VOBJ)));
+    expected.push_back(Pair("error", NullUniValue));
+
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, _1, boost::ref(vChunks)), 100);
+    writer.BeginObject();
+    writer.Key("result");
+    writer.BeginArray();
+    for (int i = 0; i < 100; i++)
+        writer.Value(entry);
+    writer.EndArray();
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("nested");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.KeyValue("error", NullUniValue);
+    writer.EndObject();
+
+    // Output is handed out in chunks of about the chunk size
+    BOOST_CHECK(writer.Flushed());
+    BOOST_CHECK(vChunks.size() > 10);
+    std::string strOut;
+    for (size_t i = 0; i < vChunks.size(); i++) {
+        BOOST_CHECK(vChunks[i].size() < 100 + entry.write().size());
+        strOut += vChunks[i];
+    }
+    strOut += writer.GetBuffer();
+    BOOST_CHECK_EQUAL(strOut, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_stream)
+{
+    FinishRPCWarmup();
+    std::string strHash = Params().GenesisBlock().GetHash().GetHex();
+    BOOST_CHECK(tableRPC.canStream("getblock"));
+    BOOST_CHECK(!tableRPC.canStream("getblockcount"));
+
+    for (int nVerbosity = 0; nVerbosity <= 2; nVerbosity++) {
+        UniValue params(UniValue::VARR);
+        params.push_back(strHash);
+        params.push_back(nVerbosity);
+        std::vector<std::string> vChunks;
+        CJSONStreamWriter writer(boost::bind(&AppendChunk, _1, boost::ref(vChunks)), 16);
+        tableRPC.executeStream("getblock", params, writer);
+        writer.Flush();
+        BOOST_CHECK_EQUAL(boost::algorithm::join(vChunks, ""), CallRPC(strprintf("getblock %s %d", strHash, nVerbosity)).write());
+    }
+    BOOST_CHECK_EQUAL(CallRPC(strprintf("getblock %s true", strHash)).write(), CallRPC(strprintf("getblock %s 1", strHash)).write());
+    BOOST_CHECK(CallRPC(strprintf("getblock %s false", strHash)).isStr());
+
+    UniValue params(UniValue::VARR);
+    params.push_back(true);
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, _1, boost::ref(vChunks)));
+    tableRPC.executeStream("getrawmempool", params, writer);
+    writer.Flush();
+    BOOST_CHECK_EQUAL(boost::algorithm::join(vChunks, ""), "{}");
+}
+
+BOOST_AUTO_TEST_CASE(rpc_method_classes)
+{
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("getblockcount"), RPC_CLASS_FAST);
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("mnsync"), RPC_CLASS_CHAIN);
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("getblock"), RPC_CLASS_CHAIN);
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("gettxoutsetinfo"), RPC_CLASS_HEAVY);
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("nosuchmethod"), RPC_CLASS_CHAIN);
+#ifdef ENABLE_WALLET
+    BOOST_CHECK_EQUAL(tableRPC.methodClass("getbalance"), RPC_CLASS_WALLET);
+#endif
+
+    // The lock-free methods answer from the published tip
+    FinishRPCWarmup();
+    BOOST_CHECK_EQUAL(CallRPC("getblockcount").get_int(), chainActive.Height());
+    BOOST_CHECK_EQUAL(CallRPC("getbestblockhash").get_str(), chainActive.Tip()->GetBlockHash().GetHex());
+}
+
+static UniValue BatchEntry(const std::string& strMethod, const UniValue& params, int nId)
+{
+    UniValue request(UniValue::VOBJ);
+    request.push_back(Pair("method", strMethod));
+    request.push_back(Pair("params", params));
+    request.push_back(Pair("id", nId));
+    return request;
+}
+
+static bool RunTask(const boost::function<void()>& func, boost::thread_group& threads, int& nTasks)
+{
+    nTasks++;
+    threads.create_thread(func);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch)
+{
+    FinishRPCWarmup();
+    UniValue vReq(UniValue::VARR);
+    for (int i = 0; i < 50; i++) {
+        UniValue params(UniValue::VARR);
+        params.push_back(i % 2 ? "51" : "nothex");
+        vReq.push_back(BatchEntry("decodescript", params, i));
+    }
+    // Other tests run batches too, only count the ones of this test
+    UniValue infoBefore = CallRPC("getrpcbatchinfo");
+
+    // Replies keep the order of the requests, whichever thread executed them
+    boost::thread_group threads;
+    int nTasks = 0;
+    UniValue vReply;
+    BOOST_CHECK(vReply.read(JSONRPCExecBatch(vReq, boost::bind(&RunTask, _1, boost::ref(threads), boost::ref(nTasks)), 4)));
+    threads.join_all();
+    BOOST_CHECK_EQUAL(nTasks, 3);
+    BOOST_CHECK_EQUAL(vReply.size(), 50U);
+    for (int i = 0; i < 50; i++) {
+        BOOST_CHECK_EQUAL(find_value(vReply[i], "id").get_int(), i);
+        BOOST_CHECK_EQUAL(find_value(vReply[i], "error").isNull(), i % 2 == 1);
+    }
+    BOOST_CHECK_EQUAL(vReply.write() + "\n", JSONRPCExecBatch(vReq));
+
+    // A method with effects keeps the whole batch on the calling thread
+    vReq.push_back(BatchEntry("setmocktime", UniValue(UniValue::VARR), 50));
+    nTasks = 0;
+    JSONRPCExecBatch(vReq, boost::bind(&RunTask, _1, boost::ref(threads), boost::ref(nTasks)), 4);
+    BOOST_CHECK_EQUAL(nTasks, 0);
+    BOOST_CHECK(tableRPC.isOrdered("sendrawtransaction"));
+    BOOST_CHECK(!tableRPC.isOrdered("getrawtransaction"));
+
+    UniValue info = CallRPC("getrpcbatchinfo");
+    BOOST_CHECK_EQUAL(find_value(info, "batches").get_int() - find_value(infoBefore, "batches").get_int(), 3);
+    BOOST_CHECK_EQUAL(find_value(info, "parallel").get_int() - find_value(infoBefore, "parallel").get_int(), 1);
+}
+
+static CDataStream ExecUnixRPC(const CDataStream& request, uint32_t nIdExpected, uint8_t nStatusExpected)
+{
+    CDataStream ssRequest(request);
+    CDataStream ssReply(SER_NETWORK, PROTOCOL_VERSION);
+    ExecUnixRPCRequest(ssRequest, ssReply);
+    uint32_t nId;
+    uint8_t nStatus;
+    ssReply >> nId >> nStatus;
+    BOOST_CHECK_EQUAL(nId, nIdExpected);
+    BOOST_CHECK_EQUAL(nStatus, nStatusExpected);
+    return ssReply;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_unix)
+{
+    FinishRPCWarmup();
+    BOOST_CHECK(tableRPC.canExecuteBinary("getblock"));
+    BOOST_CHECK(!tableRPC.canExecuteBinary("decodescript"));
+
+    // Any method with JSON params and result
+    CDataStream ssRequest(SER_NETWORK, PROTOCOL_VERSION);
+    ssRequest << (uint32_t)7 << (uint8_t)UNIX_RPC_JSON << std::string("decodescript") << std::string("[\"51\"]");
+    CDataStream ssReply = ExecUnixRPC(ssRequest, 7, UNIX_RPC_OK);
+    std::string strResult;
+    ssReply >> strResult;
+    BOOST_CHECK(ssReply.empty());
+    BOOST_CHECK_EQUAL(strResult, CallRPC("decodescript 51").write());
+
+    // Errors carry the code and message of the JSON-RPC error
+    int32_t nCode;
+    std::string strMessage;
+    ssRequest.clear();
+    ssRequest << (uint32_t)8 << (uint8_t)UNIX_RPC_BINARY << std::string("getblock") << uint256();
+    ssReply = ExecUnixRPC(ssRequest, 8, UNIX_RPC_ERROR);
+    ssReply >> nCode >> strMessage;
+    BOOST_CHECK_EQUAL(nCode, RPC_INVALID_ADDRESS_OR_KEY);
+    BOOST_CHECK_EQUAL(strMessage, "Block not found");
+
+    // Binary params are checked for truncation and trailing data
+    ssRequest.clear();
+    ssRequest << (uint32_t)9 << (uint8_t)UNIX_RPC_BINARY << std::string("getblock") << (uint8_t)0;
+    ssReply = ExecUnixRPC(ssRequest, 9, UNIX_RPC_ERROR);
+    ssReply >> nCode;
+    BOOST_CHECK_EQUAL(nCode, RPC_DESERIALIZATION_ERROR);
+
+    ssRequest.clear();
+    ssRequest << (uint32_t)10 << (uint8_t)UNIX_RPC_BINARY << std::string("getaddressbalance") << std::vector<std::pair<uint160, int> >() << (uint8_t)0;
+    ssReply = ExecUnixRPC(ssRequest, 10, UNIX_RPC_ERROR);
+    ssReply >> nCode;
+    BOOST_CHECK_EQUAL(nCode, RPC_DESERIALIZATION_ERROR);
+
+    ssRequest.clear();
+    ssRequest << (uint32_t)11 << (uint8_t)UNIX_RPC_BINARY << std::string("decodescript");
+    ssReply = ExecUnixRPC(ssRequest, 11, UNIX_RPC_ERROR);
+    ssReply >> nCode;
+    BOOST_CHECK_EQUAL(nCode, RPC_METHOD_NOT_FOUND);
+
+    ssRequest.clear();
+    ssRequest << (uint32_t)12 << (uint8_t)2 << std::string("getblockcount");
+    ssReply = ExecUnixRPC(ssRequest, 12, UNIX_RPC_ERROR);
+    ssReply >> nCode;
+    BOOST_CHECK_EQUAL(nCode, RPC_INVALID_REQUEST);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_ban)
 {
     BOOST_CHECK_NO_THROW(CallRPC(string("clearbanned")));
@@ -75,6 +75,7 @@ BOOST_AUTO_TEST_CASE(getlocator_test)
     // Build a CChain for the main branch.
     CChain chain;
     chain.SetTip(&vBlocksMain.back());
+    BOOST_CHECK(chain.AtomicTip() == chain.Tip());
 
     // Test 100 random starting points for locators.
     for (int n=0; n<100; n++) {
@@ -2,6 +2,7 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
 #include "streams.h"
 #include "support/allocators/zeroafterfree.h"
 #include "test/test_dash.h"
@@ -64,4 +65,27 @@ BOOST_AUTO_TEST_CASE(streams_serializedata_xor)
             std::string(ds.begin(), ds.end()));  
 }         
 
+BOOST_AUTO_TEST_CASE(streams_span_reader)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << (uint32_t)7 << std::string("span") << (uint8_t)1;
+    std::vector<char> vData(ss.begin(), ss.end());
+
+    CSpanReader reader(&vData[0], vData.size(), SER_DISK, CLIENT_VERSION);
+    uint32_t n;
+    std::string str;
+    reader >> n >> str;
+    BOOST_CHECK_EQUAL(n, 7U);
+    BOOST_CHECK_EQUAL(str, "span");
+    BOOST_CHECK_EQUAL(reader.size(), 1U);
+
+    // reading past the end throws and leaves the position alone
+    BOOST_CHECK_THROW(reader >> n, std::ios_base::failure);
+    BOOST_CHECK_THROW(reader.ignore(2), std::ios_base::failure);
+    uint8_t nLast;
+    reader >> nLast;
+    BOOST_CHECK_EQUAL(nLast, 1);
+    BOOST_CHECK(reader.empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -15,6 +15,7 @@
 #include "net_processing.h"
 #include "pubkey.h"
 #include "random.h"
+#include "rpc/server.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -147,6 +148,11 @@ TestChain100Setup::~TestChain100Setup()
 {
 }
 
+void FinishRPCWarmup()
+{
+    if (RPCIsInWarmup(NULL))
+        SetRPCWarmupFinished();
+}
 
 CTxMemPoolEntry TestMemPoolEntryHelper::FromTx(CMutableTransaction &tx, CTxMemPool *pool) {
     CTransaction txn(tx);
@@ -26,7 +26,6 @@ struct BasicTestingSetup {
  */
 class CConnman;
 struct TestingSetup: public BasicTestingSetup {
-    CCoinsViewDB *pcoinsdbview;
     boost::filesystem::path pathTemp;
     boost::thread_group threadGroup;
     CConnman* connman;
@@ -57,6 +56,9 @@ struct TestChain100Setup : public TestingSetup {
     CKey coinbaseKey; // private/public key needed to spend coinbase transactions
 };
 
+/** Leave the RPC warmup, which the tests calling RPC methods share, if no test did yet */
+void FinishRPCWarmup();
+
 class CTxMemPoolEntry;
 class CTxMemPool;
 
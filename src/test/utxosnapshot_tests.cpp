@@ -0,0 +1,238 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "consensus/merkle.h"
+#include "random.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+#include "utxosnapshot.h"
+#include "version.h"
+#include "test/test_dash.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(utxosnapshot_tests, BasicTestingSetup)
+
+static void AddRandomCoins(CCoinsViewCache& cache, int nTransactions)
+{
+    for (int i = 0; i < nTransactions; i++) {
+        uint256 txid = GetRandHash();
+        for (int n = 0; n < 1 + i % 4; n++) {
+            CTxOut txout;
+            txout.nValue = GetRand(1000) + 1;
+            txout.scriptPubKey.assign(1 + GetRand(30), OP_TRUE);
+            cache.AddCoin(COutPoint(txid, n * 2), Coin(txout, i, n == 0 && i % 5 == 0), false);
+        }
+    }
+}
+
+struct SnapshotFile
+{
+    boost::filesystem::path path;
+
+    SnapshotFile() : path(GetTempPath() / strprintf("test_dash_utxosnapshot_%lu_%i", (unsigned long)GetTime(), (int)GetRand(100000))) {}
+    ~SnapshotFile() { boost::filesystem::remove(path); }
+};
+
+//! Write the coins of view and vTx to path, returning the commitment to the coins
+static CCoinsCommitment WriteSnapshot(CCoinsViewDB& view, const boost::filesystem::path& path,
+                                      const std::vector<CSnapshotTx>& vTx = std::vector<CSnapshotTx>())
+{
+    CCoinsCommitment commitment;
+    BOOST_CHECK(view.GetCommitment(commitment));
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(view.Cursor());
+    CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    std::string strError;
+    BOOST_CHECK(WriteUTXOSnapshot(file, pcursor.get(), commitment, vTx, strError));
+    return commitment;
+}
+
+static bool ReadSnapshot(const boost::filesystem::path& path, CCoinsCommitment& commitment, CCoinsViewCache* pview,
+                         std::vector<CSnapshotTx>* pvTx = NULL)
+{
+    CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    CUTXOSnapshotMetadata metadata;
+    std::vector<CSnapshotTx> vTx;
+    CCriticalSection csView;
+    std::string strError;
+    return ReadUTXOSnapshotMetadata(file, metadata, strError) &&
+           ReadUTXOSnapshotCoins(file, metadata, commitment, pview, &csView, 1 << 12, strError) &&
+           ReadUTXOSnapshotTxs(file, pvTx ? *pvTx : vTx, strError);
+}
+
+//! A block of nTransactions transactions with an output each
+static CBlock MakeBlock(int nTransactions)
+{
+    CBlock block;
+    for (int i = 0; i < nTransactions; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i + 1;
+        block.vtx.push_back(CTransaction(tx));
+    }
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_roundtrip)
+{
+    CCoinsViewDB source(1 << 20, true, true);
+    CCoinsViewCache cache(&source);
+    AddRandomCoins(cache, 300);
+    uint256 hashBlock = GetRandHash();
+    cache.SetBestBlock(hashBlock);
+    BOOST_CHECK(cache.Flush());
+
+    SnapshotFile snapshot;
+    CCoinsCommitment commitment = WriteSnapshot(source, snapshot.path);
+
+    {
+        CAutoFile file(fopen(snapshot.path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadata;
+        std::string strError;
+        BOOST_CHECK(ReadUTXOSnapshotMetadata(file, metadata, strError));
+        BOOST_CHECK(metadata.hashBlock == hashBlock);
+        BOOST_CHECK_EQUAL(metadata.nCoins, (uint64_t)commitment.nTransactionOutputs);
+    }
+
+    // Checking alone adds up to the same commitment
+    CCoinsCommitment commitmentRead;
+    BOOST_CHECK(ReadSnapshot(snapshot.path, commitmentRead, NULL));
+    BOOST_CHECK(commitmentRead.GetHash() == commitment.GetHash());
+    BOOST_CHECK_EQUAL(commitmentRead.nTotalAmount, commitment.nTotalAmount);
+
+    // Loading flushes as the cache fills, and ends with the same coins
+    CCoinsViewDB target(1 << 20, true, true);
+    CCoinsViewCache cacheTarget(&target);
+    CCoinsCommitment commitmentLoaded;
+    BOOST_CHECK(ReadSnapshot(snapshot.path, commitmentLoaded, &cacheTarget));
+    cacheTarget.SetBestBlock(hashBlock);
+    BOOST_CHECK(cacheTarget.Flush());
+    BOOST_CHECK(commitmentLoaded.GetHash() == commitment.GetHash());
+    CCoinsCommitment commitmentTarget;
+    BOOST_CHECK(target.GetCommitment(commitmentTarget));
+    BOOST_CHECK(commitmentTarget.GetHash() == commitment.GetHash());
+
+    boost::scoped_ptr<CCoinsViewCursor> pcursor(source.Cursor());
+    int nCoins = 0;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint outpoint;
+        Coin coin, coinTarget;
+        BOOST_CHECK(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        BOOST_CHECK(target.GetCoin(outpoint, coinTarget));
+        BOOST_CHECK(coin.out == coinTarget.out);
+        BOOST_CHECK_EQUAL(coin.nHeight, coinTarget.nHeight);
+        BOOST_CHECK_EQUAL(coin.fCoinBase, coinTarget.fCoinBase);
+        nCoins++;
+    }
+    BOOST_CHECK_EQUAL(nCoins, commitment.nTransactionOutputs);
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_corrupt)
+{
+    CCoinsViewDB source(1 << 20, true, true);
+    CCoinsViewCache cache(&source);
+    AddRandomCoins(cache, 20);
+    cache.SetBestBlock(GetRandHash());
+    BOOST_CHECK(cache.Flush());
+
+    SnapshotFile snapshot;
+    CCoinsCommitment commitment = WriteSnapshot(source, snapshot.path);
+    size_t nSize = boost::filesystem::file_size(snapshot.path);
+
+    // A file cut short is rejected
+    boost::filesystem::resize_file(snapshot.path, nSize - 1);
+    CCoinsCommitment commitmentRead;
+    BOOST_CHECK(!ReadSnapshot(snapshot.path, commitmentRead, NULL));
+
+    // So is one with trailing data
+    boost::filesystem::resize_file(snapshot.path, nSize + 1);
+    commitmentRead = CCoinsCommitment();
+    BOOST_CHECK(!ReadSnapshot(snapshot.path, commitmentRead, NULL));
+
+    // A flipped bit in a coin, the last one before the empty transactions, reads, but doesn't match the commitment
+    boost::filesystem::resize_file(snapshot.path, nSize);
+    {
+        FILE* file = fopen(snapshot.path.string().c_str(), "rb+");
+        BOOST_CHECK(file);
+        fseek(file, -2, SEEK_END);
+        int c = fgetc(file);
+        fseek(file, -2, SEEK_END);
+        fputc(c ^ 1, file);
+        fclose(file);
+    }
+    commitmentRead = CCoinsCommitment();
+    if (ReadSnapshot(snapshot.path, commitmentRead, NULL))
+        BOOST_CHECK(commitmentRead.GetHash() != commitment.GetHash());
+
+    // And a file for another network isn't read at all
+    {
+        CAutoFile file(fopen(snapshot.path.string().c_str(), "rb+"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadata;
+        std::string strError;
+        BOOST_CHECK(ReadUTXOSnapshotMetadata(file, metadata, strError));
+        metadata.pchMessageStart[0] ^= 1;
+        fseek(file.Get(), 5 + 4, SEEK_SET);
+        file << metadata;
+    }
+    {
+        CAutoFile file(fopen(snapshot.path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadata;
+        std::string strError;
+        BOOST_CHECK(!ReadUTXOSnapshotMetadata(file, metadata, strError));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(utxosnapshot_txs)
+{
+    CBlock block = MakeBlock(7);
+    CSnapshotTx snapshotTx(block, block.vtx[5]);
+    BOOST_CHECK(snapshotTx.IsProven());
+    BOOST_CHECK(snapshotTx.merkleBlock.header.GetHash() == block.GetHash());
+
+    // Neither another transaction nor the proof of another block proves it
+    CSnapshotTx snapshotTxOther(snapshotTx);
+    snapshotTxOther.tx = block.vtx[4];
+    BOOST_CHECK(!snapshotTxOther.IsProven());
+    snapshotTxOther = snapshotTx;
+    snapshotTxOther.merkleBlock.header.hashMerkleRoot = GetRandHash();
+    BOOST_CHECK(!snapshotTxOther.IsProven());
+
+    // The transactions follow the coins
+    CCoinsViewDB source(1 << 20, true, true);
+    CCoinsViewCache cache(&source);
+    AddRandomCoins(cache, 20);
+    cache.SetBestBlock(GetRandHash());
+    BOOST_CHECK(cache.Flush());
+
+    std::vector<CSnapshotTx> vTx;
+    vTx.push_back(snapshotTx);
+    vTx.push_back(CSnapshotTx(block, block.vtx[0]));
+    SnapshotFile snapshot;
+    CCoinsCommitment commitment = WriteSnapshot(source, snapshot.path, vTx);
+
+    CCoinsCommitment commitmentRead;
+    std::vector<CSnapshotTx> vTxRead;
+    BOOST_CHECK(ReadSnapshot(snapshot.path, commitmentRead, NULL, &vTxRead));
+    BOOST_CHECK(commitmentRead.GetHash() == commitment.GetHash());
+    BOOST_CHECK_EQUAL(vTxRead.size(), 2U);
+    BOOST_CHECK(vTxRead[0].tx.GetHash() == block.vtx[5].GetHash());
+    BOOST_CHECK(vTxRead[1].tx.GetHash() == block.vtx[0].GetHash());
+    BOOST_CHECK(vTxRead[1].merkleBlock.header.GetHash() == block.GetHash());
+
+    // A transaction which isn't proven fails the file
+    vTx.push_back(snapshotTxOther);
+    SnapshotFile snapshotUnproven;
+    WriteSnapshot(source, snapshotUnproven.path, vTx);
+    commitmentRead = CCoinsCommitment();
+    BOOST_CHECK(!ReadSnapshot(snapshotUnproven.path, commitmentRead, NULL));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,87 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Hashed timer wheel with a slot per second: items are scheduled at a time
+ * and taken out again once the wheel has been advanced past it.
+ *
+ * Scheduling is O(1). Advancing the wheel by one second only looks at the
+ * items of one slot, those due and those a multiple of the wheel size later.
+ * Items can't be cancelled, the caller skips items which became stale.
+ *
+ * Not thread safe, the caller locks.
+ */
+template <typename T>
+class CTimerWheel
+{
+public:
+    typedef std::pair<int64_t, T> entry_type;
+
+private:
+    std::vector<std::vector<entry_type> > vSlots;
+    //! The wheel was advanced up to and including this time
+    int64_t nTimeAdvanced;
+    size_t nSize;
+
+    std::vector<entry_type>& Slot(int64_t nTime) { return vSlots[(uint64_t)nTime % vSlots.size()]; }
+
+public:
+    explicit CTimerWheel(size_t nSlots = 4096) : vSlots(nSlots), nTimeAdvanced(0), nSize(0) {}
+
+    /**
+     * Schedule an item, an item scheduled in the past is due on the next Advance().
+     * Returns the time it was scheduled at, which Advance() hands back with it.
+     */
+    int64_t Schedule(int64_t nTime, const T& item)
+    {
+        if (nTime <= nTimeAdvanced)
+            nTime = nTimeAdvanced + 1;
+        Slot(nTime).push_back(entry_type(nTime, item));
+        nSize++;
+        return nTime;
+    }
+
+    /** Advance the wheel to nTime and append the items due to vDue, with the time they were scheduled at */
+    void Advance(int64_t nTime, std::vector<entry_type>& vDue)
+    {
+        if (nTime <= nTimeAdvanced)
+            return;
+        // Every slot is looked at once at most, however long ago the wheel was advanced
+        int64_t nFrom = std::max(nTimeAdvanced + 1, nTime - (int64_t)vSlots.size() + 1);
+        for (int64_t t = nFrom; t <= nTime; t++) {
+            std::vector<entry_type>& vSlot = Slot(t);
+            for (size_t i = 0; i < vSlot.size(); ) {
+                if (vSlot[i].first <= nTime) {
+                    vDue.push_back(vSlot[i]);
+                    vSlot[i] = vSlot.back();
+                    vSlot.pop_back();
+                    nSize--;
+                } else {
+                    i++;
+                }
+            }
+        }
+        nTimeAdvanced = nTime;
+    }
+
+    size_t size() const { return nSize; }
+    bool empty() const { return nSize == 0; }
+
+    void clear()
+    {
+        for (size_t i = 0; i < vSlots.size(); i++)
+            vSlots[i].clear();
+        nSize = 0;
+    }
+};
+
+#endif // TIMERWHEEL_H
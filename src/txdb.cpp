@@ -6,14 +6,22 @@
 #include "txdb.h"
 
 #include "chainparams.h"
+#include "checkqueue.h"
 #include "hash.h"
 #include "pow.h"
 #include "uint256.h"
 #include "ui_interface.h"
 #include "init.h"
+#include "util.h"
+#include "utiltime.h"
+#include "utxosnapshot.h"
 
+#include <algorithm>
+#include <limits>
+#include <set>
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 
 using namespace std;
@@ -24,14 +32,50 @@ static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
 static const char DB_ADDRESSINDEX = 'a';
 static const char DB_ADDRESSUNSPENTINDEX = 'u';
+static const char DB_ADDRESSSUMMARY = 'A';
 static const char DB_TIMESTAMPINDEX = 's';
 static const char DB_SPENTINDEX = 'p';
 static const char DB_BLOCK_INDEX = 'b';
 
 static const char DB_BEST_BLOCK = 'B';
+static const char DB_COINS_COMMITMENT = 'M';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_SNAPSHOT_BASE = 'S';
+static const char DB_SNAPSHOT_TX = 'T';
+
+int nDBMaxOpenFiles = DEFAULT_DB_MAX_OPEN_FILES;
+bool fDBCompressIndex = DEFAULT_DB_COMPRESS_INDEX;
+
+/**
+ * The chainstate is hit by random point lookups of coins which mostly miss
+ * in the upper levels, so it relies on the bloom filter and on keeping
+ * table files open. Its values are small and close to incompressible.
+ */
+static CDBWrapperOptions GetCoinsDBOptions()
+{
+    CDBWrapperOptions dbOptions;
+    dbOptions.nMaxOpenFiles = nDBMaxOpenFiles;
+    return dbOptions;
+}
+
+/**
+ * Besides the block index, this database carries the tx, address, spent and
+ * timestamp indexes. Those are read far more than written and are mostly
+ * scanned by key prefix, so favour the block cache and larger blocks, which
+ * also compress better.
+ */
+static CDBWrapperOptions GetBlockTreeDBOptions()
+{
+    CDBWrapperOptions dbOptions;
+    dbOptions.nMaxOpenFiles = nDBMaxOpenFiles;
+    dbOptions.fCompression = fDBCompressIndex;
+    dbOptions.nBlockSize = 16 * 1024;
+    dbOptions.nBlockCachePercent = 75;
+    dbOptions.nWriteBufferPercent = 12;
+    return dbOptions;
+}
 
 namespace {
 
@@ -57,26 +101,85 @@ struct CoinEntry {
 
 }
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, bool fBackgroundFlushIn, const std::string& strName) :
+    db(GetDataDir() / strName, nCacheSize, fMemory, fWipe, true, GetCoinsDBOptions()),
+    fBackgroundFlush(fBackgroundFlushIn),
+    fFlushShutdown(false),
+    fFlushing(false),
+    fFlushFailed(false),
+    fCommitment(false),
+    fCommitmentFlushing(false),
+    fComputingCommitment(false),
+    nBatchWrites(0),
+    nFlushes(0),
+    nFlushFailures(0)
 {
+    uint256 hashBestChain;
+    std::pair<uint256, CCoinsCommitment> record;
+    if (!db.Read(DB_BEST_BLOCK, hashBestChain)) {
+        // A new database commits to the empty set
+        fCommitment = true;
+    } else if (db.Read(DB_COINS_COMMITMENT, record) && record.first == hashBestChain) {
+        // Otherwise the commitment is only good if the coins weren't written
+        // without it since, by a version which doesn't keep it
+        fCommitment = true;
+        commitment = record.second;
+    }
+    if (fBackgroundFlush)
+        threadFlush = boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "coinsflush", boost::function<void()>(boost::bind(&CCoinsViewDB::ThreadFlush, this))));
+}
+
+CCoinsViewDB::~CCoinsViewDB()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        fFlushShutdown = true;
+    }
+    condFlush.notify_all();
+    // The writer commits an in-flight batch before it exits
+    if (threadFlush.joinable())
+        threadFlush.join();
 }
 
 bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    if (fBackgroundFlush) {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        if (fFlushing) {
+            CCoinsMap::const_iterator it = mapFlushing.find(outpoint);
+            if (it != mapFlushing.end() && (it->second.flags & CCoinsCacheEntry::DIRTY)) {
+                coin = it->second.coin;
+                return !coin.IsSpent();
+            }
+        }
+    }
     return db.Read(CoinEntry(&outpoint), coin);
 }
 
 bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    if (fBackgroundFlush) {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        if (fFlushing) {
+            CCoinsMap::const_iterator it = mapFlushing.find(outpoint);
+            if (it != mapFlushing.end() && (it->second.flags & CCoinsCacheEntry::DIRTY))
+                return !it->second.coin.IsSpent();
+        }
+    }
     return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
+    if (fBackgroundFlush) {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        if (fFlushing && !hashBlockFlushing.IsNull())
+            return hashBlockFlushing;
+    }
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
         return uint256();
     return hashBestChain;
 }
 
-bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+bool CCoinsViewDB::WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment *pcommitment, bool fErase) {
     CDBBatch batch(db);
     size_t count = 0;
     size_t changed = 0;
@@ -90,23 +193,274 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
             changed++;
         }
         count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
+        if (fErase) {
+            CCoinsMap::iterator itOld = it++;
+            mapCoins.erase(itOld);
+        } else {
+            ++it;
+        }
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
+    if (pcommitment) {
+        // Recorded with the best block, to notice writes which didn't update it
+        uint256 hashBestChain = hashBlock;
+        if (hashBestChain.IsNull())
+            db.Read(DB_BEST_BLOCK, hashBestChain);
+        batch.Write(DB_COINS_COMMITMENT, std::make_pair(hashBestChain, *pcommitment));
+    }
 
     bool ret = db.WriteBatch(batch);
     LogPrint("coindb", "Committed %u changed transaction outputs (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
     return ret;
 }
 
+static void AddLatencySample(std::deque<int64_t>& samples, int64_t nMicros)
+{
+    samples.push_back(nMicros);
+    if (samples.size() > COINS_FLUSH_LATENCY_SAMPLES)
+        samples.pop_front();
+}
+
+bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) {
+    int64_t nStart = GetTimeMicros();
+    bool fCommitmentWrite;
+    CCoinsCommitment commitmentWrite;
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        nBatchWrites++;
+        if (fCommitment)
+            commitment += commitmentDelta;
+        if (fComputingCommitment)
+            commitmentSinceCursor += commitmentDelta;
+        fCommitmentWrite = fCommitment;
+        commitmentWrite = commitment;
+    }
+    if (!fBackgroundFlush) {
+        bool ret = WriteCoins(mapCoins, hashBlock, fCommitmentWrite ? &commitmentWrite : NULL, true);
+        int64_t nTime = GetTimeMicros() - nStart;
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        nFlushes++;
+        if (!ret)
+            nFlushFailures++;
+        AddLatencySample(vStallMicros, nTime);
+        AddLatencySample(vWriteMicros, nTime);
+        return ret;
+    }
+
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    WaitForFlush(lock);
+    if (fFlushFailed)
+        return false;
+    // Hand the whole map over; the caller gets back the empty one the writer left behind
+    mapFlushing.swap(mapCoins);
+    hashBlockFlushing = hashBlock;
+    fCommitmentFlushing = fCommitmentWrite;
+    commitmentFlushing = commitmentWrite;
+    fFlushing = true;
+    int64_t nStall = GetTimeMicros() - nStart;
+    AddLatencySample(vStallMicros, nStall);
+    size_t nEntries = mapFlushing.size();
+    lock.unlock();
+    condFlush.notify_all();
+    LogPrint("coindb", "Handed %u cache entries to the background writer, waited %.2fms for the previous flush\n", (unsigned int)nEntries, 0.001 * nStall);
+    return true;
+}
+
+void CCoinsViewDB::ThreadFlush()
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    while (true) {
+        while (!fFlushing && !fFlushShutdown)
+            condFlush.wait(lock);
+        if (!fFlushing)
+            return;
+
+        // Nobody modifies the in-flight map until fFlushing is cleared, and
+        // readers only look it up, so it can be serialized without the lock.
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = WriteCoins(mapFlushing, hashBlockFlushing, fCommitmentFlushing ? &commitmentFlushing : NULL, false);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        int64_t nWrite = GetTimeMicros() - nStart;
+
+        CCoinsMap mapDone;
+        lock.lock();
+        mapDone.swap(mapFlushing);
+        hashBlockFlushing.SetNull();
+        fFlushing = false;
+        nFlushes++;
+        if (!fOk) {
+            fFlushFailed = true;
+            nFlushFailures++;
+        }
+        AddLatencySample(vWriteMicros, nWrite);
+        condFlush.notify_all();
+        LogPrint("bench", "    - Background coins flush: %.2fms (%u entries)\n", 0.001 * nWrite, (unsigned int)mapDone.size());
+
+        // Free the flushed entries without holding up readers
+        lock.unlock();
+        mapDone = CCoinsMap();
+        lock.lock();
+    }
+}
+
+void CCoinsViewDB::WaitForFlush(boost::unique_lock<boost::mutex>& lock) const
+{
+    while (fFlushing)
+        condFlush.wait(lock);
+}
+
+bool CCoinsViewDB::WaitForFlush()
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    WaitForFlush(lock);
+    return !fFlushFailed;
+}
+
+static void GetLatency(const std::deque<int64_t>& samples, CCoinsFlushLatency& latency)
+{
+    std::vector<int64_t> vSorted(samples.begin(), samples.end());
+    std::sort(vSorted.begin(), vSorted.end());
+    if (vSorted.empty()) {
+        latency.nP50 = latency.nP90 = latency.nP99 = latency.nMax = 0;
+        return;
+    }
+    latency.nP50 = vSorted[(vSorted.size() - 1) * 50 / 100];
+    latency.nP90 = vSorted[(vSorted.size() - 1) * 90 / 100];
+    latency.nP99 = vSorted[(vSorted.size() - 1) * 99 / 100];
+    latency.nMax = vSorted.back();
+}
+
+uint64_t CCoinsViewDB::GetBatchWriteCount() const
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    return nBatchWrites;
+}
+
+void CCoinsViewDB::GetFlushStats(CCoinsFlushStats &stats) const
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    stats.fBackground = fBackgroundFlush;
+    stats.fInProgress = fFlushing;
+    stats.nFlushes = nFlushes;
+    stats.nFailures = nFlushFailures;
+    stats.nFlushingEntries = fFlushing ? mapFlushing.size() : 0;
+    GetLatency(vStallMicros, stats.stall);
+    GetLatency(vWriteMicros, stats.write);
+}
+
 size_t CCoinsViewDB::EstimateSize() const
 {
     return db.EstimateSize(DB_COIN, (char)(DB_COIN+1));
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+static DBKeyRanges MakeCoinsKeyRanges()
+{
+    DBKeyRanges ranges;
+    ranges.push_back(std::make_pair("coins", DB_COIN));
+    ranges.push_back(std::make_pair("legacycoins", DB_COINS));
+    return ranges;
+}
+
+const DBKeyRanges& CCoinsViewDB::GetKeyRanges()
+{
+    static const DBKeyRanges ranges = MakeCoinsKeyRanges();
+    return ranges;
+}
+
+bool CIndexNegativeCache::Contains(const std::string& strKey) const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (mapKeys.count(strKey)) {
+        nHits++;
+        return true;
+    }
+    nMisses++;
+    return false;
+}
+
+uint64_t CIndexNegativeCache::GetEpoch() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nEpoch;
+}
+
+void CIndexNegativeCache::Add(const std::string& strKey, uint64_t nEpochStart)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (nEpoch != nEpochStart || nMaxEntries == 0)
+        return;
+    if (!mapKeys.insert(std::make_pair(strKey, nSequence)).second)
+        return;
+    vOrder.push_back(std::make_pair(nSequence++, strKey));
+    while (mapKeys.size() > nMaxEntries) {
+        // Only the latest entry of a key evicts it
+        std::unordered_map<std::string, uint64_t>::iterator it = mapKeys.find(vOrder.front().second);
+        if (it != mapKeys.end() && it->second == vOrder.front().first)
+            mapKeys.erase(it);
+        vOrder.pop_front();
+    }
+    if (vOrder.size() > 2 * nMaxEntries) {
+        // Drop the stale entries
+        std::deque<std::pair<uint64_t, std::string> > vLive;
+        for (size_t i = 0; i < vOrder.size(); i++) {
+            std::unordered_map<std::string, uint64_t>::const_iterator it = mapKeys.find(vOrder[i].second);
+            if (it != mapKeys.end() && it->second == vOrder[i].first)
+                vLive.push_back(vOrder[i]);
+        }
+        vOrder.swap(vLive);
+    }
+}
+
+void CIndexNegativeCache::Invalidate(const std::vector<std::string>& vKeys)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nEpoch++;
+    BOOST_FOREACH(const std::string& strKey, vKeys)
+        nInvalidated += mapKeys.erase(strKey);
+}
+
+void CIndexNegativeCache::GetStats(CIndexNegativeCacheStats& stats) const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    stats.nEntries = mapKeys.size();
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nInvalidated = nInvalidated;
+}
+
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) :
+    CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, GetBlockTreeDBOptions()),
+    negativeCache(INDEX_NEGATIVE_CACHE_SIZE)
+{
+}
+
+static DBKeyRanges MakeBlockTreeKeyRanges()
+{
+    DBKeyRanges ranges;
+    ranges.push_back(std::make_pair("blockindex", DB_BLOCK_INDEX));
+    ranges.push_back(std::make_pair("blockfiles", DB_BLOCK_FILES));
+    ranges.push_back(std::make_pair("txindex", DB_TXINDEX));
+    ranges.push_back(std::make_pair("addressindex", DB_ADDRESSINDEX));
+    ranges.push_back(std::make_pair("addressunspentindex", DB_ADDRESSUNSPENTINDEX));
+    ranges.push_back(std::make_pair("addresssummary", DB_ADDRESSSUMMARY));
+    ranges.push_back(std::make_pair("spentindex", DB_SPENTINDEX));
+    ranges.push_back(std::make_pair("timestampindex", DB_TIMESTAMPINDEX));
+    ranges.push_back(std::make_pair("flags", DB_FLAG));
+    ranges.push_back(std::make_pair("reindexflag", DB_REINDEX_FLAG));
+    ranges.push_back(std::make_pair("lastblockfile", DB_LAST_BLOCK));
+    return ranges;
+}
+
+const DBKeyRanges& CBlockTreeDB::GetKeyRanges()
+{
+    static const DBKeyRanges ranges = MakeBlockTreeKeyRanges();
+    return ranges;
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -125,13 +479,64 @@ bool CBlockTreeDB::ReadReindexing(bool &fReindexing) {
     return true;
 }
 
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hash, unsigned int nChainTx) {
+    return Write(DB_SNAPSHOT_BASE, std::make_pair(hash, nChainTx), true);
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hash, unsigned int &nChainTx) {
+    std::pair<uint256, unsigned int> record;
+    if (!Read(DB_SNAPSHOT_BASE, record))
+        return false;
+    hash = record.first;
+    nChainTx = record.second;
+    return true;
+}
+
+bool CBlockTreeDB::EraseSnapshotBase() {
+    CDBBatch batch(*this);
+    batch.Erase(DB_SNAPSHOT_BASE);
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(DB_SNAPSHOT_TX, uint256()));
+    while (pcursor->Valid()) {
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_SNAPSHOT_TX)
+            break;
+        batch.Erase(key);
+        pcursor->Next();
+    }
+    return WriteBatch(batch, true);
+}
+
+bool CBlockTreeDB::WriteSnapshotTxs(const std::vector<CSnapshotTx> &vTx) {
+    CDBBatch batch(*this);
+    for (std::vector<CSnapshotTx>::const_iterator it = vTx.begin(); it != vTx.end(); it++)
+        batch.Write(make_pair(DB_SNAPSHOT_TX, it->tx.GetHash()), *it);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSnapshotTx(const uint256 &txid, CSnapshotTx &snapshotTx) {
+    return Read(make_pair(DB_SNAPSHOT_TX, txid), snapshotTx);
+}
+
 bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
 CCoinsViewCursor *CCoinsViewDB::Cursor() const
 {
-    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
+    // Iterate over committed data only
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    WaitForFlush(lock);
+    return NewCursor();
+}
+
+CCoinsViewDBCursor *CCoinsViewDB::NewCursor() const
+{
+    uint256 hashBestChain;
+    if (!db.Read(DB_BEST_BLOCK, hashBestChain))
+        hashBestChain.SetNull();
+    // The iterator reads a snapshot of the database as it is now
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), hashBestChain);
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
@@ -147,6 +552,68 @@ CCoinsViewCursor *CCoinsViewDB::Cursor() const
     return i;
 }
 
+bool CCoinsViewDB::GetCommitment(CCoinsCommitment &commitmentOut) const
+{
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    if (!fCommitment)
+        return false;
+    commitmentOut = commitment;
+    return true;
+}
+
+bool CCoinsViewDB::ComputeCommitment()
+{
+    boost::unique_lock<boost::mutex> lockCompute(csComputeCommitment);
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor;
+    {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        if (fCommitment)
+            return true;
+        WaitForFlush(lock);
+        pcursor.reset(NewCursor());
+        fComputingCommitment = true;
+        commitmentSinceCursor = CCoinsCommitment();
+    }
+
+    // Batches written meanwhile are collected by BatchWrite
+    int64_t nStart = GetTimeMillis();
+    CCoinsCommitment commitmentWalked;
+    bool fOk = true;
+    try {
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                fOk = false;
+                break;
+            }
+            commitmentWalked.Add(key, coin);
+            pcursor->Next();
+        }
+    } catch (...) {
+        boost::unique_lock<boost::mutex> lock(csFlush);
+        fComputingCommitment = false;
+        throw;
+    }
+
+    boost::unique_lock<boost::mutex> lock(csFlush);
+    fComputingCommitment = false;
+    if (!fOk)
+        return error("%s: unable to read value", __func__);
+    commitmentWalked += commitmentSinceCursor;
+    // A batch handed over before now was written without the commitment
+    WaitForFlush(lock);
+    uint256 hashBestChain;
+    db.Read(DB_BEST_BLOCK, hashBestChain);
+    if (!db.Write(DB_COINS_COMMITMENT, std::make_pair(hashBestChain, commitmentWalked)))
+        return error("%s: failed to write the commitment", __func__);
+    fCommitment = true;
+    commitment = commitmentWalked;
+    LogPrintf("Computed the commitment to %d coins in %dms\n", commitment.nTransactionOutputs, GetTimeMillis() - nStart);
+    return true;
+}
+
 bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
 {
     // Return cached key
@@ -207,36 +674,59 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
 }
 
 bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value) {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+    std::string strNegativeKey = CIndexNegativeCache::MakeKey(DB_SPENTINDEX, key);
+    if (negativeCache.Contains(strNegativeKey))
+        return false;
+    uint64_t nEpoch = negativeCache.GetEpoch();
+    if (Read(make_pair(DB_SPENTINDEX, key), value))
+        return true;
+    negativeCache.Add(strNegativeKey, nEpoch);
+    return false;
 }
 
 bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
     CDBBatch batch(*this);
+    std::vector<std::string> vNegativeKeys;
     for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_SPENTINDEX, it->first));
         } else {
             batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+            vNegativeKeys.push_back(CIndexNegativeCache::MakeKey(DB_SPENTINDEX, it->first));
         }
     }
-    return WriteBatch(batch);
+    negativeCache.Invalidate(vNegativeKeys);
+    bool ret = WriteBatch(batch);
+    negativeCache.Invalidate(vNegativeKeys);
+    return ret;
 }
 
 bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
     CDBBatch batch(*this);
+    std::vector<std::string> vNegativeKeys;
     for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
         if (it->second.IsNull()) {
             batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
         } else {
             batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+            vNegativeKeys.push_back(CIndexNegativeCache::MakeKey(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(it->first.type, it->first.hashBytes)));
         }
     }
-    return WriteBatch(batch);
+    negativeCache.Invalidate(vNegativeKeys);
+    bool ret = WriteBatch(batch);
+    negativeCache.Invalidate(vNegativeKeys);
+    return ret;
 }
 
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
 
+    std::string strNegativeKey = CIndexNegativeCache::MakeKey(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash));
+    if (negativeCache.Contains(strNegativeKey))
+        return true;
+    uint64_t nEpoch = negativeCache.GetEpoch();
+    size_t nFound = 0;
+
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
     pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
@@ -248,6 +738,7 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
             CAddressUnspentValue nValue;
             if (pcursor->GetValue(nValue)) {
                 unspentOutputs.push_back(make_pair(key.second, nValue));
+                nFound++;
                 pcursor->Next();
             } else {
                 return error("failed to get address unspent value");
@@ -257,27 +748,456 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
         }
     }
 
+    if (nFound == 0)
+        negativeCache.Add(strNegativeKey, nEpoch);
+    return true;
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndexPage(uint160 addressHash, int type,
+                                               std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                                               size_t nLimit, bool fReverse, const CAddressUnspentKey *pCursor) {
+
+    if (negativeCache.Contains(CIndexNegativeCache::MakeKey(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash))))
+        return true;
+
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    if (pCursor) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, addressHash, pCursor->txhash, pCursor->index)));
+    } else if (!fReverse) {
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressIndexIteratorKey(type, addressHash)));
+    } else {
+        uint256 hashLast;
+        std::fill(hashLast.begin(), hashLast.end(), 0xff);
+        pcursor->Seek(make_pair(DB_ADDRESSUNSPENTINDEX, CAddressUnspentKey(type, addressHash, hashLast, 0xffffffff)));
+    }
+    // The cursor is the last entry returned before, step over it
+    if (fReverse) {
+        if (pcursor->Valid())
+            pcursor->Prev();
+        else
+            pcursor->SeekToLast();
+    }
+
+    CAddressUnspentPositionCompare comp;
+    size_t nFound = 0;
+    while (pcursor->Valid() && nFound < nLimit) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressUnspentKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSUNSPENTINDEX || key.second.type != (unsigned int)type || key.second.hashBytes != addressHash)
+            break;
+        if (pCursor && !fReverse && !comp(*pCursor, key.second)) {
+            pcursor->Next();
+            continue;
+        }
+        CAddressUnspentValue nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address unspent value");
+        unspentOutputs.push_back(make_pair(key.second, nValue));
+        nFound++;
+        if (fReverse)
+            pcursor->Prev();
+        else
+            pcursor->Next();
+    }
+    return true;
+}
+
+CAddressIndexCursor::CAddressIndexCursor(CDBIterator* pcursorIn, uint160 addressHashIn, int typeIn, bool fReverseIn,
+                                         const CAddressIndexKey* pCursor, int startIn, int endIn) :
+    pcursor(pcursorIn), addressHash(addressHashIn), type(typeIn), fReverse(fReverseIn), fHaveCursor(pCursor != NULL),
+    start(startIn), end(endIn), fValid(false), fFailed(false), nValue(0)
+{
+    if (pCursor)
+        cursor = *pCursor;
+}
+
+void CAddressIndexCursor::Seek()
+{
+    // May run on an address seek thread, which must not be taken down by a
+    // database error
+    try {
+        if (fHaveCursor) {
+            CAddressIndexKey seekKey(cursor);
+            seekKey.type = type;
+            seekKey.hashBytes = addressHash;
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, seekKey));
+        } else if (!fReverse) {
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, std::max(start, 0))));
+        } else {
+            int nAfter = end > 0 && end < std::numeric_limits<int>::max() ? end + 1 : std::numeric_limits<int>::max();
+            pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, nAfter)));
+        }
+        // The cursor is the last entry returned before, step over it
+        if (fReverse) {
+            if (pcursor->Valid())
+                pcursor->Prev();
+            else
+                pcursor->SeekToLast();
+        }
+        Load();
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        fValid = false;
+        fFailed = true;
+    }
+}
+
+void CAddressIndexCursor::Step()
+{
+    if (fReverse)
+        pcursor->Prev();
+    else
+        pcursor->Next();
+}
+
+void CAddressIndexCursor::Load()
+{
+    fValid = false;
+    CAddressIndexPositionCompare comp;
+    while (pcursor->Valid()) {
+        std::pair<char,CAddressIndexKey> dbKey;
+        if (!pcursor->GetKey(dbKey) || dbKey.first != DB_ADDRESSINDEX || dbKey.second.type != (unsigned int)type || dbKey.second.hashBytes != addressHash)
+            return;
+        const CAddressIndexKey& entry = dbKey.second;
+        if (fReverse ? (start > 0 && entry.blockHeight < start) : (end > 0 && entry.blockHeight > end))
+            return;
+        bool fSkip = fReverse ? (end > 0 && entry.blockHeight > end) : (fHaveCursor && !comp(cursor, entry));
+        if (!fSkip) {
+            if (!pcursor->GetValue(nValue)) {
+                fFailed = true;
+                return;
+            }
+            key = entry;
+            fValid = true;
+            return;
+        }
+        Step();
+    }
+}
+
+void CAddressIndexCursor::Next()
+{
+    Step();
+    Load();
+}
+
+CAddressIndexCursor* CBlockTreeDB::NewAddressIndexCursor(uint160 addressHash, int type, bool fReverse,
+                                                         const CAddressIndexKey *pCursor, int start, int end) {
+    if (negativeCache.Contains(CIndexNegativeCache::MakeKey(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash))))
+        return NULL;
+    return new CAddressIndexCursor(NewIterator(), addressHash, type, fReverse, pCursor, start, end);
+}
+
+bool CBlockTreeDB::ReadAddressIndexPage(uint160 addressHash, int type,
+                                        std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                                        size_t nLimit, bool fReverse, const CAddressIndexKey *pCursor,
+                                        int start, int end) {
+
+    boost::scoped_ptr<CAddressIndexCursor> pcursor(NewAddressIndexCursor(addressHash, type, fReverse, pCursor, start, end));
+    if (!pcursor)
+        return true;
+
+    size_t nFound = 0;
+    for (pcursor->Seek(); pcursor->Valid() && nFound < nLimit; pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        addressIndex.push_back(make_pair(pcursor->GetKey(), pcursor->GetValue()));
+        nFound++;
+    }
+    if (pcursor->Failed())
+        return error("failed to get address index value");
     return true;
 }
 
+/** Positions one cursor of a CAddressIndexMerger */
+class CAddressSeekCheck
+{
+private:
+    CAddressIndexCursor* pcursor;
+
+public:
+    CAddressSeekCheck() : pcursor(NULL) {}
+    CAddressSeekCheck(CAddressIndexCursor* pcursorIn) : pcursor(pcursorIn) {}
+
+    bool operator()() {
+        pcursor->Seek();
+        return true;
+    }
+
+    void swap(CAddressSeekCheck& check) {
+        std::swap(pcursor, check.pcursor);
+    }
+};
+
+int nAddressSeekThreads = 0;
+static CCheckQueue<CAddressSeekCheck> addressseekqueue(8);
+//! CCheckQueue supports a single master at a time
+static boost::mutex csAddressSeek;
+
+void ThreadAddressSeek() {
+    RenameThread("dash-addrseek");
+    addressseekqueue.Thread();
+}
+
+CAddressIndexMerger::CAddressIndexMerger(CBlockTreeDB& db, const std::vector<std::pair<uint160, int> >& addresses, bool fReverseIn,
+                                         const CAddressIndexKey* pCursor, int start, int end) :
+    fReverse(fReverseIn), fFailed(false)
+{
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressIndexCursor* pcursor = db.NewAddressIndexCursor(it->first, it->second, fReverse, pCursor, start, end);
+        if (pcursor)
+            vCursors.push_back(pcursor);
+    }
+}
+
+CAddressIndexMerger::~CAddressIndexMerger()
+{
+    BOOST_FOREACH(CAddressIndexCursor* pcursor, vCursors)
+        delete pcursor;
+}
+
+bool CAddressIndexMerger::HeapCompare(const CAddressIndexCursor* a, const CAddressIndexCursor* b) const
+{
+    // std heaps put the greatest element first, so order the next entry last
+    CAddressIndexPositionCompare comp;
+    return fReverse ? comp(a->GetKey(), b->GetKey()) : comp(b->GetKey(), a->GetKey());
+}
+
+void CAddressIndexMerger::Seek(bool fParallel)
+{
+    // Every seek is a separate walk down the LevelDB levels, most likely
+    // hitting the disk, so it pays to have them in flight concurrently.
+    boost::unique_lock<boost::mutex> lock(csAddressSeek, boost::defer_lock);
+    if (fParallel && nAddressSeekThreads > 0 && vCursors.size() > 1 && lock.try_lock()) {
+        CCheckQueueControl<CAddressSeekCheck> control(&addressseekqueue);
+        std::vector<CAddressSeekCheck> vChecks;
+        vChecks.reserve(vCursors.size());
+        BOOST_FOREACH(CAddressIndexCursor* pcursor, vCursors)
+            vChecks.push_back(CAddressSeekCheck(pcursor));
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        BOOST_FOREACH(CAddressIndexCursor* pcursor, vCursors)
+            pcursor->Seek();
+    }
+
+    vHeap.clear();
+    BOOST_FOREACH(CAddressIndexCursor* pcursor, vCursors) {
+        if (pcursor->Valid())
+            vHeap.push_back(pcursor);
+        fFailed |= pcursor->Failed();
+    }
+    std::make_heap(vHeap.begin(), vHeap.end(), boost::bind(&CAddressIndexMerger::HeapCompare, this, _1, _2));
+}
+
+void CAddressIndexMerger::Next()
+{
+    std::pop_heap(vHeap.begin(), vHeap.end(), boost::bind(&CAddressIndexMerger::HeapCompare, this, _1, _2));
+    CAddressIndexCursor* pcursor = vHeap.back();
+    pcursor->Next();
+    fFailed |= pcursor->Failed();
+    if (pcursor->Valid())
+        std::push_heap(vHeap.begin(), vHeap.end(), boost::bind(&CAddressIndexMerger::HeapCompare, this, _1, _2));
+    else
+        vHeap.pop_back();
+}
+
+typedef std::map<std::pair<unsigned int, uint160>, CAddressSummary> AddressSummaryMap;
+
+/** Sum up the address index entries of a batch per address, counting every transaction once */
+static void GetAddressSummaryDeltas(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, AddressSummaryMap& mapDeltas)
+{
+    std::set<std::pair<std::pair<unsigned int, uint160>, uint256> > setTxs;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        std::pair<unsigned int, uint160> address(it->first.type, it->first.hashBytes);
+        CAddressSummary& delta = mapDeltas[address];
+        delta.balance += it->second;
+        if (it->second > 0)
+            delta.received += it->second;
+        if (setTxs.insert(std::make_pair(address, it->first.txhash)).second)
+            delta.txCount++;
+        if (delta.firstHeight < 0 || it->first.blockHeight < delta.firstHeight)
+            delta.firstHeight = it->first.blockHeight;
+        delta.lastHeight = std::max(delta.lastHeight, it->first.blockHeight);
+    }
+}
+
 bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+    std::vector<std::string> vNegativeKeys;
+    // The summaries are updated by deltas, so entries which are already in the
+    // database, when blocks are connected again after -reindex-chainstate or a
+    // crash, must not count twice
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vNew;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        std::string strNegativeKey = CIndexNegativeCache::MakeKey(DB_ADDRESSINDEX, CAddressIndexIteratorKey(it->first.type, it->first.hashBytes));
+        if (negativeCache.Contains(strNegativeKey) || !Exists(make_pair(DB_ADDRESSINDEX, it->first)))
+            vNew.push_back(*it);
         batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
+        vNegativeKeys.push_back(strNegativeKey);
+    }
+
+    // Keep the summaries in the same batch, so they always match the index
+    AddressSummaryMap mapDeltas;
+    GetAddressSummaryDeltas(vNew, mapDeltas);
+    for (AddressSummaryMap::const_iterator it = mapDeltas.begin(); it != mapDeltas.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        const CAddressSummary& delta = it->second;
+        CAddressSummary summary;
+        if (!Read(make_pair(DB_ADDRESSSUMMARY, key), summary) || summary.IsNull()) {
+            summary.SetNull();
+            summary.firstHeight = delta.firstHeight;
+        }
+        summary.balance += delta.balance;
+        summary.received += delta.received;
+        summary.txCount += delta.txCount;
+        summary.firstHeight = std::min(summary.firstHeight, delta.firstHeight);
+        summary.lastHeight = std::max(summary.lastHeight, delta.lastHeight);
+        batch.Write(make_pair(DB_ADDRESSSUMMARY, key), summary);
+    }
+
+    negativeCache.Invalidate(vNegativeKeys);
+    bool ret = WriteBatch(batch);
+    negativeCache.Invalidate(vNegativeKeys);
+    return ret;
+}
+
+int CBlockTreeDB::GetLastAddressHeight(uint160 addressHash, int type, int nBeforeHeight) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(make_pair(DB_ADDRESSINDEX, CAddressIndexIteratorHeightKey(type, addressHash, nBeforeHeight)));
+    if (pcursor->Valid())
+        pcursor->Prev();
+    else
+        pcursor->SeekToLast();
+
+    std::pair<char,CAddressIndexKey> key;
+    if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX &&
+        key.second.type == (unsigned int)type && key.second.hashBytes == addressHash)
+        return key.second.blockHeight;
+    return -1;
 }
 
 bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
     CDBBatch batch(*this);
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
+    // Likewise only entries which are still there are taken off the summaries
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vErased;
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
+        if (Exists(make_pair(DB_ADDRESSINDEX, it->first)))
+            vErased.push_back(*it);
         batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+    }
+
+    // Entries are erased when blocks are disconnected from the tip, so only the
+    // last height of an address can move. It is looked up while the erased
+    // entries are still in the database, just in front of them.
+    AddressSummaryMap mapDeltas;
+    GetAddressSummaryDeltas(vErased, mapDeltas);
+    for (AddressSummaryMap::const_iterator it = mapDeltas.begin(); it != mapDeltas.end(); it++) {
+        CAddressIndexIteratorKey key(it->first.first, it->first.second);
+        const CAddressSummary& delta = it->second;
+        CAddressSummary summary;
+        if (!Read(make_pair(DB_ADDRESSSUMMARY, key), summary))
+            continue;
+        summary.balance -= delta.balance;
+        summary.received -= delta.received;
+        summary.txCount -= std::min(summary.txCount, delta.txCount);
+        if (summary.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSSUMMARY, key));
+            continue;
+        }
+        if (summary.lastHeight >= delta.firstHeight)
+            summary.lastHeight = GetLastAddressHeight(key.hashBytes, key.type, delta.firstHeight);
+        batch.Write(make_pair(DB_ADDRESSSUMMARY, key), summary);
+    }
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadAddressSummary(uint160 addressHash, int type, CAddressSummary &summary) {
+    // An address without index entries has no summary either
+    std::string strNegativeKey = CIndexNegativeCache::MakeKey(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash));
+    if (negativeCache.Contains(strNegativeKey))
+        return false;
+    uint64_t nEpoch = negativeCache.GetEpoch();
+    if (Read(make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(type, addressHash)), summary))
+        return true;
+    negativeCache.Add(strNegativeKey, nEpoch);
+    return false;
+}
+
+bool CBlockTreeDB::BuildAddressSummaries() {
+    const size_t nBatchSize = 1 << 24;
+    CDBBatch batch(*this);
+
+    // Drop the summaries of an interrupted run first
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    pcursor->Seek(DB_ADDRESSSUMMARY);
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexIteratorKey> key;
+        if (!pcursor->GetKey(key) || key.first != DB_ADDRESSSUMMARY)
+            break;
+        batch.Erase(key);
+        if (batch.SizeEstimate() > nBatchSize) {
+            if (!WriteBatch(batch))
+                return false;
+            batch.Clear();
+        }
+        pcursor->Next();
+    }
+
+    // Entries are sorted by address, then height and transaction, so every
+    // address is summed up in one go and its transactions are adjacent.
+    uint64_t nAddresses = 0;
+    CAddressIndexKey prev;
+    CAddressSummary summary;
+    pcursor->Seek(DB_ADDRESSINDEX);
+    while (true) {
+        boost::this_thread::interruption_point();
+        std::pair<char,CAddressIndexKey> key;
+        bool fValid = pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_ADDRESSINDEX;
+        bool fSameAddress = fValid && key.second.type == prev.type && key.second.hashBytes == prev.hashBytes;
+        if (!fSameAddress && !summary.IsNull()) {
+            batch.Write(make_pair(DB_ADDRESSSUMMARY, CAddressIndexIteratorKey(prev.type, prev.hashBytes)), summary);
+            summary.SetNull();
+            if (++nAddresses % 100000 == 0)
+                LogPrintf("%s: summarized %u addresses\n", __func__, nAddresses);
+            if (batch.SizeEstimate() > nBatchSize) {
+                if (!WriteBatch(batch))
+                    return false;
+                batch.Clear();
+            }
+        }
+        if (!fValid)
+            break;
+
+        CAmount nValue;
+        if (!pcursor->GetValue(nValue))
+            return error("failed to get address index value");
+        summary.balance += nValue;
+        if (nValue > 0)
+            summary.received += nValue;
+        if (!fSameAddress || key.second.txhash != prev.txhash)
+            summary.txCount++;
+        if (summary.firstHeight < 0)
+            summary.firstHeight = key.second.blockHeight;
+        summary.lastHeight = key.second.blockHeight;
+        prev = key.second;
+        pcursor->Next();
+    }
+    LogPrintf("%s: summarized %u addresses\n", __func__, nAddresses);
+    return WriteBatch(batch, true);
+}
+
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
 
+    // An address without any entries has none in any height range either
+    std::string strNegativeKey = CIndexNegativeCache::MakeKey(DB_ADDRESSINDEX, CAddressIndexIteratorKey(type, addressHash));
+    if (negativeCache.Contains(strNegativeKey))
+        return true;
+    uint64_t nEpoch = negativeCache.GetEpoch();
+    size_t nFound = 0;
+
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
 
     if (start > 0 && end > 0) {
@@ -296,6 +1216,7 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
             CAmount nValue;
             if (pcursor->GetValue(nValue)) {
                 addressIndex.push_back(make_pair(key.second, nValue));
+                nFound++;
                 pcursor->Next();
             } else {
                 return error("failed to get address index value");
@@ -305,6 +1226,8 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
         }
     }
 
+    if (nFound == 0 && start <= 0 && end <= 0)
+        negativeCache.Add(strNegativeKey, nEpoch);
     return true;
 }
 
@@ -346,47 +1269,107 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex)
+/** Block index records of a range of block hashes, read by one of the threads of LoadBlockIndexGuts() */
+struct CBlockIndexRange
 {
-    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+    //! First byte of the hashes in the range, the end is exclusive and 256 for the last range
+    int nBegin;
+    int nEnd;
+    std::vector<CDiskBlockIndex> vIndex;
+    std::string strError;
+    int64_t nMicros;
+};
+
+static void ReadBlockIndexRange(CBlockTreeDB* pdb, CBlockIndexRange* prange, int nPowCheckHeight)
+{
+    int64_t nStart = GetTimeMicros();
+    boost::scoped_ptr<CDBIterator> pcursor(pdb->NewIterator());
 
-    pcursor->Seek(make_pair(DB_BLOCK_INDEX, uint256()));
+    // keys are ordered by the serialized hash, starting with its first byte
+    uint256 hashBegin;
+    *hashBegin.begin() = (unsigned char)prange->nBegin;
+    pcursor->Seek(make_pair(DB_BLOCK_INDEX, hashBegin));
 
-    // Load mapBlockIndex
     while (pcursor->Valid()) {
-        boost::this_thread::interruption_point();
         std::pair<char, uint256> key;
-        if (pcursor->GetKey(key) && key.first == DB_BLOCK_INDEX) {
-            CDiskBlockIndex diskindex;
-            if (pcursor->GetValue(diskindex)) {
-                // Construct block index object
-                CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
-                pindexNew->nHeight        = diskindex.nHeight;
-                pindexNew->nFile          = diskindex.nFile;
-                pindexNew->nDataPos       = diskindex.nDataPos;
-                pindexNew->nUndoPos       = diskindex.nUndoPos;
-                pindexNew->nVersion       = diskindex.nVersion;
-                pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
-                pindexNew->nTime          = diskindex.nTime;
-                pindexNew->nBits          = diskindex.nBits;
-                pindexNew->nNonce         = diskindex.nNonce;
-                pindexNew->nStatus        = diskindex.nStatus;
-                pindexNew->nTx            = diskindex.nTx;
-
-                if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits, Params().GetConsensus()))
-                    return error("%s: CheckProofOfWork failed: %s", __func__, pindexNew->ToString());
-
-                pcursor->Next();
-            } else {
-                return error("%s: failed to read value", __func__);
-            }
-        } else {
+        if (!pcursor->GetKey(key) || key.first != DB_BLOCK_INDEX || *key.second.begin() >= prange->nEnd)
             break;
+        prange->vIndex.push_back(CDiskBlockIndex());
+        CDiskBlockIndex& diskindex = prange->vIndex.back();
+        if (!pcursor->GetValue(diskindex)) {
+            prange->strError = "failed to read value";
+            break;
+        }
+        if (diskindex.nHeight > nPowCheckHeight && !CheckProofOfWork(diskindex.GetBlockHash(), diskindex.nBits, Params().GetConsensus())) {
+            prange->strError = strprintf("CheckProofOfWork failed: block %s at height %d", diskindex.GetBlockHash().ToString(), diskindex.nHeight);
+            break;
+        }
+        pcursor->Next();
+    }
+    prange->nMicros = GetTimeMicros() - nStart;
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nPowCheckHeight)
+{
+    // Reading and deserializing the records is split by the first byte of the
+    // block hash over several threads, each with its own iterator, while the
+    // calling thread links the ranges into mapBlockIndex in key order as they
+    // are read.
+    int nThreads = std::max(1, std::min(GetNumCores(), MAX_BLOCK_INDEX_LOAD_THREADS));
+    // the threads use vRanges until joined
+    boost::this_thread::disable_interruption noInterrupt;
+    std::vector<CBlockIndexRange> vRanges(nThreads);
+    boost::thread_group threads;
+    std::vector<boost::thread*> vThreads;
+    for (int i = 0; i < nThreads; i++) {
+        vRanges[i].nBegin = i * 256 / nThreads;
+        vRanges[i].nEnd = (i + 1) * 256 / nThreads;
+        vRanges[i].nMicros = 0;
+        vThreads.push_back(threads.create_thread(boost::bind(&ReadBlockIndexRange, this, &vRanges[i], nPowCheckHeight)));
+    }
+
+    int64_t nStart = GetTimeMicros();
+    int64_t nWaitMicros = 0;
+    size_t nEntries = 0;
+    bool fOk = true;
+    for (int i = 0; i < nThreads; i++) {
+        int64_t nWaitStart = GetTimeMicros();
+        vThreads[i]->join();
+        nWaitMicros += GetTimeMicros() - nWaitStart;
+        CBlockIndexRange& range = vRanges[i];
+        if (!fOk)
+            continue;
+        if (!range.strError.empty()) {
+            fOk = error("%s: %s", __func__, range.strError);
+            continue;
+        }
+
+        BOOST_FOREACH(const CDiskBlockIndex& diskindex, range.vIndex) {
+            // Construct block index object
+            CBlockIndex* pindexNew = insertBlockIndex(diskindex.GetBlockHash());
+            pindexNew->pprev          = insertBlockIndex(diskindex.hashPrev);
+            pindexNew->nHeight        = diskindex.nHeight;
+            pindexNew->nFile          = diskindex.nFile;
+            pindexNew->nDataPos       = diskindex.nDataPos;
+            pindexNew->nUndoPos       = diskindex.nUndoPos;
+            pindexNew->nVersion       = diskindex.nVersion;
+            pindexNew->hashMerkleRoot = diskindex.hashMerkleRoot;
+            pindexNew->nTime          = diskindex.nTime;
+            pindexNew->nBits          = diskindex.nBits;
+            pindexNew->nNonce         = diskindex.nNonce;
+            pindexNew->nStatus        = diskindex.nStatus;
+            pindexNew->nTx            = diskindex.nTx;
         }
+        nEntries += range.vIndex.size();
+        std::vector<CDiskBlockIndex>().swap(range.vIndex);
     }
 
-    return true;
+    int64_t nReadMicros = 0;
+    for (int i = 0; i < nThreads; i++)
+        nReadMicros = std::max(nReadMicros, vRanges[i].nMicros);
+    LogPrintf("%s: %u entries, read by %d threads in %.2fms (proof of work checked above height %d), linked in %.2fms\n", __func__,
+        nEntries, nThreads, nReadMicros * 0.001, nPowCheckHeight, (GetTimeMicros() - nStart - nWaitMicros) * 0.001);
+    return fOk;
 }
 
 namespace {
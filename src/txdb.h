@@ -11,15 +11,23 @@
 #include "chain.h"
 #include "spentindex.h"
 
+#include <deque>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <boost/function.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 class CBlockIndex;
+class CBlockTreeDB;
 class CCoinsViewDBCursor;
+class CSnapshotTx;
 class uint256;
 
 //! Compensate for extra memory peak (x1.5-x1.9) at flush time.
@@ -40,6 +48,43 @@ static const int64_t nMaxBlockDBCache = 2;
 static const int64_t nMaxBlockDBAndTxIndexCache = 1024;
 //! Max memory allocated to coin DB specific cache (MiB)
 static const int64_t nMaxCoinsDBCache = 8;
+//! -dbbackgroundflush default
+static const bool DEFAULT_COINS_BACKGROUND_FLUSH = true;
+//! Number of recent flushes kept for the latency percentiles
+static const size_t COINS_FLUSH_LATENCY_SAMPLES = 1000;
+//! max. -dbmaxopenfiles
+static const int MAX_DB_MAX_OPEN_FILES = 10000;
+//! -dbmaxopenfiles default, per database. LevelDB only has mmap slots for
+//! the table files on 64-bit, elsewhere every open file holds a descriptor.
+#ifdef WIN32
+static const int DEFAULT_DB_MAX_OPEN_FILES = DBWRAPPER_DEFAULT_MAX_OPEN_FILES;
+#else
+static const int DEFAULT_DB_MAX_OPEN_FILES = sizeof(void*) >= 8 ? 1000 : DBWRAPPER_DEFAULT_MAX_OPEN_FILES;
+#endif
+//! -dbcompressindex default
+static const bool DEFAULT_DB_COMPRESS_INDEX = false;
+
+//! Number of index lookups remembered to have found nothing
+static const size_t INDEX_NEGATIVE_CACHE_SIZE = 100000;
+//! -addressseekthreads default
+static const int DEFAULT_ADDRESS_SEEK_THREADS = 4;
+//! Maximum number of threads seeking the address index of many addresses at once
+static const int MAX_ADDRESS_SEEK_THREADS = 16;
+//! Maximum number of threads reading the block index at startup
+static const int MAX_BLOCK_INDEX_LOAD_THREADS = 8;
+
+/** Table files the chainstate and block index databases may each keep open */
+extern int nDBMaxOpenFiles;
+/** Whether the block index database (and the indexes it carries) is compressed */
+extern bool fDBCompressIndex;
+/** Threads positioning the address index iterators of multi address queries */
+extern int nAddressSeekThreads;
+
+/** Run instances of this in a thread group to seek the address index in parallel */
+void ThreadAddressSeek();
+
+/** Named key ranges of a database, for statistics and manual compaction */
+typedef std::vector<std::pair<std::string, char> > DBKeyRanges;
 
 struct CDiskTxPos : public CDiskBlockPos
 {
@@ -66,23 +111,111 @@ struct CDiskTxPos : public CDiskBlockPos
     }
 };
 
-/** CCoinsView backed by the coin database (chainstate/) */
+/** Latency percentiles over the last COINS_FLUSH_LATENCY_SAMPLES flushes, in microseconds */
+struct CCoinsFlushLatency
+{
+    int64_t nP50;
+    int64_t nP90;
+    int64_t nP99;
+    int64_t nMax;
+};
+
+struct CCoinsFlushStats
+{
+    bool fBackground;
+    bool fInProgress;
+    uint64_t nFlushes;
+    uint64_t nFailures;
+    //! Entries handed to the writer and not yet committed
+    size_t nFlushingEntries;
+    //! Time the caller of BatchWrite was blocked
+    CCoinsFlushLatency stall;
+    //! Time spent serializing and writing a batch
+    CCoinsFlushLatency write;
+};
+
+/** CCoinsView backed by the coin database (chainstate/)
+ *
+ * With background flushing enabled BatchWrite only takes ownership of the
+ * dirty cache and returns; a dedicated thread serializes and commits it.
+ * Until that write is done, reads are answered from the in-flight map first,
+ * so the view always reflects the state up to the last BatchWrite. Only one
+ * flush is in flight at a time: the next BatchWrite waits for the previous
+ * one, which bounds the extra memory to a single cache worth of entries.
+ */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
+
+    mutable boost::mutex csFlush;
+    mutable boost::condition_variable condFlush;
+    boost::thread threadFlush;
+    bool fBackgroundFlush;
+    bool fFlushShutdown;
+    //! Whether mapFlushing/hashBlockFlushing hold a batch the writer has not committed yet
+    bool fFlushing;
+    //! Set when a background write failed; reported by the next BatchWrite or WaitForFlush
+    bool fFlushFailed;
+    CCoinsMap mapFlushing;
+    uint256 hashBlockFlushing;
+    //! Whether commitment is known; it is updated by every BatchWrite
+    bool fCommitment;
+    CCoinsCommitment commitment;
+    //! The commitment the in-flight batch brings the database to, if known
+    bool fCommitmentFlushing;
+    CCoinsCommitment commitmentFlushing;
+    //! Changes written while ComputeCommitment walks the database
+    bool fComputingCommitment;
+    CCoinsCommitment commitmentSinceCursor;
+    boost::mutex csComputeCommitment;
+    uint64_t nBatchWrites;
+    uint64_t nFlushes;
+    uint64_t nFlushFailures;
+    std::deque<int64_t> vStallMicros;
+    std::deque<int64_t> vWriteMicros;
+
+    bool WriteCoins(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment *pcommitment, bool fErase);
+    void ThreadFlush();
+    void WaitForFlush(boost::unique_lock<boost::mutex>& lock) const;
+    //! Cursor over the committed data, csFlush held and no write in flight
+    CCoinsViewDBCursor *NewCursor() const;
+
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool fBackgroundFlushIn = false, const std::string& strName = "chainstate");
+    ~CCoinsViewDB();
 
     bool GetCoin(const COutPoint &outpoint, Coin &coin) const override;
     bool HaveCoin(const COutPoint &outpoint) const override;
     uint256 GetBestBlock() const override;
-    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) override;
+    bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock, const CCoinsCommitment &commitmentDelta) override;
     CCoinsViewCursor *Cursor() const override;
 
+    /**
+     * The commitment to the coins up to the last BatchWrite. It is kept with
+     * the coins from when the database is created, but a database written by
+     * an older version only has one after ComputeCommitment.
+     */
+    bool GetCommitment(CCoinsCommitment &commitmentOut) const;
+    //! Walk the database once to know its commitment. Returns false if it can't be read.
+    bool ComputeCommitment();
+
+    //! Block until the in-flight background write (if any) is committed. Returns false if it failed.
+    bool WaitForFlush();
+    void GetFlushStats(CCoinsFlushStats &stats) const;
+    //! Number of BatchWrite calls so far; reads done while it is unchanged saw the same state
+    uint64_t GetBatchWriteCount() const;
+
+    CDBWrapper& GetDBWrapper() { return db; }
+    static const DBKeyRanges& GetKeyRanges();
+
     //! Attempt to update from an older database format. Returns whether an error occurred.
     bool Upgrade();
     size_t EstimateSize() const override;
+
+private:
+    CCoinsViewDB(const CCoinsViewDB&);
+    void operator=(const CCoinsViewDB&);
 };
 
 /** Specialization of CCoinsViewCursor to iterate over a CCoinsViewDB */
@@ -107,11 +240,149 @@ private:
     friend class CCoinsViewDB;
 };
 
+struct CIndexNegativeCacheStats
+{
+    size_t nEntries;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nInvalidated;
+};
+
+/**
+ * Remembers index lookups that found nothing, e.g. the balance of an unused
+ * address or the spender of an unspent output, so repeating them does not
+ * touch LevelDB. The bloom filters of the database only help point lookups,
+ * while address lookups are prefix scans that have to visit every level.
+ *
+ * Writers call Invalidate() for every key they add data under, both before
+ * and after committing. A lookup only records a miss if no invalidation
+ * happened since it started (see GetEpoch), so a miss that raced with a
+ * write is never cached. Once full, the oldest entries are evicted.
+ */
+class CIndexNegativeCache
+{
+private:
+    mutable boost::mutex cs;
+    size_t nMaxEntries;
+    //! The keys, with the sequence number they were added at
+    std::unordered_map<std::string, uint64_t> mapKeys;
+    //! Insertion order, may contain stale entries of keys that were invalidated or added again meanwhile
+    std::deque<std::pair<uint64_t, std::string> > vOrder;
+    uint64_t nSequence;
+    uint64_t nEpoch;
+    mutable uint64_t nHits;
+    mutable uint64_t nMisses;
+    uint64_t nInvalidated;
+
+public:
+    CIndexNegativeCache(size_t nMaxEntriesIn) : nMaxEntries(nMaxEntriesIn), nSequence(0), nEpoch(0), nHits(0), nMisses(0), nInvalidated(0) {}
+
+    template <typename K>
+    static std::string MakeKey(char chIndex, const K& key)
+    {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << chIndex << key;
+        return ss.str();
+    }
+
+    //! Whether the lookup is known to find nothing; counts hits and misses
+    bool Contains(const std::string& strKey) const;
+    uint64_t GetEpoch() const;
+    //! Record a lookup that found nothing, unless an invalidation happened since nEpochStart
+    void Add(const std::string& strKey, uint64_t nEpochStart);
+    void Invalidate(const std::vector<std::string>& vKeys);
+    void GetStats(CIndexNegativeCacheStats& stats) const;
+};
+
+/**
+ * Iterates over the address index entries of one address in chain order, or in
+ * reverse chain order, continuing after the position of a cursor and limited to
+ * a height range, like CBlockTreeDB::ReadAddressIndexPage.
+ */
+class CAddressIndexCursor
+{
+private:
+    boost::scoped_ptr<CDBIterator> pcursor;
+    uint160 addressHash;
+    int type;
+    bool fReverse;
+    bool fHaveCursor;
+    CAddressIndexKey cursor;
+    int start;
+    int end;
+
+    bool fValid;
+    bool fFailed;
+    CAddressIndexKey key;
+    CAmount nValue;
+
+    //! Load the entry at the iterator position, stepping over entries outside the range
+    void Load();
+    void Step();
+
+public:
+    CAddressIndexCursor(CDBIterator* pcursorIn, uint160 addressHashIn, int typeIn, bool fReverseIn,
+                        const CAddressIndexKey* pCursor, int startIn, int endIn);
+
+    //! Position on the first entry, this is where the database is read
+    void Seek();
+    bool Valid() const { return fValid; }
+    //! Whether an entry could not be read
+    bool Failed() const { return fFailed; }
+    const CAddressIndexKey& GetKey() const { return key; }
+    CAmount GetValue() const { return nValue; }
+    void Next();
+};
+
+/**
+ * Iterates over the address index entries of many addresses at once, in chain
+ * order or in reverse chain order, by merging one CAddressIndexCursor per
+ * address. Only one entry per address is held in memory, so results can be
+ * produced incrementally regardless of the number of entries.
+ */
+class CAddressIndexMerger
+{
+private:
+    std::vector<CAddressIndexCursor*> vCursors;
+    //! Heap of the valid cursors, the next entry first
+    std::vector<CAddressIndexCursor*> vHeap;
+    bool fReverse;
+    bool fFailed;
+
+    bool HeapCompare(const CAddressIndexCursor* a, const CAddressIndexCursor* b) const;
+
+public:
+    CAddressIndexMerger(CBlockTreeDB& db, const std::vector<std::pair<uint160, int> >& addresses, bool fReverseIn,
+                        const CAddressIndexKey* pCursor = NULL, int start = 0, int end = 0);
+    ~CAddressIndexMerger();
+
+    /**
+     * Position all cursors. With fParallel, and if no other query is using
+     * them, the seeks are spread over the address seek threads.
+     */
+    void Seek(bool fParallel = true);
+    bool Valid() const { return !vHeap.empty(); }
+    bool Failed() const { return fFailed; }
+    const CAddressIndexKey& GetKey() const { return vHeap.front()->GetKey(); }
+    CAmount GetValue() const { return vHeap.front()->GetValue(); }
+    void Next();
+
+private:
+    CAddressIndexMerger(const CAddressIndexMerger&);
+    CAddressIndexMerger& operator=(const CAddressIndexMerger&);
+};
+
 /** Access to the block database (blocks/index/) */
 class CBlockTreeDB : public CDBWrapper
 {
+private:
+    CIndexNegativeCache negativeCache;
+
 public:
     CBlockTreeDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    static const DBKeyRanges& GetKeyRanges();
+    void GetNegativeCacheStats(CIndexNegativeCacheStats& stats) const { negativeCache.GetStats(stats); }
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
@@ -121,6 +392,14 @@ public:
     bool ReadLastBlockFile(int &nFile);
     bool WriteReindexing(bool fReindex);
     bool ReadReindexing(bool &fReindex);
+    //! The block a UTXO snapshot was loaded at, and its nChainTx
+    bool WriteSnapshotBase(const uint256 &hash, unsigned int nChainTx);
+    bool ReadSnapshotBase(uint256 &hash, unsigned int &nChainTx);
+    //! Forget the UTXO snapshot, with its transactions
+    bool EraseSnapshotBase();
+    //! The transactions which came with a UTXO snapshot, by txid
+    bool WriteSnapshotTxs(const std::vector<CSnapshotTx> &vTx);
+    bool ReadSnapshotTx(const uint256 &txid, CSnapshotTx &snapshotTx);
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
@@ -128,16 +407,45 @@ public:
     bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
+    /**
+     * Read up to nLimit unspent outputs of an address in key order, or in
+     * reverse order, continuing after the position of pCursor if given.
+     */
+    bool ReadAddressUnspentIndexPage(uint160 addressHash, int type,
+                                     std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect,
+                                     size_t nLimit, bool fReverse, const CAddressUnspentKey *pCursor = NULL);
     bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
+    /**
+     * Read up to nLimit address index entries of an address in chain order, or
+     * in reverse chain order, continuing after the position of pCursor if given.
+     * The type and address of the cursor are ignored, see CAddressIndexPositionCompare.
+     */
+    bool ReadAddressIndexPage(uint160 addressHash, int type,
+                              std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+                              size_t nLimit, bool fReverse, const CAddressIndexKey *pCursor = NULL,
+                              int start = 0, int end = 0);
+    //! Cursor over the entries of an address, NULL if it is known to have none
+    CAddressIndexCursor* NewAddressIndexCursor(uint160 addressHash, int type, bool fReverse,
+                                               const CAddressIndexKey *pCursor = NULL, int start = 0, int end = 0);
+    //! Height of the last address index entry of an address below nBeforeHeight, -1 if none
+    int GetLastAddressHeight(uint160 addressHash, int type, int nBeforeHeight);
+    //! Totals of an address, maintained together with its address index entries
+    bool ReadAddressSummary(uint160 addressHash, int type, CAddressSummary &summary);
+    //! Recompute all address summaries from the address index
+    bool BuildAddressSummaries();
     bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
-    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex);
+    /**
+     * Load the block index records through insertBlockIndex, checking the
+     * proof of work of the blocks above nPowCheckHeight.
+     */
+    bool LoadBlockIndexGuts(boost::function<CBlockIndex*(const uint256&)> insertBlockIndex, int nPowCheckHeight = -1);
 };
 
 #endif // BITCOIN_TXDB_H
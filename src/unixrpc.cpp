@@ -0,0 +1,323 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "unixrpc.h"
+
+#include "compat.h"
+#include "crypto/common.h"
+#include "netbase.h"
+#include "rpc/protocol.h"
+#include "rpc/server.h"
+#include "streams.h"
+#include "sync.h"
+#include "util.h"
+#include "version.h"
+
+#include <algorithm>
+#include <set>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
+#include <univalue.h>
+
+void ExecUnixRPCRequest(CDataStream& request, CDataStream& reply)
+{
+    // The result is written straight into the reply, which is cut back here on errors
+    size_t nStart = reply.size();
+    uint32_t nId = 0;
+    try {
+        uint8_t nFormat;
+        std::string strMethod;
+        try {
+            request >> nId >> nFormat >> strMethod;
+        } catch (const std::ios_base::failure& e) {
+            throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Request decode failed");
+        }
+
+        if (nFormat == UNIX_RPC_BINARY) {
+            reply << nId << (uint8_t)UNIX_RPC_OK;
+            tableRPC.executeBinary(strMethod, request, reply);
+        } else if (nFormat == UNIX_RPC_JSON) {
+            std::string strParams;
+            UniValue params;
+            try {
+                request >> strParams;
+            } catch (const std::ios_base::failure& e) {
+                throw JSONRPCError(RPC_DESERIALIZATION_ERROR, "Request decode failed");
+            }
+            if (!params.read(strParams) || !params.isArray())
+                throw JSONRPCError(RPC_INVALID_PARAMS, "Params must be a JSON array");
+            std::string strResult = tableRPC.execute(strMethod, params).write();
+            reply << nId << (uint8_t)UNIX_RPC_OK << strResult;
+        } else {
+            throw JSONRPCError(RPC_INVALID_REQUEST, strprintf("Unknown request format %d", nFormat));
+        }
+    } catch (const UniValue& objError) {
+        reply.resize(nStart);
+        reply << nId << (uint8_t)UNIX_RPC_ERROR;
+        reply << (int32_t)find_value(objError, "code").get_int() << find_value(objError, "message").get_str();
+    } catch (const std::exception& e) {
+        reply.resize(nStart);
+        reply << nId << (uint8_t)UNIX_RPC_ERROR;
+        reply << (int32_t)RPC_MISC_ERROR << std::string(e.what());
+    }
+}
+
+#ifndef WIN32
+
+/** Unix RPC module state */
+
+//! Listening socket, closed by StopUnixRPC
+static SOCKET hListenSocket = INVALID_SOCKET;
+//! Written to by InterruptUnixRPC to wake the listening thread, shutdown() doesn't wake accept() everywhere
+static int fdInterrupt[2] = {-1, -1};
+static boost::filesystem::path pathSocket;
+static boost::thread threadListen;
+//! Protects the fields below
+static CWaitableCriticalSection csConnections;
+static CConditionVariable condConnections;
+//! Connections being served, closed by their threads
+static std::set<SOCKET> setConnections;
+static bool fUnixRPCInterrupted = false;
+
+static bool ReadAll(SOCKET hSocket, char* pch, size_t nSize)
+{
+    while (nSize > 0) {
+        ssize_t nRead = recv(hSocket, pch, nSize, 0);
+        if (nRead < 0 && errno == EINTR)
+            continue;
+        if (nRead <= 0)
+            return false;
+        pch += nRead;
+        nSize -= nRead;
+    }
+    return true;
+}
+
+static bool WriteAll(SOCKET hSocket, const char* pch, size_t nSize)
+{
+    while (nSize > 0) {
+        ssize_t nWritten = send(hSocket, pch, nSize, MSG_NOSIGNAL);
+        if (nWritten < 0 && errno == EINTR)
+            continue;
+        if (nWritten <= 0)
+            return false;
+        pch += nWritten;
+        nSize -= nWritten;
+    }
+    return true;
+}
+
+/** Serve the requests of a connection one after the other until it is closed */
+static void ThreadUnixRPCConnection(SOCKET hSocket)
+{
+    RenameThread("dash-unixrpc");
+    while (true) {
+        unsigned char header[4];
+        if (!ReadAll(hSocket, (char*)header, sizeof(header)))
+            break;
+        uint32_t nSize = ReadLE32(header);
+        if (nSize > MAX_UNIX_RPC_REQUEST_SIZE) {
+            LogPrint("rpc", "Closing binary RPC connection after a request of %u bytes\n", nSize);
+            break;
+        }
+        CDataStream request(SER_NETWORK, PROTOCOL_VERSION);
+        request.resize(nSize);
+        if (nSize > 0 && !ReadAll(hSocket, &request[0], nSize))
+            break;
+
+        // The length is filled in once the reply is complete, so the frame goes out in one piece
+        CDataStream reply(SER_NETWORK, PROTOCOL_VERSION);
+        reply << (uint32_t)0;
+        ExecUnixRPCRequest(request, reply);
+        WriteLE32((unsigned char*)&reply[0], reply.size() - sizeof(uint32_t));
+        if (!WriteAll(hSocket, &reply[0], reply.size()))
+            break;
+    }
+
+    boost::unique_lock<boost::mutex> lock(csConnections);
+    setConnections.erase(hSocket);
+    CloseSocket(hSocket);
+    condConnections.notify_all();
+}
+
+static void ThreadUnixRPCListen()
+{
+    while (true) {
+        fd_set fdsetRecv;
+        FD_ZERO(&fdsetRecv);
+        FD_SET(hListenSocket, &fdsetRecv);
+        FD_SET(fdInterrupt[0], &fdsetRecv);
+        if (select(std::max((int)hListenSocket, fdInterrupt[0]) + 1, &fdsetRecv, NULL, NULL, NULL) == SOCKET_ERROR) {
+            if (errno == EINTR)
+                continue;
+            LogPrintf("Binary RPC socket select error: %s\n", NetworkErrorString(WSAGetLastError()));
+            break;
+        }
+        if (FD_ISSET(fdInterrupt[0], &fdsetRecv))
+            break;
+
+        // The listening socket is non-blocking, in case the client went away before accept()
+        SOCKET hSocket = accept(hListenSocket, NULL, NULL);
+        if (hSocket == INVALID_SOCKET) {
+            int nErr = WSAGetLastError();
+            if (nErr == WSAEINTR || nErr == WSAEWOULDBLOCK || nErr == ECONNABORTED)
+                continue;
+            LogPrintf("Binary RPC socket accept error: %s\n", NetworkErrorString(nErr));
+            break;
+        }
+        // Accepted sockets inherit O_NONBLOCK on BSD and macOS
+        if (!SetSocketNonBlocking(hSocket, false)) {
+            CloseSocket(hSocket);
+            continue;
+        }
+
+        boost::unique_lock<boost::mutex> lock(csConnections);
+        if (fUnixRPCInterrupted) {
+            CloseSocket(hSocket);
+            break;
+        }
+        if (setConnections.size() >= (size_t)MAX_UNIX_RPC_CONNECTIONS) {
+            LogPrintf("Binary RPC connection refused, %d connections are open already\n", MAX_UNIX_RPC_CONNECTIONS);
+            CloseSocket(hSocket);
+            continue;
+        }
+        setConnections.insert(hSocket);
+        boost::thread(boost::bind(&ThreadUnixRPCConnection, hSocket));
+    }
+}
+
+bool StartUnixRPC()
+{
+    std::string strPath = GetArg("-rpcunixsocket", "");
+    if (!mapArgs.count("-rpcunixsocket") || strPath == "0")
+        return true;
+    if (strPath.empty() || strPath == "1")
+        strPath = DEFAULT_UNIX_RPC_SOCKET;
+    pathSocket = boost::filesystem::absolute(strPath, GetDataDir());
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (pathSocket.string().size() >= sizeof(addr.sun_path)) {
+        LogPrintf("Binary RPC socket path is too long: %s\n", pathSocket.string());
+        return false;
+    }
+    strncpy(addr.sun_path, pathSocket.string().c_str(), sizeof(addr.sun_path) - 1);
+
+    hListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (hListenSocket == INVALID_SOCKET) {
+        LogPrintf("Unable to create binary RPC socket: %s\n", NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+
+    // A socket left behind by a previous run that didn't shut down cleanly
+    struct stat st;
+    if (lstat(addr.sun_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(addr.sun_path);
+
+    // Anyone who can connect may call any method, so only the user running dashd can,
+    // from the moment the socket is created
+    mode_t nOldMask = umask(S_IRWXG | S_IRWXO);
+    int nBind = bind(hListenSocket, (struct sockaddr*)&addr, sizeof(addr));
+    umask(nOldMask);
+    if (nBind == SOCKET_ERROR) {
+        LogPrintf("Unable to bind binary RPC socket %s: %s\n", pathSocket.string(), NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hListenSocket);
+        return false;
+    }
+    if (!SetSocketNonBlocking(hListenSocket, true) || listen(hListenSocket, SOMAXCONN) == SOCKET_ERROR) {
+        LogPrintf("Unable to listen on binary RPC socket %s: %s\n", pathSocket.string(), NetworkErrorString(WSAGetLastError()));
+        CloseSocket(hListenSocket);
+        unlink(addr.sun_path);
+        return false;
+    }
+    if (pipe(fdInterrupt) != 0) {
+        LogPrintf("Unable to create binary RPC interrupt pipe: %s\n", NetworkErrorString(errno));
+        CloseSocket(hListenSocket);
+        unlink(addr.sun_path);
+        return false;
+    }
+
+    LogPrintf("Binary RPC listening on %s\n", pathSocket.string());
+    fUnixRPCInterrupted = false;
+    threadListen = boost::thread(boost::bind(&TraceThread<void (*)()>, "unixrpc", &ThreadUnixRPCListen));
+    return true;
+}
+
+void InterruptUnixRPC()
+{
+    if (hListenSocket == INVALID_SOCKET)
+        return;
+    LogPrint("rpc", "Interrupting binary RPC server\n");
+    boost::unique_lock<boost::mutex> lock(csConnections);
+    if (!fUnixRPCInterrupted) {
+        fUnixRPCInterrupted = true;
+        char c = 0;
+        if (write(fdInterrupt[1], &c, 1) != 1)
+            LogPrintf("Unable to interrupt binary RPC listening thread: %s\n", NetworkErrorString(errno));
+    }
+    // Connections stop reading further requests, those in progress are finished
+    BOOST_FOREACH(SOCKET hSocket, setConnections)
+        shutdown(hSocket, SHUT_RD);
+}
+
+void StopUnixRPC()
+{
+    if (hListenSocket == INVALID_SOCKET)
+        return;
+    LogPrint("rpc", "Stopping binary RPC server\n");
+    InterruptUnixRPC();
+    threadListen.join();
+    {
+        boost::unique_lock<boost::mutex> lock(csConnections);
+        boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(UNIX_RPC_STOP_TIMEOUT);
+        while (!setConnections.empty()) {
+            if (!condConnections.timed_wait(lock, deadline))
+                break;
+        }
+        // Replies still being written to clients that don't read them fail, the threads close their sockets
+        if (!setConnections.empty()) {
+            LogPrintf("Closing %u binary RPC connections with requests in progress\n", setConnections.size());
+            BOOST_FOREACH(SOCKET hSocket, setConnections)
+                shutdown(hSocket, SHUT_RDWR);
+        }
+    }
+    CloseSocket(hListenSocket);
+    close(fdInterrupt[0]);
+    close(fdInterrupt[1]);
+    fdInterrupt[0] = fdInterrupt[1] = -1;
+    boost::system::error_code ec;
+    boost::filesystem::remove(pathSocket, ec);
+}
+
+#else
+
+bool StartUnixRPC()
+{
+    if (mapArgs.count("-rpcunixsocket") && GetArg("-rpcunixsocket", "") != "0") {
+        LogPrintf("Binary RPC over a Unix domain socket is not supported on Windows\n");
+        return false;
+    }
+    return true;
+}
+
+void InterruptUnixRPC()
+{
+}
+
+void StopUnixRPC()
+{
+}
+
+#endif // WIN32
@@ -0,0 +1,51 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef UNIXRPC_H
+#define UNIXRPC_H
+
+#include <string>
+
+class CDataStream;
+
+//! Largest request accepted over the binary RPC socket, in bytes
+static const unsigned int MAX_UNIX_RPC_REQUEST_SIZE = 4 * 1024 * 1024;
+//! Connections to the binary RPC socket served at once, each by a thread of its own
+static const int MAX_UNIX_RPC_CONNECTIONS = 32;
+//! Name of the socket in the data directory if -rpcunixsocket is given without a path
+static const char* const DEFAULT_UNIX_RPC_SOCKET = "rpc.sock";
+//! Seconds StopUnixRPC waits for the requests in progress before it cuts their connections
+static const int UNIX_RPC_STOP_TIMEOUT = 5;
+
+/** How the parameters and the result of a request are encoded */
+enum UnixRPCFormat
+{
+    UNIX_RPC_BINARY = 0, //!< Serialized Dash types, for methods with a CRPCBinaryCommand
+    UNIX_RPC_JSON = 1,   //!< JSON strings, for any method
+};
+
+/** Status of a reply */
+enum UnixRPCStatus
+{
+    UNIX_RPC_OK = 0,
+    UNIX_RPC_ERROR = 1, //!< Followed by the int32 code and the message of the error
+};
+
+/**
+ * Execute a request of the binary RPC transport, see doc/unix-rpc.md.
+ * @param[in] request  Payload of a request frame
+ * @param[out] reply   The payload of the reply frame is appended to it
+ */
+void ExecUnixRPCRequest(CDataStream& request, CDataStream& reply);
+
+/** Start listening on -rpcunixsocket, if given.
+ * Precondition; RPC has been started.
+ */
+bool StartUnixRPC();
+/** Stop accepting connections and interrupt the connections being served */
+void InterruptUnixRPC();
+/** Wait for the connections to be closed, at most UNIX_RPC_STOP_TIMEOUT seconds, and remove the socket */
+void StopUnixRPC();
+
+#endif // UNIXRPC_H
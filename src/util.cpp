@@ -13,6 +13,7 @@
 #include "support/allocators/secure.h"
 #include "chainparamsbase.h"
 #include "random.h"
+#include "ringbuffer.h"
 #include "serialize.h"
 #include "sync.h"
 #include "utilstrencodings.h"
@@ -40,8 +41,10 @@
 
 #include <algorithm>
 #include <fcntl.h>
+#include <signal.h>
 #include <sys/resource.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #else
 
@@ -131,6 +134,7 @@ bool fLogTimestamps = DEFAULT_LOGTIMESTAMPS;
 bool fLogTimeMicros = DEFAULT_LOGTIMEMICROS;
 bool fLogThreadNames = DEFAULT_LOGTHREADNAMES;
 bool fLogIPs = DEFAULT_LOGIPS;
+int nDebugRateLimit = DEFAULT_DEBUGRATELIMIT;
 volatile bool fReopenDebugLog = false;
 CTranslationInterface translationInterface;
 
@@ -211,16 +215,67 @@ static FILE* fileout = NULL;
 static boost::mutex* mutexDebugLog = NULL;
 static list<string> *vMsgsBeforeOpenLog;
 
+//! Lines queued for the debug.log writer thread, at most this many
+static const size_t DEBUG_LOG_QUEUE_LINES = 1 << 16;
+//! Largest batch the writer thread passes to a single write
+static const size_t DEBUG_LOG_MAX_BATCH = 1 << 20;
+
+/**
+ * Once StartDebugLogWriter() is called, LogPrintStr() only queues lines for
+ * a writer thread, which writes them in batches, so logging threads neither
+ * wait for the disk nor for each other. When the queue is full lines are
+ * dropped and counted, the writer logs how many. These are leaked too.
+ */
+static CMPSCRingBuffer<std::string>* queueDebugLog = NULL;
+static std::atomic<bool> fDebugLogAsync(false);
+//! Threads between seeing fDebugLogAsync set and having queued their line
+static std::atomic<int> nDebugLogQueueing(0);
+static std::atomic<bool> fDebugLogWriterStop(false);
+static std::atomic<bool> fDebugLogWriterSleeping(false);
+static std::atomic<uint64_t> nDebugLogDropped(0);
+static boost::mutex* mutexDebugLogWriter = NULL;
+static boost::condition_variable* condDebugLogWriter = NULL;
+static boost::thread* threadDebugLogWriter = NULL;
+//! File descriptor of debug.log for the fatal signal handler
+static int nDebugLogFd = -1;
+
+/** Lines logged by a -debug category in the current second, for -debugratelimit */
+struct CLogRate
+{
+    int64_t nSecond;
+    int nLines;
+    uint64_t nSuppressed;
+    CLogRate() : nSecond(0), nLines(0), nSuppressed(0) {}
+};
+static std::map<std::string, CLogRate>* mapLogRate = NULL;
+static boost::mutex* mutexLogRate = NULL;
+
 static int FileWriteStr(const std::string &str, FILE *fp)
 {
     return fwrite(str.data(), 1, str.size(), fp);
 }
 
+/** Write to debug.log, reopening it first if requested. The caller holds mutexDebugLog. */
+static int WriteDebugLog(const std::string& str)
+{
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+        nDebugLogFd = fileno(fileout);
+    }
+
+    return FileWriteStr(str, fileout);
+}
+
 static void DebugPrintInit()
 {
     assert(mutexDebugLog == NULL);
     mutexDebugLog = new boost::mutex();
     vMsgsBeforeOpenLog = new list<string>;
+    mutexLogRate = new boost::mutex();
+    mapLogRate = new std::map<std::string, CLogRate>();
 }
 
 void OpenDebugLog()
@@ -293,6 +348,34 @@ bool LogAcceptCategory(const char* category)
     return true;
 }
 
+bool LogAcceptRate(const char* category)
+{
+    if (category == NULL || nDebugRateLimit <= 0)
+        return true;
+
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    int64_t nSecond = GetTimeMillis() / 1000;
+    uint64_t nSuppressed = 0;
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexLogRate);
+        CLogRate& rate = (*mapLogRate)[category];
+        if (rate.nSecond != nSecond) {
+            nSuppressed = rate.nSuppressed;
+            rate.nSecond = nSecond;
+            rate.nLines = 0;
+            rate.nSuppressed = 0;
+        }
+        if (rate.nLines >= nDebugRateLimit) {
+            rate.nSuppressed++;
+            return false;
+        }
+        rate.nLines++;
+    }
+    if (nSuppressed > 0)
+        LogPrintStr(strprintf("%u lines of category %s suppressed by -debugratelimit\n", nSuppressed, category));
+    return true;
+}
+
 /**
  * fStartedNewLine is a state variable held by the calling context that will
  * suppress printing of the timestamp when multiple calls are made that don't
@@ -361,6 +444,21 @@ int LogPrintStr(const std::string &str)
     else if (fPrintToDebugLog)
     {
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+
+        // leave it to the writer thread. StopDebugLogWriter() waits for the
+        // threads which saw it running before it drains the queue a last time.
+        nDebugLogQueueing++;
+        if (fDebugLogAsync.load()) {
+            ret = strTimestamped.length();
+            if (!queueDebugLog->TryPush(std::move(strTimestamped)))
+                nDebugLogDropped++;
+            else if (fDebugLogWriterSleeping.load(std::memory_order_relaxed))
+                condDebugLogWriter->notify_one();
+            nDebugLogQueueing--;
+            return ret;
+        }
+        nDebugLogQueueing--;
+
         boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
 
         // buffer if we haven't opened the log yet
@@ -371,20 +469,124 @@ int LogPrintStr(const std::string &str)
         }
         else
         {
-            // reopen the log file, if requested
-            if (fReopenDebugLog) {
-                fReopenDebugLog = false;
-                boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-                if (freopen(pathDebug.string().c_str(),"a",fileout) != NULL)
-                    setbuf(fileout, NULL); // unbuffered
-            }
-
-            ret = FileWriteStr(strTimestamped, fileout);
+            ret = WriteDebugLog(strTimestamped);
         }
     }
     return ret;
 }
 
+static void ThreadDebugLogWriter()
+{
+    RenameThread("dash-logwriter");
+
+    std::string strBatch;
+    uint64_t nDroppedReported = 0;
+    while (true) {
+        bool fStop = fDebugLogWriterStop.load();
+        strBatch.clear();
+        // the lines stay queued until they are written, for HandleFatalSignalDebugLog()
+        size_t nLines = 0;
+        const std::string* pstrLine;
+        while (strBatch.size() < DEBUG_LOG_MAX_BATCH && (pstrLine = queueDebugLog->Peek(nLines)) != NULL) {
+            strBatch += *pstrLine;
+            nLines++;
+        }
+        uint64_t nDropped = nDebugLogDropped.load();
+        if (nDropped != nDroppedReported) {
+            bool fStartedNewLine = true;
+            strBatch += LogTimestampStr(strprintf("%u lines dropped, the debug.log writer fell behind\n", nDropped - nDroppedReported), &fStartedNewLine);
+            nDroppedReported = nDropped;
+        }
+
+        if (!strBatch.empty()) {
+            {
+                boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+                WriteDebugLog(strBatch);
+            }
+            queueDebugLog->Pop(nLines);
+            continue;
+        }
+        if (fStop)
+            break;
+
+        // LogPrintStr() only wakes us up while we're sleeping, lost wakeups are caught by the timeout
+        boost::unique_lock<boost::mutex> lock(*mutexDebugLogWriter);
+        fDebugLogWriterSleeping = true;
+        condDebugLogWriter->timed_wait(lock, boost::posix_time::milliseconds(100));
+        fDebugLogWriterSleeping = false;
+    }
+}
+
+#ifndef WIN32
+static void HandleFatalSignalDebugLog(int nSignal)
+{
+    // write what the writer thread didn't get to, with write() as stdio isn't async-signal-safe
+    if (nDebugLogFd >= 0 && queueDebugLog) {
+        queueDebugLog->ForEachPending([](const std::string& str) {
+            if (write(nDebugLogFd, str.data(), str.size()) < 0)
+                return;
+        });
+    }
+    // the default action was restored by SA_RESETHAND
+    raise(nSignal);
+}
+#endif
+
+void StartDebugLogWriter()
+{
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    {
+        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+        if (fileout == NULL || threadDebugLogWriter != NULL)
+            return;
+        nDebugLogFd = fileno(fileout);
+    }
+    if (queueDebugLog == NULL) {
+        queueDebugLog = new CMPSCRingBuffer<std::string>(DEBUG_LOG_QUEUE_LINES);
+        mutexDebugLogWriter = new boost::mutex();
+        condDebugLogWriter = new boost::condition_variable();
+    }
+
+#ifndef WIN32
+    // don't lose the lines explaining a crash
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = HandleFatalSignalDebugLog;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESETHAND;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sigaction(SIGILL, &sa, NULL);
+    sigaction(SIGFPE, &sa, NULL);
+    sigaction(SIGABRT, &sa, NULL);
+#endif
+
+    fDebugLogWriterStop = false;
+    threadDebugLogWriter = new boost::thread(&ThreadDebugLogWriter);
+    fDebugLogAsync = true;
+}
+
+void StopDebugLogWriter()
+{
+    if (threadDebugLogWriter == NULL)
+        return;
+    fDebugLogAsync = false;
+    // lines are only logged synchronously from here on, wait for those still being queued,
+    // so the writer sees every queued line before it is told to stop and writes them all
+    while (nDebugLogQueueing.load() > 0)
+        boost::this_thread::yield();
+    fDebugLogWriterStop = true;
+    condDebugLogWriter->notify_one();
+    threadDebugLogWriter->join();
+    delete threadDebugLogWriter;
+    threadDebugLogWriter = NULL;
+}
+
+uint64_t GetDebugLogDropped()
+{
+    return nDebugLogDropped.load();
+}
+
 /** Interpret string as boolean, for argument parsing */
 static bool InterpretBool(const std::string& strValue)
 {
@@ -51,6 +51,11 @@ static const bool DEFAULT_LOGTIMEMICROS  = false;
 static const bool DEFAULT_LOGIPS         = false;
 static const bool DEFAULT_LOGTIMESTAMPS  = true;
 static const bool DEFAULT_LOGTHREADNAMES = false;
+//! Write debug.log from a background thread. Off by default: lines still queued are lost
+//! when the process is killed or exits without shutting down, only fatal signals replay them.
+static const bool DEFAULT_LOGASYNC       = false;
+//! Lines per second a -debug category may log, 0 for no limit
+static const int DEFAULT_DEBUGRATELIMIT  = 0;
 
 /** Signals for translation. */
 class CTranslationInterface
@@ -71,6 +76,7 @@ extern bool fLogTimestamps;
 extern bool fLogTimeMicros;
 extern bool fLogThreadNames;
 extern bool fLogIPs;
+extern int nDebugRateLimit;
 extern volatile bool fReopenDebugLog;
 extern CTranslationInterface translationInterface;
 
@@ -92,6 +98,8 @@ bool SetupNetworking();
 
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
+/** Return true if category hasn't logged -debugratelimit lines in the current second yet */
+bool LogAcceptRate(const char* category);
 /** Send a string to the log output */
 int LogPrintStr(const std::string &str);
 
@@ -106,7 +114,7 @@ int LogPrintStr(const std::string &str);
     template<TINYFORMAT_ARGTYPES(n)>                                          \
     static inline int LogPrint(const char* category, const char* format, TINYFORMAT_VARARGS(n))  \
     {                                                                         \
-        if(!LogAcceptCategory(category)) return 0;                            \
+        if(!LogAcceptCategory(category) || !LogAcceptRate(category)) return 0; \
         return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n))); \
     }                                                                         \
     /**   Log error and return false */                                        \
@@ -125,7 +133,7 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
  */
 static inline int LogPrint(const char* category, const char* format)
 {
-    if(!LogAcceptCategory(category)) return 0;
+    if(!LogAcceptCategory(category) || !LogAcceptRate(category)) return 0;
     return LogPrintStr(format);
 }
 static inline bool error(const char* format)
@@ -158,6 +166,12 @@ boost::filesystem::path GetSpecialFolderPath(int nFolder, bool fCreate = true);
 #endif
 boost::filesystem::path GetTempPath();
 void OpenDebugLog();
+/** Hand debug.log lines to a background writer thread from now on */
+void StartDebugLogWriter();
+/** Write the lines queued for the writer thread and go back to writing on the calling thread */
+void StopDebugLogWriter();
+/** Lines dropped because the writer thread fell behind */
+uint64_t GetDebugLogDropped();
 void ShrinkDebugFile();
 void runCommand(const std::string& strCommand);
 
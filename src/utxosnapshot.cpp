@@ -0,0 +1,219 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chainparams.h"
+#include "coins.h"
+#include "streams.h"
+#include "sync.h"
+#include "util.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+#include <boost/thread.hpp>
+
+static const unsigned char UTXO_SNAPSHOT_MAGIC[5] = {'u', 't', 'x', 'o', 0xff};
+
+static void WriteCoinGroup(CAutoFile& file, const uint256& txid, const std::map<uint32_t, Coin>& coins)
+{
+    uint64_t nGroup = coins.size();
+    file << txid;
+    file << VARINT(nGroup);
+    for (std::map<uint32_t, Coin>::const_iterator it = coins.begin(); it != coins.end(); ++it) {
+        file << VARINT(it->first);
+        file << it->second;
+    }
+}
+
+CSnapshotTx::CSnapshotTx(const CBlock& block, const CTransaction& txIn) :
+    merkleBlock(block, std::set<uint256>{txIn.GetHash()}), tx(txIn)
+{
+}
+
+bool CSnapshotTx::IsProven() const
+{
+    std::vector<uint256> vMatch;
+    CPartialMerkleTree txn(merkleBlock.txn);
+    if (txn.ExtractMatches(vMatch) != merkleBlock.header.hashMerkleRoot)
+        return false;
+    return vMatch.size() == 1 && vMatch[0] == tx.GetHash();
+}
+
+bool WriteUTXOSnapshot(CAutoFile& file, CCoinsViewCursor* pcursor, const CCoinsCommitment& commitment,
+                       const std::vector<CSnapshotTx>& vTx, std::string& strError)
+{
+    CUTXOSnapshotMetadata metadata;
+    memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+    metadata.hashBlock = pcursor->GetBestBlock();
+    metadata.nCoins = commitment.nTransactionOutputs;
+
+    uint32_t nVersion = CUTXOSnapshotMetadata::CURRENT_VERSION;
+
+    CCoinsCommitment commitmentWritten;
+    try {
+        file.write((const char*)UTXO_SNAPSHOT_MAGIC, sizeof(UTXO_SNAPSHOT_MAGIC));
+        file << nVersion;
+        file << metadata;
+
+        uint256 txid;
+        std::map<uint32_t, Coin> coins;
+        while (pcursor->Valid()) {
+            boost::this_thread::interruption_point();
+            COutPoint key;
+            Coin coin;
+            if (!pcursor->GetKey(key) || !pcursor->GetValue(coin)) {
+                strError = "Unable to read the coins database";
+                return false;
+            }
+            if (!coins.empty() && key.hash != txid) {
+                WriteCoinGroup(file, txid, coins);
+                coins.clear();
+            }
+            commitmentWritten.Add(key, coin);
+            txid = key.hash;
+            coins[key.n] = std::move(coin);
+            pcursor->Next();
+        }
+        if (!coins.empty())
+            WriteCoinGroup(file, txid, coins);
+        file << vTx;
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to write the snapshot: %s", e.what());
+        return false;
+    }
+
+    if (commitmentWritten.nTransactionOutputs != commitment.nTransactionOutputs || commitmentWritten.GetHash() != commitment.GetHash()) {
+        strError = "The coins database doesn't match its commitment";
+        return false;
+    }
+    return true;
+}
+
+bool ReadUTXOSnapshotMetadata(CAutoFile& file, CUTXOSnapshotMetadata& metadata, std::string& strError)
+{
+    try {
+        unsigned char magic[sizeof(UTXO_SNAPSHOT_MAGIC)];
+        file.read((char*)magic, sizeof(magic));
+        if (memcmp(magic, UTXO_SNAPSHOT_MAGIC, sizeof(magic))) {
+            strError = "Not a UTXO snapshot";
+            return false;
+        }
+        uint32_t nVersion;
+        file >> nVersion;
+        if (nVersion != CUTXOSnapshotMetadata::CURRENT_VERSION) {
+            strError = strprintf("Unsupported UTXO snapshot version %u", nVersion);
+            return false;
+        }
+        file >> metadata;
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to read the snapshot: %s", e.what());
+        return false;
+    }
+    if (memcmp(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart))) {
+        strError = "The UTXO snapshot is for another network";
+        return false;
+    }
+    return true;
+}
+
+/** Add one transaction's coins to view, flushing it if it uses more than nMaxCacheUsage */
+static bool AddUTXOSnapshotCoins(CCoinsViewCache* view, std::vector<std::pair<COutPoint, Coin> >& vCoins,
+                                 uint64_t nCoins, uint64_t nCoinsTotal, size_t nMaxCacheUsage, std::string& strError)
+{
+    try {
+        for (size_t i = 0; i < vCoins.size(); i++)
+            view->AddCoin(vCoins[i].first, std::move(vCoins[i].second), false);
+    } catch (const std::logic_error& e) {
+        // A coin which the view already has
+        strError = strprintf("Unable to load the snapshot: %s", e.what());
+        return false;
+    }
+
+    if (view->DynamicMemoryUsage() > nMaxCacheUsage) {
+        LogPrintf("%s: loaded %u of %u coins\n", __func__, nCoins, nCoinsTotal);
+        if (!view->Flush()) {
+            strError = "Failed to write to the coins database";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReadUTXOSnapshotCoins(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, CCoinsCommitment& commitment,
+                           CCoinsViewCache* pview, CCriticalSection* pcsView, size_t nMaxCacheUsage,
+                           std::string& strError)
+{
+    uint64_t nCoins = 0;
+    std::vector<std::pair<COutPoint, Coin> > vCoins;
+    try {
+        while (nCoins < metadata.nCoins) {
+            boost::this_thread::interruption_point();
+            uint256 txid;
+            uint64_t nGroup;
+            file >> txid;
+            file >> VARINT(nGroup);
+            if (nGroup == 0 || nGroup > metadata.nCoins - nCoins) {
+                strError = "The UTXO snapshot is corrupt";
+                return false;
+            }
+            vCoins.clear();
+            uint32_t nPrev = 0;
+            for (uint64_t i = 0; i < nGroup; i++) {
+                COutPoint outpoint(txid, 0);
+                Coin coin;
+                file >> VARINT(outpoint.n);
+                file >> coin;
+                // The outputs of a transaction are in order, which also rules out duplicates
+                if ((i > 0 && outpoint.n <= nPrev) || coin.IsSpent()) {
+                    strError = "The UTXO snapshot is corrupt";
+                    return false;
+                }
+                nPrev = outpoint.n;
+                commitment.Add(outpoint, coin);
+                if (pview)
+                    vCoins.push_back(std::make_pair(outpoint, std::move(coin)));
+            }
+            nCoins += nGroup;
+
+            if (!pview)
+                continue;
+            // Only hold the lock while touching the view, not while reading and hashing
+            if (pcsView) {
+                LOCK(*pcsView);
+                if (!AddUTXOSnapshotCoins(pview, vCoins, nCoins, metadata.nCoins, nMaxCacheUsage, strError))
+                    return false;
+            } else if (!AddUTXOSnapshotCoins(pview, vCoins, nCoins, metadata.nCoins, nMaxCacheUsage, strError)) {
+                return false;
+            }
+        }
+    } catch (const std::ios_base::failure& e) {
+        strError = strprintf("The UTXO snapshot is truncated or corrupt: %s", e.what());
+        return false;
+    }
+    return true;
+}
+
+bool ReadUTXOSnapshotTxs(CAutoFile& file, std::vector<CSnapshotTx>& vTx, std::string& strError)
+{
+    try {
+        file >> vTx;
+    } catch (const std::ios_base::failure& e) {
+        strError = strprintf("The UTXO snapshot is truncated or corrupt: %s", e.what());
+        return false;
+    }
+    for (size_t i = 0; i < vTx.size(); i++) {
+        if (!vTx[i].IsProven()) {
+            strError = strprintf("The UTXO snapshot's transaction %s isn't proven to be in its block", vTx[i].tx.GetHash().ToString());
+            return false;
+        }
+    }
+    if (fgetc(file.Get()) != EOF) {
+        strError = "The UTXO snapshot has more data than it says";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,102 @@
+// Copyright (c) 2018 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef UTXOSNAPSHOT_H
+#define UTXOSNAPSHOT_H
+
+#include "merkleblock.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+#include "serialize.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <string>
+#include <string.h>
+#include <vector>
+
+class CAutoFile;
+class CCoinsCommitment;
+class CCoinsViewCache;
+class CCoinsViewCursor;
+
+/**
+ * What a UTXO snapshot file starts with, after its magic and version: the
+ * network and block it was taken at, and the number of coins which follow.
+ * The coins are grouped by transaction, each group being the txid, the number
+ * of its coins and then the output index and Coin of each. The coins are
+ * followed by the transactions of the snapshot, see CSnapshotTx.
+ */
+class CUTXOSnapshotMetadata
+{
+public:
+    static const uint32_t CURRENT_VERSION = 1;
+
+    CMessageHeader::MessageStartChars pchMessageStart;
+    uint256 hashBlock;
+    uint64_t nCoins;
+
+    CUTXOSnapshotMetadata() : nCoins(0) { memset(pchMessageStart, 0, sizeof(pchMessageStart)); }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(hashBlock);
+        READWRITE(nCoins);
+    }
+};
+
+/**
+ * A transaction below the block of a snapshot, which a node loading it can't
+ * find in the coins, like the collateral of a governance object. The proof of
+ * its block is checked against the header, as the snapshot's commitment only
+ * covers the coins.
+ */
+class CSnapshotTx
+{
+public:
+    CMerkleBlock merkleBlock;
+    CTransaction tx;
+
+    CSnapshotTx() {}
+    CSnapshotTx(const CBlock& block, const CTransaction& txIn);
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(merkleBlock);
+        READWRITE(tx);
+    }
+
+    //! Whether the proof is of tx only, in the block with merkleBlock's header
+    bool IsProven() const;
+};
+
+/**
+ * Write the coins pcursor walks and vTx to file, for the active network.
+ * commitment must be the one to the same coins, the file is checked against it.
+ */
+bool WriteUTXOSnapshot(CAutoFile& file, CCoinsViewCursor* pcursor, const CCoinsCommitment& commitment,
+                       const std::vector<CSnapshotTx>& vTx, std::string& strError);
+
+/** Read the start of a snapshot file, which must be for the active network */
+bool ReadUTXOSnapshotMetadata(CAutoFile& file, CUTXOSnapshotMetadata& metadata, std::string& strError);
+
+/**
+ * Read the coins which follow the metadata, adding them to commitment and,
+ * unless pview is NULL, to pview, which is flushed whenever it uses more than
+ * nMaxCacheUsage. If pcsView is not NULL it is only held while pview is used,
+ * so it is released between the transactions of the snapshot.
+ */
+bool ReadUTXOSnapshotCoins(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, CCoinsCommitment& commitment,
+                           CCoinsViewCache* pview, CCriticalSection* pcsView, size_t nMaxCacheUsage,
+                           std::string& strError);
+
+/** Read the transactions which follow the coins, and end the file, checking their proofs */
+bool ReadUTXOSnapshotTxs(CAutoFile& file, std::vector<CSnapshotTx>& vTx, std::string& strError);
+
+#endif // UTXOSNAPSHOT_H
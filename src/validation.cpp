@@ -8,14 +8,18 @@
 
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockcache.h"
+#include "blockfilemap.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "collateralwatch.h"
 #include "consensus/consensus.h"
 #include "consensus/merkle.h"
 #include "consensus/validation.h"
 #include "hash.h"
 #include "init.h"
+#include "net.h"
 #include "policy/policy.h"
 #include "pow.h"
 #include "primitives/block.h"
@@ -33,12 +37,14 @@
 #include "spork.h"
 #include "utilmoneystr.h"
 #include "utilstrencodings.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "versionbits.h"
 
 #include "instantx.h"
 #include "masternodeman.h"
 #include "masternode-payments.h"
+#include "masternode-sync.h"
 
 #include <sstream>
 
@@ -64,9 +70,13 @@ CCriticalSection cs_main;
 BlockMap mapBlockIndex;
 CChain chainActive;
 CBlockIndex *pindexBestHeader = NULL;
+CBlockIndex *pindexSnapshotBase = NULL;
+CBlockIndex *pindexSnapshotValidated = NULL;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nCoinsPrefetchThreads = 0;
+int nImportThreads = 1;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
@@ -87,6 +97,7 @@ bool fEnableReplacement = DEFAULT_ENABLE_REPLACEMENT;
 
 std::atomic<bool> fDIP0001WasLockedIn{false};
 std::atomic<bool> fDIP0001ActiveAtTip{false};
+std::atomic<bool> fUTXOSnapshotLoading{false};
 
 uint256 hashAssumeValid;
 
@@ -167,6 +178,47 @@ namespace {
 
     /** Dirty block file entries. */
     set<int> setDirtyFileInfo;
+
+    /**
+     * Storage of the entries of mapBlockIndex. They are allocated in chunks
+     * and only ever freed all at once, so loading the block index doesn't
+     * take a separate heap allocation per block.
+     */
+    class CBlockIndexArena
+    {
+    private:
+        static const size_t CHUNK_ENTRIES = 16384;
+        std::vector<CBlockIndex*> vChunks;
+        //! Entries used of the last chunk
+        size_t nUsed;
+
+    public:
+        CBlockIndexArena() : nUsed(CHUNK_ENTRIES) {}
+        ~CBlockIndexArena() { Clear(); }
+
+        CBlockIndex* New(const CBlockIndex& index)
+        {
+            if (nUsed == CHUNK_ENTRIES) {
+                vChunks.push_back(static_cast<CBlockIndex*>(::operator new(CHUNK_ENTRIES * sizeof(CBlockIndex))));
+                nUsed = 0;
+            }
+            return new (vChunks.back() + nUsed++) CBlockIndex(index);
+        }
+
+        /** Destroy all entries, pointers to them are invalid afterwards */
+        void Clear()
+        {
+            for (size_t i = 0; i < vChunks.size(); i++) {
+                size_t nEntries = i + 1 < vChunks.size() ? CHUNK_ENTRIES : nUsed;
+                for (size_t j = 0; j < nEntries; j++)
+                    vChunks[i][j].~CBlockIndex();
+                ::operator delete(vChunks[i]);
+            }
+            vChunks.clear();
+            nUsed = CHUNK_ENTRIES;
+        }
+    };
+    CBlockIndexArena blockIndexArena;
 } // anon namespace
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
@@ -186,6 +238,8 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 
 CCoinsViewDB *pcoinsdbview = NULL;
 CCoinsViewCache *pcoinsTip = NULL;
+CCoinsViewDB *pcoinsdbviewBackground = NULL;
+CCoinsViewCache *pcoinsBackground = NULL;
 CBlockTreeDB *pblocktree = NULL;
 
 enum FlushStateMode {
@@ -566,6 +620,10 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
     if (tx.IsCoinBase())
         return state.DoS(100, false, REJECT_INVALID, "coinbase");
 
+    // The coins are incomplete while a UTXO snapshot is being loaded
+    if (fUTXOSnapshotLoading)
+        return state.DoS(0, false, REJECT_INVALID, "utxo-snapshot-loading");
+
     // Rather not work on nonstandard transactions (unless -testnet/-regtest)
     string reason;
     if (fRequireStandard && !IsStandardTx(tx, reason))
@@ -987,7 +1045,7 @@ bool AcceptToMemoryPoolWorker(CTxMemPool& pool, CValidationState &state, const C
                     FormatMoney(nModifiedFees - nConflictingFees),
                     (int)nSize - (int)nConflictingSize);
         }
-        pool.RemoveStaged(allConflicting);
+        pool.RemoveStaged(allConflicting, MemPoolRemovalReason::REPLACED);
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry, setAncestors, !IsInitialBlockDownload());
@@ -1069,6 +1127,30 @@ bool GetAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
+bool GetAddressUnspentPage(uint160 addressHash, int type,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           size_t nLimit, bool fReverse, const CAddressUnspentKey *pCursor)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressUnspentIndexPage(addressHash, type, unspentOutputs, nLimit, fReverse, pCursor))
+        return error("unable to get address unspent outputs");
+
+    return true;
+}
+
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummary &summary)
+{
+    if (!fAddressIndex)
+        return error("address index not enabled");
+
+    if (!pblocktree->ReadAddressSummary(addressHash, type, summary))
+        summary.SetNull();
+
+    return true;
+}
+
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs)
 {
@@ -1093,19 +1175,41 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
         return true;
     }
 
+    // Transactions below a loaded UTXO snapshot's block which came with it
+    if (pindexSnapshotBase) {
+        CSnapshotTx snapshotTx;
+        if (pblocktree->ReadSnapshotTx(hash, snapshotTx)) {
+            txOut = snapshotTx.tx;
+            hashBlock = snapshotTx.merkleBlock.header.GetHash();
+            return true;
+        }
+    }
+
     if (fTxIndex) {
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            CBlockFileView view;
+            if (blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, postx, 0, view)) {
+                try {
+                    CSpanReader reader(view.pch, view.nSize, SER_DISK, CLIENT_VERSION);
+                    reader >> header;
+                    reader.ignore(postx.nTxOffset);
+                    reader >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
@@ -1173,17 +1277,29 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 {
     block.SetNull();
 
-    // Open history file to read
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    CBlockFileView view;
+    if (blockFileMaps.MapRecord(CBlockFileMapPool::BLOCK_FILE, pos, 0, view)) {
+        // Read block straight from the mapped file
+        try {
+            CSpanReader reader(view.pch, view.nSize, SER_DISK, CLIENT_VERSION);
+            reader >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header
@@ -1203,6 +1319,40 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus
     return true;
 }
 
+FILE* OpenRawBlock(const CBlockIndex* pindex, unsigned int& nSize)
+{
+    CDiskBlockPos pos = pindex->GetBlockPos();
+    if (pos.IsNull() || pos.nPos < sizeof(nSize)) {
+        error("OpenRawBlock: no block data for %s", pindex->ToString());
+        return NULL;
+    }
+
+    // The size of the block is stored right before it, see WriteBlockToDisk
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - sizeof(nSize)), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull()) {
+        error("OpenRawBlock: OpenBlockFile failed for %s", pos.ToString());
+        return NULL;
+    }
+
+    CBlockHeader header;
+    try {
+        filein >> nSize >> header;
+    }
+    catch (const std::exception& e) {
+        error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        return NULL;
+    }
+    if (nSize > MAX_SIZE || header.GetHash() != pindex->GetBlockHash()) {
+        error("OpenRawBlock: header doesn't match index for %s at %s", pindex->ToString(), pos.ToString());
+        return NULL;
+    }
+    if (fseek(filein.Get(), pos.nPos, SEEK_SET)) {
+        error("OpenRawBlock: Unable to seek to position %u of %s", pos.nPos, pos.ToString());
+        return NULL;
+    }
+    return filein.release();
+}
+
 double ConvertBitsToDouble(unsigned int nBits)
 {
     int nShift = (nBits >> 24) & 0xff;
@@ -1605,6 +1755,25 @@ bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
+    // The undo data is followed by its checksum
+    CBlockFileView view;
+    if (blockFileMaps.MapRecord(CBlockFileMapPool::UNDO_FILE, pos, sizeof(uint256), view)) {
+        CSpanReader reader(view.pch, view.nSize, SER_DISK, CLIENT_VERSION);
+        uint256 hashChecksum;
+        CHashVerifier<CSpanReader> verifier(&reader);
+        try {
+            verifier << hashBlock;
+            verifier >> blockundo;
+            reader >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
+        if (hashChecksum != verifier.GetHash())
+            return error("%s: Checksum mismatch", __func__);
+        return true;
+    }
+
     // Open history file to read
     CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
     if (filein.IsNull())
@@ -1843,16 +2012,20 @@ void static FlushBlockFile(bool fFinalize = false)
 
     FILE *fileOld = OpenBlockFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nSize);
+            blockFileMaps.Invalidate(nLastBlockFile);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
 
     fileOld = OpenUndoFile(posOld);
     if (fileOld) {
-        if (fFinalize)
+        if (fFinalize) {
             TruncateFile(fileOld, vinfoBlockFile[nLastBlockFile].nUndoSize);
+            blockFileMaps.Invalidate(nLastBlockFile);
+        }
         FileCommit(fileOld);
         fclose(fileOld);
     }
@@ -1867,6 +2040,124 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread();
 }
 
+/** Reads one coin from the coin database into a slot owned by PrefetchBlockInputs */
+class CCoinsPrefetchCheck
+{
+private:
+    const COutPoint* pOutpoint;
+    Coin* pCoin;
+    char* pfFound;
+
+public:
+    CCoinsPrefetchCheck() : pOutpoint(NULL), pCoin(NULL), pfFound(NULL) {}
+    CCoinsPrefetchCheck(const COutPoint& outpoint, Coin& coin, char& fFound) : pOutpoint(&outpoint), pCoin(&coin), pfFound(&fFound) {}
+
+    bool operator()() {
+        try {
+            *pfFound = pcoinsdbview->GetCoin(*pOutpoint, *pCoin);
+        } catch (const std::exception& e) {
+            // Leave it to ConnectBlock, which reads through the error catcher
+            LogPrintf("%s: %s\n", __func__, e.what());
+            *pfFound = false;
+        }
+        return true;
+    }
+
+    void swap(CCoinsPrefetchCheck& check) {
+        std::swap(pOutpoint, check.pOutpoint);
+        std::swap(pCoin, check.pCoin);
+        std::swap(pfFound, check.pfFound);
+    }
+};
+
+static CCheckQueue<CCoinsPrefetchCheck> coinsprefetchqueue(16);
+//! CCheckQueue supports a single master at a time
+static CCriticalSection cs_coinsprefetch;
+
+void ThreadCoinsPrefetch() {
+    RenameThread("dash-prefetch");
+    coinsprefetchqueue.Thread();
+}
+
+/** Outpoints spent by a block, except the ones created by the block itself */
+static void GetBlockPrevouts(const CBlock& block, std::vector<COutPoint>& vPrevouts)
+{
+    std::set<uint256> setBlockTxids;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        setBlockTxids.insert(tx.GetHash());
+    vPrevouts.clear();
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (!setBlockTxids.count(txin.prevout.hash))
+                vPrevouts.push_back(txin.prevout);
+        }
+    }
+}
+
+/**
+ * Load the coins a block spends into pcoinsTip before the block is connected.
+ * The database reads run in parallel on the prefetch threads and without
+ * holding cs_main, so ConnectBlock finds the inputs in the cache instead of
+ * doing one synchronous read per input under cs_main.
+ */
+static void PrefetchBlockInputs(const CBlock& block)
+{
+    if (!nCoinsPrefetchThreads)
+        return;
+
+    int64_t nTimeStart = GetTimeMicros();
+    std::vector<COutPoint> vPrevouts;
+    GetBlockPrevouts(block, vPrevouts);
+    size_t nInputs = vPrevouts.size();
+    if (nInputs == 0)
+        return;
+
+    uint64_t nBatchWrites;
+    {
+        LOCK(cs_main);
+        nBatchWrites = pcoinsdbview->GetBatchWriteCount();
+        std::vector<COutPoint> vMissing;
+        vMissing.reserve(nInputs);
+        BOOST_FOREACH(const COutPoint& outpoint, vPrevouts) {
+            if (!pcoinsTip->HaveCoinInCache(outpoint))
+                vMissing.push_back(outpoint);
+        }
+        vPrevouts.swap(vMissing);
+    }
+    size_t nCached = nInputs - vPrevouts.size();
+
+    std::vector<Coin> vCoins(vPrevouts.size());
+    std::vector<char> vFound(vPrevouts.size(), false);
+    if (!vPrevouts.empty()) {
+        LOCK(cs_coinsprefetch);
+        CCheckQueueControl<CCoinsPrefetchCheck> control(&coinsprefetchqueue);
+        std::vector<CCoinsPrefetchCheck> vChecks;
+        vChecks.reserve(vPrevouts.size());
+        for (size_t i = 0; i < vPrevouts.size(); i++)
+            vChecks.push_back(CCoinsPrefetchCheck(vPrevouts[i], vCoins[i], vFound[i]));
+        control.Add(vChecks);
+        control.Wait();
+    }
+
+    size_t nLoaded = 0;
+    {
+        LOCK(cs_main);
+        // Entries only leave pcoinsTip when they are flushed or unmodified, so
+        // unless a flush happened meanwhile, an outpoint that is still not
+        // cached has the value just read from the database.
+        if (pcoinsdbview->GetBatchWriteCount() == nBatchWrites) {
+            for (size_t i = 0; i < vPrevouts.size(); i++) {
+                if (vFound[i] && pcoinsTip->CacheCoin(vPrevouts[i], std::move(vCoins[i])))
+                    nLoaded++;
+            }
+        }
+    }
+    LogPrint("bench", "  - Prefetch %u inputs: %u already cached, %u loaded: %.2fms\n",
+        (unsigned int)nInputs, (unsigned int)nCached, (unsigned int)nLoaded, 0.001 * (GetTimeMicros() - nTimeStart));
+}
+
 // Protected by cs_main
 VersionBitsCache versionbitscache;
 
@@ -1950,8 +2241,10 @@ static int64_t nTimeTotal = 0;
 
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins.
  *  Validity checks that depend on the UTXO set are also done; ConnectBlock()
- *  can fail if those validity checks fail (among other reasons). */
-static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false)
+ *  can fail if those validity checks fail (among other reasons).
+ *  fBackground is for a block below a loaded UTXO snapshot's, which is connected
+ *  to the background chain state rather than the tip. */
+static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck = false, bool fBackground = false)
 {
     const CChainParams& chainparams = Params();
     AssertLockHeld(cs_main);
@@ -2223,13 +2516,16 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
     // the peer who sent us this block is missing some data and wasn't able
     // to recognize that block is actually invalid.
     // TODO: resync data (both ways?) and try to reprocess this block later.
+    // The masternode and governance data is about the tip, so the blocks below
+    // a UTXO snapshot's are checked as during the initial block download
+    bool fSynced = !fBackground && masternodeSync.IsSynced();
     CAmount blockReward = nFees + GetBlockSubsidy(pindex->pprev->nBits, pindex->pprev->nHeight, chainparams.GetConsensus());
     std::string strError = "";
-    if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError)) {
+    if (!IsBlockValueValid(block, pindex->nHeight, blockReward, strError, fSynced)) {
         return state.DoS(0, error("ConnectBlock(DASH): %s", strError), REJECT_INVALID, "bad-cb-amount");
     }
 
-    if (!IsBlockPayeeValid(block.vtx[0], pindex->nHeight, blockReward)) {
+    if (!IsBlockPayeeValid(block.vtx[0], pindex->nHeight, blockReward, fSynced)) {
         mapRejectedBlocks.insert(make_pair(block.GetHash(), GetTime()));
         return state.DoS(0, error("ConnectBlock(DASH): couldn't find masternode or superblock payments"),
                                 REJECT_INVALID, "bad-cb-payee");
@@ -2293,8 +2589,10 @@ static bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockInd
 
     // Watch for changes to the previous coinbase transaction.
     static uint256 hashPrevBestCoinBase;
-    GetMainSignals().UpdatedTransaction(hashPrevBestCoinBase);
-    hashPrevBestCoinBase = block.vtx[0].GetHash();
+    if (!fBackground) {
+        GetMainSignals().UpdatedTransaction(hashPrevBestCoinBase);
+        hashPrevBestCoinBase = block.vtx[0].GetHash();
+    }
 
     int64_t nTime6 = GetTimeMicros(); nTimeCallbacks += nTime6 - nTime5;
     LogPrint("bench", "    - Callbacks: %.2fms [%.2fs]\n", 0.001 * (nTime6 - nTime5), nTimeCallbacks * 0.000001);
@@ -2342,6 +2640,9 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
     }
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t cacheSize = pcoinsTip->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
+    // The background chain state of a UTXO snapshot shares the coins cache
+    if (pcoinsBackground)
+        cacheSize += pcoinsBackground->DynamicMemoryUsage() * DB_PEAK_USAGE_FACTOR;
     int64_t nTotalSpace = nCoinCacheUsage + std::max<int64_t>(nMempoolSizeMax - nMempoolUsage, 0);
     // The cache is large and we're within 10% and 10 MiB of the limit, but we have time now (not in the middle of a block processing).
     bool fCacheLarge = mode == FLUSH_STATE_PERIODIC && cacheSize > std::max((9 * nTotalSpace) / 10, nTotalSpace - MAX_BLOCK_COINSDB_USAGE * 1024 * 1024);
@@ -2393,8 +2694,16 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         if (!CheckDiskSpace(48 * 2 * 2 * pcoinsTip->GetCacheSize()))
             return state.Error("out of disk space");
         // Flush the chainstate (which may refer to block index entries).
+        int64_t nFlushStart = GetTimeMicros();
         if (!pcoinsTip->Flush())
             return AbortNode(state, "Failed to write to coin database");
+        // With -dbbackgroundflush the write above may still be in progress;
+        // callers asking for a full flush expect the coins to be on disk.
+        if (mode == FLUSH_STATE_ALWAYS && !pcoinsdbview->WaitForFlush())
+            return AbortNode(state, "Failed to write to coin database");
+        if (pcoinsBackground && !pcoinsBackground->Flush())
+            return AbortNode(state, "Failed to write to background coin database");
+        LogPrint("bench", "  - Coins cache flush: %.2fms\n", 0.001 * (GetTimeMicros() - nFlushStart));
         nLastFlush = nNow;
     }
     if (fDoFullFlush || ((mode == FLUSH_STATE_ALWAYS || mode == FLUSH_STATE_PERIODIC) && nNow > nLastSetChain + (int64_t)DATABASE_WRITE_INTERVAL * 1000000)) {
@@ -2481,6 +2790,8 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
 {
     CBlockIndex *pindexDelete = chainActive.Tip();
     assert(pindexDelete);
+    if (pindexDelete == pindexSnapshotBase)
+        return error("DisconnectTip(): can't disconnect the block of the UTXO snapshot, which has no undo data");
     // Read block from disk.
     CBlock block;
     if (!ReadBlockFromDisk(block, pindexDelete, consensusParams))
@@ -2504,7 +2815,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
         list<CTransaction> removed;
         CValidationState stateDummy;
         if (tx.IsCoinBase() || !AcceptToMemoryPool(mempool, stateDummy, tx, false, NULL, true)) {
-            mempool.remove(tx, removed, true);
+            mempool.remove(tx, removed, true, MemPoolRemovalReason::REORG);
         } else if (mempool.exists(tx.GetHash())) {
             vHashUpdate.push_back(tx.GetHash());
         }
@@ -2517,6 +2828,7 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
     mempool.UpdateTransactionsFromBlock(vHashUpdate);
     // Update chainActive and related variables.
     UpdateTip(pindexDelete->pprev);
+    collateralWatch.BlockDisconnected(block, pindexDelete);
     // Let wallets know transactions went from 1-confirmed to
     // 0-confirmed or conflicted:
     BOOST_FOREACH(const CTransaction &tx, block.vtx) {
@@ -2530,6 +2842,8 @@ static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
+static uint64_t nCoinsCacheHits = 0;
+static uint64_t nCoinsCacheMisses = 0;
 
 /**
  * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
@@ -2550,6 +2864,20 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     int64_t nTime2 = GetTimeMicros(); nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
     LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    if (LogAcceptCategory("bench")) {
+        // Every miss is a synchronous coin database read in ConnectBlock
+        std::vector<COutPoint> vPrevouts;
+        GetBlockPrevouts(*pblock, vPrevouts);
+        unsigned int nHits = 0;
+        BOOST_FOREACH(const COutPoint& outpoint, vPrevouts) {
+            if (pcoinsTip->HaveCoinInCache(outpoint))
+                nHits++;
+        }
+        unsigned int nMisses = vPrevouts.size() - nHits;
+        nCoinsCacheHits += nHits;
+        nCoinsCacheMisses += nMisses;
+        LogPrint("bench", "  - Inputs in coins cache: %u hits, %u misses [%u hits, %u misses]\n", nHits, nMisses, nCoinsCacheHits, nCoinsCacheMisses);
+    }
     {
         CCoinsViewCache view(pcoinsTip);
         bool rv = ConnectBlock(*pblock, state, pindexNew, view);
@@ -2575,6 +2903,10 @@ bool static ConnectTip(CValidationState& state, const CChainParams& chainparams,
     mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted, !IsInitialBlockDownload());
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
+    // Peers, RPC and ZMQ clients ask for a new tip within seconds, keep it at hand
+    if (!IsInitialBlockDownload())
+        recentBlocks.Add(*pblock);
+    collateralWatch.BlockConnected(*pblock, pindexNew);
     // Tell wallet about transactions that went from mempool
     // to conflicted:
     BOOST_FOREACH(const CTransaction &tx, txConflicted) {
@@ -2820,6 +3152,9 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
         bool fInitialDownload;
         {
             LOCK(cs_main);
+            // Loading a UTXO snapshot sets the tip, and activates the best chain from there
+            if (fUTXOSnapshotLoading)
+                return true;
             CBlockIndex *pindexOldTip = chainActive.Tip();
             if (pindexMostWork == NULL) {
                 pindexMostWork = FindMostWorkChain();
@@ -2866,6 +3201,11 @@ bool ActivateBestChain(CValidationState &state, const CChainParams& chainparams,
 bool InvalidateBlock(CValidationState& state, const Consensus::Params& consensusParams, CBlockIndex *pindex)
 {
     AssertLockHeld(cs_main);
+    if (fUTXOSnapshotLoading)
+        return state.Error("a UTXO snapshot is being loaded");
+    // The blocks up to a loaded snapshot's have no undo data, and would be the only chain left
+    if (pindexSnapshotBase && pindexSnapshotBase->GetAncestor(pindex->nHeight) == pindex)
+        return state.Error("the blocks up to the UTXO snapshot's can't be invalidated");
 
     // Mark the block itself as invalid.
     pindex->nStatus |= BLOCK_FAILED_VALID;
@@ -2945,8 +3285,7 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(CBlockIndex(block));
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -2970,11 +3309,34 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
     return pindexNew;
 }
 
+/** Set nChainTx of the queued blocks, which parents have it, and of their descendants which were waiting for them. */
+static void LinkChainTx(deque<CBlockIndex*>& queue)
+{
+    while (!queue.empty()) {
+        CBlockIndex *pindex = queue.front();
+        queue.pop_front();
+        pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindex->nSequenceId = nBlockSequenceId++;
+        }
+        if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+            setBlockIndexCandidates.insert(pindex);
+        }
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
+        while (range.first != range.second) {
+            std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
+            queue.push_back(it->second);
+            range.first++;
+            mapBlocksUnlinked.erase(it);
+        }
+    }
+}
+
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBlockIndex *pindexNew, const CDiskBlockPos& pos)
 {
     pindexNew->nTx = block.vtx.size();
-    pindexNew->nChainTx = 0;
     pindexNew->nFile = pos.nFile;
     pindexNew->nDataPos = pos.nPos;
     pindexNew->nUndoPos = 0;
@@ -2982,31 +3344,19 @@ bool ReceivedBlockTransactions(const CBlock &block, CValidationState& state, CBl
     pindexNew->RaiseValidity(BLOCK_VALID_TRANSACTIONS);
     setDirtyBlockIndex.insert(pindexNew);
 
+    // A UTXO snapshot's block is linked already, with the snapshot's nChainTx,
+    // which the background validation checks against the blocks below it
+    if (pindexNew == pindexSnapshotBase)
+        return true;
+    pindexNew->nChainTx = 0;
+
     if (pindexNew->pprev == NULL || pindexNew->pprev->nChainTx) {
         // If pindexNew is the genesis block or all parents are BLOCK_VALID_TRANSACTIONS.
         deque<CBlockIndex*> queue;
         queue.push_back(pindexNew);
 
         // Recursively process any descendant blocks that now may be eligible to be connected.
-        while (!queue.empty()) {
-            CBlockIndex *pindex = queue.front();
-            queue.pop_front();
-            pindex->nChainTx = (pindex->pprev ? pindex->pprev->nChainTx : 0) + pindex->nTx;
-            {
-                LOCK(cs_nBlockSequenceId);
-                pindex->nSequenceId = nBlockSequenceId++;
-            }
-            if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
-                setBlockIndexCandidates.insert(pindex);
-            }
-            std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
-            while (range.first != range.second) {
-                std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first;
-                queue.push_back(it->second);
-                range.first++;
-                mapBlocksUnlinked.erase(it);
-            }
-        }
+        LinkChainTx(queue);
     } else {
         if (pindexNew->pprev && pindexNew->pprev->IsValid(BLOCK_VALID_TREE)) {
             mapBlocksUnlinked.insert(std::make_pair(pindexNew->pprev, pindexNew));
@@ -3367,6 +3717,11 @@ static bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state
         if (fCheckpointsEnabled && !CheckIndexAgainstCheckpoint(pindexPrev, state, chainparams, hash))
             return error("%s: CheckIndexAgainstCheckpoint(): %s", __func__, state.GetRejectReason().c_str());
 
+        // The headers up to a loaded UTXO snapshot's block are all known, so this forks below it
+        if (pindexSnapshotBase && pindexPrev->nHeight < pindexSnapshotBase->nHeight)
+            return state.DoS(0, error("%s: forked chain older than the UTXO snapshot (height %d)", __func__, pindexPrev->nHeight + 1),
+                             REJECT_INVALID, "bad-fork-prior-to-snapshot");
+
         if (!ContextualCheckBlockHeader(block, state, pindexPrev))
             return false;
     }
@@ -3486,6 +3841,7 @@ static bool IsSuperMajority(int minVersion, const CBlockIndex* pstart, unsigned
 
 bool ProcessNewBlock(const CChainParams& chainparams, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp, bool *fNewBlock)
 {
+    bool fPrefetch = false;
     {
         LOCK(cs_main);
 
@@ -3499,10 +3855,15 @@ bool ProcessNewBlock(const CChainParams& chainparams, const CBlock* pblock, bool
             GetMainSignals().BlockChecked(*pblock, state);
             return error("%s: AcceptBlock FAILED", __func__);
         }
+        // Only warm the cache for a block that is about to be connected
+        fPrefetch = pindex->nChainTx && pindex->nChainWork > chainActive.Tip()->nChainWork;
     }
 
     NotifyHeaderTip();
 
+    if (fPrefetch)
+        PrefetchBlockInputs(*pblock);
+
     CValidationState state; // Only used to report errors, not invalidity - ignore it
     if (!ActivateBestChain(state, chainparams, pblock))
         return error("%s: ActivateBestChain failed", __func__);
@@ -3588,6 +3949,7 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune)
 {
     for (set<int>::iterator it = setFilesToPrune.begin(); it != setFilesToPrune.end(); ++it) {
         CDiskBlockPos pos(*it, 0);
+        blockFileMaps.Invalidate(*it);
         boost::filesystem::remove(GetBlockPosFilename(pos, "blk"));
         boost::filesystem::remove(GetBlockPosFilename(pos, "rev"));
         LogPrintf("Prune: %s deleted blk/rev (%05u)\n", __func__, *it);
@@ -3606,6 +3968,12 @@ void FindFilesToPrune(std::set<int>& setFilesToPrune, uint64_t nPruneAfterHeight
     }
 
     unsigned int nLastBlockWeCanPrune = chainActive.Tip()->nHeight - MIN_BLOCKS_TO_KEEP;
+    // Nor the blocks below a UTXO snapshot's which are yet to be validated in the background
+    if (pindexSnapshotBase) {
+        if (pindexSnapshotValidated == NULL)
+            return;
+        nLastBlockWeCanPrune = std::min(nLastBlockWeCanPrune, (unsigned int)pindexSnapshotValidated->nHeight);
+    }
     uint64_t nCurrentUsage = CalculateCurrentUsage();
     // We don't check to prune until after we've allocated new space for files
     // So we should leave a buffer under our target to account for another allocation
@@ -3700,9 +4068,7 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("InsertBlockIndex(): new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New(CBlockIndex());
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
 
@@ -3712,11 +4078,28 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
 bool static LoadBlockIndexDB()
 {
     const CChainParams& chainparams = Params();
-    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex))
+    int64_t nStart = GetTimeMicros();
+
+    // Headers below the last checkpoint were only accepted on the checkpointed
+    // chain, and their proof of work was checked then.
+    const MapCheckpoints& mapCheckpoints = chainparams.Checkpoints().mapCheckpoints;
+    int nPowCheckHeight = fCheckpointsEnabled && !mapCheckpoints.empty() ? mapCheckpoints.rbegin()->first : -1;
+    if (!pblocktree->LoadBlockIndexGuts(InsertBlockIndex, nPowCheckHeight))
         return false;
+    int64_t nTimeGuts = GetTimeMicros();
 
     boost::this_thread::interruption_point();
 
+    // A UTXO snapshot's block is linked without the blocks below it
+    uint256 hashSnapshotBase;
+    unsigned int nSnapshotChainTx = 0;
+    if (pblocktree->ReadSnapshotBase(hashSnapshotBase, nSnapshotChainTx)) {
+        BlockMap::iterator mi = mapBlockIndex.find(hashSnapshotBase);
+        if (mi == mapBlockIndex.end())
+            return error("%s: the block of the UTXO snapshot isn't in the block index", __func__);
+        pindexSnapshotBase = mi->second;
+    }
+
     // Calculate nChainWork
     vector<pair<int, CBlockIndex*> > vSortedByHeight;
     vSortedByHeight.reserve(mapBlockIndex.size());
@@ -3732,7 +4115,11 @@ bool static LoadBlockIndexDB()
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
         // We can link the chain of blocks for which we've received transactions at some point.
         // Pruned nodes may have deleted the block.
-        if (pindex->nTx > 0) {
+        if (pindex == pindexSnapshotBase) {
+            // Whether or not the blocks below it were received
+            pindex->nChainTx = nSnapshotChainTx;
+            setBlockIndexCandidates.insert(pindex);
+        } else if (pindex->nTx > 0) {
             if (pindex->pprev) {
                 if (pindex->pprev->nChainTx) {
                     pindex->nChainTx = pindex->pprev->nChainTx + pindex->nTx;
@@ -3744,6 +4131,14 @@ bool static LoadBlockIndexDB()
                 pindex->nChainTx = pindex->nTx;
             }
         }
+        // The blocks connected on a UTXO snapshot which -reindex-chainstate dropped are
+        // only as valid as the blocks below the snapshot's, which are yet to be connected
+        // (the genesis block is never connected past BLOCK_VALID_TRANSACTIONS)
+        if (pindex->pprev && pindex->pprev->pprev && pindex->pprev != pindexSnapshotBase && (pindex->nStatus & BLOCK_VALID_MASK) >= BLOCK_VALID_CHAIN &&
+            (pindex->pprev->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) {
+            pindex->nStatus = (pindex->nStatus & ~BLOCK_VALID_MASK) | BLOCK_VALID_TRANSACTIONS;
+            setDirtyBlockIndex.insert(pindex);
+        }
         if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == NULL))
             setBlockIndexCandidates.insert(pindex);
         if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
@@ -3753,6 +4148,7 @@ bool static LoadBlockIndexDB()
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    int64_t nTimeChainWork = GetTimeMicros();
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -3771,6 +4167,8 @@ bool static LoadBlockIndexDB()
         }
     }
 
+    int64_t nTimeFileInfo = GetTimeMicros();
+
     // Check presence of blk files
     LogPrintf("Checking all blk files are present...\n");
     set<int> setBlkDataFiles;
@@ -3788,12 +4186,24 @@ bool static LoadBlockIndexDB()
             return false;
         }
     }
+    int64_t nTimeBlkFiles = GetTimeMicros();
+    LogPrintf("%s: %u entries in %.2fms: database %.2fms, chain work %.2fms, block file info %.2fms, blk files %.2fms\n", __func__,
+        mapBlockIndex.size(), (nTimeBlkFiles - nStart) * 0.001, (nTimeGuts - nStart) * 0.001, (nTimeChainWork - nTimeGuts) * 0.001,
+        (nTimeFileInfo - nTimeChainWork) * 0.001, (nTimeBlkFiles - nTimeFileInfo) * 0.001);
 
     // Check whether we have ever pruned block & undo files
     pblocktree->ReadFlag("prunedblockfiles", fHavePruned);
     if (fHavePruned)
         LogPrintf("LoadBlockIndexDB(): Block files have previously been pruned\n");
 
+    // An interrupted UTXO snapshot load left the coins incomplete
+    bool fSnapshotLoading = false;
+    pblocktree->ReadFlag("utxosnapshotload", fSnapshotLoading);
+    if (fSnapshotLoading)
+        return error("%s: loading a UTXO snapshot was interrupted, -reindex-chainstate is needed", __func__);
+    if (pindexSnapshotBase)
+        LogPrintf("%s: UTXO snapshot loaded at height %d\n", __func__, pindexSnapshotBase->nHeight);
+
     // Check whether we need to continue reindexing
     bool fReindexing = false;
     pblocktree->ReadReindexing(fReindexing);
@@ -3807,6 +4217,16 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("addressindex", fAddressIndex);
     LogPrintf("%s: address index %s\n", __func__, fAddressIndex ? "enabled" : "disabled");
 
+    // Address indexes built by older versions lack the per address summaries
+    bool fAddressSummary = false;
+    pblocktree->ReadFlag("addresssummary", fAddressSummary);
+    if (fAddressIndex && !fAddressSummary) {
+        LogPrintf("%s: building address summaries...\n", __func__);
+        uiInterface.InitMessage(_("Building address summaries..."));
+        if (!pblocktree->BuildAddressSummaries() || !pblocktree->WriteFlag("addresssummary", true))
+            return error("%s: failed to build address summaries", __func__);
+    }
+
     // Check whether we have a timestamp index
     pblocktree->ReadFlag("timestampindex", fTimestampIndex);
     LogPrintf("%s: timestamp index %s\n", __func__, fTimestampIndex ? "enabled" : "disabled");
@@ -3831,6 +4251,303 @@ bool static LoadBlockIndexDB()
     return true;
 }
 
+/** Check the metadata of a snapshot against the chain, for ActivateUTXOSnapshot */
+static const CAssumeUTXOData* CheckUTXOSnapshotBase(const CUTXOSnapshotMetadata& metadata, CBlockIndex*& pindexBase, std::string& strError)
+{
+    AssertLockHeld(cs_main);
+    if (chainActive.Height() != 0) {
+        strError = "A UTXO snapshot can only be loaded by a node at the genesis block";
+        return NULL;
+    }
+    BlockMap::iterator mi = mapBlockIndex.find(metadata.hashBlock);
+    if (mi == mapBlockIndex.end()) {
+        strError = strprintf("The header of the snapshot's block %s isn't known yet, wait for the headers to sync", metadata.hashBlock.ToString());
+        return NULL;
+    }
+    pindexBase = mi->second;
+    if (pindexBestHeader->GetAncestor(pindexBase->nHeight) != pindexBase) {
+        strError = "The snapshot's block isn't on the best header chain";
+        return NULL;
+    }
+    const MapAssumeUTXO& mapAssumeUTXO = Params().AssumeUTXO();
+    MapAssumeUTXO::const_iterator it = mapAssumeUTXO.find(pindexBase->nHeight);
+    if (it == mapAssumeUTXO.end() || it->second.hashBlock != metadata.hashBlock) {
+        strError = strprintf("No UTXO snapshot at height %d is assumed valid", pindexBase->nHeight);
+        return NULL;
+    }
+    if (it->second.nTransactionOutputs != metadata.nCoins) {
+        strError = strprintf("The snapshot has %u coins, %u are expected", metadata.nCoins, it->second.nTransactionOutputs);
+        return NULL;
+    }
+    return &it->second;
+}
+
+bool ActivateUTXOSnapshot(const boost::filesystem::path& path, std::string& strError)
+{
+    const CChainParams& chainparams = Params();
+    if (fAddressIndex || fSpentIndex) {
+        strError = "A UTXO snapshot can't be loaded with -addressindex or -spentindex, which need the whole chain";
+        return false;
+    }
+
+    // Check the coins against their commitment before touching the chain state
+    CUTXOSnapshotMetadata metadata;
+    CCoinsCommitment commitment;
+    std::vector<CSnapshotTx> vTx;
+    {
+        CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        if (file.IsNull()) {
+            strError = strprintf("Unable to open %s", path.string());
+            return false;
+        }
+        if (!ReadUTXOSnapshotMetadata(file, metadata, strError))
+            return false;
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindexBase;
+            if (!CheckUTXOSnapshotBase(metadata, pindexBase, strError))
+                return false;
+        }
+        LogPrintf("%s: checking the UTXO snapshot at block %s\n", __func__, metadata.hashBlock.ToString());
+        if (!ReadUTXOSnapshotCoins(file, metadata, commitment, NULL, NULL, 0, strError) ||
+            !ReadUTXOSnapshotTxs(file, vTx, strError))
+            return false;
+    }
+
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexBase;
+        const CAssumeUTXOData* pdata = CheckUTXOSnapshotBase(metadata, pindexBase, strError);
+        if (!pdata)
+            return false;
+        if (commitment.GetHash() != pdata->hashCommitment) {
+            strError = strprintf("The snapshot's coins hash to %s, %s is expected", commitment.GetHash().ToString(), pdata->hashCommitment.ToString());
+            return false;
+        }
+        // The transactions are proven to be in their blocks, which must be below the snapshot's
+        for (size_t i = 0; i < vTx.size(); i++) {
+            BlockMap::iterator mi = mapBlockIndex.find(vTx[i].merkleBlock.header.GetHash());
+            if (mi == mapBlockIndex.end() || pindexBase->GetAncestor(mi->second->nHeight) != mi->second) {
+                strError = strprintf("The snapshot's transaction %s isn't in a block below the snapshot's", vTx[i].tx.GetHash().ToString());
+                return false;
+            }
+        }
+        if (fUTXOSnapshotLoading) {
+            strError = "A UTXO snapshot is already being loaded";
+            return false;
+        }
+
+        // From here on a failure leaves the coins incomplete, which the flag records
+        CValidationState state;
+        if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS) || !pblocktree->WriteFlag("utxosnapshotload", true)) {
+            strError = "Failed to write to the database";
+            return false;
+        }
+        fUTXOSnapshotLoading = true;
+    }
+
+    // cs_main is only taken while the coins are added to pcoinsTip, the flag
+    // keeps blocks and transactions from being connected to it meanwhile
+    LogPrintf("%s: loading the UTXO snapshot at block %s\n", __func__, metadata.hashBlock.ToString());
+    {
+        CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadataLoad;
+        CCoinsCommitment commitmentLoad;
+        if (file.IsNull() || !ReadUTXOSnapshotMetadata(file, metadataLoad, strError) || metadataLoad.hashBlock != metadata.hashBlock ||
+            !ReadUTXOSnapshotCoins(file, metadataLoad, commitmentLoad, pcoinsTip, &cs_main, nCoinCacheUsage, strError) ||
+            commitmentLoad.GetHash() != commitment.GetHash()) {
+            strError = strprintf("Failed to load the UTXO snapshot, -reindex-chainstate is needed: %s", strError);
+            return AbortNode(strError);
+        }
+    }
+
+    {
+        LOCK(cs_main);
+        CBlockIndex* pindexBase = mapBlockIndex[metadata.hashBlock];
+        const CAssumeUTXOData& data = chainparams.AssumeUTXO().find(pindexBase->nHeight)->second;
+        pcoinsTip->SetBestBlock(pindexBase->GetBlockHash());
+
+        // The snapshot's block takes the place of the blocks below it
+        pindexBase->nChainTx = data.nChainTx;
+        {
+            LOCK(cs_nBlockSequenceId);
+            pindexBase->nSequenceId = nBlockSequenceId++;
+        }
+        chainActive.SetTip(pindexBase);
+        setBlockIndexCandidates.insert(pindexBase);
+        deque<CBlockIndex*> queue;
+        std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindexBase);
+        for (std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first; it != range.second; ++it)
+            queue.push_back(it->second);
+        mapBlocksUnlinked.erase(range.first, range.second);
+        LinkChainTx(queue);
+        PruneBlockIndexCandidates();
+
+        CValidationState state;
+        if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS) ||
+            !pblocktree->WriteSnapshotTxs(vTx) ||
+            !pblocktree->WriteSnapshotBase(pindexBase->GetBlockHash(), pindexBase->nChainTx) ||
+            !pblocktree->WriteFlag("utxosnapshotload", false)) {
+            strError = "Failed to write to the database, -reindex-chainstate is needed";
+            return AbortNode(strError);
+        }
+        pindexSnapshotBase = pindexBase;
+        fUTXOSnapshotLoading = false;
+        LogPrintf("%s: loaded %u coins and %u transactions, new best=%s height=%d\n", __func__, metadata.nCoins, vTx.size(),
+                  pindexBase->GetBlockHash().ToString(), pindexBase->nHeight);
+    }
+
+    // The blocks below the snapshot's can't be served, as at startup after loading one
+    if (g_connman && (g_connman->GetLocalServices() & NODE_NETWORK)) {
+        LogPrintf("Unsetting NODE_NETWORK after loading a UTXO snapshot\n");
+        g_connman->RemoveLocalServices(NODE_NETWORK);
+    }
+
+    CValidationState state;
+    if (!ActivateBestChain(state, chainparams))
+        LogPrintf("%s: ActivateBestChain failed: %s\n", __func__, FormatStateMessage(state));
+    return true;
+}
+
+/**
+ * Open the background chain state of a loaded UTXO snapshot, continuing from
+ * where it was left unless it belongs to another snapshot.
+ */
+static void OpenBackgroundChainState()
+{
+    AssertLockHeld(cs_main);
+    assert(pcoinsBackground == NULL);
+    pcoinsdbviewBackground = new CCoinsViewDB(nMaxCoinsDBCache << 20, false, false, false, BACKGROUND_CHAINSTATE_DIR);
+    pindexSnapshotValidated = NULL;
+    uint256 hashBest = pcoinsdbviewBackground->GetBestBlock();
+    if (!hashBest.IsNull()) {
+        BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+        if (mi != mapBlockIndex.end() && pindexSnapshotBase->GetAncestor(mi->second->nHeight) == mi->second) {
+            pindexSnapshotValidated = mi->second;
+        } else {
+            LogPrintf("%s: the background chain state at %s isn't below the UTXO snapshot, starting over\n", __func__, hashBest.ToString());
+            delete pcoinsdbviewBackground;
+            pcoinsdbviewBackground = new CCoinsViewDB(nMaxCoinsDBCache << 20, false, true, false, BACKGROUND_CHAINSTATE_DIR);
+        }
+    }
+    pcoinsBackground = new CCoinsViewCache(pcoinsdbviewBackground);
+    LogPrintf("%s: validating the blocks below the UTXO snapshot from height %d\n", __func__,
+              pindexSnapshotValidated ? pindexSnapshotValidated->nHeight + 1 : 0);
+}
+
+/**
+ * Check the background chain state at a UTXO snapshot's block against the
+ * snapshot, and forget the snapshot if they match: the chain is then as if it
+ * had been validated in full.
+ */
+static bool CompleteSnapshotValidation(const CChainParams& chainparams)
+{
+    AssertLockHeld(cs_main);
+    CCoinsCommitment commitment;
+    if (!pcoinsdbviewBackground->GetCommitment(commitment))
+        return AbortNode("Failed to read the background coin database");
+    commitment += pcoinsBackground->GetCommitmentDelta();
+    MapAssumeUTXO::const_iterator it = chainparams.AssumeUTXO().find(pindexSnapshotBase->nHeight);
+    if (it == chainparams.AssumeUTXO().end() || it->second.hashBlock != pindexSnapshotBase->GetBlockHash() ||
+        it->second.hashCommitment != commitment.GetHash() || it->second.nTransactionOutputs != (uint64_t)commitment.nTransactionOutputs ||
+        pindexSnapshotBase->nChainTx != pindexSnapshotBase->pprev->nChainTx + pindexSnapshotBase->nTx) {
+        return AbortNode(strprintf("The coins at the UTXO snapshot's block %s hash to %s (%d coins, %u transactions), which isn't the snapshot",
+                                   pindexSnapshotBase->GetBlockHash().ToString(), commitment.GetHash().ToString(), commitment.nTransactionOutputs,
+                                   pindexSnapshotBase->pprev->nChainTx + pindexSnapshotBase->nTx),
+                         _("The UTXO snapshot doesn't match the blocks below it, -reindex-chainstate is needed to validate the whole chain"));
+    }
+
+    // The undo data and validity of the blocks are written before the snapshot is forgotten
+    CValidationState state;
+    if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS) || !pblocktree->EraseSnapshotBase())
+        return AbortNode(state, "Failed to write to the database");
+    LogPrintf("%s: the blocks below the UTXO snapshot's block %s are valid\n", __func__, pindexSnapshotBase->GetBlockHash().ToString());
+    pindexSnapshotBase = NULL;
+    pindexSnapshotValidated = NULL;
+    delete pcoinsBackground;
+    pcoinsBackground = NULL;
+    delete pcoinsdbviewBackground;
+    pcoinsdbviewBackground = NULL;
+    try {
+        boost::filesystem::remove_all(GetDataDir() / BACKGROUND_CHAINSTATE_DIR);
+    } catch (const boost::filesystem::filesystem_error& e) {
+        LogPrintf("%s: unable to remove the background chain state: %s\n", __func__, e.what());
+    }
+
+    // The blocks can be served again, unless pruned
+    if (g_connman && !fPruneMode && !(g_connman->GetLocalServices() & NODE_NETWORK)) {
+        LogPrintf("Setting NODE_NETWORK after validating a UTXO snapshot\n");
+        g_connman->AddLocalServices(NODE_NETWORK);
+    }
+    return true;
+}
+
+/**
+ * Connect the next blocks below a loaded UTXO snapshot's to the background
+ * chain state, in order and as their data arrives, for up to nMaxMicros.
+ * fMore is set if there is more to connect right away. Returns false if the
+ * node was aborted.
+ */
+static bool ConnectSnapshotBlocks(const CChainParams& chainparams, int64_t nMaxMicros, bool& fMore)
+{
+    AssertLockHeld(cs_main);
+    fMore = false;
+    if (pindexSnapshotBase == NULL || fUTXOSnapshotLoading)
+        return true;
+    if (pcoinsBackground == NULL)
+        OpenBackgroundChainState();
+
+    int64_t nStart = GetTimeMicros();
+    while (pindexSnapshotValidated != pindexSnapshotBase) {
+        if (GetTimeMicros() - nStart > nMaxMicros) {
+            fMore = true;
+            return true;
+        }
+        CBlockIndex* pindex = pindexSnapshotBase->GetAncestor(pindexSnapshotValidated ? pindexSnapshotValidated->nHeight + 1 : 0);
+        if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+            return true;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
+            return AbortNode("Failed to read block");
+        CValidationState state;
+        if (!ConnectBlock(block, state, pindex, *pcoinsBackground, false, true)) {
+            if (state.IsInvalid())
+                return AbortNode(strprintf("The block %s below the UTXO snapshot's is invalid: %s", pindex->GetBlockHash().ToString(), FormatStateMessage(state)),
+                                 _("The UTXO snapshot was loaded on an invalid chain, -reindex-chainstate is needed to validate the whole chain"));
+            return false;
+        }
+        pindexSnapshotValidated = pindex;
+        if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED))
+            return false;
+    }
+    return CompleteSnapshotValidation(chainparams);
+}
+
+void ThreadSnapshotValidation()
+{
+    RenameThread("dash-snapshot");
+    const CChainParams& chainparams = Params();
+    while (true) {
+        bool fMore;
+        {
+            LOCK(cs_main);
+            try {
+                if (!ConnectSnapshotBlocks(chainparams, SNAPSHOT_VALIDATION_BATCH_MICROS, fMore))
+                    return;
+            } catch (const std::runtime_error& e) {
+                AbortNode(std::string("System error while validating the blocks below the UTXO snapshot: ") + e.what());
+                return;
+            }
+            if (!fMore && pcoinsBackground) {
+                CValidationState state;
+                FlushStateToDisk(state, FLUSH_STATE_PERIODIC);
+            }
+        }
+        // Others get cs_main between the batches, and more blocks may arrive meanwhile
+        MilliSleep(fMore ? 1 : 1000);
+    }
+}
+
 CVerifyDB::CVerifyDB()
 {
     uiInterface.ShowProgress(_("Verifying blocks..."), 0);
@@ -3865,6 +4582,9 @@ bool CVerifyDB::VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview,
         uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
         if (pindex->nHeight < chainActive.Height()-nCheckDepth)
             break;
+        // The blocks up to a loaded UTXO snapshot's were never connected
+        if (pindexSnapshotBase && pindex->nHeight <= pindexSnapshotBase->nHeight)
+            break;
         CBlock block;
         // check level 0: read from disk
         if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus()))
@@ -3931,6 +4651,12 @@ void UnloadBlockIndex()
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
+    pindexSnapshotBase = NULL;
+    pindexSnapshotValidated = NULL;
+    delete pcoinsBackground;
+    pcoinsBackground = NULL;
+    delete pcoinsdbviewBackground;
+    pcoinsdbviewBackground = NULL;
     mempool.clear();
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -3943,10 +4669,8 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
-    }
     mapBlockIndex.clear();
+    blockIndexArena.Clear();
     fHavePruned = false;
 }
 
@@ -3973,6 +4697,7 @@ bool InitBlockIndex(const CChainParams& chainparams)
     // Use the provided setting for -addressindex in the new database
     fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
     pblocktree->WriteFlag("addressindex", fAddressIndex);
+    pblocktree->WriteFlag("addresssummary", true);
 
     // Use the provided setting for -timestampindex in the new database
     fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
@@ -4010,119 +4735,276 @@ bool InitBlockIndex(const CChainParams& chainparams)
     return true;
 }
 
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp)
+CBlockImporter::~CBlockImporter()
+{
+    // external files which were never read
+    for (size_t i = nNextRead; i < vFiles.size(); i++) {
+        if (vFiles[i].file)
+            fclose(vFiles[i].file);
+    }
+}
+
+void CBlockImporter::ReadFile(size_t nIndex)
+{
+    const CImportFile& importFile = vFiles[nIndex];
+    FILE* fileIn = importFile.file ? importFile.file : OpenBlockFile(CDiskBlockPos(importFile.nFile, 0), true);
+    if (!fileIn)
+        return; // This error is logged in OpenBlockFile
+
+    unsigned int nMaxBlockSize = MaxBlockSize(true);
+    // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
+    CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
+    uint64_t nRewind = blkdat.GetPos();
+    while (!blkdat.eof()) {
+        blkdat.SetPos(nRewind);
+        nRewind++; // start one byte further next time, in case of failure
+        blkdat.SetLimit(); // remove former limit
+        unsigned int nSize = 0;
+        try {
+            // locate a header
+            unsigned char buf[MESSAGE_START_SIZE];
+            blkdat.FindByte(chainparams.MessageStart()[0]);
+            nRewind = blkdat.GetPos()+1;
+            blkdat >> FLATDATA(buf);
+            if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
+                continue;
+            // read size
+            blkdat >> nSize;
+            if (nSize < 80 || nSize > nMaxBlockSize)
+                continue;
+        } catch (const std::exception&) {
+            // no valid block header found; don't complain
+            break;
+        }
+        try {
+            // read block
+            uint64_t nBlockPos = blkdat.GetPos();
+            blkdat.SetLimit(nBlockPos + nSize);
+            blkdat.SetPos(nBlockPos);
+            CImportBlock imported;
+            blkdat >> imported.block;
+            nRewind = blkdat.GetPos();
+            imported.hash = imported.block.GetHash();
+            imported.pos = CDiskBlockPos(importFile.nFile, nBlockPos);
+            imported.nSize = nSize;
+
+            // Blocks failing the checks are checked again, and rejected, when
+            // they are accepted. Blocks passing them are marked as checked.
+            CValidationState state;
+            CheckBlock(imported.block, state);
+
+            if (!Push(nIndex, imported))
+                return;
+        } catch (const std::exception& e) {
+            LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
+        }
+    }
+}
+
+bool CBlockImporter::Push(size_t nIndex, CImportBlock& imported)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nIndex != nAccepting && nBuffered + imported.nSize > nMaxBuffered && !fStop && !vQueues[nIndex].fSkip) {
+        int64_t nWaitStart = GetTimeMicros();
+        while (nIndex != nAccepting && nBuffered + imported.nSize > nMaxBuffered && !fStop && !vQueues[nIndex].fSkip)
+            condRead.wait(lock);
+        nReadWaitMicros += GetTimeMicros() - nWaitStart;
+    }
+    if (fStop || vQueues[nIndex].fSkip)
+        return false;
+    nBuffered += imported.nSize;
+    vQueues[nIndex].blocks.push_back(std::move(imported));
+    if (nIndex == nAccepting)
+        condAccept.notify_one();
+    return true;
+}
+
+void CBlockImporter::ThreadRead()
+{
+    while (true) {
+        size_t nIndex;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (fStop || nNextRead == vFiles.size())
+                return;
+            nIndex = nNextRead++;
+        }
+        try {
+            ReadFile(nIndex);
+        } catch (const std::runtime_error& e) {
+            AbortNode(std::string("System error: ") + e.what());
+        }
+        boost::unique_lock<boost::mutex> lock(mutex);
+        vQueues[nIndex].fDone = true;
+        if (nIndex == nAccepting)
+            condAccept.notify_one();
+    }
+}
+
+bool CBlockImporter::Pop(size_t nIndex, CImportBlock& imported)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nAccepting != nIndex) {
+        // the reader of this file may be waiting for room
+        nAccepting = nIndex;
+        condRead.notify_all();
+    }
+    CFileQueue& queue = vQueues[nIndex];
+    if (queue.blocks.empty() && !queue.fDone) {
+        int64_t nWaitStart = GetTimeMicros();
+        while (queue.blocks.empty() && !queue.fDone)
+            condAccept.wait(lock);
+        nAcceptWaitMicros += GetTimeMicros() - nWaitStart;
+    }
+    if (queue.blocks.empty())
+        return false;
+    imported = std::move(queue.blocks.front());
+    queue.blocks.pop_front();
+    nBuffered -= imported.nSize;
+    condRead.notify_all();
+    return true;
+}
+
+void CBlockImporter::Skip(size_t nIndex)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    CFileQueue& queue = vQueues[nIndex];
+    queue.fSkip = true;
+    BOOST_FOREACH(const CImportBlock& imported, queue.blocks)
+        nBuffered -= imported.nSize;
+    queue.blocks.clear();
+    condRead.notify_all();
+}
+
+void CBlockImporter::Stop()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fStop = true;
+    condRead.notify_all();
+}
+
+namespace {
+
+/** Accept a block read by the importer. Returns false if the rest of its file is to be skipped. */
+bool AcceptImportedBlock(const CChainParams& chainparams, const CImportBlock& imported, const CDiskBlockPos* dbp, int& nLoaded)
 {
     // Map of disk positions for blocks with unknown parent (only used for reindex)
     static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
-    int64_t nStart = GetTimeMillis();
 
-    int nLoaded = 0;
-    try {
-        unsigned int nMaxBlockSize = MaxBlockSize(true);
-        // This takes over fileIn and calls fclose() on it in the CBufferedFile destructor
-        CBufferedFile blkdat(fileIn, 2*nMaxBlockSize, nMaxBlockSize+8, SER_DISK, CLIENT_VERSION);
-        uint64_t nRewind = blkdat.GetPos();
-        while (!blkdat.eof()) {
-            boost::this_thread::interruption_point();
+    const CBlock& block = imported.block;
+    const uint256& hash = imported.hash;
 
-            blkdat.SetPos(nRewind);
-            nRewind++; // start one byte further next time, in case of failure
-            blkdat.SetLimit(); // remove former limit
-            unsigned int nSize = 0;
-            try {
-                // locate a header
-                unsigned char buf[MESSAGE_START_SIZE];
-                blkdat.FindByte(chainparams.MessageStart()[0]);
-                nRewind = blkdat.GetPos()+1;
-                blkdat >> FLATDATA(buf);
-                if (memcmp(buf, chainparams.MessageStart(), MESSAGE_START_SIZE))
-                    continue;
-                // read size
-                blkdat >> nSize;
-                if (nSize < 80 || nSize > nMaxBlockSize)
-                    continue;
-            } catch (const std::exception&) {
-                // no valid block header found; don't complain
-                break;
-            }
-            try {
-                // read block
-                uint64_t nBlockPos = blkdat.GetPos();
-                if (dbp)
-                    dbp->nPos = nBlockPos;
-                blkdat.SetLimit(nBlockPos + nSize);
-                blkdat.SetPos(nBlockPos);
-                CBlock block;
-                blkdat >> block;
-                nRewind = blkdat.GetPos();
-
-                // detect out of order blocks, and store them for later
-                uint256 hash = block.GetHash();
-                if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
-                    LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
-                            block.hashPrevBlock.ToString());
-                    if (dbp)
-                        mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
-                    continue;
-                }
+    // detect out of order blocks, and store them for later
+    if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex.find(block.hashPrevBlock) == mapBlockIndex.end()) {
+        LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, hash.ToString(),
+                block.hashPrevBlock.ToString());
+        if (dbp)
+            mapBlocksUnknownParent.insert(std::make_pair(block.hashPrevBlock, *dbp));
+        return true;
+    }
 
-                // process in case the block isn't known yet
-                if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
-                    LOCK(cs_main);
-                    CValidationState state;
-                    if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL))
-                        nLoaded++;
-                    if (state.IsError())
-                        break;
-                } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
-                    LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
-                }
+    // process in case the block isn't known yet
+    if (mapBlockIndex.count(hash) == 0 || (mapBlockIndex[hash]->nStatus & BLOCK_HAVE_DATA) == 0) {
+        LOCK(cs_main);
+        CValidationState state;
+        if (AcceptBlock(block, state, chainparams, NULL, true, dbp, NULL))
+            nLoaded++;
+        if (state.IsError())
+            return false;
+    } else if (hash != chainparams.GetConsensus().hashGenesisBlock && mapBlockIndex[hash]->nHeight % 1000 == 0) {
+        LogPrint("reindex", "Block Import: already had block %s at height %d\n", hash.ToString(), mapBlockIndex[hash]->nHeight);
+    }
 
-                // Activate the genesis block so normal node progress can continue
-                if (hash == chainparams.GetConsensus().hashGenesisBlock) {
-                    CValidationState state;
-                    if (!ActivateBestChain(state, chainparams)) {
-                        break;
-                    }
+    // Activate the genesis block so normal node progress can continue
+    if (hash == chainparams.GetConsensus().hashGenesisBlock) {
+        CValidationState state;
+        if (!ActivateBestChain(state, chainparams)) {
+            return false;
+        }
+    }
+
+    NotifyHeaderTip();
+
+    // Recursively process earlier encountered successors of this block
+    deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 head = queue.front();
+        queue.pop_front();
+        std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+        while (range.first != range.second) {
+            std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+            CBlock blockChild;
+            if (ReadBlockFromDisk(blockChild, it->second, chainparams.GetConsensus()))
+            {
+                LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, blockChild.GetHash().ToString(),
+                        head.ToString());
+                LOCK(cs_main);
+                CValidationState dummy;
+                if (AcceptBlock(blockChild, dummy, chainparams, NULL, true, &it->second, NULL))
+                {
+                    nLoaded++;
+                    queue.push_back(blockChild.GetHash());
                 }
+            }
+            range.first++;
+            mapBlocksUnknownParent.erase(it);
+            NotifyHeaderTip();
+        }
+    }
+    return true;
+}
 
-                NotifyHeaderTip();
-
-                // Recursively process earlier encountered successors of this block
-                deque<uint256> queue;
-                queue.push_back(hash);
-                while (!queue.empty()) {
-                    uint256 head = queue.front();
-                    queue.pop_front();
-                    std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
-                    while (range.first != range.second) {
-                        std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
-                        if (ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
-                        {
-                            LogPrint("reindex", "%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
-                                    head.ToString());
-                            LOCK(cs_main);
-                            CValidationState dummy;
-                            if (AcceptBlock(block, dummy, chainparams, NULL, true, &it->second, NULL))
-                            {
-                                nLoaded++;
-                                queue.push_back(block.GetHash());
-                            }
-                        }
-                        range.first++;
-                        mapBlocksUnknownParent.erase(it);
-                        NotifyHeaderTip();
+} // anon namespace
+
+bool LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<CImportFile>& vFiles, uint64_t nMaxBuffered)
+{
+    int64_t nStart = GetTimeMillis();
+    int nLoaded = 0;
+
+    CBlockImporter importer(chainparams, vFiles, nMaxBuffered);
+    boost::thread_group threads;
+    int nThreads = std::max(1, std::min(nImportThreads, (int)vFiles.size()));
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&CBlockImporter::ThreadRead, &importer));
+
+    try {
+        for (size_t i = 0; i < vFiles.size(); i++) {
+            if (vFiles[i].nFile >= 0)
+                LogPrintf("Reindexing block file blk%05u.dat...\n", (unsigned int)vFiles[i].nFile);
+            else
+                LogPrintf("Importing blocks file %s...\n", vFiles[i].strName);
+
+            CImportBlock imported;
+            while (importer.Pop(i, imported)) {
+                boost::this_thread::interruption_point();
+                try {
+                    if (!AcceptImportedBlock(chainparams, imported, vFiles[i].nFile >= 0 ? &imported.pos : NULL, nLoaded)) {
+                        importer.Skip(i);
+                        break;
                     }
+                } catch (const std::exception& e) {
+                    LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
                 }
-            } catch (const std::exception& e) {
-                LogPrintf("%s: Deserialize or I/O error - %s\n", __func__, e.what());
             }
         }
     } catch (const std::runtime_error& e) {
         AbortNode(std::string("System error: ") + e.what());
+    } catch (...) {
+        boost::this_thread::disable_interruption noInterrupt;
+        importer.Stop();
+        threads.join_all();
+        throw;
     }
+    {
+        boost::this_thread::disable_interruption noInterrupt;
+        importer.Stop();
+        threads.join_all();
+    }
+
     if (nLoaded > 0)
-        LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+        LogPrintf("Loaded %i blocks from %u external files in %dms, %d threads reading and checking them (readers waited %dms, accepting waited %dms)\n",
+            nLoaded, vFiles.size(), GetTimeMillis() - nStart, nThreads, importer.GetReadWaitMicros() / 1000, importer.GetAcceptWaitMicros() / 1000);
     return nLoaded > 0;
 }
 
@@ -4167,15 +5049,28 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
     CBlockIndex* pindexFirstNotTransactionsValid = NULL; // Oldest ancestor of pindex which does not have BLOCK_VALID_TRANSACTIONS (regardless of being valid or not).
     CBlockIndex* pindexFirstNotChainValid = NULL; // Oldest ancestor of pindex which does not have BLOCK_VALID_CHAIN (regardless of being valid or not).
     CBlockIndex* pindexFirstNotScriptsValid = NULL; // Oldest ancestor of pindex which does not have BLOCK_VALID_SCRIPTS (regardless of being valid or not).
+    // A UTXO snapshot's block is checked as if it were fully validated, and the
+    // blocks below it aren't ancestors of its descendants for these checks.
+    CBlockIndex* pindexSnapshotSaved[5] = {};
     while (pindex != NULL) {
         nNodes++;
+        if (pindex == pindexSnapshotBase) {
+            pindexSnapshotSaved[0] = pindexFirstMissing;
+            pindexSnapshotSaved[1] = pindexFirstNeverProcessed;
+            pindexSnapshotSaved[2] = pindexFirstNotTransactionsValid;
+            pindexSnapshotSaved[3] = pindexFirstNotChainValid;
+            pindexSnapshotSaved[4] = pindexFirstNotScriptsValid;
+            pindexFirstMissing = pindexFirstNeverProcessed = pindexFirstNotTransactionsValid = pindexFirstNotChainValid = pindexFirstNotScriptsValid = NULL;
+        }
         if (pindexFirstInvalid == NULL && pindex->nStatus & BLOCK_FAILED_VALID) pindexFirstInvalid = pindex;
-        if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
-        if (pindexFirstNeverProcessed == NULL && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
         if (pindex->pprev != NULL && pindexFirstNotTreeValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TREE) pindexFirstNotTreeValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotTransactionsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
-        if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        if (pindex != pindexSnapshotBase) {
+            if (pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_HAVE_DATA)) pindexFirstMissing = pindex;
+            if (pindexFirstNeverProcessed == NULL && pindex->nTx == 0) pindexFirstNeverProcessed = pindex;
+            if (pindex->pprev != NULL && pindexFirstNotTransactionsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_TRANSACTIONS) pindexFirstNotTransactionsValid = pindex;
+            if (pindex->pprev != NULL && pindexFirstNotChainValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_CHAIN) pindexFirstNotChainValid = pindex;
+            if (pindex->pprev != NULL && pindexFirstNotScriptsValid == NULL && (pindex->nStatus & BLOCK_VALID_MASK) < BLOCK_VALID_SCRIPTS) pindexFirstNotScriptsValid = pindex;
+        }
 
         // Begin: actual consistency checks.
         if (pindex->pprev == NULL) {
@@ -4283,6 +5178,13 @@ void static CheckBlockIndex(const Consensus::Params& consensusParams)
             if (pindex == pindexFirstNotTransactionsValid) pindexFirstNotTransactionsValid = NULL;
             if (pindex == pindexFirstNotChainValid) pindexFirstNotChainValid = NULL;
             if (pindex == pindexFirstNotScriptsValid) pindexFirstNotScriptsValid = NULL;
+            if (pindex == pindexSnapshotBase) {
+                pindexFirstMissing = pindexSnapshotSaved[0];
+                pindexFirstNeverProcessed = pindexSnapshotSaved[1];
+                pindexFirstNotTransactionsValid = pindexSnapshotSaved[2];
+                pindexFirstNotChainValid = pindexSnapshotSaved[3];
+                pindexFirstNotScriptsValid = pindexSnapshotSaved[4];
+            }
             // Find our parent.
             CBlockIndex* pindexPar = pindex->pprev;
             // Find which child we just visited.
@@ -4389,9 +5291,7 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
     }
 } instance_of_cmaincleanup;
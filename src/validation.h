@@ -21,6 +21,7 @@
 #include "spentindex.h"
 
 #include <algorithm>
+#include <deque>
 #include <exception>
 #include <map>
 #include <set>
@@ -33,6 +34,8 @@
 
 #include <boost/unordered_map.hpp>
 #include <boost/filesystem/path.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 class CBlockIndex;
 class CBlockTreeDB;
@@ -79,8 +82,29 @@ static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
-/** Number of blocks that can be requested at any given time from a single peer. */
+/** Maximum number of threads prefetching block inputs from the coin database */
+static const int MAX_COINS_PREFETCH_THREADS = 16;
+/** -prefetchthreads default */
+static const int DEFAULT_COINS_PREFETCH_THREADS = 4;
+/** Maximum number of threads reading and checking block files while importing them */
+static const int MAX_IMPORT_THREADS = 16;
+/** -importthreads default (number of threads reading and checking block files while importing them, 0 = auto) */
+static const int DEFAULT_IMPORT_THREADS = 0;
+/** Serialized size of the blocks read ahead of the blocks being accepted while importing block files */
+static const uint64_t MAX_IMPORT_BUFFER_SIZE = 256 * 1024 * 1024;
+/** Number of blocks that can be requested at any given time from a single peer, until its download rate is
+ *  measured, and when fetching blocks announced near the tip. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Bounds of the per-peer number of blocks in flight during parallel download, sized by the peer's measured rate. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 2;
+static const int MAX_ADAPTIVE_BLOCKS_IN_TRANSIT_PER_PEER = 128;
+/** Time (in microseconds) a peer should be kept sending blocks for at its measured rate, beyond its round trip. */
+static const int64_t BLOCK_DOWNLOAD_BUFFER_TIME = 2 * 1000000;
+/** Number of blocks received from a peer before its rate is used to size its number of blocks in flight. */
+static const int BLOCK_DOWNLOAD_MIN_SAMPLES = 4;
+/** Blocks held up by a stalling peer are requested from another peer once in flight for twice the stalling
+ *  peer's average response time, and at least this long (in microseconds). */
+static const int64_t BLOCK_STALLED_REREQUEST_MIN = 500000;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -95,6 +119,10 @@ static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
 static const unsigned int DATABASE_WRITE_INTERVAL = 60 * 60;
 /** Time to wait (in seconds) between flushing chainstate to disk. */
 static const unsigned int DATABASE_FLUSH_INTERVAL = 24 * 60 * 60;
+/** Directory of the chain state the blocks below a loaded UTXO snapshot's are validated on. */
+static const char* const BACKGROUND_CHAINSTATE_DIR = "chainstate_background";
+/** Time (in microseconds) the background validation of a UTXO snapshot holds cs_main for at a time. */
+static const int64_t SNAPSHOT_VALIDATION_BATCH_MICROS = 100000;
 /** Maximum length of reject messages. */
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Average delay between local address broadcasts in seconds. */
@@ -147,7 +175,10 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nCoinsPrefetchThreads;
+extern int nImportThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -172,6 +203,22 @@ extern uint256 hashAssumeValid;
 /** Best header we've seen so far (used for getheaders queries' starting points). */
 extern CBlockIndex *pindexBestHeader;
 
+/**
+ * The block a UTXO snapshot was loaded at, if any. The chain below it is
+ * assumed valid until ThreadSnapshotValidation has downloaded and connected
+ * its blocks, and found the snapshot's coins at the end.
+ */
+extern CBlockIndex *pindexSnapshotBase;
+
+/** The last block below pindexSnapshotBase connected in the background, if any */
+extern CBlockIndex *pindexSnapshotValidated;
+
+/**
+ * Whether a UTXO snapshot is being added to pcoinsTip. cs_main is released
+ * meanwhile, so nothing may connect to or disconnect from the chain state.
+ */
+extern std::atomic<bool> fUTXOSnapshotLoading;
+
 /** Minimum disk space required - used in CheckDiskSpace() */
 static const uint64_t nMinDiskSpace = 52428800;
 
@@ -236,8 +283,98 @@ FILE* OpenBlockFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 FILE* OpenUndoFile(const CDiskBlockPos &pos, bool fReadOnly = false);
 /** Translation to a filesystem path */
 boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char *prefix);
-/** Import blocks from an external file */
-bool LoadExternalBlockFile(const CChainParams& chainparams, FILE* fileIn, CDiskBlockPos *dbp = NULL);
+/** A file to import blocks from */
+struct CImportFile
+{
+    //! Open external file, or NULL for a block file of our own, which is opened when it is read
+    FILE* file;
+    //! Number of the blk?????.dat file when reindexing, -1 for an external file
+    int nFile;
+    std::string strName;
+
+    CImportFile(FILE* fileIn, int nFileIn, const std::string& strNameIn) : file(fileIn), nFile(nFileIn), strName(strNameIn) {}
+};
+
+/** A block of a file being imported, read and checked by an import thread */
+struct CImportBlock
+{
+    CBlock block;
+    uint256 hash;
+    CDiskBlockPos pos;
+    unsigned int nSize;
+};
+
+/**
+ * Pipeline of LoadExternalBlockFiles(). Reader threads take the files in
+ * order, find and deserialize their blocks and run the context-free
+ * CheckBlock() on them, which is most of the work of importing a block.
+ * The calling thread accepts the blocks of one file after another, in the
+ * order they appear in the file, so blocks are accepted just as if the files
+ * were read one at a time.
+ *
+ * Readers stop when the blocks read ahead take up nMaxBuffered bytes,
+ * except the reader of the file being accepted.
+ */
+class CBlockImporter
+{
+private:
+    struct CFileQueue
+    {
+        std::deque<CImportBlock> blocks;
+        bool fDone;
+        //! Remaining blocks of the file are dropped
+        bool fSkip;
+        CFileQueue() : fDone(false), fSkip(false) {}
+    };
+
+    const CChainParams& chainparams;
+    const std::vector<CImportFile>& vFiles;
+    const uint64_t nMaxBuffered;
+
+    boost::mutex mutex;
+    boost::condition_variable condRead;
+    boost::condition_variable condAccept;
+    std::vector<CFileQueue> vQueues;
+    size_t nNextRead;
+    size_t nAccepting;
+    uint64_t nBuffered;
+    bool fStop;
+    int64_t nReadWaitMicros;
+    int64_t nAcceptWaitMicros;
+
+    void ReadFile(size_t nIndex);
+    bool Push(size_t nIndex, CImportBlock& imported);
+
+public:
+    CBlockImporter(const CChainParams& chainparamsIn, const std::vector<CImportFile>& vFilesIn, uint64_t nMaxBufferedIn = MAX_IMPORT_BUFFER_SIZE) :
+        chainparams(chainparamsIn), vFiles(vFilesIn), nMaxBuffered(nMaxBufferedIn), vQueues(vFilesIn.size()), nNextRead(0),
+        nAccepting(0), nBuffered(0), fStop(false), nReadWaitMicros(0), nAcceptWaitMicros(0) {}
+    ~CBlockImporter();
+
+    void ThreadRead();
+    /** Take the next block of file nIndex, waiting for it to be read. Returns false at the end of the file. */
+    bool Pop(size_t nIndex, CImportBlock& imported);
+    /** Drop the remaining blocks of file nIndex */
+    void Skip(size_t nIndex);
+    /** Make the reader threads return */
+    void Stop();
+
+    uint64_t GetBuffered() { boost::unique_lock<boost::mutex> lock(mutex); return nBuffered; }
+    int64_t GetReadWaitMicros() { boost::unique_lock<boost::mutex> lock(mutex); return nReadWaitMicros; }
+    int64_t GetAcceptWaitMicros() { boost::unique_lock<boost::mutex> lock(mutex); return nAcceptWaitMicros; }
+
+private:
+    CBlockImporter(const CBlockImporter&);
+    CBlockImporter& operator=(const CBlockImporter&);
+};
+
+/**
+ * Import the blocks of files, which are read and checked by nImportThreads
+ * threads and accepted in the order of the files. This takes over and closes
+ * the open files.
+ */
+bool LoadExternalBlockFiles(const CChainParams& chainparams, const std::vector<CImportFile>& vFiles,
+                            uint64_t nMaxBuffered = MAX_IMPORT_BUFFER_SIZE);
 /** Initialize a new block tree database + block data on disk */
 bool InitBlockIndex(const CChainParams& chainparams);
 /** Load the block tree and coins database from disk */
@@ -246,6 +383,10 @@ bool LoadBlockIndex();
 void UnloadBlockIndex();
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run an instance of the coins prefetch thread */
+void ThreadCoinsPrefetch();
+/** Validate the blocks below a loaded UTXO snapshot's, whenever there is one */
+void ThreadSnapshotValidation();
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
 /** Format a string that describes several potential problems detected by the core.
@@ -294,6 +435,13 @@ void FlushStateToDisk();
 /** Prune block files and flush state to disk. */
 void PruneAndFlush();
 
+/**
+ * Replace the chain state of a node at the genesis block with the UTXO
+ * snapshot at path, which must match an entry of the chain parameters'
+ * AssumeUTXO(), and continue the active chain from its block.
+ */
+bool ActivateUTXOSnapshot(const boost::filesystem::path& path, std::string& strError);
+
 /** (try to) add transaction to memory pool **/
 bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState &state, const CTransaction &tx, bool fLimitFree,
                         bool* pfMissingInputs, bool fOverrideMempoolLimit=false, bool fRejectAbsurdFee=false, bool fDryRun=false);
@@ -419,11 +567,21 @@ bool GetAddressIndex(uint160 addressHash, int type,
                      int start = 0, int end = 0);
 bool GetAddressUnspent(uint160 addressHash, int type,
                        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs);
+bool GetAddressUnspentPage(uint160 addressHash, int type,
+                           std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs,
+                           size_t nLimit, bool fReverse, const CAddressUnspentKey *pCursor = NULL);
+bool GetAddressSummary(uint160 addressHash, int type, CAddressSummary &summary);
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+/**
+ * Open the block file holding the block of pindex, positioned at its serialized
+ * block, and set nSize to the size of it. The header is checked against the
+ * index, the transactions are not read. Returns NULL on failure.
+ */
+FILE* OpenRawBlock(const CBlockIndex* pindex, unsigned int& nSize);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -468,6 +626,10 @@ extern CCoinsViewDB *pcoinsdbview;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** The chain state of ThreadSnapshotValidation while a UTXO snapshot is loaded (protected by cs_main) */
+extern CCoinsViewDB *pcoinsdbviewBackground;
+extern CCoinsViewCache *pcoinsBackground;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
@@ -13,11 +13,14 @@ class CBlock;
 struct CBlockLocator;
 class CBlockIndex;
 class CConnman;
+class CGovernanceObject;
+class COutPoint;
 class CReserveScript;
 class CTransaction;
 class CValidationInterface;
 class CValidationState;
 class uint256;
+enum class MemPoolRemovalReason;
 
 // These functions dispatch to one or all registered wallets
 
@@ -35,6 +38,9 @@ protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
+    virtual void TransactionRemovedFromMempool(const CTransaction &tx, MemPoolRemovalReason reason) {}
+    virtual void NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded) {}
+    virtual void NotifyGovernanceObject(const CGovernanceObject &govobj) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
     virtual void Inventory(const uint256 &hash) {}
@@ -58,6 +64,12 @@ struct CMainSignals {
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    /** Notifies listeners of a transaction leaving the mempool, for any reason. Called with the mempool locked. */
+    boost::signals2::signal<void (const CTransaction &, MemPoolRemovalReason)> TransactionRemovedFromMempool;
+    /** Notifies listeners of a masternode added to or removed from the masternode list */
+    boost::signals2::signal<void (const COutPoint &, bool fAdded)> NotifyMasternodeListChanged;
+    /** Notifies listeners of a new governance object */
+    boost::signals2::signal<void (const CGovernanceObject &)> NotifyGovernanceObject;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
@@ -25,3 +25,18 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyTransactionRemoved(const CTransaction &/*transaction*/, MemPoolRemovalReason /*reason*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyMasternodeListChanged(const COutPoint &/*outpoint*/, bool /*fAdded*/)
+{
+    return true;
+}
+
+bool CZMQAbstractNotifier::NotifyGovernanceObject(const CGovernanceObject &/*govobj*/)
+{
+    return true;
+}
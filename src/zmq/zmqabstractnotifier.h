@@ -8,14 +8,19 @@
 #include "zmqconfig.h"
 
 class CBlockIndex;
+class CGovernanceObject;
 class CZMQAbstractNotifier;
+enum class MemPoolRemovalReason;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
+//! Messages queued on a ZMQ socket for slow subscribers before further ones are dropped, per topic
+static const int DEFAULT_ZMQ_SNDHWM = 1000;
+
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : psocket(0), outbound_message_high_water_mark(DEFAULT_ZMQ_SNDHWM) { }
     virtual ~CZMQAbstractNotifier();
 
     template <typename T>
@@ -28,6 +33,12 @@ public:
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    int GetOutboundMessageHighWaterMark() const { return outbound_message_high_water_mark; }
+    void SetOutboundMessageHighWaterMark(const int sndhwm) {
+        if (sndhwm >= 0) {
+            outbound_message_high_water_mark = sndhwm;
+        }
+    }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
@@ -35,11 +46,15 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyTransactionRemoved(const CTransaction &transaction, MemPoolRemovalReason reason);
+    virtual bool NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded);
+    virtual bool NotifyGovernanceObject(const CGovernanceObject &govobj);
 
 protected:
     void *psocket;
     std::string type;
     std::string address;
+    int outbound_message_high_water_mark; // aka SNDHWM
 };
 
 #endif // BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
@@ -41,6 +41,10 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
     factories["pubrawblock"] = CZMQAbstractNotifier::Create<CZMQPublishRawBlockNotifier>;
     factories["pubrawtx"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionNotifier>;
     factories["pubrawtxlock"] = CZMQAbstractNotifier::Create<CZMQPublishRawTransactionLockNotifier>;
+    factories["pubhashtxremoved"] = CZMQAbstractNotifier::Create<CZMQPublishHashTransactionRemovedNotifier>;
+    factories["pubmasternodelist"] = CZMQAbstractNotifier::Create<CZMQPublishMasternodeListNotifier>;
+    factories["pubhashgovernanceobject"] = CZMQAbstractNotifier::Create<CZMQPublishHashGovernanceObjectNotifier>;
+    factories["pubrawgovernanceobject"] = CZMQAbstractNotifier::Create<CZMQPublishRawGovernanceObjectNotifier>;
 
     for (std::map<std::string, CZMQNotifierFactory>::const_iterator i=factories.begin(); i!=factories.end(); ++i)
     {
@@ -52,6 +56,9 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
             CZMQAbstractNotifier *notifier = factory();
             notifier->SetType(i->first);
             notifier->SetAddress(address);
+            std::map<std::string, std::string>::const_iterator k = args.find("-zmq" + i->first + "hwm");
+            if (k!=args.end())
+                notifier->SetOutboundMessageHighWaterMark(atoi(k->second.c_str()));
             notifiers.push_back(notifier);
         }
     }
@@ -105,6 +112,8 @@ bool CZMQNotificationInterface::Initialize()
         return false;
     }
 
+    StartZMQPublishThread();
+
     return true;
 }
 
@@ -114,6 +123,8 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        StopZMQPublishThread();
+
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
@@ -126,15 +137,15 @@ void CZMQNotificationInterface::Shutdown()
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+void CZMQNotificationInterface::NotifyBlocks(const std::vector<const CBlockIndex*>& vBlocks)
 {
-    if (fInitialDownload || pindexNew == pindexFork) // In IBD or blocks were disconnected without any new ones
-        return;
-
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindexNew))
+        bool fOk = true;
+        for (std::vector<const CBlockIndex*>::const_iterator it = vBlocks.begin(); fOk && it != vBlocks.end(); ++it)
+            fOk = notifier->NotifyBlock(*it);
+        if (fOk)
         {
             i++;
         }
@@ -146,6 +157,39 @@ void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, co
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload)
+{
+    LOCK(cs);
+
+    // Blocks disconnected since they were connected during IBD are not published
+    while (!vIBDBlocks.empty() && (!pindexFork || vIBDBlocks.back()->nHeight > pindexFork->nHeight))
+        vIBDBlocks.pop_back();
+
+    if (fInitialDownload)
+    {
+        // Publish every block connected, a batch at a time
+        std::vector<const CBlockIndex*> vConnected;
+        for (const CBlockIndex *pindex = pindexNew; pindex && pindex != pindexFork; pindex = pindex->pprev)
+            vConnected.push_back(pindex);
+        vIBDBlocks.insert(vIBDBlocks.end(), vConnected.rbegin(), vConnected.rend());
+        if (vIBDBlocks.size() >= ZMQ_IBD_BLOCK_BATCH)
+        {
+            NotifyBlocks(vIBDBlocks);
+            vIBDBlocks.clear();
+        }
+        return;
+    }
+
+    if (pindexNew == pindexFork && vIBDBlocks.empty()) // blocks were disconnected without any new ones
+        return;
+
+    // The rest of the IBD batch is published with the first tip after it
+    if (pindexNew != pindexFork)
+        vIBDBlocks.push_back(pindexNew);
+    NotifyBlocks(vIBDBlocks);
+    vIBDBlocks.clear();
+}
+
 void CZMQNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
@@ -179,3 +223,54 @@ void CZMQNotificationInterface::NotifyTransactionLock(const CTransaction &tx)
         }
     }
 }
+
+void CZMQNotificationInterface::TransactionRemovedFromMempool(const CTransaction &tx, MemPoolRemovalReason reason)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyTransactionRemoved(tx, reason))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyMasternodeListChanged(outpoint, fAdded))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
+
+void CZMQNotificationInterface::NotifyGovernanceObject(const CGovernanceObject &govobj)
+{
+    for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+    {
+        CZMQAbstractNotifier *notifier = *i;
+        if (notifier->NotifyGovernanceObject(govobj))
+        {
+            i++;
+        }
+        else
+        {
+            notifier->Shutdown();
+            i = notifiers.erase(i);
+        }
+    }
+}
@@ -6,12 +6,17 @@
 #define BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
 
 #include "validationinterface.h"
+#include "sync.h"
 #include <string>
 #include <map>
+#include <vector>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 
+//! Blocks connected during initial block download that are published together
+static const unsigned int ZMQ_IBD_BLOCK_BATCH = 100;
+
 class CZMQNotificationInterface : public CValidationInterface
 {
 public:
@@ -27,12 +32,22 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindexNew, const CBlockIndex *pindexFork, bool fInitialDownload);
     void NotifyTransactionLock(const CTransaction &tx);
+    void TransactionRemovedFromMempool(const CTransaction &tx, MemPoolRemovalReason reason);
+    void NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded);
+    void NotifyGovernanceObject(const CGovernanceObject &govobj);
 
 private:
     CZMQNotificationInterface();
 
+    void NotifyBlocks(const std::vector<const CBlockIndex*>& vBlocks);
+
     void *pcontext;
     std::list<CZMQAbstractNotifier*> notifiers;
+
+    //! Protects vIBDBlocks and keeps block notifications in order
+    CCriticalSection cs;
+    //! Blocks connected during initial block download, not yet published
+    std::vector<const CBlockIndex*> vIBDBlocks;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
@@ -2,20 +2,61 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockcache.h"
 #include "chainparams.h"
+#include "governance-object.h"
 #include "streams.h"
+#include "txmempool.h"
 #include "zmqpublishnotifier.h"
 #include "validation.h"
 #include "util.h"
 
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/thread.hpp>
+
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
+/** A message waiting for the publish thread */
+struct CZMQPublishMessage
+{
+    CZMQAbstractPublishNotifier *notifier;
+    const char *command;
+    std::vector<unsigned char> data;
+    //! If set, the data is this block, read from disk when the message is sent
+    const CBlockIndex *pindexBlock;
+    uint32_t nSequence;
+};
+
+/** Publish queue state */
+
+//! Protects the fields below
+static CWaitableCriticalSection csPublishQueue;
+static CConditionVariable condPublishQueue;
+static std::deque<CZMQPublishMessage> queuePublish;
+//! Bytes taken by the messages in queuePublish
+static size_t nPublishQueueSize = 0;
+//! Messages dropped since the queue became full
+static int64_t nPublishDropped = 0;
+static bool fPublishRunning = false;
+static bool fPublishStop = false;
+static boost::thread threadPublish;
+
+//! Held by the publish thread while it sends on a socket and by Shutdown() while it closes one
+static boost::mutex csPublishSend;
+
 static const char *MSG_HASHBLOCK  = "hashblock";
 static const char *MSG_HASHTX     = "hashtx";
 static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_HASHTXREMOVED = "hashtxremoved";
+static const char *MSG_MASTERNODELIST = "masternodelist";
+static const char *MSG_HASHGOVOBJ = "hashgovernanceobject";
+static const char *MSG_RAWGOVOBJ  = "rawgovernanceobject";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -73,7 +114,17 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
             return false;
         }
 
-        int rc = zmq_bind(psocket, address.c_str());
+        LogPrint("zmq", "zmq: Outbound message high water mark for %s at %s is %d\n", type, address, outbound_message_high_water_mark);
+
+        int rc = zmq_setsockopt(psocket, ZMQ_SNDHWM, &outbound_message_high_water_mark, sizeof(outbound_message_high_water_mark));
+        if (rc != 0)
+        {
+            zmqError("Failed to set outbound message high water mark");
+            zmq_close(psocket);
+            return false;
+        }
+
+        rc = zmq_bind(psocket, address.c_str());
         if (rc!=0)
         {
             zmqError("Failed to bind address");
@@ -88,6 +139,8 @@ bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
     else
     {
         LogPrint("zmq", "zmq: Reusing socket for address %s\n", address);
+        if (outbound_message_high_water_mark != i->second->outbound_message_high_water_mark)
+            LogPrint("zmq", "zmq: Outbound message high water mark for %s at %s is %d from %s\n", type, address, i->second->outbound_message_high_water_mark, i->second->type);
 
         psocket = i->second->psocket;
         mapPublishNotifiers.insert(std::make_pair(address, this));
@@ -100,6 +153,24 @@ void CZMQAbstractPublishNotifier::Shutdown()
 {
     assert(psocket);
 
+    {
+        // The messages still queued for this notifier are dropped
+        boost::unique_lock<boost::mutex> lock(csPublishQueue);
+        for (std::deque<CZMQPublishMessage>::iterator it = queuePublish.begin(); it != queuePublish.end(); )
+        {
+            if (it->notifier == this)
+            {
+                nPublishQueueSize -= sizeof(CZMQPublishMessage) + it->data.size();
+                it = queuePublish.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+
+    // Wait for a message of this notifier the publish thread may be sending
+    boost::unique_lock<boost::mutex> lockSend(csPublishSend);
+
     int count = mapPublishNotifiers.count(address);
 
     // remove this notifier from the list of publishers using this address
@@ -126,21 +197,139 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::QueueMessage(const char *command, const void* data, size_t size, const CBlockIndex *pindex)
 {
     assert(psocket);
 
+    boost::unique_lock<boost::mutex> lock(csPublishQueue);
+    if (fSendFailed)
+        return false;
+    if (!fPublishRunning)
+        return true;
+
+    // The sequence number is taken even by dropped messages, that's how subscribers notice them
+    uint32_t nMsgSequence = nSequence++;
+    size_t nMsgSize = sizeof(CZMQPublishMessage) + size;
+    if (nPublishQueueSize + nMsgSize > MAX_ZMQ_PUBLISH_QUEUE_SIZE)
+    {
+        if (nPublishDropped++ == 0)
+            LogPrintf("zmq: Publish queue is full, dropping messages\n");
+        return true;
+    }
+    if (nPublishDropped > 0)
+    {
+        LogPrintf("zmq: Dropped %d messages while the publish queue was full\n", nPublishDropped);
+        nPublishDropped = 0;
+    }
+
+    queuePublish.push_back(CZMQPublishMessage());
+    CZMQPublishMessage& msg = queuePublish.back();
+    msg.notifier = this;
+    msg.command = command;
+    msg.data.assign((const unsigned char*)data, (const unsigned char*)data + size);
+    msg.pindexBlock = pindex;
+    msg.nSequence = nMsgSequence;
+    nPublishQueueSize += nMsgSize;
+    condPublishQueue.notify_one();
+
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+{
+    return QueueMessage(command, data, size, NULL);
+}
+
+bool CZMQAbstractPublishNotifier::SendBlock(const char *command, const CBlockIndex *pindex)
+{
+    return QueueMessage(command, NULL, 0, pindex);
+}
+
+bool CZMQAbstractPublishNotifier::SendMultipart(const char *command, const void* data, size_t size, uint32_t nMsgSequence)
+{
+    boost::unique_lock<boost::mutex> lock(csPublishSend);
+    if (!psocket)
+        return true;
+
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
+    WriteLE32(&msgseq[0], nMsgSequence);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
-    if (rc == -1)
-        return false;
+    return rc != -1;
+}
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+void CZMQAbstractPublishNotifier::SetSendFailed()
+{
+    boost::unique_lock<boost::mutex> lock(csPublishQueue);
+    fSendFailed = true;
+}
 
-    return true;
+static bool SendPublishMessage(const CZMQPublishMessage& msg)
+{
+    if (!msg.pindexBlock)
+        return msg.notifier->SendMultipart(msg.command, begin_ptr(msg.data), msg.data.size(), msg.nSequence);
+
+    std::shared_ptr<const CServedBlock> pblock;
+    {
+        LOCK(cs_main);
+        pblock = recentBlocks.GetOrRead(msg.pindexBlock, Params().GetConsensus());
+        if (!pblock)
+        {
+            zmqError("Can't read block from disk");
+            return false;
+        }
+    }
+    return msg.notifier->SendMultipart(msg.command, pblock->GetSerialized(), pblock->GetSerializedSize(), msg.nSequence);
+}
+
+// Sends the queued messages in batches, so the notifying threads never wait for a subscriber or the disk
+static void ThreadZMQPublish()
+{
+    std::deque<CZMQPublishMessage> queueSend;
+    while (true)
+    {
+        {
+            boost::unique_lock<boost::mutex> lock(csPublishQueue);
+            while (queuePublish.empty() && !fPublishStop)
+                condPublishQueue.wait(lock);
+            // Stopping, after the messages queued before have been sent
+            if (queuePublish.empty())
+                break;
+            queueSend.swap(queuePublish);
+            nPublishQueueSize = 0;
+        }
+
+        // A notifier that failed is shut down by the next notification it gets, as when it sent itself
+        BOOST_FOREACH(const CZMQPublishMessage& msg, queueSend)
+            if (!SendPublishMessage(msg))
+                msg.notifier->SetSendFailed();
+        queueSend.clear();
+    }
+}
+
+void StartZMQPublishThread()
+{
+    boost::unique_lock<boost::mutex> lock(csPublishQueue);
+    assert(!fPublishRunning);
+    fPublishRunning = true;
+    fPublishStop = false;
+    threadPublish = boost::thread(boost::bind(&TraceThread<void (*)()>, "zmqpub", &ThreadZMQPublish));
+}
+
+void StopZMQPublishThread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(csPublishQueue);
+        if (!fPublishRunning)
+            return;
+        fPublishStop = true;
+        condPublishQueue.notify_all();
+    }
+    threadPublish.join();
+
+    boost::unique_lock<boost::mutex> lock(csPublishQueue);
+    fPublishRunning = false;
+    nPublishDropped = 0;
 }
 
 bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
@@ -176,22 +365,7 @@ bool CZMQPublishHashTransactionLockNotifier::NotifyTransactionLock(const CTransa
 bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
-
-    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    {
-        LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        {
-            zmqError("Can't read block from disk");
-            return false;
-        }
-
-        ss << block;
-    }
-
-    return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+    return SendBlock(MSG_RAWBLOCK, pindex);
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
@@ -211,3 +385,43 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishHashTransactionRemovedNotifier::NotifyTransactionRemoved(const CTransaction &transaction, MemPoolRemovalReason reason)
+{
+    uint256 hash = transaction.GetHash();
+    LogPrint("zmq", "zmq: Publish hashtxremoved %s\n", hash.GetHex());
+    char data[33];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    data[32] = (char)reason;
+    return SendMessage(MSG_HASHTXREMOVED, data, 33);
+}
+
+bool CZMQPublishMasternodeListNotifier::NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded)
+{
+    LogPrint("zmq", "zmq: Publish masternodelist %s %s\n", outpoint.ToStringShort(), fAdded ? "added" : "removed");
+    unsigned char data[37];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = outpoint.hash.begin()[i];
+    WriteLE32(&data[32], outpoint.n);
+    data[36] = fAdded ? 1 : 0;
+    return SendMessage(MSG_MASTERNODELIST, data, 37);
+}
+
+bool CZMQPublishHashGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
+{
+    uint256 hash = govobj.GetHash();
+    LogPrint("zmq", "zmq: Publish hashgovernanceobject %s\n", hash.GetHex());
+    char data[32];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = hash.begin()[i];
+    return SendMessage(MSG_HASHGOVOBJ, data, 32);
+}
+
+bool CZMQPublishRawGovernanceObjectNotifier::NotifyGovernanceObject(const CGovernanceObject &govobj)
+{
+    LogPrint("zmq", "zmq: Publish rawgovernanceobject %s\n", govobj.GetHash().GetHex());
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << govobj;
+    return SendMessage(MSG_RAWGOVOBJ, &(*ss.begin()), ss.size());
+}
@@ -9,25 +9,51 @@
 
 class CBlockIndex;
 
+//! Bytes of messages waiting for the publish thread before further messages are dropped
+static const size_t MAX_ZMQ_PUBLISH_QUEUE_SIZE = 64 * 1024 * 1024;
+
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; // upcounting per message sequence number
+    uint32_t nSequence; // upcounting per message sequence number, taken when the message is queued
+    bool fSendFailed; // set by the publish thread when a message couldn't be sent, under the queue lock
 
 public:
+    CZMQAbstractPublishNotifier() : nSequence(0), fSendFailed(false) { }
 
-    /* send zmq multipart message
+    /* queue zmq multipart message for the publish thread
        parts:
           * command
           * data
           * message sequence number
+       A message dropped because the queue is full still takes its
+       sequence number, so subscribers can tell that they missed it.
+       Returns false once the publish thread failed to send one of the
+       messages of this notifier, so it gets shut down.
     */
     bool SendMessage(const char *command, const void* data, size_t size);
+    /* queue a message with the raw block at pindex as data, the
+       block is read from disk by the publish thread */
+    bool SendBlock(const char *command, const CBlockIndex *pindex);
+
+    /* send a queued message, called by the publish thread only,
+       a no-op once the notifier is shut down */
+    bool SendMultipart(const char *command, const void* data, size_t size, uint32_t nMsgSequence);
+    /* called by the publish thread when a message couldn't be sent */
+    void SetSendFailed();
 
     bool Initialize(void *pcontext);
     void Shutdown();
+
+private:
+    bool QueueMessage(const char *command, const void* data, size_t size, const CBlockIndex *pindex);
 };
 
+/** Start the thread that sends the messages queued by all publish notifiers */
+void StartZMQPublishThread();
+/** Send the messages still queued and stop the thread */
+void StopZMQPublishThread();
+
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
@@ -64,4 +90,28 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishHashTransactionRemovedNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionRemoved(const CTransaction &transaction, MemPoolRemovalReason reason);
+};
+
+class CZMQPublishMasternodeListNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyMasternodeListChanged(const COutPoint &outpoint, bool fAdded);
+};
+
+class CZMQPublishHashGovernanceObjectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceObject(const CGovernanceObject &govobj);
+};
+
+class CZMQPublishRawGovernanceObjectNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyGovernanceObject(const CGovernanceObject &govobj);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H